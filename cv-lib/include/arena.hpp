@@ -0,0 +1,162 @@
+/**
+ * @file
+ * @author   Jason M. Carter (carterjm@ornl.gov)
+ * @author   Aaron E. Ferber (ferberae@ornl.gov)
+ * @date     April 2017
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+#ifndef CVDP_DI_ARENA_HPP
+#define CVDP_DI_ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace geo {
+
+/**
+ * @brief The kind of pages a large, long-lived buffer is placed on; see allocate_pages.
+ */
+enum class PageMode {
+    NORMAL,                                                         ///< The heap's ordinary pages.
+    TRANSPARENT_HUGE,                                               ///< Huge-page aligned memory the kernel is asked to back with transparent huge pages.
+    EXPLICIT_HUGE                                                   ///< Memory from the reserved huge page pool (MAP_HUGETLB).
+};
+
+constexpr std::size_t kHugePageSize = 2 * 1024 * 1024;              ///< The huge page size used for alignment and rounding.
+
+/**
+ * @brief Allocate a buffer on the requested kind of pages. With huge pages a buffer that is touched at random (e.g., an
+ * index) needs far fewer TLB entries and page faults.
+ *
+ * When the requested kind is not available (no huge pages are reserved, or the platform has no huge page support), the
+ * next kind down is used: explicit, then transparent, then normal.
+ *
+ * @param bytes the size of the buffer.
+ * @param mode the kind of pages requested; set to the kind that was used.
+ * @return the buffer, aligned for any type; it is released when the last pointer to it is destroyed.
+ * @throws bad_alloc when no memory is available.
+ */
+std::shared_ptr<char> allocate_pages( std::size_t bytes, PageMode& mode );
+
+/**
+ * @brief Return the size of the pages used for a kind of page.
+ *
+ * @param mode the kind of page.
+ * @return the page size in bytes.
+ */
+std::size_t page_size( PageMode mode );
+
+/**
+ * @brief An Arena is a bump allocator for objects that are created together and destroyed together, e.g., the shapes
+ * read from a map file.
+ *
+ * Memory is taken from large blocks in allocation order, so objects built one after another are next to each other in
+ * memory and there is no per-object allocation overhead. Individual allocations are never returned; all the blocks are
+ * released at once when the arena is destroyed. An arena is not thread safe; it is filled by one thread.
+ */
+class Arena {
+    public:
+        using Ptr = std::shared_ptr<Arena>;                         ///< Shared pointer to an arena.
+
+        static constexpr std::size_t kDefaultBlockSize = 1024 * 1024;   ///< The default size of each block in bytes.
+
+        /**
+         * @brief Construct an empty arena; no memory is allocated until the first allocation.
+         *
+         * @param block_size the size of the blocks to allocate; larger requests get a block of their own.
+         */
+        explicit Arena( std::size_t block_size = kDefaultBlockSize );
+
+        Arena( const Arena& ) = delete;
+        Arena& operator=( const Arena& ) = delete;
+
+        /**
+         * @brief Allocate memory from the current block, starting a new block when it does not have enough room.
+         *
+         * @param bytes the number of bytes to allocate.
+         * @param alignment the required alignment; a power of two no larger than alignof(std::max_align_t).
+         * @return a pointer to the memory; it remains valid until the arena is destroyed.
+         */
+        void* allocate( std::size_t bytes, std::size_t alignment );
+
+        std::size_t bytes_allocated() const;                        ///< The number of bytes handed out.
+        std::size_t bytes_reserved() const;                         ///< The total size of the blocks.
+        std::size_t block_count() const;                            ///< The number of blocks.
+
+    private:
+        std::size_t block_size_;                                    ///< The size of a standard block.
+        std::vector<std::unique_ptr<char[]>> blocks_;               ///< The blocks; freed when the arena is destroyed.
+        char* next_;                                                ///< The next free byte in the current block.
+        std::size_t remaining_;                                     ///< The free bytes in the current block.
+        std::size_t allocated_;                                     ///< The bytes handed out.
+        std::size_t reserved_;                                      ///< The bytes in all blocks.
+};
+
+/**
+ * @brief A standard allocator that takes memory from an Arena; used with std::allocate_shared so the object and its
+ * control block are placed in the arena. Each copy of the allocator (including the one kept in a shared_ptr's control
+ * block) shares ownership of the arena, so the arena lives until the last object allocated from it is destroyed.
+ */
+template <typename T>
+class ArenaAllocator {
+    public:
+        using value_type = T;
+
+        /**
+         * @brief Construct an allocator for an arena.
+         *
+         * @param arena_ptr the arena to allocate from.
+         */
+        explicit ArenaAllocator( Arena::Ptr arena_ptr ) : arena_ptr_{ arena_ptr } {}
+
+        template <typename U>
+        ArenaAllocator( const ArenaAllocator<U>& other ) : arena_ptr_{ other.get_arena() } {}
+
+        T* allocate( std::size_t n ) {
+            return static_cast<T*>( arena_ptr_->allocate( n * sizeof(T), alignof(T) ) );
+        }
+
+        void deallocate( T*, std::size_t ) {
+            // memory is released with the arena.
+        }
+
+        const Arena::Ptr& get_arena() const {
+            return arena_ptr_;
+        }
+
+        template <typename U>
+        bool operator==( const ArenaAllocator<U>& other ) const {
+            return arena_ptr_ == other.get_arena();
+        }
+
+        template <typename U>
+        bool operator!=( const ArenaAllocator<U>& other ) const {
+            return arena_ptr_ != other.get_arena();
+        }
+
+    private:
+        Arena::Ptr arena_ptr_;                                      ///< The arena memory is taken from.
+};
+
+}
+
+#endif
@@ -26,6 +26,7 @@
 #ifndef CVDP_DI_ENTITY_HPP
 #define CVDP_DI_ENTITY_HPP
 
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <limits>
@@ -148,6 +149,36 @@ struct Point {
     friend std::ostream& operator<<(std::ostream& os, const Point& pt);
 };
 
+/**
+ * @brief The interval of time during which a shape is part of the geofence, e.g., the hours of a work zone. Times are
+ * seconds since the Unix epoch (UTC); the interval includes from and excludes to.
+ */
+struct Validity {
+    static constexpr int64_t kBeginning = std::numeric_limits<int64_t>::min();   ///< The from of a shape valid since forever.
+    static constexpr int64_t kEnd = std::numeric_limits<int64_t>::max();         ///< The to of a shape valid forever.
+
+    int64_t from;                                           ///< The first second the shape is valid.
+    int64_t to;                                             ///< The first second the shape is no longer valid.
+
+    /**
+     * @brief Construct a validity that always holds.
+     */
+    Validity() : from{ kBeginning }, to{ kEnd } {}
+
+    /**
+     * @brief Construct a validity interval.
+     *
+     * @param valid_from the first second the shape is valid.
+     * @param valid_to the first second the shape is no longer valid.
+     */
+    Validity( int64_t valid_from, int64_t valid_to ) : from{ valid_from }, to{ valid_to } {}
+
+    bool always() const { return from == kBeginning && to == kEnd; }                ///< True when the interval has no limits.
+    bool contains( int64_t time ) const { return from <= time && time < to; }       ///< True when time is in the interval.
+    bool operator==( const Validity& other ) const { return from == other.from && to == other.to; }
+    bool operator!=( const Validity& other ) const { return !(*this == other); }
+};
+
 /**
  * @brief Interface for entities which can be partially contained within other
  * entities. Entity is the base class for all shapes, points, lines, etc.
@@ -166,6 +197,13 @@ class Entity {
          */ 
         virtual const std::string get_type(void) const = 0;
 
+        /**
+         * @brief Get the unique identifier of this entity; identifiers are only unique among entities of the same type.
+         *
+         * @return uint64_t The unique identifier of this entity; 0 for entities that are not identified.
+         */
+        virtual uint64_t get_uid(void) const = 0;
+
         /**
          * @brief Determine is this entity is within the bounds object.
          * 
@@ -174,6 +212,13 @@ class Entity {
          *              false.      
          */ 
         virtual bool touches(const Bounds& bounds) const = 0;
+
+        /**
+         * @brief Get the interval of time during which this entity is part of the geofence.
+         *
+         * @return Validity The interval; entities without one are always valid.
+         */
+        virtual Validity get_validity(void) const;
 };
 
 /**
@@ -356,6 +401,13 @@ class Location : public Point, public Entity {
          */ 
         const std::string get_type(void) const;
 
+        /**
+         * @brief Get the unique identifier of this location.
+         *
+         * @return uint64_t The unique ID of the location.
+         */
+        uint64_t get_uid(void) const;
+
         /**
          * @brief Determine is this location is within the bounds object.
          * 
@@ -824,6 +876,19 @@ class Edge : public Entity {
          */
         AreaPtr to_area( double capwidth, double extension ) const;
 
+        /**
+         * @brief Make the area that encapsulates the segment between two locations; this is the area #to_area
+         * returns for an edge with these vertices.
+         *
+         * @param loc1 the first end of the segment.
+         * @param loc2 the second end of the segment.
+         * @param cap_width the total width of the area in meters.
+         * @param extension the meters to extend the area from each end of the segment.
+         * @return a shared pointer to the area that encapsulates the segment.
+         * @throws ZeroAreaException when there area characterizes 0 space.
+         */
+        static AreaPtr make_area( const Location& loc1, const Location& loc2, double cap_width, double extension );
+
         /**
          * @brief Operator that evaluates whether two edges are equivalent based ONLY
          * on their vertex coordinates.
@@ -855,10 +920,25 @@ class Edge : public Entity {
          */
         friend std::ostream& operator<< (std::ostream& os, const Edge& edge);
 
+        /**
+         * @brief Get the interval of time during which this edge is part of the geofence.
+         *
+         * @return the interval; always valid unless set.
+         */
+        Validity get_validity(void) const;
+
+        /**
+         * @brief Limit the time during which this edge is part of the geofence.
+         *
+         * @param validity the interval.
+         */
+        void set_validity(const Validity& validity);
+
     private:
         uint64_t uid_;                       ///< This edge's unique identifier.
         osm::Highway way_type_;              ///< This edge's OSM way type.
         bool explicit_edge_;                 ///< Indicates how this edge was constructed: from an OSM segment or inferred from the trip.
+        Validity validity_;                  ///< When this edge is part of the geofence.
 };
 
 /**
@@ -914,6 +994,13 @@ class Area : public Entity {
          */ 
         const std::string get_type(void) const;
 
+        /**
+         * @brief Areas are derived shapes and are not identified.
+         *
+         * @return uint64_t Always 0.
+         */
+        uint64_t get_uid(void) const;
+
         /**
          * @brief Predicate that indicates whether this area is contained within the 
          * provided bounds or intersects spatially the bounds.
@@ -956,6 +1043,29 @@ class Area : public Entity {
          */
         bool outside_edge( int edge, const Point& loc ) const;
 
+        /**
+         * @brief Predicate that indicates whether the area described by the
+         * provided corners contains the provided point; see #contains. This
+         * allows areas to be stored as plain corner arrays.
+         *
+         * @param corners the four corners in the order of #get_corners.
+         * @param loc the location whose containment is checked.
+         * @return true if the point is within the area; false otherwise.
+         */
+        static bool contains( const Point* corners, const Point& loc );
+
+        /**
+         * @brief Predicate that indicates whether the point is outside (to the
+         * left of) an edge of the area described by the provided corners; see
+         * #outside_edge.
+         *
+         * @param corners the four corners in the order of #get_corners.
+         * @param edge the index of the edge.
+         * @param loc the point whose position is being checked.
+         * @return true if the point is to the left of the edge.
+         */
+        static bool outside_edge( const Point* corners, int edge, const Point& loc );
+
         /**
          * @brief Return a constant reference to the list of corners that
          * describe this area.
@@ -1087,6 +1197,23 @@ class Circle : public Location {
          * @return std::ostream& Returns the given stream object.
          */
         friend std::ostream& operator<< (std::ostream& os, const Circle& circle);
+
+        /**
+         * @brief Get the interval of time during which this circle is part of the geofence.
+         *
+         * @return the interval; always valid unless set.
+         */
+        Validity get_validity(void) const;
+
+        /**
+         * @brief Limit the time during which this circle is part of the geofence.
+         *
+         * @param validity the interval.
+         */
+        void set_validity(const Validity& validity);
+
+    private:
+        Validity validity_;                         ///< When this circle is part of the geofence.
 };
 
 /** @brief A boundary is a horizontally/vertically oriented rectangle based on a
@@ -1297,6 +1424,22 @@ class Grid : public Bounds, public Entity {
          */ 
         const std::string get_type(void) const;
 
+        /**
+         * @brief Get the unique identifier of this grid square composed from its row and column.
+         *
+         * @return uint64_t The row in the upper 32 bits and the column in the lower 32 bits.
+         */
+        uint64_t get_uid(void) const;
+
+        /**
+         * @brief Compose the unique identifier of a grid square from its row and column; see #get_uid.
+         *
+         * @param row The row index of the grid square.
+         * @param col The column index of the grid square.
+         * @return uint64_t The unique identifier.
+         */
+        static uint64_t make_uid(uint32_t row, uint32_t col);
+
         /**
          * @brief Predicate indicating whether any of the corners of this grid are within
          * the provided bounds, the grid is contained in the bounds, or the bounds is contained in the grid.
@@ -1325,6 +1468,144 @@ class Grid : public Bounds, public Entity {
          * @return the stream after the grid has been written.
          */
         friend std::ostream& operator<< (std::ostream& os, const Grid& grid);
+
+        /**
+         * @brief Get the interval of time during which this grid cell is part of the geofence.
+         *
+         * @return the interval; always valid unless set.
+         */
+        Validity get_validity(void) const;
+
+        /**
+         * @brief Limit the time during which this grid cell is part of the geofence.
+         *
+         * @param validity the interval.
+         */
+        void set_validity(const Validity& validity);
+
+    private:
+        Validity validity_;                             ///< When this grid cell is part of the geofence.
+};
+
+/**
+ * @brief A Polyline is a way, or a part of one, as a sequence of vertices; it replaces the chain of Edges between them.
+ *
+ * Each segment is buffered like an Edge with the polyline's way type (see Edge::make_area), so a polyline covers
+ * exactly the space its edges would, but it is one entity in a Quad leaf instead of one per segment.
+ */
+class Polyline : public Entity {
+    public:
+        using Ptr = std::shared_ptr<Polyline>;              ///< A shared pointer to a Polyline instance.
+        using CPtr = std::shared_ptr<const Polyline>;       ///< A shared pointer to a constant Polyline instance.
+
+        /**
+         * @brief Create a Polyline from its vertices.
+         *
+         * @param vertices The vertices in way order.
+         * @param way_type The OSM way type of every segment.
+         * @param id A unique identifier for this polyline; typically the identifier of its first edge.
+         * @throws invalid_argument when there are fewer than two vertices.
+         */
+        Polyline(const std::vector<Location>& vertices, osm::Highway way_type, uint64_t id);
+
+        /**
+         * @brief Get a string identifier for this entity type.
+         *
+         * @return std::string The type of this entity.
+         */
+        const std::string get_type(void) const;
+
+        /**
+         * @brief Return the unique identifier for this polyline.
+         *
+         * @return a 64-bit integer that uniquely identifies this polyline.
+         */
+        uint64_t get_uid(void) const;
+
+        /**
+         * @brief Predicate indicating whether any segment of this polyline touches the bounds; see Edge::touches.
+         *
+         * @param bounds Bounds object to test against.
+         * @return bool True if this polyline touches the bounds, otherwise False.
+         */
+        bool touches(const Bounds& bounds) const;
+
+        /**
+         * @brief Predicate indicating whether one segment of this polyline touches the bounds.
+         *
+         * @param segment The index of the segment; segment i runs from vertex i to vertex i + 1.
+         * @param bounds Bounds object to test against.
+         * @return bool True if the segment touches the bounds, otherwise False.
+         */
+        bool segment_touches(std::size_t segment, const Bounds& bounds) const;
+
+        /**
+         * @brief Return the area that encapsulates one segment of this polyline; this is the area Edge::to_area returns
+         * for an edge with the segment's vertices and this polyline's way type.
+         *
+         * @param segment The index of the segment.
+         * @param extension the meters to extend the area from each end of the segment.
+         * @return a shared pointer to the area that encapsulates the segment.
+         * @throws ZeroAreaException when there area characterizes 0 space.
+         */
+        AreaPtr segment_area(std::size_t segment, double extension) const;
+
+        /**
+         * @brief Return the number of segments; one less than the number of vertices.
+         *
+         * @return the number of segments.
+         */
+        std::size_t segment_count() const;
+
+        /**
+         * @brief Return the vertices of this polyline in way order.
+         *
+         * @return an immutable vector of the vertices.
+         */
+        const std::vector<Location>& get_vertices() const;
+
+        /**
+         * @brief Return the OSM highway type associated with this polyline.
+         *
+         * @return an instance of the enumeration used to describe OSM way types.
+         */
+        osm::Highway get_way_type() const;
+
+        /**
+         * @brief Return the width of each segment in meters.
+         *
+         * @return the width of this OSM way in meters.
+         */
+        double get_way_width() const;
+
+        /**
+         * @brief Write a readable form of this polyline to the provided stream.
+         *
+         * @param os the stream to write the polyline to.
+         * @param polyline the polyline to convert into readable form and output to the stream.
+         * @return the stream.
+         */
+        friend std::ostream& operator<< (std::ostream& os, const Polyline& polyline);
+
+        /**
+         * @brief Get the interval of time during which this polyline is part of the geofence.
+         *
+         * @return the interval; always valid unless set.
+         */
+        Validity get_validity(void) const;
+
+        /**
+         * @brief Limit the time during which this polyline is part of the geofence.
+         *
+         * @param validity the interval.
+         */
+        void set_validity(const Validity& validity);
+
+    private:
+        std::vector<Location> vertices_;     ///< The vertices in way order.
+        osm::Highway way_type_;              ///< The OSM way type of every segment.
+        uint64_t uid_;                       ///< This polyline's unique identifier.
+        Validity validity_;                  ///< When this polyline is part of the geofence.
 };
 
 }
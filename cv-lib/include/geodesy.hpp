@@ -0,0 +1,106 @@
+/**
+ * @file
+ * @author   Jason M. Carter (carterjm@ornl.gov)
+ * @author   Aaron E. Ferber (ferberae@ornl.gov)
+ * @date     April 2017
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+#ifndef CVDP_DI_GEODESY_HPP
+#define CVDP_DI_GEODESY_HPP
+
+#include <cstddef>
+
+#include "entity.hpp"
+
+namespace geo {
+
+/**
+ * @brief Batch versions of the Location geodesy methods.
+ *
+ * Each function applies the formula of the Location method of the same name to n inputs held in separate arrays of
+ * latitudes, longitudes, bearings, and distances (decimal degrees and meters, as for Location) and writes n results.
+ * They construct no Location instances, and their loops have no branches or library calls: the sines, cosines, and
+ * arctangents are range reduction and polynomials, and choices are made by arithmetic, so the compiler runs several
+ * inputs at once in vector registers (geodesy.cpp is compiled without errno and trap semantics for this; the results are
+ * the same IEEE results either way).
+ *
+ * The polynomials have the coefficients of the fdlibm kernels. Over the inputs of a map (latitudes within +/-85 degrees,
+ * distances up to 1000 km) their largest errors against the exact functions are:
+ * - sin and cos: 2.3e-16 (absolute).
+ * - atan2: 4.5e-16 radians.
+ *
+ * and the largest errors of the results against the exact formulas are:
+ * - distance and distance_haversine: 3e-15 of the distance, and 1e-9 meters.
+ * - bearing: 2e-7 degrees divided by the distance in meters between the locations.
+ * - project_position: 5e-11 degrees.
+ *
+ * The Location methods round differently (they take the difference of radians rather than of degrees), so the two
+ * agree to the sum of their errors rather than bit for bit: about 1e-8 of the distance plus 1e-8 meters, and 1e-9
+ * degrees.
+ *
+ * Output arrays may be the same as input arrays.
+ */
+namespace batch {
+
+/**
+ * @brief The equirectangular distance in meters between n pairs of locations; see Location::distance.
+ */
+void distance( const double* lat1, const double* lon1, const double* lat2, const double* lon2, double* meters, std::size_t n );
+
+/**
+ * @brief The Haversine distance in meters between n pairs of locations; see Location::distance_haversine.
+ */
+void distance_haversine( const double* lat1, const double* lon1, const double* lat2, const double* lon2, double* meters, std::size_t n );
+
+/**
+ * @brief The initial bearing in decimal degrees, [0, 360), from the first to the second location of n pairs; see
+ * Location::bearing.
+ */
+void bearing( const double* lat1, const double* lon1, const double* lat2, const double* lon2, double* degrees, std::size_t n );
+
+/**
+ * @brief Project n locations along a bearing in decimal degrees for a distance in meters; see
+ * Location::project_position. Longitudes are in [-180, 180).
+ */
+void project_position( const double* lat, const double* lon, const double* bearing, const double* distance,
+        double* lat_out, double* lon_out, std::size_t n );
+
+/**
+ * @brief The four corners of the area around each of n segments, in the order of Area::get_corners; see
+ * Edge::make_area. The widths must be positive.
+ *
+ * @param lat1 The latitude of the first end of each segment.
+ * @param lon1 The longitude of the first end of each segment.
+ * @param lat2 The latitude of the second end of each segment.
+ * @param lon2 The longitude of the second end of each segment.
+ * @param width The width of each area in meters.
+ * @param extension The meters the areas extend past each end of the segments.
+ * @param corners Set to the 4 * n corners.
+ * @param n The number of segments.
+ */
+void segment_areas( const double* lat1, const double* lon1, const double* lat2, const double* lon2, const double* width,
+        double extension, Point* corners, std::size_t n );
+
+}  // end namespace batch.
+
+}  // end namespace geo.
+
+#endif
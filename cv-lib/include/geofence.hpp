@@ -0,0 +1,708 @@
+/**
+ * @file
+ * @author   Jason M. Carter (carterjm@ornl.gov)
+ * @author   Aaron E. Ferber (ferberae@ornl.gov)
+ * @date     April 2017
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+#ifndef CVDP_DI_GEOFENCE_HPP
+#define CVDP_DI_GEOFENCE_HPP
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include "arena.hpp"
+#include "entity.hpp"
+#include "roadgraph.hpp"
+#include "quad.hpp"
+
+/**
+ * @brief A Geofence is the read-only query index of one or more Quad trees, one per region.
+ *
+ * The tree's nodes are copied into one array and the contents of each leaf into one array of 32-bit shape indices. The
+ * shapes themselves are stored in a shape table as plain values: edges as the corners of their buffered areas (see
+ * Edge::to_area), circles as a center and radius, and grid cells as bounds. An entity that is in several leaves has one
+ * entry in the shape table.
+ *
+ * The buffered segments of a polyline (see geo::Polyline) are stored next to each other, in way order. A leaf refers to
+ * the segments of a polyline that touch it by their runs: one shape table entry per run of consecutive segments, whose
+ * areas are checked in one pass over contiguous corners.
+ *
+ * Edges and polyline segments can instead be indexed as capsules (see EdgeModel): every point within a distance of the
+ * segment, measured on a plane tangent at its first end. A capsule test is a dot product and a compare, and capsules
+ * have round ends, so consecutive segments of a road overlap at every bend.
+ *
+ * All of the arrays are placed in a single allocation in quad order: the nodes depth first, and the shapes in the order
+ * the leaves are visited, so the shapes of a leaf, and of neighboring leaves, are next to each other in memory. Releasing
+ * an index is a single free.
+ *
+ * Queries (#contains and #retrieve_shapes) use only these arrays: they do not allocate and do not touch any reference
+ * counts, so any number of threads can query one instance. The Quads the instance was built from are kept so they can
+ * be copied and changed to build the next instance.
+ *
+ * The buffer is also the index's image: it starts with a header giving the offset of each array, and the arrays refer to
+ * each other by index, never by address, so the same bytes can be written to a file and used by another process at any
+ * address (see #image and the image constructor). An instance made from an image has no source Quads.
+ *
+ * Grid cells (see Grid::build_grid) that form a regular lattice within a region, with uniform row heights and uniform
+ * column widths within each row, are not put in the leaves. Instead each region has a bitmap of its lattice, and a
+ * point's row and column are computed directly, so a query against a grid map takes constant time however many cells it
+ * has. The lattice is detected when the index is built; grids that do not fit one are indexed like other shapes.
+ *
+ * Shapes that are only part of the geofence for an interval of time (see geo::Validity) are kept out of the leaves'
+ * shape lists. Each leaf has a separate list of windows, each a shape and its interval, sorted by the start of the
+ * interval: a query at a time stops at the first window that has not started and skips those that have ended by
+ * comparing times, so shapes that are not valid are never tested. A leaf without windows costs nothing extra.
+ *
+ * Independent regions (e.g., one per state or corridor) each have their own tree. The region roots are the first nodes,
+ * so a point outside every region is rejected after one box comparison per region without touching any tree. Regions
+ * should not overlap; a point in more than one region is checked against each of them.
+ */
+class Geofence {
+    public:
+        using Ptr = std::shared_ptr<Geofence>;                      ///< Shared pointer to a geofence.
+        using CPtr = std::shared_ptr<const Geofence>;               ///< Shared pointer to a constant geofence.
+
+        /**
+         * @brief The kinds of shapes in the shape table.
+         */
+        enum class ShapeType : uint32_t {
+            AREA,                                                   ///< A four cornered area; the buffer around an edge.
+            CIRCLE,                                                 ///< A circle.
+            GRID,                                                   ///< A grid cell.
+            POLYLINE,                                               ///< A run of consecutive buffered segments of a polyline.
+            CAPSULE,                                                ///< The capsule around an edge.
+            CAPSULE_RUN                                             ///< A run of the capsules around consecutive segments of a polyline.
+        };
+
+        /**
+         * @brief How edges and polyline segments are buffered.
+         */
+        enum class EdgeModel : uint32_t {
+            AREA,                                                   ///< A rectangle of the way's width, extended from each end by the extension; see Edge::to_area.
+            CAPSULE                                                 ///< The points within half the way's width plus the extension of the segment.
+        };
+
+        /**
+         * @brief How a box relates to the geofence; see #classify.
+         */
+        enum class Cover : uint32_t {
+            OUTSIDE,                                                ///< #contains is false for every point of the box.
+            INSIDE,                                                 ///< #contains is true for every point of the box.
+            MIXED                                                   ///< The box may have points of both kinds.
+        };
+
+        /**
+         * @brief How far inside the geofence a point is; see #grade.
+         */
+        enum class Grade : uint32_t {
+            OUTSIDE,                                                ///< #contains is false.
+            BUFFER,                                                 ///< Only inside the extension of edges and polyline segments.
+            CORE                                                    ///< Inside the way width of an edge or polyline segment, a circle, or a grid cell.
+        };
+
+        /**
+         * @brief An entry in the shape table.
+         */
+        struct Shape {
+            ShapeType type;                                         ///< The kind of shape.
+            uint32_t index;                                         ///< The index of the shape's geometry in the table for its kind.
+        };
+
+        /**
+         * @brief The hits one searcher counted in an index; see #count_hits and #reordered.
+         *
+         * Only the searcher that asked for the table adds to it, so no hit is lost and no other thread writes its cache
+         * lines; the counts are atomics only so #reordered can read them while the searcher runs.
+         */
+        class Hits {
+            public:
+                using Ptr = std::shared_ptr<Hits>;                  ///< Shared pointer to a table of hits.
+
+                /**
+                 * @brief Make a table of zero hits for each entry of an index's leaf shape list.
+                 *
+                 * @param size The number of entries.
+                 */
+                explicit Hits( uint32_t size );
+
+                void add( uint32_t entry );                         ///< Count a hit for an entry; only from the owning searcher.
+                uint32_t get( uint32_t entry ) const;               ///< The hits counted for an entry.
+
+            private:
+                std::unique_ptr<std::atomic<uint32_t>[]> counts_;   ///< The hits of each entry.
+        };
+
+        /**
+         * @brief Build the index of a Quad tree.
+         *
+         * Edges and polyline segments whose buffered area has no size (see ZeroAreaException) cannot contain a point and
+         * are left out.
+         *
+         * @param quad_ptr The root of the tree; it must not be changed after it is indexed.
+         * @param extension The meters to extend the area around each edge from each end of the edge.
+         * @throws invalid_argument when quad_ptr is null.
+         */
+        Geofence( Quad::CPtr quad_ptr, double extension );
+
+        /**
+         * @brief Build the index of several independent Quad trees, one per region.
+         *
+         * @param regions The root of each region's tree; they must not be changed after they are indexed.
+         * @param extension The meters to extend the area around each edge from each end of the edge.
+         * @param pages The kind of pages to place the index on; see geo::allocate_pages and #page_mode.
+         * @param edges How edges and polyline segments are buffered.
+         * @throws invalid_argument when there are no regions or a root is null.
+         */
+        Geofence( const std::vector<Quad::CPtr>& regions, double extension, geo::PageMode pages = geo::PageMode::NORMAL,
+                  EdgeModel edges = EdgeModel::AREA );
+
+        /**
+         * @brief Use an index image made by another instance (see #image) without copying it, e.g., a read-only memory
+         * mapping of a file shared by several processes. The instance has no source Quads.
+         *
+         * @param image The image; it is kept, and must not change, as long as this instance exists.
+         * @param size The size of the image in bytes.
+         * @throws invalid_argument when image is null, misaligned, or is not a complete image of this version.
+         */
+        Geofence( std::shared_ptr<const char> image, std::size_t size );
+
+        Geofence( const Geofence& ) = delete;
+        Geofence& operator=( const Geofence& ) = delete;
+
+        /**
+         * @brief Predicate indicating whether a point is inside any shape of the leaf that contains it, in any region.
+         * The validity of the shapes is not checked; every shape counts.
+         *
+         * @param pt The point to check.
+         * @return true if the point is inside the geofence; false otherwise, including points outside the root.
+         */
+        bool contains( const geo::Point& pt ) const;
+
+        /**
+         * @brief Predicate indicating whether a point is inside any shape of the leaf that contains it, in any region,
+         * that is valid at a time.
+         *
+         * @param pt The point to check.
+         * @param time The time in seconds since the Unix epoch (UTC); see geo::Validity.
+         * @param hits The table to count the hit in, from #count_hits; null to count nothing.
+         * @return true if the point is inside the geofence at that time; false otherwise.
+         */
+        bool contains( const geo::Point& pt, int64_t time, Hits* hits = nullptr ) const;
+
+        /**
+         * @brief Grade a point in the same search as #contains: CORE when some shape contains it without its extension
+         * (an edge or polyline segment within the way's width and not past its ends, a circle, or a grid cell), BUFFER
+         * when it is only inside the extension, and OUTSIDE otherwise. A point in a buffer goes on to the rest of the
+         * leaf's shapes, as one of them could hold it in its core.
+         *
+         * @param pt The point to grade.
+         * @return the point's grade; grade( pt ) != Grade::OUTSIDE exactly when contains( pt ).
+         */
+        Grade grade( const geo::Point& pt ) const;
+
+        /**
+         * @brief Grade a point against the shapes that are valid at a time; see #grade and #contains.
+         *
+         * @param pt The point to grade.
+         * @param time The time in seconds since the Unix epoch (UTC); see geo::Validity.
+         * @param hits The table to count the hit in, from #count_hits; null to count nothing.
+         * @return the point's grade at that time.
+         */
+        Grade grade( const geo::Point& pt, int64_t time, Hits* hits = nullptr ) const;
+
+        /**
+         * @brief Classify a small box, e.g., the cell of a position cache, against the geofence.
+         *
+         * The answer is conservative: a box is INSIDE only when it is inside a single leaf and one of that leaf's shapes
+         * contains all of it, and OUTSIDE only when it is outside every region or inside a single leaf and none of that
+         * leaf's shapes comes near it. Everything else, including boxes on a region or leaf boundary, is MIXED. The
+         * answer holds at any time: a box that a shape with a limited validity comes near is never OUTSIDE, and such a
+         * shape never makes it INSIDE.
+         *
+         * @param sw The southwest corner of the box.
+         * @param ne The northeast corner of the box.
+         * @return how the box relates to the geofence.
+         */
+        Cover classify( const geo::Point& sw, const geo::Point& ne ) const;
+
+        /**
+         * @brief Return the shape table indices of the shapes in the leaf that contains the point in the first region
+         * that contains it; see Quad::retrieve_elements.
+         *
+         * @param pt The point whose leaf we are interested in.
+         * @return A view of the leaf's shape indices; empty when the point is outside the root. Grid cells in a
+         * region's lattice and shapes with a limited validity are not included.
+         */
+        geo::IndexRange retrieve_shapes( const geo::Point& pt ) const;
+
+        /**
+         * @brief Predicate indicating whether a shape in the shape table contains a point.
+         *
+         * @param shape The index of the shape in the shape table.
+         * @param pt The point to check.
+         * @return true if the shape contains the point.
+         */
+        bool shape_contains( uint32_t shape, const geo::Point& pt ) const;
+
+        const Shape& get_shape( uint32_t shape ) const;             ///< The entry for a shape in the shape table.
+        uint32_t shape_count() const;                               ///< The number of entries in the shape table.
+        uint32_t node_count() const;                                ///< The number of tree nodes.
+        uint32_t region_count() const;                              ///< The number of regions.
+        std::size_t lattice_cell_count() const;                     ///< The number of grid cells in the regions' lattices.
+        uint32_t window_count() const;                              ///< The number of leaf windows; 0 when every shape is always valid.
+        uint32_t coverage_leaf_count() const;                       ///< The number of leaves whose areas are answered by their coverage.
+
+        /**
+         * @brief Return a new table of hits for one searcher, e.g., a BSM handler, to pass to #contains and #grade.
+         *
+         * A search given the table that finds a point inside a shape of a leaf with more than one shape counts a hit for
+         * that shape in it. Each searcher counts in its own table, so the index stays read only while it is searched;
+         * #reordered adds up the tables.
+         *
+         * @return the table; it stays with this index and is only valid for its searches.
+         */
+        Hits::Ptr count_hits() const;
+
+        /**
+         * @brief Return the hits counted in this index's tables, and those it started with; see #reordered.
+         */
+        uint64_t hit_count() const;
+
+        /**
+         * @brief Return a copy of the index with the shapes of each leaf in order of their hits, most first.
+         *
+         * The hits are those of every table from #count_hits, so a copy made under traffic tests first the shapes the
+         * traffic is in and stops sooner. The copy answers every query as this index does and starts with half of this
+         * index's counts, so its order follows the traffic as it changes. A table read while its searcher counts may
+         * miss the newest hits, which only makes the order approximate.
+         *
+         * @return the copy; null when every leaf is already in that order.
+         */
+        CPtr reordered() const;
+
+        /**
+         * @brief Return an id shared only by indices that answer every query alike.
+         *
+         * Each index gets a new id when it is built or loaded; a copy from #reordered keeps the id of its source, so a
+         * searcher that caches answers can keep them when it moves to the copy.
+         */
+        uint64_t answers() const;
+
+        /**
+         * @brief Return the number of bytes used by the index's arrays, not counting the source Quad.
+         *
+         * @return the memory used in bytes.
+         */
+        std::size_t memory_usage() const;
+
+        /**
+         * @brief Return the start of the index's image; it is #memory_usage bytes long and position independent.
+         *
+         * @return a pointer to the image, aligned for any type.
+         */
+        const char* image() const;
+
+        /**
+         * @brief Return the version of the image layout; images of another version are rejected.
+         */
+        static uint32_t image_version();
+
+        /**
+         * @brief Return the kind of pages the index is on; this can be less than what was requested, and is NORMAL for
+         * an instance made from an image.
+         *
+         * @return the kind of pages.
+         */
+        geo::PageMode page_mode() const;
+
+        /**
+         * @brief Read every cache line of the index so its pages are mapped, in the TLB, and in cache before the first
+         * query; queries into a cold index take page faults.
+         *
+         * @return the number of pages touched.
+         */
+        std::size_t warm_up() const;
+
+        /**
+         * @brief Predicate indicating whether the instance has the Quads it was built from; false when it was made
+         * from an image.
+         *
+         * @return true if #get_quad can be used.
+         */
+        bool has_source() const;
+
+        double get_extension() const;                               ///< The extension used to build the edge areas.
+        EdgeModel edge_model() const;                               ///< How edges and polyline segments are buffered.
+
+        /**
+         * @brief Return the Quad tree a region was built from.
+         *
+         * @param region The index of the region.
+         * @return the root of the region's tree.
+         * @throws out_of_range when there is no such region or the instance has no source Quads.
+         */
+        const Quad& get_quad( uint32_t region = 0 ) const;
+
+    private:
+        /**
+         * @brief A tree node. The children of a node are stored next to each other, so they are identified by the
+         * first one and their number; a leaf's shapes are a range of leaf_shapes_ and its windows a range of windows_.
+         */
+        struct Node {
+            geo::Point sw;                                          ///< The southwest corner of the retrieval bounds.
+            geo::Point ne;                                          ///< The northeast corner of the retrieval bounds.
+            uint32_t first_child;                                   ///< The index of the first child.
+            uint32_t child_count;                                   ///< The number of children; 0 for a leaf.
+            uint32_t first_shape;                                   ///< The index of the leaf's first entry in leaf_shapes_.
+            uint32_t shape_count;                                   ///< The number of the leaf's entries in leaf_shapes_.
+            uint32_t first_window;                                  ///< The index of the leaf's first entry in windows_.
+            uint32_t window_count;                                  ///< The number of the leaf's entries in windows_.
+            uint32_t first_slab;                                    ///< The index of the leaf's first slab in slabs_.
+            uint32_t slab_count;                                    ///< The number of the leaf's slabs; 0 when the leaf has no coverage.
+            uint32_t covered_count;                                 ///< The number of the leaf's first entries the coverage answers for.
+            uint32_t reserved;                                      ///< Padding.
+        };
+
+        /**
+         * @brief A band of longitudes of a leaf's coverage (see #add_coverage). No side of a covered area has an end or
+         * a crossing inside the band, so the union of the areas in it is a few pieces, each between two straight lines.
+         */
+        struct Slab {
+            double west;                                            ///< The western edge of the band.
+            double east;                                            ///< The eastern edge of the band; greater than west.
+            uint32_t first_piece;                                   ///< The index of the band's southernmost piece in pieces_.
+            uint32_t piece_count;                                   ///< The number of the band's pieces.
+        };
+
+        /**
+         * @brief A piece of a slab's coverage: the points between its lower and upper lines, which are given by their
+         * latitudes at the slab's edges. The pieces of a slab are disjoint and ordered south to north.
+         */
+        struct Piece {
+            double lower_west;                                      ///< The latitude of the lower line at the western edge.
+            double lower_east;                                      ///< The latitude of the lower line at the eastern edge.
+            double upper_west;                                      ///< The latitude of the upper line at the western edge.
+            double upper_east;                                      ///< The latitude of the upper line at the eastern edge.
+        };
+
+        /**
+         * @brief A shape of a leaf that is only valid for an interval of time; see geo::Validity.
+         */
+        struct Window {
+            int64_t from;                                           ///< The first second the shape is valid.
+            int64_t to;                                             ///< The first second the shape is no longer valid.
+            uint32_t shape;                                         ///< The index of the shape in the shape table.
+            uint32_t reserved;                                      ///< Padding.
+        };
+
+        /**
+         * @brief The geometry of a circle.
+         */
+        struct Disc {
+            geo::Point center;                                      ///< The center of the circle.
+            double radius;                                          ///< The radius of the circle in meters.
+        };
+
+        /**
+         * @brief The geometry of a grid cell.
+         */
+        struct Box {
+            geo::Point sw;                                          ///< The southwest corner.
+            geo::Point ne;                                          ///< The northeast corner.
+        };
+
+        /**
+         * @brief The geometry of a capsule in the plane tangent at the first end of its segment, in meters: x is east
+         * and y is north of the first end, and the second end is at (dx, dy).
+         */
+        struct Capsule {
+            double lat;                                             ///< The latitude of the first end.
+            double lon;                                             ///< The longitude of the first end.
+            double dx;                                              ///< The east offset of the second end in meters.
+            double dy;                                              ///< The north offset of the second end in meters.
+            double inv_length2;                                     ///< 1 / (dx^2 + dy^2); 0 for a segment with no length.
+            double lon_scale;                                       ///< Meters per degree of longitude at the first end.
+            double radius;                                          ///< The distance from the segment in meters.
+            double radius2;                                         ///< The square of the radius.
+        };
+
+        /**
+         * @brief The geometry of a run of polyline segments: consecutive areas in area_corners_, or consecutive capsules.
+         */
+        struct Span {
+            uint32_t first;                                         ///< The index of the first segment's area or capsule.
+            uint32_t count;                                         ///< The number of segments in the run.
+        };
+
+        /**
+         * @brief The start of an image; the offsets are from the start of the image.
+         */
+        struct Header {
+            char magic[8];                                          ///< kMagic.
+            uint32_t version;                                       ///< kVersion.
+            uint32_t region_count;                                  ///< The number of regions.
+            uint32_t counts[14];                                    ///< The number of items in each array, in buffer order.
+            uint32_t edge_model;                                    ///< The EdgeModel.
+            uint64_t offsets[14];                                   ///< The offset of each array, in buffer order.
+            uint64_t size;                                          ///< The size of the image in bytes.
+            double extension;                                       ///< The edge area extension in meters.
+        };
+
+        static const char kMagic[8];                                ///< Identifies an image.
+        static constexpr uint32_t kVersion = 6;                     ///< Changed whenever the layout of an image changes.
+
+        /**
+         * @brief The grid lattice of a region: row r covers latitudes [north - (r + 1) * row_height, north - r * row_height]
+         * and cell (r, c) covers longitudes [west + c * width, west + (c + 1) * width] of row r.
+         */
+        struct Lattice {
+            double north;                                           ///< The northern edge of row 0.
+            double row_height;                                      ///< The height of a row in degrees.
+            uint32_t rows;                                          ///< The number of rows; 0 when the region has no lattice.
+            uint32_t cols;                                          ///< The number of columns.
+            uint32_t first_row;                                     ///< The index of row 0 in lattice_rows_.
+            uint32_t first_word;                                    ///< The index of the first word of the bitmap in lattice_bits_.
+            uint32_t cell_count;                                    ///< The number of cells in the bitmap.
+            uint32_t reserved;                                      ///< Padding.
+        };
+
+        /**
+         * @brief The columns of a lattice row.
+         */
+        struct LatticeRow {
+            double west;                                            ///< The western edge of column 0.
+            double width;                                           ///< The width of a column in degrees; 0 for a row with no cells.
+        };
+
+        static constexpr double kLatticeTolerance = 1e-9;           ///< Degrees a grid's edges may differ from its lattice's (about 0.1 mm).
+        static constexpr uint32_t kMinLatticeCells = 4;             ///< Fewer grid cells are indexed as shapes.
+        static constexpr uint32_t kMaxLatticeBitsPerCell = 64;      ///< A sparser lattice is indexed as shapes.
+        static constexpr uint32_t kMinCoverageAreas = 8;            ///< A leaf with fewer areas is searched area by area.
+        static constexpr uint32_t kMaxCoverageAreas = 256;          ///< A leaf with more areas is searched area by area.
+        static constexpr uint32_t kMaxCoveragePieces = 4096;        ///< A leaf whose coverage needs more pieces is searched area by area.
+        static constexpr double kMetersPerDegree = 6378137.0 * M_PI / 180.0;  ///< Meters per degree of latitude; see geo::kEarthRadiusM.
+
+        struct Tables;                                              ///< The arrays while the index is being built.
+
+        std::vector<Quad::CPtr> regions_;                           ///< The source trees; empty when made from an image.
+        uint32_t region_count_;                                     ///< The number of regions.
+        double extension_;                                          ///< The edge area extension in meters.
+        EdgeModel edge_model_;                                      ///< How edges and polyline segments are buffered.
+
+        std::shared_ptr<const char> buffer_;                        ///< The image holding the header and the arrays below.
+        std::size_t buffer_size_;                                   ///< The size of buffer_ in bytes.
+        geo::PageMode page_mode_;                                   ///< The kind of pages buffer_ is on.
+
+        const Node* nodes_;                                         ///< The region roots, then each tree depth first.
+        uint32_t node_count_;                                       ///< The number of nodes.
+        const Shape* shapes_;                                       ///< The shape table.
+        uint32_t shape_count_;                                      ///< The number of entries in the shape table.
+        const geo::Point* area_corners_;                            ///< Four corners per area in the order of Area::get_corners.
+        const Disc* circles_;                                       ///< The circles.
+        const Box* grids_;                                          ///< The grid cells.
+        const uint32_t* leaf_shapes_;                               ///< The shape table indices of the shapes in each leaf.
+        const Lattice* lattices_;                                   ///< The lattice of each region.
+        const LatticeRow* lattice_rows_;                            ///< The rows of the lattices.
+        const uint64_t* lattice_bits_;                              ///< The lattice bitmaps; bit r * cols + c is set when cell (r, c) is present.
+        const Span* spans_;                                         ///< The runs of polyline segments.
+        const Capsule* capsules_;                                   ///< The capsules.
+        const Window* windows_;                                     ///< The windows of each leaf, in order of their start.
+        uint32_t window_count_;                                     ///< The number of windows.
+        const Slab* slabs_;                                         ///< The slabs of each leaf's coverage, west to east.
+        const Piece* pieces_;                                       ///< The pieces of each slab.
+        uint32_t leaf_shape_count_;                                 ///< The number of entries in leaf_shapes_.
+        std::vector<uint32_t> start_hits_;                          ///< The hits of each entry in leaf_shapes_ a copy starts with; empty for none.
+        mutable std::mutex hits_mutex_;                             ///< Guards hit_tables_.
+        mutable std::vector<Hits::Ptr> hit_tables_;                 ///< The tables of #count_hits.
+        uint64_t answers_;                                          ///< See #answers.
+
+        /**
+         * @brief Return the leaf under a node that contains a point.
+         *
+         * @param node A node that contains the point.
+         * @param pt The point whose leaf we are interested in.
+         * @return A pointer to the leaf, or nullptr when no child contains the point.
+         */
+        const Node* find_leaf( const Node* node, const geo::Point& pt ) const;
+
+        /**
+         * @brief Classify a box inside a leaf against one shape: INSIDE when the shape contains the whole box, OUTSIDE
+         * when the shape has no point in common with it, and MIXED otherwise.
+         */
+        Cover shape_cover( uint32_t shape, const geo::Point& sw, const geo::Point& ne ) const;
+
+        /**
+         * @brief Grade a point against the shapes of a leaf, then the shapes of its windows.
+         *
+         * @param leaf The leaf.
+         * @param pt The point to grade.
+         * @param time The time the window must include; null to check every window.
+         * @param graded false to stop at the first shape containing the point and answer CORE.
+         * @param hits The table to count a hit in; null to count nothing.
+         */
+        Grade leaf_grade( const Node& leaf, const geo::Point& pt, const int64_t* time, bool graded, Hits* hits ) const;
+
+        /**
+         * @brief Grade a point against the geofence; see #contains and #grade.
+         *
+         * @param pt The point to grade.
+         * @param time The time the shapes must be valid at; null to count every shape.
+         * @param graded false to stop at the first shape containing the point and answer CORE.
+         * @param hits The table to count a hit in; null to count nothing.
+         */
+        Grade search( const geo::Point& pt, const int64_t* time, bool graded, Hits* hits ) const;
+
+        /**
+         * @brief Return the hits of each entry in leaf_shapes_: those it started with plus those of every table.
+         */
+        std::vector<uint32_t> merged_hits() const;
+
+        /**
+         * @brief Predicate indicating whether the coverage of a leaf contains a point.
+         *
+         * @param leaf A leaf with coverage; see #add_coverage.
+         * @param pt A point inside the leaf.
+         * @return true if one of the leaf's first covered_count shapes contains pt.
+         */
+        bool coverage_contains( const Node& leaf, const geo::Point& pt ) const;
+
+        /**
+         * @brief Predicate indicating whether a point inside a shape is in its core, i.e., not only in its extension.
+         */
+        bool shape_core( uint32_t shape, const geo::Point& pt ) const;
+
+        /**
+         * @brief Predicate indicating whether a point inside an area is not in the extension past the ends of its edge.
+         */
+        bool area_core( const geo::Point* corners, const geo::Point& pt ) const;
+
+        /**
+         * @brief Predicate indicating whether a present cell of a lattice contains a point.
+         */
+        bool lattice_contains( const Lattice& lattice, const geo::Point& pt ) const;
+
+        /**
+         * @brief Classify a box against a lattice: INSIDE when a present cell contains the whole box, OUTSIDE when no
+         * present cell comes near it, and MIXED otherwise.
+         */
+        Cover lattice_cover( const Lattice& lattice, const geo::Point& sw, const geo::Point& ne ) const;
+
+        /**
+         * @brief Add the grid cells of a tree to its region's lattice when they form one; otherwise add an empty lattice.
+         *
+         * @param quad The root of the region's tree.
+         * @param tables The tables being built; the grids in the lattice are added to its lattice set.
+         */
+        void add_lattice( const Quad& quad, Tables& tables ) const;
+
+        /**
+         * @brief Add the grid cells of a tree to a list, once each.
+         */
+        void collect_grids( const Quad& quad, std::vector<const geo::Grid*>& grids, std::unordered_set<const geo::Entity*>& seen ) const;
+
+        /**
+         * @brief Add the children of a node, and then each child's subtree, to the tables; leaves add their shapes.
+         *
+         * @param quad The Quad the node was made from.
+         * @param n The index of the node.
+         * @param tables The tables being built.
+         */
+        void layout( const Quad& quad, uint32_t n, Tables& tables ) const;
+
+        /**
+         * @brief Replace a leaf's areas with the union of them for #contains, when the leaf has enough of them.
+         *
+         * At interchanges and parallel carriageways many areas overlap, and a point is tested against each of them in
+         * turn. The union of the leaf's areas (edges and polyline segments, for the AREA edge model) within the leaf's
+         * bounds is cut into slabs at the longitudes of every corner and every crossing of two sides; within a slab
+         * the union is a few disjoint pieces. A point is then found by its slab and tested against the pieces of that
+         * slab alone. The areas are moved to the front of the leaf's entries and are still used by #grade.
+         *
+         * @param n The index of the leaf.
+         * @param tables The tables being built; the area corners must be complete.
+         */
+        void add_coverage( uint32_t n, Tables& tables ) const;
+
+        /**
+         * @brief Add the geometry of an entity to the end of the shape table.
+         *
+         * @param entity The entity to add.
+         * @param tables The tables being built.
+         * @return true if the entity was added; false if it is not a shape the geofence uses.
+         */
+        bool add_shape( const geo::Entity& entity, Tables& tables ) const;
+
+        /**
+         * @brief Add the buffer around a segment to the area or capsule table, according to the edge model.
+         *
+         * @param p1 The first end of the segment.
+         * @param p2 The second end of the segment.
+         * @param width The width of the way in meters.
+         * @param tables The tables being built.
+         * @param index Set to the index of the area or capsule.
+         * @return true if the segment was added; false if its buffer has no size.
+         */
+        bool add_segment( const geo::Location& p1, const geo::Location& p2, double width, Tables& tables, uint32_t& index ) const;
+
+        /**
+         * @brief Return the square of the distance in meters from a point to the segment of a capsule.
+         */
+        static double capsule_distance2( const Capsule& capsule, const geo::Point& pt );
+
+        /**
+         * @brief Classify a box against a capsule: INSIDE when the capsule contains the whole box, OUTSIDE when the
+         * capsule has no point in common with it, and MIXED otherwise.
+         */
+        static Cover capsule_cover( const Capsule& capsule, const geo::Point& sw, const geo::Point& ne );
+
+        /**
+         * @brief Add the buffers of a polyline's segments once, then add one shape per run of consecutive segments that
+         * touch a leaf to the shape table and the leaf.
+         *
+         * @param polyline The polyline in the leaf.
+         * @param bounds The bounds the leaf's entities were inserted with.
+         * @param tables The tables being built.
+         * @param leaf The list the shapes of the runs are added to.
+         */
+        void add_polyline( const geo::Polyline& polyline, const geo::Bounds& bounds, Tables& tables, std::vector<uint32_t>& leaf ) const;
+
+        /**
+         * @brief Copy the header and the tables into a new buffer_, then attach to it.
+         *
+         * @param tables The completed tables.
+         */
+        void pack( const Tables& tables );
+
+        /**
+         * @brief Check the header of buffer_ and point the arrays at their place in it.
+         *
+         * @throws invalid_argument when buffer_ is not a complete image of this version.
+         */
+        void attach();
+};
+
+#endif
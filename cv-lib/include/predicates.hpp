@@ -0,0 +1,155 @@
+/**
+ * @file
+ * @author   Jason M. Carter (carterjm@ornl.gov)
+ * @author   Aaron E. Ferber (ferberae@ornl.gov)
+ * @date     April 2017
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+#ifndef CVDP_DI_PREDICATES_HPP
+#define CVDP_DI_PREDICATES_HPP
+
+#include <cmath>
+
+#include "entity.hpp"
+
+namespace geo {
+
+/**
+ * @brief Geometric predicates on plain coordinates.
+ *
+ * These are the kernels behind the Entity touches and Bounds contains/intersects methods. They are inline, allocate
+ * nothing, and work directly on latitude/longitude pairs, so they can be called for every entity and every quad while a
+ * tree is built without constructing temporary Vertex or Edge instances. A box is given by its southwest and northeast
+ * corners; an area by its four corners in the order of Area::get_corners.
+ */
+namespace predicates {
+
+/**
+ * @brief Predicate indicating whether a box contains a point; points on the boundary are contained.
+ */
+inline bool box_contains( const Point& sw, const Point& ne, const Point& pt )
+{
+    return sw.lat <= pt.lat && pt.lat <= ne.lat && sw.lon <= pt.lon && pt.lon <= ne.lon;
+}
+
+/**
+ * @brief Predicate indicating whether two boxes have any point in common.
+ */
+inline bool boxes_overlap( const Point& sw1, const Point& ne1, const Point& sw2, const Point& ne2 )
+{
+    return sw1.lat <= ne2.lat && sw2.lat <= ne1.lat && sw1.lon <= ne2.lon && sw2.lon <= ne1.lon;
+}
+
+/**
+ * @brief Predicate indicating whether segment a1-a2 crosses segment b1-b2. Parallel segments do not cross; see
+ * Edge::intersects.
+ */
+inline bool segments_intersect( const Point& a1, const Point& a2, const Point& b1, const Point& b2 )
+{
+    double adlat = a2.lat - a1.lat;
+    double adlon = a2.lon - a1.lon;
+    double bdlat = b2.lat - b1.lat;
+    double bdlon = b2.lon - b1.lon;
+
+    double d = -bdlat * adlon + adlat * bdlon;
+
+    if (std::fabs( d ) < kGPSEpsilon) {
+        return false;
+    }
+
+    double xdlat = a1.lat - b1.lat;
+    double xdlon = a1.lon - b1.lon;
+
+    double s = (-adlon * xdlat + adlat * xdlon) / d;
+    double t = (bdlat * xdlon - bdlon * xdlat) / d;
+
+    return s >= 0.0 && s <= 1.0 && t >= 0.0 && t <= 1.0;
+}
+
+/**
+ * @brief Predicate indicating whether a segment crosses any side of a box; see Bounds::intersects.
+ */
+inline bool box_crosses_segment( const Point& sw, const Point& ne, const Point& p1, const Point& p2 )
+{
+    const Point nw{ ne.lat, sw.lon };
+    const Point se{ sw.lat, ne.lon };
+
+    return segments_intersect( p1, p2, sw, nw ) || segments_intersect( p1, p2, nw, ne ) ||
+        segments_intersect( p1, p2, ne, se ) || segments_intersect( p1, p2, sw, se );
+}
+
+/**
+ * @brief Predicate indicating whether a segment is in or crosses a box; see Edge::touches.
+ */
+inline bool box_touches_segment( const Point& sw, const Point& ne, const Point& p1, const Point& p2 )
+{
+    return box_contains( sw, ne, p1 ) || box_contains( sw, ne, p2 ) || box_crosses_segment( sw, ne, p1, p2 );
+}
+
+/**
+ * @brief Predicate indicating whether a point is outside (to the left of) an edge of an area; see Area::outside_edge.
+ */
+inline bool area_outside_edge( const Point* corners, int p1, const Point& pt )
+{
+    int p2 = (p1 + 1) % 4;
+
+    double C = corners[p1].lat * ( corners[p2].lon - corners[p1].lon ) - corners[p1].lon * ( corners[p2].lat - corners[p1].lat );
+    double D = -pt.lat * ( corners[p2].lon - corners[p1].lon ) + pt.lon * ( corners[p2].lat - corners[p1].lat ) + C;
+
+    return (D < 0.0);
+}
+
+/**
+ * @brief Predicate indicating whether an area contains a point; see Area::contains.
+ */
+inline bool area_contains( const Point* corners, const Point& pt )
+{
+    return !(area_outside_edge( corners, 0, pt ) || area_outside_edge( corners, 1, pt ) ||
+             area_outside_edge( corners, 2, pt ) || area_outside_edge( corners, 3, pt ));
+}
+
+/**
+ * @brief Predicate indicating whether an area and a box have any point in common; see Area::touches.
+ */
+inline bool box_touches_area( const Point& sw, const Point& ne, const Point* corners )
+{
+    for (int c = 0; c < 4; ++c) {
+        if (box_contains( sw, ne, corners[c] )) return true;
+    }
+
+    const Point nw{ ne.lat, sw.lon };
+    const Point se{ sw.lat, ne.lon };
+
+    if (area_contains( corners, sw ) || area_contains( corners, nw ) || area_contains( corners, se ) || area_contains( corners, ne )) {
+        return true;
+    }
+
+    for (int c = 0; c < 4; ++c) {
+        if (box_crosses_segment( sw, ne, corners[c], corners[(c + 1) % 4] )) return true;
+    }
+
+    return false;
+}
+
+}
+}
+
+#endif
@@ -76,6 +76,39 @@ class Quad : public geo::Bounds {
          */
         static bool insert( Ptr& quadptr, Entity::CPtr entity_ptr );
 
+        /**
+         * @brief Remove every copy of an Entity from the Quad tree. Entities are matched by type and unique identifier, so
+         * entity_ptr can be a separately constructed instance with the same definition as the one inserted; its geometry
+         * limits the search to the quads it touches. When removal leaves the children of a quad with few enough distinct
+         * entities, the children are merged back into that quad.
+         *
+         * @param quadptr A pointer to the quad from which to remove the Entity.
+         * @param entity_ptr A pointer to an entity with the type, unique identifier, and geometry of the one to remove.
+         * @return True if the entity was found and removed, False otherwise.
+         */
+        static bool remove( Ptr& quadptr, Entity::CPtr entity_ptr );
+
+        /**
+         * @brief Remove every copy of an Entity from the Quad tree using only its type and unique identifier. Every leaf
+         * is searched; see #remove( Ptr&, Entity::CPtr ) when the geometry is known.
+         *
+         * @param quadptr A pointer to the quad from which to remove the Entity.
+         * @param type The type of the entity to remove, e.g., "edge".
+         * @param uid The unique identifier of the entity to remove.
+         * @return True if the entity was found and removed, False otherwise.
+         */
+        static bool remove( Ptr& quadptr, const std::string& type, uint64_t uid );
+
+        /**
+         * @brief Copy the structure of a Quad tree. The copy shares the (immutable) entities with the original, so it is
+         * much cheaper to produce than a tree built from the map data; changes to the copy's structure do not affect the
+         * original. This allows a tree being read by other threads to be updated by changing a copy and publishing it.
+         *
+         * @param quad The root of the tree to copy.
+         * @return A pointer to the root of the copy.
+         */
+        static Ptr clone( const Quad& quad );
+
         /**
          * @brief Return the all the Bounds that contains the provided point.
          *
@@ -141,6 +174,8 @@ class Quad : public geo::Bounds {
          */
         friend std::ostream& operator<< (std::ostream& os, const Quad& quad);
 
+        friend class Geofence;                                  ///< Flattens the tree into its query index.
+
     private:
         static geo::Vertex::IdToPtrMap elementmap;              ///< Lookup table from vertex unique identifer to pointers to Vertex instance; prevents duplicating Vertex creation.
         static geo::Entity::PtrList empty_element_list;                ///< Fixed empty set of Edges; returned when a point is contained in a Quad with no Entities.
@@ -187,6 +222,22 @@ class Quad : public geo::Bounds {
          * @return True if the quad is split, False otherise.
          */
         bool split( );
+
+        /**
+         * @brief Remove the matching entities from this Quad and its children, merging children that underflow.
+         *
+         * @param prune_ptr When not null, only quads this entity touches are searched.
+         * @param type The type of the entities to remove.
+         * @param uid The unique identifier of the entities to remove.
+         * @return True if any entity was removed, False otherwise.
+         */
+        bool remove_matching( const Entity::CPtr& prune_ptr, const std::string& type, uint64_t uid );
+
+        /**
+         * @brief Replace this Quad's children with their elements when all children are leaves and together hold no more
+         * than half of MAX_ELEMENTS distinct elements; the margin keeps a following insertion from splitting it again.
+         */
+        void merge();
 };
 
 #endif
@@ -0,0 +1,271 @@
+/**
+ * @file
+ * @author   Jason M. Carter (carterjm@ornl.gov)
+ * @author   Aaron E. Ferber (ferberae@ornl.gov)
+ * @date     April 2017
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+#ifndef CVDP_DI_ROADGRAPH_HPP
+#define CVDP_DI_ROADGRAPH_HPP
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "entity.hpp"
+#include "osm.hpp"
+
+namespace geo {
+
+/**
+ * @brief A non-owning view of a contiguous range of indices; used to return index lists without copying them.
+ */
+class IndexRange {
+    public:
+        IndexRange( const uint32_t* first, const uint32_t* last ) : first_{ first }, last_{ last } {}
+        const uint32_t* begin() const { return first_; }
+        const uint32_t* end() const { return last_; }
+        std::size_t size() const { return static_cast<std::size_t>( last_ - first_ ); }
+
+    private:
+        const uint32_t* first_;                                     ///< The first index.
+        const uint32_t* last_;                                      ///< One past the last index.
+};
+
+/**
+ * @brief A RoadGraph is a compact, compressed sparse row (CSR) representation of a road network.
+ *
+ * Vertex coordinates and identifiers are stored in flat arrays, edges are stored as pairs of vertex indices, and the
+ * edges incident to each vertex are stored as one offset array and one edge index array. Compared with a network of
+ * #Vertex and #Edge instances (one allocation, reference count, and hash set per vertex) this uses a small constant
+ * number of bytes per vertex and edge.
+ *
+ * A graph is built by adding vertices and edges and then calling #finalize, which builds the incidence arrays. Once
+ * finalized the graph is immutable and can be shared between threads.
+ */
+class RoadGraph {
+    public:
+        using Ptr = std::shared_ptr<RoadGraph>;                     ///< Shared pointer to a graph; used while building.
+        using CPtr = std::shared_ptr<const RoadGraph>;              ///< Shared pointer to a finalized graph.
+
+        static constexpr uint32_t kNoIndex = 0xFFFFFFFF;            ///< Returned by #find_vertex for unknown vertices.
+
+        /**
+         * @brief Construct an empty graph.
+         */
+        RoadGraph();
+
+        /**
+         * @brief Return the index of the vertex with the provided unique identifier. Only available before #finalize.
+         *
+         * @param uid the unique identifier of the vertex.
+         * @return the index of the vertex or #kNoIndex when it has not been added.
+         */
+        uint32_t find_vertex( uint64_t uid ) const;
+
+        /**
+         * @brief Add a vertex, or return the index of the vertex with the same unique identifier if it was added before.
+         *
+         * @param uid the unique identifier of the vertex.
+         * @param lat the latitude of the vertex.
+         * @param lon the longitude of the vertex.
+         * @return the index of the vertex.
+         * @throws logic_error when the graph has been finalized.
+         */
+        uint32_t add_vertex( uint64_t uid, double lat, double lon );
+
+        /**
+         * @brief Add an edge between two previously added vertices.
+         *
+         * @param v1 the index of the first vertex.
+         * @param v2 the index of the second vertex.
+         * @param way_type the OSM way type of the edge.
+         * @param uid the unique identifier of the edge.
+         * @return the index of the edge.
+         * @throws logic_error when the graph has been finalized; out_of_range for an unknown vertex.
+         */
+        uint32_t add_edge( uint32_t v1, uint32_t v2, osm::Highway way_type, uint64_t uid );
+
+        /**
+         * @brief Build the incidence arrays and release the memory used only while building.
+         */
+        void finalize();
+
+        /**
+         * @brief Predicate indicating whether #finalize has been called.
+         *
+         * @return true if the graph is finalized.
+         */
+        bool is_final() const;
+
+        uint32_t vertex_count() const;                              ///< The number of vertices.
+        uint32_t edge_count() const;                                ///< The number of edges.
+
+        double lat( uint32_t v ) const;                             ///< The latitude of vertex v.
+        double lon( uint32_t v ) const;                             ///< The longitude of vertex v.
+        uint64_t vertex_uid( uint32_t v ) const;                    ///< The unique identifier of vertex v.
+
+        /**
+         * @brief Return vertex v as a Location.
+         *
+         * @param v the index of the vertex.
+         * @return the location of the vertex with its unique identifier.
+         */
+        Location location( uint32_t v ) const;
+
+        uint32_t edge_v1( uint32_t e ) const;                       ///< The index of the first vertex of edge e.
+        uint32_t edge_v2( uint32_t e ) const;                       ///< The index of the second vertex of edge e.
+        osm::Highway way_type( uint32_t e ) const;                  ///< The OSM way type of edge e.
+        uint64_t edge_uid( uint32_t e ) const;                      ///< The unique identifier of edge e.
+
+        /**
+         * @brief Return the number of edges incident to a vertex; see Vertex::degree. Only available after #finalize.
+         *
+         * @param v the index of the vertex.
+         * @return the degree of the vertex.
+         */
+        uint32_t degree( uint32_t v ) const;
+
+        /**
+         * @brief Return the indices of the edges incident to a vertex. Only available after #finalize.
+         *
+         * @param v the index of the vertex.
+         * @return a view of the incident edge indices; valid as long as this graph exists.
+         */
+        IndexRange incident_edges( uint32_t v ) const;
+
+        /**
+         * @brief Return the approximate number of bytes used by the graph's arrays.
+         *
+         * @return the memory used in bytes.
+         */
+        std::size_t memory_usage() const;
+
+    private:
+        /**
+         * @brief The vertices and type of an edge.
+         */
+        struct EdgeRecord {
+            uint32_t v1;                                            ///< The index of the first vertex.
+            uint32_t v2;                                            ///< The index of the second vertex.
+            uint64_t uid;                                           ///< The unique identifier of the edge.
+            osm::Highway way_type;                                  ///< The OSM way type of the edge.
+        };
+
+        bool final_;                                                ///< Set by #finalize.
+
+        std::vector<double> lat_;                                   ///< Vertex latitudes.
+        std::vector<double> lon_;                                   ///< Vertex longitudes.
+        std::vector<uint64_t> vertex_uid_;                          ///< Vertex unique identifiers.
+
+        std::vector<EdgeRecord> edges_;                             ///< The edges.
+
+        std::vector<uint32_t> offsets_;                             ///< incident_[offsets_[v], offsets_[v+1]) are the edges incident to v.
+        std::vector<uint32_t> incident_;                            ///< Incident edge indices grouped by vertex.
+
+        std::unordered_map<uint64_t, uint32_t> uid_index_;          ///< Vertex identifier to index; only used while building.
+};
+
+/**
+ * @brief A GraphEdge is an Entity that refers to an edge in a RoadGraph; it is what is inserted into a Quad when the
+ * map is loaded as a graph. It is much smaller than an #Edge because the vertices are not copied.
+ *
+ * GraphEdges have the same type string, "edge", as Edges.
+ */
+class GraphEdge : public Entity {
+    public:
+        using CPtr = std::shared_ptr<const GraphEdge>;              ///< Shared pointer to a constant GraphEdge.
+
+        /**
+         * @brief Construct a GraphEdge for an edge of a finalized graph.
+         *
+         * @param graph_ptr the graph; it is kept alive by this instance.
+         * @param index the index of the edge in the graph.
+         */
+        GraphEdge( RoadGraph::CPtr graph_ptr, uint32_t index );
+
+        /**
+         * @brief Get a string identifier for this entity.
+         *
+         * @return std::string "edge".
+         */
+        const std::string get_type(void) const;
+
+        /**
+         * @brief Get the unique identifier of the edge.
+         *
+         * @return uint64_t The unique identifier of the edge.
+         */
+        uint64_t get_uid(void) const;
+
+        /**
+         * @brief Determine if this edge is within the bounds object; see Edge::touches.
+         *
+         * @param bounds Bounds object to test against.
+         * @return bool True if this edge touches the bounds, otherwise False.
+         */
+        bool touches(const Bounds& bounds) const;
+
+        /**
+         * @brief Return the OSM highway type of the edge.
+         *
+         * @return the OSM way type.
+         */
+        osm::Highway get_way_type() const;
+
+        /**
+         * @brief Return the width of the edge in meters; see Edge::get_way_width.
+         *
+         * @return the width of the OSM segment in meters.
+         */
+        double get_way_width() const;
+
+        /**
+         * @brief Return an area that encapsulates this edge; see Edge::to_area.
+         *
+         * @param extension the meters to extend the area from each end of the edge.
+         * @return a shared pointer to the area that encapsulates this edge.
+         * @throws ZeroAreaException when there area characterizes 0 space.
+         */
+        AreaPtr to_area( double extension ) const;
+
+        /**
+         * @brief Return the graph this edge belongs to.
+         *
+         * @return a reference to the graph.
+         */
+        const RoadGraph& get_graph() const;
+
+        /**
+         * @brief Return the index of this edge in its graph.
+         *
+         * @return the edge index.
+         */
+        uint32_t get_index() const;
+
+    private:
+        RoadGraph::CPtr graph_ptr_;                                 ///< The graph containing the edge.
+        uint32_t index_;                                            ///< The index of the edge in the graph.
+};
+
+}
+
+#endif
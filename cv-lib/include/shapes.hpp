@@ -27,7 +27,12 @@
 #define CVDP_SHAPES_HPP
 
 #include <memory>
+#include <string>
+#include <vector>
+#include "arena.hpp"
 #include "entity.hpp"
+#include "quad.hpp"
+#include "roadgraph.hpp"
 
 namespace shapes {
 
@@ -54,7 +59,20 @@ static const int POINT_LON = 2;
  *
  * Geographies are specified in their respective make_<shape> methods.
  *
+ * Any shape can be limited to an interval of time (see geo::Validity) by the valid_from and valid_to attributes, each a
+ * UTC time (see time_utilities::parse_utc); a missing attribute leaves that end open. Edges with different validities
+ * are not chained into one polyline, and in graph mode an edge with a limited validity is made into a geo::Edge, not
+ * added to the graph.
+ *
  * The order of the shapes in the file does not matter.
+ *
+ * A file whose name ends in ".osm" is instead read as an OSM XML extract, e.g., from Geofabrik or osmium, and its
+ * highways are made into edges directly, without first converting them to the format above. Each way with a highway
+ * tag whose value is a known osm::Highway type that is not in osm::highway_blacklist is a chain of edges between its
+ * nodes, with the way's id as its way_id; the edges are numbered from 1 in file order. Edges to nodes that are not in
+ * the extract are dropped. The file is streamed twice, once to find the nodes of the kept ways and once to read their
+ * positions and make the edges, so only the positions of those nodes are held; graph mode, merging, and simplification
+ * apply as for a shape file.
  */
 class CSVInputFactory
 {
@@ -71,6 +89,51 @@ class CSVInputFactory
          */
         CSVInputFactory(const std::string& file_path);
 
+        /**
+         * @brief Construct a Shape Factory given a file specification that optionally loads the edges into a
+         * geo::RoadGraph.
+         *
+         * In graph mode, edges are not made into #geo::Edge instances; after #make_shapes the graph is available from
+         * #get_graph and one geo::GraphEdge per edge from #get_graph_edges.
+         *
+         * @param file_path the file, including path, that contains the shape specifications.
+         * @param use_graph true to load edges into a graph.
+         */
+        CSVInputFactory(const std::string& file_path, bool use_graph);
+
+        /**
+         * @brief Construct a Shape Factory given a file specification that optionally loads the edges into a
+         * geo::RoadGraph or merges them into geo::Polyline instances.
+         *
+         * When merging, the edges of each way (the way_id attribute) that chain together, the second vertex of one
+         * being the first vertex of the next, are made into one polyline identified by the id of its first edge; every
+         * edge is part of some polyline, and #get_edges is empty. Edges without a way_id are polylines of one segment.
+         * Graph mode takes precedence over merging.
+         *
+         * @param file_path the file, including path, that contains the shape specifications.
+         * @param use_graph true to load edges into a graph.
+         * @param merge_ways true to merge the edges of each way into polylines.
+         */
+        CSVInputFactory(const std::string& file_path, bool use_graph, bool merge_ways);
+
+        /**
+         * @brief Construct a Shape Factory given a file specification that optionally simplifies the ways as they are
+         * loaded.
+         *
+         * Simplification first drops every edge that duplicates an earlier one (see geo::Edge::operator==), then
+         * chains the edges of each way as for merging and removes the vertices of each chain that Douglas-Peucker
+         * finds within the tolerance of the chain that remains. Every removed vertex is within the tolerance of a
+         * remaining segment, so the buffered geofence shrinks by at most the tolerance. Without merging, each
+         * remaining segment is an edge with the id of the first edge it replaces. Graph mode takes precedence over
+         * simplification.
+         *
+         * @param file_path the file, including path, that contains the shape specifications.
+         * @param use_graph true to load edges into a graph.
+         * @param merge_ways true to merge the edges of each way into polylines.
+         * @param simplify_tolerance the meters a vertex may be from the simplified way; 0 does not simplify.
+         */
+        CSVInputFactory(const std::string& file_path, bool use_graph, bool merge_ways, double simplify_tolerance);
+
         /** @brief Open the shape specification file, create the shapes, and close the file.
          *
          * Shapes will be stored in the respective containers. If a shape specification is incorrect it will be skipped and a message 
@@ -107,6 +170,66 @@ class CSVInputFactory
          */
         const std::vector<geo::Grid::CPtr>& get_grids(void) const;
 
+        /**
+         * @brief Return an immutable vector of the polylines the edges in the file were merged into.
+         *
+         * Note: The factory must be merging ways and the make_shapes method must have been called.
+         *
+         * @return an immutable vector containing pointers to Polyline instances, in the order of their first edges.
+         */
+        const std::vector<geo::Polyline::CPtr>& get_polylines(void) const;
+
+        /**
+         * @brief Return the number of duplicate edges simplification dropped.
+         *
+         * @return the number of edges dropped; 0 when not simplifying.
+         */
+        std::size_t get_duplicate_count(void) const;
+
+        /**
+         * @brief Return the number of way segments simplification removed, not counting duplicates.
+         *
+         * @return the number of segments removed; 0 when not simplifying.
+         */
+        std::size_t get_simplified_count(void) const;
+
+        /**
+         * @brief Return the road graph of the edges specified in the file.
+         *
+         * Note: The factory must be in graph mode and the make_shapes method must have been called.
+         *
+         * @return a pointer to the finalized graph; null when not in graph mode.
+         */
+        geo::RoadGraph::CPtr get_graph(void) const;
+
+        /**
+         * @brief Return an immutable vector of the graph edges specified in the file.
+         *
+         * Note: The factory must be in graph mode and the make_shapes method must have been called.
+         *
+         * @return an immutable vector containing pointers to GraphEdge instances, in graph edge index order.
+         */
+        const std::vector<geo::GraphEdge::CPtr>& get_graph_edges(void) const;
+
+        /**
+         * @brief Return the smallest box that contains every shape specified in the file; for circles this is the box
+         * around the circle.
+         *
+         * Note: the make_shapes method must have been called.
+         *
+         * @param bounds set to the box when there are shapes.
+         * @return true if the file contained any shapes; false otherwise, in which case bounds is unchanged.
+         */
+        bool get_bounds(geo::Bounds& bounds) const;
+
+        /**
+         * @brief Return the arena the shapes are allocated from. Circles, grids, polylines, and graph edges are placed in the
+         * arena in file order; it is released when the last of them is destroyed.
+         *
+         * @return a pointer to the arena.
+         */
+        geo::Arena::Ptr get_arena(void) const;
+
 
         /**
          * @brief Attempt to construct a Circle instance from the parts provided
@@ -117,11 +240,12 @@ class CSVInputFactory
          * - line_parts[1] : unique 64-bit integer identifier
          * - line_parts[2] : A sequence of colon-split elements that define the center.
          *      - Center: <lat>:<lon>:<radius in meters>
+         * - line_parts[3] : Optional colon-split key=value attributes; only valid_from and valid_to are used.
          *
          * @param line_parts A vector of strings where each string is a part of
          * a shape specification.
          * @throws out_of_range exception for incorrect lat/lon center point or
-         * radius.
+         * radius; invalid_argument for an incorrect validity.
          */
         void make_circle(const StrVector& line_parts); 
 
@@ -152,19 +276,186 @@ class CSVInputFactory
          * - line_parts[1] : A '_' split row-column pair.
          * - line_parts[2] : A sequence of colon-split elements defining the grid position.
          *      - Point: <sw lat>:<sw lon>:<ne lat>:<ne lon>
+         * - line_parts[3] : Optional colon-split key=value attributes; only valid_from and valid_to are used.
          *
          * @param line_parts A vector of strings where each string is a part of a shape specification.
-         * @throws out_of_range exception for incorrect positions.
+         * @throws out_of_range exception for incorrect positions; invalid_argument for an incorrect validity.
          */
         void make_grid(const StrVector& line_parts);
 
     private:
 
+        /**
+         * @brief Make the edge between two vertices: add it to the graph, save it to be chained, or make it a geo::Edge.
+         *
+         * @param edge_id the edge's identifier.
+         * @param v1 the first vertex; its uid identifies it.
+         * @param v2 the second vertex.
+         * @param way_type the OSM way type.
+         * @param way_id the way the edge belongs to; empty when not specified.
+         * @param validity when the edge is part of the geofence.
+         * @throws out_of_range for a new vertex with an incorrect position; invalid_argument when the vertices are the
+         * same.
+         */
+        void add_edge(uint64_t edge_id, const geo::Location& v1, const geo::Location& v2, osm::Highway way_type,
+                const std::string& way_id, const geo::Validity& validity);
+
+        /**
+         * @brief Read the shape specifications of a shape file.
+         *
+         * @throws invalid_argument when the file could not be opened or has no header.
+         */
+        void make_csv_shapes(void);
+
+        /**
+         * @brief Read the highways of an OSM XML file as edges.
+         *
+         * @throws invalid_argument when the file could not be opened.
+         */
+        void make_osm_shapes(void);
+
+        /**
+         * @brief An edge waiting to be merged into a polyline.
+         */
+        struct WayEdge {
+            uint64_t uid;                                       ///< The edge's identifier.
+            geo::Location v1;                                   ///< The first vertex.
+            geo::Location v2;                                   ///< The second vertex.
+            osm::Highway way_type;                              ///< The OSM way type.
+            std::string way_id;                                 ///< The way the edge belongs to; empty when not specified.
+            geo::Validity validity;                             ///< When the edge is part of the geofence.
+        };
+
         std::string file_path_;                                 ///< The file containing the shape specifications.
         geo::Vertex::IdToPtrMap vertex_map_;                      ///< Map from identifiers to pointers to previously constructed vertices; prevents duplicates seen in OSM.
         std::vector<geo::Circle::CPtr> circles_;                ///< Vector of constant pointers to Circle instances.
         std::vector<geo::EdgeCPtr> edges_;                      ///< Vector of constant pointers to Edge instances.
         std::vector<geo::Grid::CPtr> grids_;                    ///< Vector of constant pointers to Grid instances.
+        geo::RoadGraph::Ptr graph_;                             ///< The graph that edges are loaded into; null when not in graph mode.
+        std::vector<geo::GraphEdge::CPtr> graph_edges_;         ///< Vector of constant pointers to GraphEdge instances.
+        geo::Arena::Ptr arena_;                                 ///< The arena the shapes are allocated from.
+        bool merge_ways_;                                       ///< True to merge the edges of each way into polylines.
+        double simplify_tolerance_;                             ///< The simplification tolerance in meters; 0 when not simplifying.
+        bool chain_ways_;                                       ///< True when edges are chained by way once the file is read.
+        std::vector<WayEdge> way_edges_;                        ///< The edges to chain, in file order.
+        std::vector<geo::Polyline::CPtr> polylines_;            ///< Vector of constant pointers to Polyline instances.
+        std::size_t duplicate_count_;                           ///< The number of duplicate edges dropped.
+        std::size_t simplified_count_;                          ///< The number of segments removed by simplification.
+
+        /**
+         * @brief Chain the edges of each way, simplify the chains when requested, and make each chain into a polyline
+         * or into edges.
+         */
+        void build_ways(void);
+
+        /**
+         * @brief Drop the edges in way_edges_ that duplicate an earlier edge.
+         */
+        void remove_duplicate_edges(void);
+
+        /**
+         * @brief Return the vertex for a location, making it the first time its identifier is seen.
+         *
+         * @param location the location of the vertex.
+         * @return a pointer to the vertex.
+         */
+        geo::Vertex::Ptr make_vertex(const geo::Location& location);
+
+        /**
+         * @brief Extend a box to contain a point.
+         *
+         * @param bounds the box; it is set to the point when first is true.
+         * @param first true when this is the first point.
+         * @param pt the point.
+         */
+        static void extend_bounds(geo::Bounds& bounds, bool& first, const geo::Point& pt);
+};
+
+/**
+ * @brief Read a delta file that adds shapes to and removes shapes from an existing Quad tree, e.g., the daily changes to
+ * work zones, and apply it to a tree.
+ *
+ * A delta file has a header line and one change per line with the following comma-delimited fields:
+ * - op : either add or remove.
+ * - type, id, geography, attributes : the shape as specified for #CSVInputFactory.
+ *
+ * A shape is identified by its type and id; an add replaces a shape with the same type and id. A remove only requires
+ * the type and id; if the geography is provided it narrows the search to the quads the shape touches. A polyline made
+ * by merging a way's edges (type polyline, the id of its first edge) can only be removed, without a geography.
+ */
+class CSVDeltaFactory
+{
+    public:
+        /**
+         * @brief The change to make to the tree.
+         */
+        enum class Operation { ADD, REMOVE };
+
+        /**
+         * @brief A single line of a delta file.
+         */
+        struct Change {
+            Operation op;                                   ///< Whether the shape is added or removed.
+            std::string type;                               ///< The type of the shape, e.g., edge.
+            uint64_t uid;                                   ///< The unique identifier of the shape.
+            geo::Entity::CPtr entity_ptr;                   ///< The shape; null for a remove without a geography.
+        };
+
+        /**
+         * @brief Construct a CSVDeltaFactory given a file specification.
+         *
+         * @param file_path the file, including path, that contains the changes.
+         */
+        CSVDeltaFactory(const std::string& file_path);
+
+        /**
+         * @brief Open the delta file, read the changes, and close the file.
+         *
+         * If a change is specified incorrectly it will be skipped and a message will be displayed on std::cerr.
+         *
+         * @throws invalid_argument when the file could not be opened or has no header.
+         */
+        void make_changes(void);
+
+        /**
+         * @brief Attempt to construct a Change from the parts of a delta file line and add it to the container.
+         *
+         * @param line_parts A vector of strings where each string is a part of a change specification.
+         * @throws invalid_argument or out_of_range for an incorrect change specification.
+         */
+        void make_change(const StrVector& line_parts);
+
+        /**
+         * @brief Return an immutable vector of the changes, in file order.
+         *
+         * @return an immutable vector of changes.
+         */
+        const std::vector<Change>& get_changes(void) const;
+
+        /**
+         * @brief Apply the changes, in file order, to a Quad tree. The tree is modified in place, so it should not be
+         * one that is being read by other threads; see Quad::clone.
+         *
+         * @param quadptr the root of the tree to change.
+         * @return the number of changes that modified the tree; removes of shapes not in the tree and adds of shapes
+         * outside of the tree's bounds are not counted.
+         */
+        std::size_t apply_changes(Quad::Ptr& quadptr) const;
+
+        /**
+         * @brief Apply the changes, in file order, to the trees of several regions; see above. A shape is added to every
+         * region whose tree it touches.
+         *
+         * @param quads the roots of the trees to change.
+         * @param unplaced set to the adds of shapes outside of every tree's bounds, which change nothing.
+         * @return the number of changes that modified at least one tree; each change is counted once.
+         */
+        std::size_t apply_changes(std::vector<Quad::Ptr>& quads, std::vector<const Change*>& unplaced) const;
+
+    private:
+        std::string file_path_;                             ///< The file containing the changes.
+        CSVInputFactory shape_factory_;                     ///< Used to construct the shapes in the changes.
+        std::vector<Change> changes_;                       ///< The changes in file order.
 };
 
 /**
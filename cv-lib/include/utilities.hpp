@@ -26,6 +26,7 @@
 #ifndef CTES_UTILITIES_H
 #define CTES_UTILITIES_H
 
+#include <cstdint>
 #include <string>
 #include <sstream>
 #include <iterator>
@@ -175,4 +176,27 @@ namespace double_utilities {
 
 }  // end namespace.
 
+namespace time_utilities {
+
+/**
+ * @brief Convert a UTC time to seconds since the Unix epoch. The time is either an ISO 8601 date and time,
+ * YYYY-MM-DDTHH:MM:SS with optional fractional seconds and an optional trailing 'Z' (e.g., an ODE odeReceivedAt), a date
+ * alone (YYYY-MM-DD, at midnight), or an integer number of seconds. Fractional seconds are dropped.
+ *
+ * @param s the time.
+ * @param seconds set to the seconds since the epoch.
+ * @return true if s is a time in one of these forms; false otherwise, and seconds is unchanged.
+ */
+bool parse_utc( const std::string& s, int64_t& seconds );
+
+/**
+ * @brief Write seconds since the Unix epoch as an ISO 8601 UTC time, YYYY-MM-DDTHH:MM:SSZ.
+ *
+ * @param seconds the seconds since the epoch.
+ * @return the time.
+ */
+std::string format_utc( int64_t seconds );
+
+}  // end namespace.
+
 #endif
@@ -0,0 +1,132 @@
+/**
+ * @file
+ * @author   Jason M. Carter (carterjm@ornl.gov)
+ * @author   Aaron E. Ferber (ferberae@ornl.gov)
+ * @date     April 2017
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "arena.hpp"
+
+namespace geo {
+
+std::shared_ptr<char> allocate_pages( std::size_t bytes, PageMode& mode )
+{
+    // huge pages are only used whole.
+    std::size_t size = (bytes + kHugePageSize - 1) & ~(kHugePageSize - 1);
+
+#ifdef MAP_HUGETLB
+    if (mode == PageMode::EXPLICIT_HUGE) {
+        void* buffer = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+
+        if (buffer != MAP_FAILED) {
+            return std::shared_ptr<char>{ static_cast<char*>( buffer ), [size]( char* p ) { munmap( p, size ); } };
+        }
+
+        // the huge page pool is empty or not configured.
+        mode = PageMode::TRANSPARENT_HUGE;
+    }
+#endif
+
+#ifdef MADV_HUGEPAGE
+    if (mode == PageMode::EXPLICIT_HUGE || mode == PageMode::TRANSPARENT_HUGE) {
+        void* buffer = nullptr;
+
+        if (posix_memalign( &buffer, kHugePageSize, size ) != 0) {
+            throw std::bad_alloc{};
+        }
+
+        // the kernel only backs whole, aligned huge pages; a failure here still leaves a usable buffer.
+        mode = madvise( buffer, size, MADV_HUGEPAGE ) == 0 ? PageMode::TRANSPARENT_HUGE : PageMode::NORMAL;
+        return std::shared_ptr<char>{ static_cast<char*>( buffer ), []( char* p ) { std::free( p ); } };
+    }
+#endif
+
+    mode = PageMode::NORMAL;
+    return std::shared_ptr<char>{ new char[bytes], std::default_delete<char[]>() };
+}
+
+std::size_t page_size( PageMode mode )
+{
+    return mode == PageMode::NORMAL ? static_cast<std::size_t>( sysconf( _SC_PAGESIZE ) ) : kHugePageSize;
+}
+
+constexpr std::size_t Arena::kDefaultBlockSize;
+
+Arena::Arena( std::size_t block_size ) :
+    block_size_{ block_size },
+    blocks_{},
+    next_{ nullptr },
+    remaining_{ 0 },
+    allocated_{ 0 },
+    reserved_{ 0 }
+{}
+
+void* Arena::allocate( std::size_t bytes, std::size_t alignment )
+{
+    std::size_t padding = (alignment - reinterpret_cast<std::uintptr_t>( next_ ) % alignment) % alignment;
+
+    if (!next_ || padding + bytes > remaining_) {
+        // blocks are aligned for any type; a request larger than a standard block gets a block of its own.
+        std::size_t size = bytes > block_size_ ? bytes : block_size_;
+        blocks_.emplace_back( new char[size] );
+        reserved_ += size;
+
+        if (size > block_size_) {
+            // keep filling the current block.
+            allocated_ += bytes;
+            return blocks_.back().get();
+        }
+
+        next_ = blocks_.back().get();
+        remaining_ = size;
+        padding = 0;
+    }
+
+    char* result = next_ + padding;
+    next_ += padding + bytes;
+    remaining_ -= padding + bytes;
+    allocated_ += bytes;
+    return result;
+}
+
+std::size_t Arena::bytes_allocated() const
+{
+    return allocated_;
+}
+
+std::size_t Arena::bytes_reserved() const
+{
+    return reserved_;
+}
+
+std::size_t Arena::block_count() const
+{
+    return blocks_.size();
+}
+
+}
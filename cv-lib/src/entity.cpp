@@ -25,12 +25,21 @@
 #include <cmath>
 #include <iomanip>
 #include <sstream>
+#include <stdexcept>
 
 #include "entity.hpp"
+#include "predicates.hpp"
 #include "utilities.hpp"
 
 namespace geo {
 
+constexpr int64_t Validity::kBeginning;
+constexpr int64_t Validity::kEnd;
+
+Validity Entity::get_validity(void) const {
+    return Validity{};
+}
+
 Point::Point() :
     lat{0.0},
     lon{0.0}
@@ -166,6 +175,10 @@ const std::string Location::get_type() const {
     return "location";
 }
 
+uint64_t Location::get_uid() const {
+    return uid;
+}
+
 bool Location::touches(const Bounds& bounds) const {
     return bounds.contains(*this); 
 }
@@ -290,8 +303,16 @@ const std::string Edge::get_type(void) const {
     return "edge";
 }
 
+Validity Edge::get_validity(void) const {
+    return validity_;
+}
+
+void Edge::set_validity(const Validity& validity) {
+    validity_ = validity;
+}
+
 bool Edge::touches(const Bounds& bounds) const {
-    return bounds.contains_or_intersects(*this);
+    return predicates::box_touches_segment(bounds.sw, bounds.ne, *v1, *v2);
 }
 
 bool Edge::operator==( const Edge& other ) const
@@ -392,22 +413,7 @@ double Edge::length_haversine() const
 
 bool Edge::intersects( double lat1, double lon1, double lat2, double lon2 ) const
 {
-    double edgedlat = lat2 - lat1;
-    double edgedlon = lon2 - lon1;
-
-    double d = -edgedlat * dlongitude() + dlatitude() * edgedlon;
-
-    if (double_utilities::are_equal(d, 0, kGPSEpsilon)) {
-        return false;
-    }
-
-    double xdlat = v1->lat - lat1;
-    double xdlon = v1->lon - lon1;
-
-    double s = (-dlongitude() * xdlat + dlatitude() * xdlon) / d;
-    double t = (edgedlat * xdlon - edgedlon * xdlat) / d;
-
-    return s >= 0.0 && s <= 1.0 && t >= 0.0 && t <= 1.0;
+    return predicates::segments_intersect( *v1, *v2, Point{ lat1, lon1 }, Point{ lat2, lon2 } );
 }
 
 bool Edge::intersects( const Edge& edge ) const
@@ -426,39 +432,37 @@ AreaPtr Edge::to_area( double extension ) const
 }
 
 AreaPtr Edge::to_area( double cap_width, double extension ) const
+{
+    return make_area( *v1, *v2, cap_width, extension );
+}
+
+AreaPtr Edge::make_area( const Location& loc1, const Location& loc2, double cap_width, double extension )
 {
     double half_width;
     double ab_bearing;
     double x_bearing;
     double y_bearing;
-    Vertex::Ptr v1_tmp;
-    Vertex::Ptr v2_tmp;
 
     if (cap_width <= 0.0) {
         throw ZeroAreaException();
     }
 
     half_width = cap_width / 2.0;
-    ab_bearing = v1->bearing_to(*v2);
+    ab_bearing = Location::bearing(loc1, loc2);
 
-    v1_tmp = v1; 
-    v2_tmp = v2; 
-
-    if (extension > 0.0) {
-        // Extend the nodes of this edge.
-        v1_tmp = std::make_shared<Vertex>(v1_tmp->project_position(std::fmod(ab_bearing - 180.0, 360.0), extension));
-        v2_tmp = std::make_shared<Vertex>(v2_tmp->project_position(ab_bearing, extension));
-    }
+    // Extend the ends of the segment; Location declares a copy constructor but no assignment.
+    Location l1_tmp = extension > 0.0 ? loc1.project_position(std::fmod(ab_bearing - 180.0, 360.0), extension) : loc1;
+    Location l2_tmp = extension > 0.0 ? loc2.project_position(ab_bearing, extension) : loc2;
 
     // Get the bearing to the area corners.
     x_bearing = std::fmod(ab_bearing - 90.0, 360.0);
     y_bearing = std::fmod(ab_bearing + 90.0, 360.0);
     
     // Get the locations of the corners and return the area.
-    return std::make_shared<Area>(v1_tmp->project_position(x_bearing, half_width),
-        v2_tmp->project_position(x_bearing, half_width),
-        v2_tmp->project_position(y_bearing, half_width),
-        v1_tmp->project_position(y_bearing, half_width));
+    return std::make_shared<Area>(l1_tmp.project_position(x_bearing, half_width),
+        l2_tmp.project_position(x_bearing, half_width),
+        l2_tmp.project_position(y_bearing, half_width),
+        l1_tmp.project_position(y_bearing, half_width));
 }
 
 Area::Area( const Point& p1, const Point& p2, const Point& p3, const Point& p4 ) :
@@ -483,16 +487,12 @@ const std::string Area::get_type() const {
     return "area";
 }
 
-bool Area::touches(const Bounds& bounds) const {
-    if (bounds.contains(corners_[0]) || bounds.contains(corners_[1]) || bounds.contains(corners_[2]) || bounds.contains(corners_[3])) {
-        return true;
-    }
-
-    if (contains(bounds.sw) || contains(bounds.nw) || contains(bounds.se) || contains(bounds.ne)) {
-        return true;
-    }
+uint64_t Area::get_uid() const {
+    return 0;
+}
 
-    return bounds.intersects(corners_[0], corners_[1]) || bounds.intersects(corners_[1], corners_[2]) || bounds.intersects(corners_[2], corners_[3]) || bounds.intersects(corners_[3], corners_[0]);
+bool Area::touches(const Bounds& bounds) const {
+    return predicates::box_touches_area(bounds.sw, bounds.ne, corners_.data());
 }
 
 const std::vector<Point>& Area::get_corners() const {
@@ -500,6 +500,11 @@ const std::vector<Point>& Area::get_corners() const {
 }
 
 bool Area::outside_edge( int p1, const Point& pt ) const
+{
+    return outside_edge( corners_.data(), p1, pt );
+}
+
+bool Area::outside_edge( const Point* corners, int p1, const Point& pt )
 {
     //   See the documentation for the method "relationship" in class Line.
     //   
@@ -517,23 +522,17 @@ bool Area::outside_edge( int p1, const Point& pt ) const
     
     if (p1 < 0 || p1 > 3) return false;
 
-    // p1 is the index of the first point that defines the edge of interest.
-    // p1+1%4 is the index of the second point that defines the edge of interest.
-    int p2 = (p1 + 1) % 4;
-
-    double C = corners_[p1].lat * ( corners_[p2].lon - corners_[p1].lon ) - corners_[p1].lon * ( corners_[p2].lat - corners_[p1].lat );
-    double D = -pt.lat * ( corners_[p2].lon - corners_[p1].lon ) + pt.lon * ( corners_[p2].lat - corners_[p1].lat ) + C;
-
-    // negative D indicates pt is to the left of a line from p1 to p2.
-    return (D < 0.0);
+    return predicates::area_outside_edge( corners, p1, pt );
 }
 
 bool Area::contains( const Point& pt ) const
 {
-    return !(outside_edge( 0, pt ) ||
-             outside_edge( 1, pt ) ||
-             outside_edge( 2, pt ) ||
-             outside_edge( 3, pt ));
+    return contains( corners_.data(), pt );
+}
+
+bool Area::contains( const Point* corners, const Point& pt )
+{
+    return predicates::area_contains( corners, pt );
 }
 
 const std::string Area::get_poly_string() const
@@ -581,6 +580,14 @@ const std::string Circle::get_type(void) const {
     return "circle";
 }
 
+Validity Circle::get_validity(void) const {
+    return validity_;
+}
+
+void Circle::set_validity(const Validity& validity) {
+    validity_ = validity;
+}
+
 bool Circle::touches(const Bounds& bounds) const {
     bool cardinals_within_bounds = bounds.contains(north) || bounds.contains(south) || bounds.contains(east) || bounds.contains(west);
 
@@ -624,7 +631,7 @@ Bounds::Bounds( const Bounds& bounds ) :
 
 bool Bounds::contains( const Point& pt ) const
 {
-    return  (sw.lat <= pt.lat && pt.lat <= ne.lat && sw.lon <= pt.lon && pt.lon <= ne.lon);
+    return predicates::box_contains( sw, ne, pt );
 }
 
 bool Bounds::contains( const Edge& edge ) const
@@ -639,21 +646,16 @@ bool Bounds::contains( const Circle& circle ) const
 
 bool Bounds::contains_or_intersects( const Edge& e ) const
 {
-    return contains( *(e.v1) ) || contains( *(e.v2) ) || intersects( e );
+    return predicates::box_touches_segment( sw, ne, *(e.v1), *(e.v2) );
 }
 
 bool Bounds::intersects( const Edge& e ) const
 {
-    if (e.intersects(sw.lat, sw.lon, ne.lat, sw.lon)) return true;
-    if (e.intersects(ne.lat, sw.lon, ne.lat, ne.lon)) return true;
-    if (e.intersects(ne.lat, ne.lon, sw.lat, ne.lon)) return true;
-    if (e.intersects(sw.lat, sw.lon, sw.lat, ne.lon)) return true;
-    return false;
+    return predicates::box_crosses_segment( sw, ne, *(e.v1), *(e.v2) );
 }
 
 bool Bounds::intersects(const Point& pt_a, const Point& pt_b) const {
-    Edge e(Vertex(pt_a.lat, pt_a.lon), Vertex(pt_b.lat, pt_b.lon));
-    return intersects(e);
+    return predicates::box_crosses_segment( sw, ne, pt_a, pt_b );
 }
 
 bool Bounds::intersects( const Circle& circle ) const {
@@ -714,16 +716,25 @@ Grid::Grid(const geo::Point& sw_loc, const geo::Point& ne_loc, uint32_t row, uin
 const std::string Grid::get_type() const {
     return "grid";
 }
+
+Validity Grid::get_validity(void) const {
+    return validity_;
+}
+
+void Grid::set_validity(const Validity& validity) {
+    validity_ = validity;
+}
+
+uint64_t Grid::get_uid() const {
+    return make_uid(row, col);
+}
+
+uint64_t Grid::make_uid(uint32_t row, uint32_t col) {
+    return (static_cast<uint64_t>(row) << 32) | col;
+}
    
 bool Grid::touches(const geo::Bounds& bounds) const {
-    if (bounds.contains(sw) || bounds.contains(ne) || bounds.contains(se) || bounds.contains(nw)) {
-        return true;
-    } 
-
-    if (contains(bounds.sw) || contains(bounds.ne) || contains(bounds.se) || contains(bounds.nw)) {
-        return true;
-    }
-    return false;
+    return predicates::boxes_overlap(sw, ne, bounds.sw, bounds.ne);
 }
 
 Grid::GridPtrVector Grid::build_grid(const geo::Location& nw_point, double grid_width, double lat_threshold, double lon_threshold) {
@@ -772,6 +783,64 @@ Grid::GridPtrVector Grid::build_grid(const geo::Location& nw_point, double grid_
     return ret;
 }
 
+Polyline::Polyline(const std::vector<Location>& vertices, osm::Highway way_type, uint64_t id) :
+    vertices_{ vertices },
+    way_type_{ way_type },
+    uid_{ id }
+{
+    if (vertices_.size() < 2) {
+        throw std::invalid_argument("a polyline requires at least two vertices.");
+    }
+}
+
+const std::string Polyline::get_type() const {
+    return "polyline";
+}
+
+Validity Polyline::get_validity(void) const {
+    return validity_;
+}
+
+void Polyline::set_validity(const Validity& validity) {
+    validity_ = validity;
+}
+
+uint64_t Polyline::get_uid() const {
+    return uid_;
+}
+
+bool Polyline::touches(const Bounds& bounds) const {
+    for (std::size_t s = 0; s < segment_count(); ++s) {
+        if (segment_touches(s, bounds)) return true;
+    }
+
+    return false;
+}
+
+bool Polyline::segment_touches(std::size_t segment, const Bounds& bounds) const {
+    return predicates::box_touches_segment(bounds.sw, bounds.ne, vertices_[segment], vertices_[segment + 1]);
+}
+
+AreaPtr Polyline::segment_area(std::size_t segment, double extension) const {
+    return Edge::make_area(vertices_[segment], vertices_[segment + 1], get_way_width(), extension);
+}
+
+std::size_t Polyline::segment_count() const {
+    return vertices_.size() - 1;
+}
+
+const std::vector<Location>& Polyline::get_vertices() const {
+    return vertices_;
+}
+
+osm::Highway Polyline::get_way_type() const {
+    return way_type_;
+}
+
+double Polyline::get_way_width() const {
+    return osm::highway_width_map[static_cast<int>(way_type_)];
+}
+
 std::ostream& operator<< (std::ostream& os, const Grid& grid) 
 {
     return os << grid.sw << "," << grid.ne << "," << grid.row << "," << grid.col; 
@@ -802,6 +871,15 @@ std::ostream& operator<< (std::ostream& os, const Edge& edge)
     return os << edge.uid_ << "," << (edge.is_explicit() ? "explicit" : "implicit") << "," << osm::highway_name_map[edge.way_type_] << "," << *(edge.v1) << "," << *(edge.v2);
 }
 
+std::ostream& operator<< (std::ostream& os, const Polyline& polyline)
+{
+    os << polyline.uid_ << "," << osm::highway_name_map[polyline.way_type_];
+    for ( auto& v : polyline.vertices_ ) {
+        os << "," << v;
+    }
+    return os;
+}
+
 std::ostream& operator<< ( std::ostream& os, const Area& area )
 {
     os << "[";
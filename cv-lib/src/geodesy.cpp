@@ -0,0 +1,277 @@
+/**
+ * @file
+ * @author   Jason M. Carter (carterjm@ornl.gov)
+ * @author   Aaron E. Ferber (ferberae@ornl.gov)
+ * @date     April 2017
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+#include <cmath>
+
+#include "geodesy.hpp"
+
+namespace geo {
+
+namespace {
+
+const double kRadiansPerDegree = kPi / 180.0;
+const double kDegreesPerRadian = 180.0 / kPi;
+const double kHalfPi = kPi / 2.0;
+const double kQuarterPi = kPi / 4.0;
+const double kTanEighthPi = 0.41421356237309504880;             ///< tan(pi/8); the largest argument of the atan polynomial.
+
+// pi/2 in two parts, so multiples of the first part are exact (Cody and Waite).
+const double kHalfPiHigh = 1.57079632673412561417e+00;
+const double kHalfPiLow = 6.07710050650619224932e-11;
+const double kRoundMagic = 6755399441055744.0;                  ///< 1.5 * 2^52; adding and subtracting it rounds to an integer.
+
+/**
+ * @brief The sine and cosine of an angle in radians.
+ */
+inline void sin_cos( double x, double& s, double& c )
+{
+    // x = r + q * pi/2 with |r| <= pi/4.
+    double k = (x * (2.0 / kPi) + kRoundMagic) - kRoundMagic;
+    double r = (x - k * kHalfPiHigh) - k * kHalfPiLow;
+    int q = static_cast<int>( k );
+
+    double z = r * r;
+    double sin_r = r + r * z * (-1.66666666666666324348e-01 + z * (8.33333333332248946124e-03 + z * (-1.98412698298579493134e-04 +
+        z * (2.75573137070700676789e-06 + z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)))));
+    double cos_r = 1.0 - 0.5 * z + z * z * (4.16666666666666019037e-02 + z * (-1.38888888888741095749e-03 + z * (2.48015872894767294178e-05 +
+        z * (-2.75573143513906633035e-07 + z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11)))));
+
+    // the quadrant's swap and signs are multiplied in rather than chosen, which is exact and leaves the loops no branches
+    // to vectorize around.
+    double odd = static_cast<double>( q & 1 );
+    double sin_q = sin_r * (1.0 - odd) + cos_r * odd;
+    double cos_q = cos_r * (1.0 - odd) + sin_r * odd;
+    s = sin_q * static_cast<double>( 1 - (q & 2) );
+    c = cos_q * static_cast<double>( 1 - ((q + 1) & 2) );
+}
+
+/**
+ * @brief The arctangent of y / x in radians, (-pi, pi]; the quadrant is that of (x, y).
+ */
+inline double arc_tangent( double y, double x )
+{
+    double ax = std::fabs( x );
+    double ay = std::fabs( y );
+    double swap = ay > ax ? 1.0 : 0.0;
+    double big = ax * (1.0 - swap) + ay * swap;
+    double small = ay * (1.0 - swap) + ax * swap;
+    double t = small / (big + (big > 0.0 ? 0.0 : 1.0));
+
+    // atan(t) = pi/4 + atan((t - 1) / (t + 1)) puts the polynomial's argument within tan(pi/8); with reduced 0 the
+    // quotient is t exactly.
+    double reduced = t > kTanEighthPi ? 1.0 : 0.0;
+    double u = (t - reduced) / (1.0 + reduced * t);
+
+    double z = u * u;
+    double w = z * z;
+    double odd = z * (3.33333333333329318027e-01 + w * (1.42857142725034663711e-01 + w * (9.09088713343650656196e-02 +
+        w * (6.66107313738753120669e-02 + w * (4.97687799461593236017e-02 + w * 1.62858201153657823623e-02)))));
+    double even = w * (-1.99999999998764832476e-01 + w * (-1.11111104054623557880e-01 + w * (-7.69187620504482999495e-02 +
+        w * (-5.83357013379057348645e-02 + w * -3.65315727442169155270e-02))));
+    double a = u - u * (odd + even) + reduced * kQuarterPi;
+
+    // reflect into the octant of (x, y): pi/2 - a when |y| > |x|, then pi - a when x < 0, then the sign of y.
+    a += swap * (kHalfPi - 2.0 * a);
+    a += (x < 0.0 ? 1.0 : 0.0) * (kPi - 2.0 * a);
+    return std::copysign( a, y );
+}
+
+/**
+ * @brief The arcsine of a value in [-1, 1], in radians.
+ */
+inline double arc_sine( double v )
+{
+    double c2 = (1.0 - v) * (1.0 + v);
+    return arc_tangent( v, std::sqrt( c2 > 0.0 ? c2 : 0.0 ) );
+}
+
+/**
+ * @brief See Location::bearing; the latitudes' sines and cosines are given.
+ */
+inline double bearing_of( double sin_lat1, double cos_lat1, double sin_lat2, double cos_lat2, double lon_delta )
+{
+    double sin_delta;
+    double cos_delta;
+    sin_cos( lon_delta, sin_delta, cos_delta );
+
+    double degrees = arc_tangent( sin_delta * cos_lat2, cos_lat1 * sin_lat2 - sin_lat1 * cos_lat2 * cos_delta ) * kDegreesPerRadian;
+    return degrees + (degrees < 0.0 ? 360.0 : 0.0);
+}
+
+/**
+ * @brief See Location::project_position; the latitude's sine and cosine are given.
+ */
+inline void project( double sin_lat, double cos_lat, double lon, double bearing, double distance, double& lat_out, double& lon_out )
+{
+    double sin_b;
+    double cos_b;
+    double sin_d;
+    double cos_d;
+    sin_cos( bearing * kRadiansPerDegree, sin_b, cos_b );
+    sin_cos( distance / kEarthRadiusM, sin_d, cos_d );
+
+    double sin_lat_out = sin_lat * cos_d + cos_lat * sin_d * cos_b;
+    double lon_delta = arc_tangent( sin_b * sin_d * cos_lat, cos_d - sin_lat * sin_lat_out );
+    double degrees = lon + lon_delta * kDegreesPerRadian;
+
+    lat_out = arc_sine( sin_lat_out ) * kDegreesPerRadian;
+    // the same wrap as Location::project_position for longitudes within one turn of the range.
+    degrees -= degrees >= 180.0 ? 360.0 : 0.0;
+    lon_out = degrees + (degrees < -180.0 ? 360.0 : 0.0);
+}
+
+/**
+ * @brief Set corner k of each of n areas of four corners; Point declares a copy constructor but no assignment.
+ */
+inline void set_corners( Point* corners, std::size_t k, const double* lat, const double* lon, std::size_t n )
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        corners[4 * i + k].lat = lat[i];
+        corners[4 * i + k].lon = lon[i];
+    }
+}
+
+}  // end namespace.
+
+namespace batch {
+
+void distance( const double* lat1, const double* lon1, const double* lat2, const double* lon2, double* meters, std::size_t n )
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        double sin_mid;
+        double cos_mid;
+        sin_cos( (lat1[i] + lat2[i]) * (kRadiansPerDegree / 2.0), sin_mid, cos_mid );
+
+        double x = (lon2[i] - lon1[i]) * kRadiansPerDegree * cos_mid;
+        double y = (lat2[i] - lat1[i]) * kRadiansPerDegree;
+        meters[i] = std::sqrt( x * x + y * y ) * kEarthRadiusM;
+    }
+}
+
+void distance_haversine( const double* lat1, const double* lon1, const double* lat2, const double* lon2, double* meters, std::size_t n )
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        double x;
+        double y;
+        double cos_lat1;
+        double cos_lat2;
+        double unused;
+        sin_cos( (lat2[i] - lat1[i]) * (kRadiansPerDegree / 2.0), x, unused );
+        sin_cos( (lon2[i] - lon1[i]) * (kRadiansPerDegree / 2.0), y, unused );
+        sin_cos( lat1[i] * kRadiansPerDegree, unused, cos_lat1 );
+        sin_cos( lat2[i] * kRadiansPerDegree, unused, cos_lat2 );
+
+        double a = x * x + cos_lat1 * cos_lat2 * y * y;
+        // a rounded past 1 makes arc_sine's cosine 0, so the arcsine is pi/2 as for 1.
+        meters[i] = 2.0 * arc_sine( std::sqrt( a ) ) * kEarthRadiusM;
+    }
+}
+
+void bearing( const double* lat1, const double* lon1, const double* lat2, const double* lon2, double* degrees, std::size_t n )
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        double sin_lat1;
+        double cos_lat1;
+        double sin_lat2;
+        double cos_lat2;
+        sin_cos( lat1[i] * kRadiansPerDegree, sin_lat1, cos_lat1 );
+        sin_cos( lat2[i] * kRadiansPerDegree, sin_lat2, cos_lat2 );
+
+        degrees[i] = bearing_of( sin_lat1, cos_lat1, sin_lat2, cos_lat2, (lon2[i] - lon1[i]) * kRadiansPerDegree );
+    }
+}
+
+void project_position( const double* lat, const double* lon, const double* bearing, const double* distance,
+        double* lat_out, double* lon_out, std::size_t n )
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        double sin_lat;
+        double cos_lat;
+        sin_cos( lat[i] * kRadiansPerDegree, sin_lat, cos_lat );
+
+        double lat_i;
+        double lon_i;
+        project( sin_lat, cos_lat, lon[i], bearing[i], distance[i], lat_i, lon_i );
+        lat_out[i] = lat_i;
+        lon_out[i] = lon_i;
+    }
+}
+
+void segment_areas( const double* lat1, const double* lon1, const double* lat2, const double* lon2, const double* width,
+        double extension, Point* corners, std::size_t n )
+{
+    // the segments are taken a block at a time through the loops above, which are each vectorized; one loop doing all of
+    // the steps is too large for the compiler to inline the steps into.
+    const std::size_t kBlock = 64;
+    double ext = extension > 0.0 ? extension : 0.0;
+
+    double ab_bearing[kBlock];
+    double side_bearing[kBlock];
+    double ext_distance[kBlock];
+    double half_width[kBlock];
+    double e1_lat[kBlock];
+    double e1_lon[kBlock];
+    double e2_lat[kBlock];
+    double e2_lon[kBlock];
+    double corner_lat[kBlock];
+    double corner_lon[kBlock];
+
+    for (std::size_t start = 0; start < n; start += kBlock) {
+        std::size_t m = n - start < kBlock ? n - start : kBlock;
+        Point* area = corners + 4 * start;
+
+        bearing( lat1 + start, lon1 + start, lat2 + start, lon2 + start, ab_bearing, m );
+        for (std::size_t i = 0; i < m; ++i) {
+            side_bearing[i] = ab_bearing[i] - 180.0;
+            ext_distance[i] = ext;
+            half_width[i] = width[start + i] / 2.0;
+        }
+
+        // extend the ends of the segment; with no extension they are projected no distance and stay where they are.
+        project_position( lat1 + start, lon1 + start, side_bearing, ext_distance, e1_lat, e1_lon, m );
+        project_position( lat2 + start, lon2 + start, ab_bearing, ext_distance, e2_lat, e2_lon, m );
+
+        // the corners in the order of Edge::make_area: e1 and e2 to the left, then e2 and e1 to the right.
+        for (std::size_t i = 0; i < m; ++i) {
+            side_bearing[i] = ab_bearing[i] - 90.0;
+        }
+        project_position( e1_lat, e1_lon, side_bearing, half_width, corner_lat, corner_lon, m );
+        set_corners( area, 0, corner_lat, corner_lon, m );
+        project_position( e2_lat, e2_lon, side_bearing, half_width, corner_lat, corner_lon, m );
+        set_corners( area, 1, corner_lat, corner_lon, m );
+
+        for (std::size_t i = 0; i < m; ++i) {
+            side_bearing[i] = ab_bearing[i] + 90.0;
+        }
+        project_position( e2_lat, e2_lon, side_bearing, half_width, corner_lat, corner_lon, m );
+        set_corners( area, 2, corner_lat, corner_lon, m );
+        project_position( e1_lat, e1_lon, side_bearing, half_width, corner_lat, corner_lon, m );
+        set_corners( area, 3, corner_lat, corner_lon, m );
+    }
+}
+
+}  // end namespace batch.
+
+}  // end namespace geo.
@@ -0,0 +1,1538 @@
+/**
+ * @file
+ * @author   Jason M. Carter (carterjm@ornl.gov)
+ * @author   Aaron E. Ferber (ferberae@ornl.gov)
+ * @date     April 2017
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "geodesy.hpp"
+#include "geofence.hpp"
+#include "predicates.hpp"
+
+namespace {
+
+/**
+ * @brief The last id handed out by Geofence::answers.
+ */
+std::atomic<uint64_t> last_answers{ 0 };
+
+/**
+ * @brief Predicate indicating whether a box is inside another box and touches none of its sides.
+ */
+bool box_inside( const geo::Point& outer_sw, const geo::Point& outer_ne, const geo::Point& sw, const geo::Point& ne )
+{
+    return outer_sw.lat < sw.lat && ne.lat < outer_ne.lat && outer_sw.lon < sw.lon && ne.lon < outer_ne.lon;
+}
+
+/**
+ * @brief Classify a box against an area; areas are convex, so they contain the box when they contain its corners.
+ */
+Geofence::Cover area_cover( const geo::Point* corners, const geo::Point& sw, const geo::Point& ne )
+{
+    const geo::Point nw{ ne.lat, sw.lon };
+    const geo::Point se{ sw.lat, ne.lon };
+
+    if (geo::predicates::area_contains( corners, sw ) && geo::predicates::area_contains( corners, nw ) &&
+            geo::predicates::area_contains( corners, ne ) && geo::predicates::area_contains( corners, se )) {
+        return Geofence::Cover::INSIDE;
+    }
+
+    return geo::predicates::box_touches_area( sw, ne, corners ) ? Geofence::Cover::MIXED : Geofence::Cover::OUTSIDE;
+}
+
+/**
+ * @brief Find the longitude where two segments cross.
+ *
+ * @return true if the segments cross at a single point; lon is set to its longitude.
+ */
+bool crossing_lon( const geo::Point& p1, const geo::Point& p2, const geo::Point& q1, const geo::Point& q2, double& lon )
+{
+    double px = p2.lon - p1.lon;
+    double py = p2.lat - p1.lat;
+    double qx = q2.lon - q1.lon;
+    double qy = q2.lat - q1.lat;
+    double d = px * qy - py * qx;
+
+    // parallel sides never change places, whether or not they overlap.
+    if (d == 0.0) {
+        return false;
+    }
+
+    double rx = q1.lon - p1.lon;
+    double ry = q1.lat - p1.lat;
+    double t = (rx * qy - ry * qx) / d;
+    double u = (rx * py - ry * px) / d;
+
+    if (t < 0.0 || t > 1.0 || u < 0.0 || u > 1.0) {
+        return false;
+    }
+
+    lon = p1.lon + t * px;
+    return true;
+}
+
+/**
+ * @brief Find the latitudes where a meridian enters and leaves an area; areas are convex, so it is one interval.
+ *
+ * @return true if the meridian meets the area.
+ */
+bool area_extent( const geo::Point* corners, double lon, double& lower, double& upper )
+{
+    lower = std::numeric_limits<double>::infinity();
+    upper = -std::numeric_limits<double>::infinity();
+
+    for (int c = 0; c < 4; ++c) {
+        const geo::Point& a = corners[c];
+        const geo::Point& b = corners[(c + 1) % 4];
+
+        if (lon < std::min( a.lon, b.lon ) || lon > std::max( a.lon, b.lon )) continue;
+
+        if (a.lon == b.lon) {
+            lower = std::min( lower, std::min( a.lat, b.lat ) );
+            upper = std::max( upper, std::max( a.lat, b.lat ) );
+        } else {
+            double lat = a.lat + (lon - a.lon) * (b.lat - a.lat) / (b.lon - a.lon);
+            lower = std::min( lower, lat );
+            upper = std::max( upper, lat );
+        }
+    }
+
+    return lower <= upper;
+}
+
+/**
+ * @brief Return the space a number of bytes takes in the buffer; every array is 16-byte aligned.
+ */
+std::size_t space( std::size_t bytes )
+{
+    return (bytes + 15) & ~static_cast<std::size_t>( 15 );
+}
+
+/**
+ * @brief Return the space an array takes in the buffer.
+ */
+template <typename T>
+std::size_t space( const std::vector<T>& items )
+{
+    return space( items.size() * sizeof(T) );
+}
+
+/**
+ * @brief Copy an array into the buffer at offset, record its offset and size, and advance offset past it.
+ */
+template <typename T>
+void place( const std::vector<T>& items, char* buffer, std::size_t& offset, uint64_t& item_offset, uint32_t& item_count )
+{
+    static_assert( std::is_trivially_destructible<T>::value, "buffer contents are never destroyed." );
+
+    std::uninitialized_copy( items.begin(), items.end(), reinterpret_cast<T*>( buffer + offset ) );
+    item_offset = offset;
+    item_count = static_cast<uint32_t>( items.size() );
+    offset += space( items );
+}
+
+}
+
+/**
+ * @brief The arrays of an index while it is being built.
+ */
+struct Geofence::Tables {
+    std::vector<Node> nodes;                                        ///< See Geofence::nodes_.
+    std::vector<uint32_t> leaf_shapes;                              ///< See Geofence::leaf_shapes_.
+    std::vector<Shape> shapes;                                      ///< See Geofence::shapes_.
+    std::vector<geo::Point> area_corners;                           ///< See Geofence::area_corners_.
+    std::vector<Disc> circles;                                      ///< See Geofence::circles_.
+    std::vector<Box> grids;                                         ///< See Geofence::grids_.
+    std::vector<Lattice> lattices;                                  ///< See Geofence::lattices_.
+    std::vector<LatticeRow> lattice_rows;                           ///< See Geofence::lattice_rows_.
+    std::vector<uint64_t> lattice_bits;                             ///< See Geofence::lattice_bits_.
+    std::vector<Span> spans;                                        ///< See Geofence::spans_.
+    std::vector<Capsule> capsules;                                  ///< See Geofence::capsules_.
+    std::vector<Window> windows;                                    ///< See Geofence::windows_.
+    std::vector<Slab> slabs;                                        ///< See Geofence::slabs_.
+    std::vector<Piece> pieces;                                      ///< See Geofence::pieces_.
+    std::vector<double> segment_lat1;                               ///< The latitude of the first end of each area segment.
+    std::vector<double> segment_lon1;                               ///< The longitude of the first end of each area segment.
+    std::vector<double> segment_lat2;                               ///< The latitude of the second end of each area segment.
+    std::vector<double> segment_lon2;                               ///< The longitude of the second end of each area segment.
+    std::vector<double> segment_width;                              ///< The width of each area segment.
+    std::unordered_map<const geo::Entity*, uint32_t> shape_index;   ///< The shape table entry of each entity added.
+    std::unordered_set<const geo::Entity*> lattice_grids;           ///< The grids in a lattice; they are not added to the leaves.
+    std::unordered_map<const geo::Entity*, std::vector<uint32_t>> polyline_segments;  ///< The area or capsule of each segment of each polyline added; kNoSegment when it has none.
+
+    static constexpr uint32_t kNoSegment = UINT32_MAX;              ///< A segment whose buffer has no size.
+};
+
+const char Geofence::kMagic[8] = { 'C', 'V', 'D', 'P', 'G', 'E', 'O', 'F' };
+constexpr uint32_t Geofence::kVersion;
+constexpr double Geofence::kLatticeTolerance;
+constexpr uint32_t Geofence::kMinLatticeCells;
+constexpr uint32_t Geofence::kMaxLatticeBitsPerCell;
+constexpr uint32_t Geofence::kMinCoverageAreas;
+constexpr uint32_t Geofence::kMaxCoverageAreas;
+constexpr uint32_t Geofence::kMaxCoveragePieces;
+constexpr double Geofence::kMetersPerDegree;
+constexpr uint32_t Geofence::Tables::kNoSegment;
+
+Geofence::Geofence( Quad::CPtr quad_ptr, double extension ) :
+    Geofence{ std::vector<Quad::CPtr>{ quad_ptr }, extension }
+{}
+
+Geofence::Geofence( const std::vector<Quad::CPtr>& regions, double extension, geo::PageMode pages, EdgeModel edges ) :
+    regions_{ regions },
+    region_count_{ 0 },
+    extension_{ extension },
+    edge_model_{ edges },
+    buffer_{},
+    buffer_size_{ 0 },
+    page_mode_{ pages },
+    nodes_{ nullptr },
+    node_count_{ 0 },
+    shapes_{ nullptr },
+    shape_count_{ 0 },
+    area_corners_{ nullptr },
+    circles_{ nullptr },
+    grids_{ nullptr },
+    leaf_shapes_{ nullptr },
+    lattices_{ nullptr },
+    lattice_rows_{ nullptr },
+    lattice_bits_{ nullptr },
+    spans_{ nullptr },
+    capsules_{ nullptr },
+    windows_{ nullptr },
+    window_count_{ 0 },
+    slabs_{ nullptr },
+    pieces_{ nullptr },
+    leaf_shape_count_{ 0 },
+    start_hits_{},
+    hits_mutex_{},
+    hit_tables_{},
+    answers_{ ++last_answers }
+{
+    if (regions_.empty()) {
+        throw std::invalid_argument{ "cannot index an empty list of regions." };
+    }
+
+    Tables tables;
+
+    // the region roots come first; they are all the dispatcher looks at.
+    for (auto& quad_ptr : regions_) {
+        if (!quad_ptr) {
+            throw std::invalid_argument{ "cannot index a null quad tree." };
+        }
+
+        tables.nodes.push_back( Node{ quad_ptr->sw, quad_ptr->ne, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 } );
+    }
+
+    for (auto& quad_ptr : regions_) {
+        add_lattice( *quad_ptr, tables );
+    }
+
+    for (uint32_t r = 0; r < regions_.size(); ++r) {
+        layout( *regions_[r], r, tables );
+    }
+
+    // the areas of the segments are made together, in the order their corners were reserved by add_segment.
+    geo::batch::segment_areas( tables.segment_lat1.data(), tables.segment_lon1.data(), tables.segment_lat2.data(), tables.segment_lon2.data(),
+        tables.segment_width.data(), extension_, tables.area_corners.data(), tables.segment_width.size() );
+
+    for (uint32_t n = 0; n < tables.nodes.size(); ++n) {
+        if (tables.nodes[n].child_count == 0) add_coverage( n, tables );
+    }
+
+    pack( tables );
+}
+
+Geofence::Geofence( std::shared_ptr<const char> image, std::size_t size ) :
+    regions_{},
+    region_count_{ 0 },
+    extension_{ 0.0 },
+    edge_model_{ EdgeModel::AREA },
+    buffer_{ image },
+    buffer_size_{ size },
+    page_mode_{ geo::PageMode::NORMAL },
+    nodes_{ nullptr },
+    node_count_{ 0 },
+    shapes_{ nullptr },
+    shape_count_{ 0 },
+    area_corners_{ nullptr },
+    circles_{ nullptr },
+    grids_{ nullptr },
+    leaf_shapes_{ nullptr },
+    lattices_{ nullptr },
+    lattice_rows_{ nullptr },
+    lattice_bits_{ nullptr },
+    spans_{ nullptr },
+    capsules_{ nullptr },
+    windows_{ nullptr },
+    window_count_{ 0 },
+    slabs_{ nullptr },
+    pieces_{ nullptr },
+    leaf_shape_count_{ 0 },
+    start_hits_{},
+    hits_mutex_{},
+    hit_tables_{},
+    answers_{ ++last_answers }
+{
+    attach();
+}
+
+void Geofence::layout( const Quad& quad, uint32_t n, Tables& tables ) const
+{
+    if (quad.haschildren()) {
+        // siblings are added together so a node only needs the index of its first child; each child's subtree follows.
+        uint32_t first_child = static_cast<uint32_t>( tables.nodes.size() );
+        tables.nodes[n].first_child = first_child;
+        tables.nodes[n].child_count = static_cast<uint32_t>( quad.children_.size() );
+
+        for (auto& child : quad.children_) {
+            tables.nodes.push_back( Node{ child->sw, child->ne, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 } );
+        }
+
+        for (uint32_t c = 0; c < quad.children_.size(); ++c) {
+            layout( *quad.children_[c], first_child + c, tables );
+        }
+
+        return;
+    }
+
+    uint32_t first_shape = static_cast<uint32_t>( tables.leaf_shapes.size() );
+    std::vector<Window> windows;
+    std::vector<uint32_t> timed;
+
+    for (auto& entity_ptr : quad.element_list_) {
+        if (tables.lattice_grids.count( entity_ptr.get() ) > 0) continue;
+
+        // shapes valid for an interval go to the leaf's windows rather than its shape list.
+        geo::Validity validity = entity_ptr->get_validity();
+        std::vector<uint32_t>& leaf = validity.always() ? tables.leaf_shapes : timed;
+        timed.clear();
+
+        if (entity_ptr->get_type() == "polyline") {
+            add_polyline( static_cast<const geo::Polyline&>( *entity_ptr ), quad.fuzzybounds_, tables, leaf );
+        } else {
+            // entities are in every leaf they touch; each gets one shape table entry.
+            auto item = tables.shape_index.find( entity_ptr.get() );
+
+            if (item == tables.shape_index.end()) {
+                if (!add_shape( *entity_ptr, tables )) continue;
+                item = tables.shape_index.emplace( entity_ptr.get(), static_cast<uint32_t>( tables.shapes.size() - 1 ) ).first;
+            }
+
+            leaf.push_back( item->second );
+        }
+
+        for (uint32_t shape : timed) {
+            windows.push_back( Window{ validity.from, validity.to, shape, 0 } );
+        }
+    }
+
+    tables.nodes[n].first_shape = first_shape;
+    tables.nodes[n].shape_count = static_cast<uint32_t>( tables.leaf_shapes.size() ) - first_shape;
+
+    // a query stops at the first window that starts after its time.
+    std::stable_sort( windows.begin(), windows.end(), []( const Window& a, const Window& b ) { return a.from < b.from; } );
+    tables.nodes[n].first_window = static_cast<uint32_t>( tables.windows.size() );
+    tables.nodes[n].window_count = static_cast<uint32_t>( windows.size() );
+    tables.windows.insert( tables.windows.end(), windows.begin(), windows.end() );
+}
+
+void Geofence::add_polyline( const geo::Polyline& polyline, const geo::Bounds& bounds, Tables& tables, std::vector<uint32_t>& leaf ) const
+{
+    auto item = tables.polyline_segments.find( &polyline );
+
+    if (item == tables.polyline_segments.end()) {
+        // every segment's buffer is added the first time the polyline is seen, so the buffers of consecutive segments
+        // are next to each other.
+        std::vector<uint32_t> segments( polyline.segment_count(), Tables::kNoSegment );
+        const std::vector<geo::Location>& vertices = polyline.get_vertices();
+
+        for (std::size_t s = 0; s < polyline.segment_count(); ++s) {
+            add_segment( vertices[s], vertices[s + 1], polyline.get_way_width(), tables, segments[s] );
+        }
+
+        item = tables.polyline_segments.emplace( &polyline, std::move( segments ) ).first;
+    }
+
+    const std::vector<uint32_t>& segments = item->second;
+    ShapeType type = edge_model_ == EdgeModel::CAPSULE ? ShapeType::CAPSULE_RUN : ShapeType::POLYLINE;
+
+    for (std::size_t s = 0; s < segments.size(); ) {
+        if (segments[s] == Tables::kNoSegment || !polyline.segment_touches( s, bounds )) {
+            ++s;
+            continue;
+        }
+
+        Span span{ segments[s], 0 };
+
+        while (s < segments.size() && segments[s] != Tables::kNoSegment && polyline.segment_touches( s, bounds )) {
+            ++span.count;
+            ++s;
+        }
+
+        leaf.push_back( static_cast<uint32_t>( tables.shapes.size() ) );
+        tables.shapes.push_back( Shape{ type, static_cast<uint32_t>( tables.spans.size() ) } );
+        tables.spans.push_back( span );
+    }
+}
+
+bool Geofence::add_segment( const geo::Location& p1, const geo::Location& p2, double width, Tables& tables, uint32_t& index ) const
+{
+    if (edge_model_ == EdgeModel::CAPSULE) {
+        if (width <= 0.0) {
+            return false;
+        }
+
+        // the plane is tangent at the first end; over the length of a segment its error is far below a meter.
+        Capsule capsule;
+        capsule.lat = p1.lat;
+        capsule.lon = p1.lon;
+        capsule.lon_scale = kMetersPerDegree * std::cos( p1.lat * M_PI / 180.0 );
+        capsule.dx = (p2.lon - p1.lon) * capsule.lon_scale;
+        capsule.dy = (p2.lat - p1.lat) * kMetersPerDegree;
+
+        double length2 = capsule.dx * capsule.dx + capsule.dy * capsule.dy;
+        capsule.inv_length2 = length2 > 0.0 ? 1.0 / length2 : 0.0;
+        capsule.radius = width / 2.0 + extension_;
+        capsule.radius2 = capsule.radius * capsule.radius;
+
+        index = static_cast<uint32_t>( tables.capsules.size() );
+        tables.capsules.push_back( capsule );
+        return true;
+    }
+
+    // as Edge::make_area; the corners are filled in once every segment has been added.
+    if (width <= 0.0) {
+        return false;
+    }
+
+    index = static_cast<uint32_t>( tables.segment_width.size() );
+    tables.segment_lat1.push_back( p1.lat );
+    tables.segment_lon1.push_back( p1.lon );
+    tables.segment_lat2.push_back( p2.lat );
+    tables.segment_lon2.push_back( p2.lon );
+    tables.segment_width.push_back( width );
+    tables.area_corners.resize( tables.area_corners.size() + 4 );
+    return true;
+}
+
+void Geofence::add_coverage( uint32_t n, Tables& tables ) const
+{
+    Node& leaf = tables.nodes[n];
+    auto first = tables.leaf_shapes.begin() + leaf.first_shape;
+    auto last = first + leaf.shape_count;
+    auto is_area = [&tables]( uint32_t shape ) {
+        return tables.shapes[shape].type == ShapeType::AREA || tables.shapes[shape].type == ShapeType::POLYLINE;
+    };
+
+    std::vector<const geo::Point*> areas;
+
+    for (auto entry = first; entry != last; ++entry) {
+        const Shape& shape = tables.shapes[*entry];
+
+        if (shape.type == ShapeType::AREA) {
+            areas.push_back( &tables.area_corners[4 * shape.index] );
+        } else if (shape.type == ShapeType::POLYLINE) {
+            const Span& span = tables.spans[shape.index];
+            for (uint32_t s = 0; s < span.count; ++s) {
+                areas.push_back( &tables.area_corners[4 * (span.first + s)] );
+            }
+        }
+    }
+
+    if (areas.size() < kMinCoverageAreas || areas.size() > kMaxCoverageAreas) {
+        return;
+    }
+
+    double west = leaf.sw.lon;
+    double east = leaf.ne.lon;
+    std::vector<geo::Point> area_sw;
+    std::vector<geo::Point> area_ne;
+
+    for (const geo::Point* corners : areas) {
+        area_sw.push_back( geo::Point{ std::min( std::min( corners[0].lat, corners[1].lat ), std::min( corners[2].lat, corners[3].lat ) ),
+            std::min( std::min( corners[0].lon, corners[1].lon ), std::min( corners[2].lon, corners[3].lon ) ) } );
+        area_ne.push_back( geo::Point{ std::max( std::max( corners[0].lat, corners[1].lat ), std::max( corners[2].lat, corners[3].lat ) ),
+            std::max( std::max( corners[0].lon, corners[1].lon ), std::max( corners[2].lon, corners[3].lon ) ) } );
+    }
+
+    // the slab edges: the leaf's sides, and every corner and crossing of two sides inside the leaf.
+    std::vector<double> edges{ west, east };
+
+    for (std::size_t a = 0; a < areas.size(); ++a) {
+        for (int c = 0; c < 4; ++c) {
+            if (areas[a][c].lon > west && areas[a][c].lon < east) edges.push_back( areas[a][c].lon );
+        }
+
+        for (std::size_t b = a + 1; b < areas.size(); ++b) {
+            if (!geo::predicates::boxes_overlap( area_sw[a], area_ne[a], area_sw[b], area_ne[b] )) continue;
+
+            for (int i = 0; i < 4; ++i) {
+                for (int j = 0; j < 4; ++j) {
+                    double lon;
+
+                    if (crossing_lon( areas[a][i], areas[a][(i + 1) % 4], areas[b][j], areas[b][(j + 1) % 4], lon ) && lon > west && lon < east) {
+                        edges.push_back( lon );
+                    }
+                }
+            }
+        }
+    }
+
+    std::sort( edges.begin(), edges.end() );
+    edges.erase( std::unique( edges.begin(), edges.end() ), edges.end() );
+
+    // an area either spans a slab or misses its inside; in a slab, each area is the points between two lines, and lines
+    // that do not cross keep their order, so intervals that overlap at the middle of the slab overlap across it.
+    struct Interval {
+        Piece piece;
+        double lower_mid;
+        double upper_mid;
+    };
+
+    std::vector<Slab> slabs;
+    std::vector<Piece> pieces;
+    std::vector<Interval> intervals;
+
+    for (std::size_t e = 0; e + 1 < edges.size(); ++e) {
+        double slab_west = edges[e];
+        double slab_east = edges[e + 1];
+        double mid = slab_west + (slab_east - slab_west) / 2.0;
+        intervals.clear();
+
+        for (std::size_t a = 0; a < areas.size(); ++a) {
+            if (area_sw[a].lon > slab_west || area_ne[a].lon < slab_east) continue;
+
+            Interval interval;
+            area_extent( areas[a], slab_west, interval.piece.lower_west, interval.piece.upper_west );
+            area_extent( areas[a], slab_east, interval.piece.lower_east, interval.piece.upper_east );
+            area_extent( areas[a], mid, interval.lower_mid, interval.upper_mid );
+            intervals.push_back( interval );
+        }
+
+        std::sort( intervals.begin(), intervals.end(), []( const Interval& a, const Interval& b ) { return a.lower_mid < b.lower_mid; } );
+        Slab slab{ slab_west, slab_east, static_cast<uint32_t>( tables.pieces.size() + pieces.size() ), 0 };
+
+        for (std::size_t i = 0; i < intervals.size(); ++slab.piece_count) {
+            Interval merged = intervals[i];
+
+            for (++i; i < intervals.size() && intervals[i].lower_mid <= merged.upper_mid; ++i) {
+                if (intervals[i].upper_mid > merged.upper_mid) {
+                    merged.upper_mid = intervals[i].upper_mid;
+                    merged.piece.upper_west = intervals[i].piece.upper_west;
+                    merged.piece.upper_east = intervals[i].piece.upper_east;
+                }
+            }
+
+            pieces.push_back( merged.piece );
+        }
+
+        slabs.push_back( slab );
+
+        if (pieces.size() > kMaxCoveragePieces) {
+            return;
+        }
+    }
+
+    // the areas the coverage answers for go first.
+    leaf.covered_count = static_cast<uint32_t>( std::stable_partition( first, last, is_area ) - first );
+    leaf.first_slab = static_cast<uint32_t>( tables.slabs.size() );
+    leaf.slab_count = static_cast<uint32_t>( slabs.size() );
+    tables.slabs.insert( tables.slabs.end(), slabs.begin(), slabs.end() );
+    tables.pieces.insert( tables.pieces.end(), pieces.begin(), pieces.end() );
+}
+
+double Geofence::capsule_distance2( const Capsule& capsule, const geo::Point& pt )
+{
+    double x = (pt.lon - capsule.lon) * capsule.lon_scale;
+    double y = (pt.lat - capsule.lat) * kMetersPerDegree;
+    double t = std::min( std::max( (x * capsule.dx + y * capsule.dy) * capsule.inv_length2, 0.0 ), 1.0 );
+    double ex = x - t * capsule.dx;
+    double ey = y - t * capsule.dy;
+
+    return ex * ex + ey * ey;
+}
+
+Geofence::Cover Geofence::capsule_cover( const Capsule& capsule, const geo::Point& sw, const geo::Point& ne )
+{
+    // capsules are convex, so they contain the box when they contain its corners.
+    if (capsule_distance2( capsule, sw ) <= capsule.radius2 && capsule_distance2( capsule, ne ) <= capsule.radius2 &&
+            capsule_distance2( capsule, geo::Point{ ne.lat, sw.lon } ) <= capsule.radius2 &&
+            capsule_distance2( capsule, geo::Point{ sw.lat, ne.lon } ) <= capsule.radius2) {
+        return Cover::INSIDE;
+    }
+
+    // every point of the box is within half its diagonal of its center.
+    double width = (ne.lon - sw.lon) * capsule.lon_scale;
+    double height = (ne.lat - sw.lat) * kMetersPerDegree;
+    double half_diagonal = std::sqrt( width * width + height * height ) / 2.0;
+    double center = std::sqrt( capsule_distance2( capsule, geo::Point{ (sw.lat + ne.lat) / 2.0, (sw.lon + ne.lon) / 2.0 } ) );
+
+    return center > capsule.radius + half_diagonal ? Cover::OUTSIDE : Cover::MIXED;
+}
+
+void Geofence::collect_grids( const Quad& quad, std::vector<const geo::Grid*>& grids, std::unordered_set<const geo::Entity*>& seen ) const
+{
+    for (auto& child : quad.children_) {
+        collect_grids( *child, grids, seen );
+    }
+
+    for (auto& entity_ptr : quad.element_list_) {
+        // a lattice cell is always in the geofence; grids with a limited validity stay in the leaves.
+        if (entity_ptr->get_type() == "grid" && entity_ptr->get_validity().always() && seen.insert( entity_ptr.get() ).second) {
+            grids.push_back( static_cast<const geo::Grid*>( entity_ptr.get() ) );
+        }
+    }
+}
+
+void Geofence::add_lattice( const Quad& quad, Tables& tables ) const
+{
+    Lattice none{ 0.0, 0.0, 0, 0, 0, 0, 0, 0 };
+    std::vector<const geo::Grid*> grids;
+    std::unordered_set<const geo::Entity*> seen;
+    collect_grids( quad, grids, seen );
+
+    if (grids.size() < kMinLatticeCells) {
+        tables.lattices.push_back( none );
+        return;
+    }
+
+    uint32_t row_min = grids[0]->row;
+    uint32_t row_max = grids[0]->row;
+    uint32_t col_min = grids[0]->col;
+    uint32_t col_max = grids[0]->col;
+
+    for (auto grid : grids) {
+        row_min = std::min( row_min, grid->row );
+        row_max = std::max( row_max, grid->row );
+        col_min = std::min( col_min, grid->col );
+        col_max = std::max( col_max, grid->col );
+    }
+
+    uint64_t rows = static_cast<uint64_t>( row_max - row_min ) + 1;
+    uint64_t cols = static_cast<uint64_t>( col_max - col_min ) + 1;
+
+    if (rows * cols > kMaxLatticeBitsPerCell * grids.size()) {
+        tables.lattices.push_back( none );
+        return;
+    }
+
+    // the first grid sets the row height and, for each row, the first grid in it sets the column width; every grid
+    // must then be where its row and column put it.
+    Lattice lattice{ 0.0, grids[0]->ne.lat - grids[0]->sw.lat, static_cast<uint32_t>( rows ), static_cast<uint32_t>( cols ),
+        static_cast<uint32_t>( tables.lattice_rows.size() ), static_cast<uint32_t>( tables.lattice_bits.size() ), 0, 0 };
+    lattice.north = grids[0]->ne.lat + (grids[0]->row - row_min) * lattice.row_height;
+
+    std::vector<LatticeRow> lattice_rows( rows, LatticeRow{ 0.0, 0.0 } );
+    std::vector<uint64_t> bits( (rows * cols + 63) / 64, 0 );
+
+    bool fits = lattice.row_height > kLatticeTolerance;
+
+    for (auto it = grids.begin(); fits && it != grids.end(); ++it) {
+        const geo::Grid& grid = **it;
+        uint32_t r = grid.row - row_min;
+        uint32_t c = grid.col - col_min;
+        LatticeRow& row = lattice_rows[r];
+
+        if (row.width == 0.0) {
+            row.width = grid.ne.lon - grid.sw.lon;
+            row.west = grid.sw.lon - c * row.width;
+        }
+
+        fits = row.width > kLatticeTolerance &&
+            std::fabs( grid.ne.lat - (lattice.north - r * lattice.row_height) ) <= kLatticeTolerance &&
+            std::fabs( grid.sw.lat - (lattice.north - (r + 1) * lattice.row_height) ) <= kLatticeTolerance &&
+            std::fabs( grid.sw.lon - (row.west + c * row.width) ) <= kLatticeTolerance &&
+            std::fabs( grid.ne.lon - (row.west + (c + 1) * row.width) ) <= kLatticeTolerance;
+
+        uint64_t bit = r * cols + c;
+        if (fits && !(bits[bit / 64] >> (bit % 64) & 1)) {
+            bits[bit / 64] |= uint64_t{ 1 } << (bit % 64);
+            ++lattice.cell_count;
+        }
+    }
+
+    if (!fits) {
+        tables.lattices.push_back( none );
+        return;
+    }
+
+    tables.lattices.push_back( lattice );
+    tables.lattice_rows.insert( tables.lattice_rows.end(), lattice_rows.begin(), lattice_rows.end() );
+    tables.lattice_bits.insert( tables.lattice_bits.end(), bits.begin(), bits.end() );
+    tables.lattice_grids.insert( seen.begin(), seen.end() );
+}
+
+bool Geofence::add_shape( const geo::Entity& entity, Tables& tables ) const
+{
+    const std::string type = entity.get_type();
+
+    if (type == "edge") {
+        // edges are either Edges or, when the map is loaded as a graph, GraphEdges; both are buffered as Edge::to_area
+        // does.
+        uint32_t index;
+        bool added;
+        const geo::Edge* edge = dynamic_cast<const geo::Edge*>( &entity );
+
+        if (edge) {
+            added = add_segment( *edge->v1, *edge->v2, edge->get_way_width(), tables, index );
+        } else {
+            const geo::GraphEdge& graph_edge = static_cast<const geo::GraphEdge&>( entity );
+            const geo::RoadGraph& graph = graph_edge.get_graph();
+            added = add_segment( graph.location( graph.edge_v1( graph_edge.get_index() ) ), graph.location( graph.edge_v2( graph_edge.get_index() ) ),
+                graph_edge.get_way_width(), tables, index );
+        }
+
+        if (!added) {
+            return false;
+        }
+
+        tables.shapes.push_back( Shape{ edge_model_ == EdgeModel::CAPSULE ? ShapeType::CAPSULE : ShapeType::AREA, index } );
+
+    } else if (type == "circle") {
+        const geo::Circle& circle = static_cast<const geo::Circle&>( entity );
+
+        tables.shapes.push_back( Shape{ ShapeType::CIRCLE, static_cast<uint32_t>( tables.circles.size() ) } );
+        tables.circles.push_back( Disc{ geo::Point{ circle.lat, circle.lon }, circle.radius } );
+
+    } else if (type == "grid") {
+        const geo::Grid& grid = static_cast<const geo::Grid&>( entity );
+
+        tables.shapes.push_back( Shape{ ShapeType::GRID, static_cast<uint32_t>( tables.grids.size() ) } );
+        tables.grids.push_back( Box{ grid.sw, grid.ne } );
+
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+void Geofence::pack( const Tables& tables )
+{
+    std::size_t size = space( sizeof(Header) ) + space( tables.nodes ) + space( tables.shapes ) + space( tables.area_corners ) +
+        space( tables.circles ) + space( tables.grids ) + space( tables.leaf_shapes ) + space( tables.lattices ) +
+        space( tables.lattice_rows ) + space( tables.lattice_bits ) + space( tables.spans ) + space( tables.capsules ) +
+        space( tables.windows ) + space( tables.slabs ) + space( tables.pieces );
+
+    // the buffer is aligned for any type, so every array in the buffer is aligned.
+    std::shared_ptr<char> pages = geo::allocate_pages( size, page_mode_ );
+    char* buffer = pages.get();
+    buffer_ = pages;
+    buffer_size_ = size;
+
+    Header header;
+    std::memset( &header, 0, sizeof(header) );
+    std::memcpy( header.magic, kMagic, sizeof(kMagic) );
+    header.version = kVersion;
+    header.region_count = static_cast<uint32_t>( regions_.size() );
+    header.size = size;
+    header.extension = extension_;
+    header.edge_model = static_cast<uint32_t>( edge_model_ );
+
+    std::size_t offset = space( sizeof(Header) );
+    place( tables.nodes, buffer, offset, header.offsets[0], header.counts[0] );
+    place( tables.shapes, buffer, offset, header.offsets[1], header.counts[1] );
+    place( tables.area_corners, buffer, offset, header.offsets[2], header.counts[2] );
+    place( tables.circles, buffer, offset, header.offsets[3], header.counts[3] );
+    place( tables.grids, buffer, offset, header.offsets[4], header.counts[4] );
+    place( tables.leaf_shapes, buffer, offset, header.offsets[5], header.counts[5] );
+    place( tables.lattices, buffer, offset, header.offsets[6], header.counts[6] );
+    place( tables.lattice_rows, buffer, offset, header.offsets[7], header.counts[7] );
+    place( tables.lattice_bits, buffer, offset, header.offsets[8], header.counts[8] );
+    place( tables.spans, buffer, offset, header.offsets[9], header.counts[9] );
+    place( tables.capsules, buffer, offset, header.offsets[10], header.counts[10] );
+    place( tables.windows, buffer, offset, header.offsets[11], header.counts[11] );
+    place( tables.slabs, buffer, offset, header.offsets[12], header.counts[12] );
+    place( tables.pieces, buffer, offset, header.offsets[13], header.counts[13] );
+
+    std::memcpy( buffer, &header, sizeof(header) );
+    attach();
+}
+
+void Geofence::attach()
+{
+    if (!buffer_) {
+        throw std::invalid_argument{ "geofence image is null." };
+    }
+
+    if (reinterpret_cast<std::uintptr_t>( buffer_.get() ) % 16 != 0) {
+        throw std::invalid_argument{ "geofence image is not 16-byte aligned." };
+    }
+
+    Header header;
+
+    if (buffer_size_ < sizeof(header)) {
+        throw std::invalid_argument{ "geofence image is too small." };
+    }
+
+    std::memcpy( &header, buffer_.get(), sizeof(header) );
+
+    if (std::memcmp( header.magic, kMagic, sizeof(kMagic) ) != 0 || header.version != kVersion) {
+        throw std::invalid_argument{ "not a geofence image of version " + std::to_string( kVersion ) + "." };
+    }
+
+    if (header.size != buffer_size_) {
+        throw std::invalid_argument{ "geofence image size does not match its header." };
+    }
+
+    // every array must be aligned and lie completely within the image.
+    const std::size_t item_sizes[14] = { sizeof(Node), sizeof(Shape), sizeof(geo::Point), sizeof(Disc), sizeof(Box), sizeof(uint32_t),
+        sizeof(Lattice), sizeof(LatticeRow), sizeof(uint64_t), sizeof(Span), sizeof(Capsule), sizeof(Window), sizeof(Slab), sizeof(Piece) };
+
+    for (int a = 0; a < 14; ++a) {
+        if (header.offsets[a] % 16 != 0 || header.offsets[a] < sizeof(header) ||
+                header.offsets[a] + static_cast<uint64_t>( header.counts[a] ) * item_sizes[a] > header.size) {
+            throw std::invalid_argument{ "geofence image array " + std::to_string( a ) + " is out of bounds." };
+        }
+    }
+
+    if (header.region_count == 0 || header.region_count > header.counts[0] || header.counts[6] != header.region_count) {
+        throw std::invalid_argument{ "geofence image has an invalid region count." };
+    }
+
+    if (header.edge_model > static_cast<uint32_t>( EdgeModel::CAPSULE )) {
+        throw std::invalid_argument{ "geofence image has an unknown edge model." };
+    }
+
+    region_count_ = header.region_count;
+    extension_ = header.extension;
+    edge_model_ = static_cast<EdgeModel>( header.edge_model );
+
+    const char* buffer = buffer_.get();
+    nodes_ = reinterpret_cast<const Node*>( buffer + header.offsets[0] );
+    node_count_ = header.counts[0];
+    shapes_ = reinterpret_cast<const Shape*>( buffer + header.offsets[1] );
+    shape_count_ = header.counts[1];
+    area_corners_ = reinterpret_cast<const geo::Point*>( buffer + header.offsets[2] );
+    circles_ = reinterpret_cast<const Disc*>( buffer + header.offsets[3] );
+    grids_ = reinterpret_cast<const Box*>( buffer + header.offsets[4] );
+    leaf_shapes_ = reinterpret_cast<const uint32_t*>( buffer + header.offsets[5] );
+    lattices_ = reinterpret_cast<const Lattice*>( buffer + header.offsets[6] );
+    lattice_rows_ = reinterpret_cast<const LatticeRow*>( buffer + header.offsets[7] );
+    lattice_bits_ = reinterpret_cast<const uint64_t*>( buffer + header.offsets[8] );
+    spans_ = reinterpret_cast<const Span*>( buffer + header.offsets[9] );
+    capsules_ = reinterpret_cast<const Capsule*>( buffer + header.offsets[10] );
+    windows_ = reinterpret_cast<const Window*>( buffer + header.offsets[11] );
+    window_count_ = header.counts[11];
+    slabs_ = reinterpret_cast<const Slab*>( buffer + header.offsets[12] );
+    pieces_ = reinterpret_cast<const Piece*>( buffer + header.offsets[13] );
+    leaf_shape_count_ = header.counts[5];
+}
+
+const Geofence::Node* Geofence::find_leaf( const Node* node, const geo::Point& pt ) const
+{
+    while (node->child_count > 0) {
+        const Node* child = nodes_ + node->first_child;
+        const Node* last = child + node->child_count;
+
+        // retrieval bounds are disjoint; stop at the first child that contains the point.
+        while (child != last && !geo::predicates::box_contains( child->sw, child->ne, pt )) ++child;
+
+        if (child == last) {
+            return nullptr;
+        }
+
+        node = child;
+    }
+
+    return node;
+}
+
+bool Geofence::contains( const geo::Point& pt ) const
+{
+    return search( pt, nullptr, false, nullptr ) != Grade::OUTSIDE;
+}
+
+bool Geofence::contains( const geo::Point& pt, int64_t time, Hits* hits ) const
+{
+    return search( pt, &time, false, hits ) != Grade::OUTSIDE;
+}
+
+Geofence::Grade Geofence::grade( const geo::Point& pt ) const
+{
+    return search( pt, nullptr, true, nullptr );
+}
+
+Geofence::Grade Geofence::grade( const geo::Point& pt, int64_t time, Hits* hits ) const
+{
+    return search( pt, &time, true, hits );
+}
+
+Geofence::Grade Geofence::search( const geo::Point& pt, const int64_t* time, bool graded, Hits* hits ) const
+{
+    Grade grade = Grade::OUTSIDE;
+
+    for (const Node* root = nodes_; root != nodes_ + region_count_; ++root) {
+        if (!geo::predicates::box_contains( root->sw, root->ne, pt )) continue;
+
+        const Lattice& lattice = lattices_[root - nodes_];
+
+        if (lattice.rows > 0 && lattice_contains( lattice, pt )) {
+            return Grade::CORE;
+        }
+
+        const Node* leaf = find_leaf( root, pt );
+
+        if (leaf) {
+            Grade leaf_result = leaf_grade( *leaf, pt, time, graded, hits );
+            if (leaf_result == Grade::CORE) return Grade::CORE;
+            if (leaf_result == Grade::BUFFER) grade = Grade::BUFFER;
+        }
+    }
+
+    return grade;
+}
+
+bool Geofence::lattice_contains( const Lattice& lattice, const geo::Point& pt ) const
+{
+    // the rows and columns within the tolerance of the point; usually one of each.
+    double row_eps = kLatticeTolerance / lattice.row_height;
+    double y = (lattice.north - pt.lat) / lattice.row_height;
+
+    if (!(y >= -row_eps && y <= lattice.rows + row_eps)) {
+        return false;
+    }
+
+    int64_t last_row = std::min( static_cast<int64_t>( std::floor( y + row_eps ) ), static_cast<int64_t>( lattice.rows ) - 1 );
+
+    for (int64_t r = std::max( static_cast<int64_t>( std::floor( y - row_eps ) ), int64_t{ 0 } ); r <= last_row; ++r) {
+        const LatticeRow& row = lattice_rows_[lattice.first_row + r];
+        if (row.width == 0.0) continue;
+
+        double col_eps = kLatticeTolerance / row.width;
+        double x = (pt.lon - row.west) / row.width;
+        if (!(x >= -col_eps && x <= lattice.cols + col_eps)) continue;
+
+        int64_t last_col = std::min( static_cast<int64_t>( std::floor( x + col_eps ) ), static_cast<int64_t>( lattice.cols ) - 1 );
+
+        for (int64_t c = std::max( static_cast<int64_t>( std::floor( x - col_eps ) ), int64_t{ 0 } ); c <= last_col; ++c) {
+            uint64_t bit = static_cast<uint64_t>( r ) * lattice.cols + static_cast<uint64_t>( c );
+
+            if (lattice_bits_[lattice.first_word + bit / 64] >> (bit % 64) & 1) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+Geofence::Cover Geofence::lattice_cover( const Lattice& lattice, const geo::Point& sw, const geo::Point& ne ) const
+{
+    double row_eps = kLatticeTolerance / lattice.row_height;
+    double y0 = (lattice.north - ne.lat) / lattice.row_height;
+    double y1 = (lattice.north - sw.lat) / lattice.row_height;
+
+    if (y1 < -row_eps || y0 > lattice.rows + row_eps) {
+        return Cover::OUTSIDE;
+    }
+
+    int64_t first_row = std::max( static_cast<int64_t>( std::floor( y0 - row_eps ) ), int64_t{ 0 } );
+    int64_t last_row = std::min( static_cast<int64_t>( std::floor( y1 + row_eps ) ), static_cast<int64_t>( lattice.rows ) - 1 );
+
+    // only small boxes are worth the work; larger ones go to the index.
+    if (last_row - first_row > 2) {
+        return Cover::MIXED;
+    }
+
+    for (int64_t r = first_row; r <= last_row; ++r) {
+        const LatticeRow& row = lattice_rows_[lattice.first_row + r];
+        if (row.width == 0.0) continue;
+
+        double col_eps = kLatticeTolerance / row.width;
+        double x0 = (sw.lon - row.west) / row.width;
+        double x1 = (ne.lon - row.west) / row.width;
+        if (x1 < -col_eps || x0 > lattice.cols + col_eps) continue;
+
+        int64_t first_col = std::max( static_cast<int64_t>( std::floor( x0 - col_eps ) ), int64_t{ 0 } );
+        int64_t last_col = std::min( static_cast<int64_t>( std::floor( x1 + col_eps ) ), static_cast<int64_t>( lattice.cols ) - 1 );
+
+        if (last_col - first_col > 2) {
+            return Cover::MIXED;
+        }
+
+        for (int64_t c = first_col; c <= last_col; ++c) {
+            uint64_t bit = static_cast<uint64_t>( r ) * lattice.cols + static_cast<uint64_t>( c );
+            if (!(lattice_bits_[lattice.first_word + bit / 64] >> (bit % 64) & 1)) continue;
+
+            // a present cell near the box; the box is inside only when it is clear of the cell's edges.
+            bool inside = y0 - row_eps >= r && y1 + row_eps <= r + 1 && x0 - col_eps >= c && x1 + col_eps <= c + 1;
+            return inside ? Cover::INSIDE : Cover::MIXED;
+        }
+    }
+
+    return Cover::OUTSIDE;
+}
+
+Geofence::Grade Geofence::leaf_grade( const Node& leaf, const geo::Point& pt, const int64_t* time, bool graded, Hits* hits ) const
+{
+    Grade grade = Grade::OUTSIDE;
+
+    const uint32_t* first = leaf_shapes_ + leaf.first_shape;
+
+    // the coverage answers for the leaf's areas at once, but not for their cores.
+    if (!graded && leaf.slab_count > 0) {
+        if (coverage_contains( leaf, pt )) return Grade::CORE;
+        first += leaf.covered_count;
+    }
+
+    // the core is only looked at for the shapes that contain the point.
+    for (const uint32_t* shape = first; shape != leaf_shapes_ + leaf.first_shape + leaf.shape_count; ++shape) {
+        if (shape_contains( *shape, pt )) {
+            if (hits && leaf.shape_count > 1) hits->add( static_cast<uint32_t>( shape - leaf_shapes_ ) );
+
+            if (!graded || shape_core( *shape, pt )) return Grade::CORE;
+            grade = Grade::BUFFER;
+        }
+    }
+
+    for (const Window* window = windows_ + leaf.first_window; window != windows_ + leaf.first_window + leaf.window_count; ++window) {
+        if (time) {
+            // the windows are ordered by their start, so none of the rest has started either.
+            if (window->from > *time) break;
+            if (*time >= window->to) continue;
+        }
+
+        if (shape_contains( window->shape, pt )) {
+            if (!graded || shape_core( window->shape, pt )) return Grade::CORE;
+            grade = Grade::BUFFER;
+        }
+    }
+
+    return grade;
+}
+
+geo::IndexRange Geofence::retrieve_shapes( const geo::Point& pt ) const
+{
+    for (const Node* root = nodes_; root != nodes_ + region_count_; ++root) {
+        if (!geo::predicates::box_contains( root->sw, root->ne, pt )) continue;
+
+        const Node* leaf = find_leaf( root, pt );
+
+        if (leaf) {
+            return geo::IndexRange{ leaf_shapes_ + leaf->first_shape, leaf_shapes_ + leaf->first_shape + leaf->shape_count };
+        }
+    }
+
+    return geo::IndexRange{ leaf_shapes_, leaf_shapes_ };
+}
+
+Geofence::Cover Geofence::classify( const geo::Point& sw, const geo::Point& ne ) const
+{
+    const Node* region = nullptr;
+
+    for (const Node* root = nodes_; root != nodes_ + region_count_; ++root) {
+        if (!geo::predicates::boxes_overlap( root->sw, root->ne, sw, ne )) continue;
+
+        // a box that overlaps more than one region could have parts answered by either.
+        if (region) return Cover::MIXED;
+        region = root;
+    }
+
+    if (!region) {
+        return Cover::OUTSIDE;
+    }
+
+    if (!box_inside( region->sw, region->ne, sw, ne )) {
+        return Cover::MIXED;
+    }
+
+    const Lattice& lattice = lattices_[region - nodes_];
+
+    if (lattice.rows > 0) {
+        Cover lattice_result = lattice_cover( lattice, sw, ne );
+        if (lattice_result != Cover::OUTSIDE) return lattice_result;
+    }
+
+    // every point of a box inside a leaf is found in that leaf; a box on a leaf boundary could be found in either.
+    const Node* leaf = find_leaf( region, sw );
+
+    if (!leaf || !box_inside( leaf->sw, leaf->ne, sw, ne )) {
+        return Cover::MIXED;
+    }
+
+    Cover cover = Cover::OUTSIDE;
+
+    for (const uint32_t* shape = leaf_shapes_ + leaf->first_shape; shape != leaf_shapes_ + leaf->first_shape + leaf->shape_count; ++shape) {
+        Cover shape_result = shape_cover( *shape, sw, ne );
+
+        if (shape_result == Cover::INSIDE) {
+            return Cover::INSIDE;
+        }
+
+        if (shape_result == Cover::MIXED) {
+            cover = Cover::MIXED;
+        }
+    }
+
+    // a shape with a limited validity may or may not be there, so any it comes near makes the box MIXED.
+    for (const Window* window = windows_ + leaf->first_window; cover == Cover::OUTSIDE && window != windows_ + leaf->first_window + leaf->window_count; ++window) {
+        if (shape_cover( window->shape, sw, ne ) != Cover::OUTSIDE) {
+            cover = Cover::MIXED;
+        }
+    }
+
+    return cover;
+}
+
+Geofence::Cover Geofence::shape_cover( uint32_t shape, const geo::Point& sw, const geo::Point& ne ) const
+{
+    const Shape& entry = shapes_[shape];
+    const geo::Point nw{ ne.lat, sw.lon };
+    const geo::Point se{ sw.lat, ne.lon };
+
+    switch (entry.type) {
+        case ShapeType::AREA:
+            return area_cover( area_corners_ + 4 * entry.index, sw, ne );
+
+        case ShapeType::POLYLINE: {
+            const Span& span = spans_[entry.index];
+            Cover cover = Cover::OUTSIDE;
+
+            for (const geo::Point* corners = area_corners_ + 4 * span.first; corners != area_corners_ + 4 * (span.first + span.count); corners += 4) {
+                Cover area_result = area_cover( corners, sw, ne );
+
+                if (area_result == Cover::INSIDE) {
+                    return Cover::INSIDE;
+                }
+
+                if (area_result == Cover::MIXED) {
+                    cover = Cover::MIXED;
+                }
+            }
+
+            return cover;
+        }
+
+        case ShapeType::CAPSULE:
+            return capsule_cover( capsules_[entry.index], sw, ne );
+
+        case ShapeType::CAPSULE_RUN: {
+            const Span& span = spans_[entry.index];
+            Cover cover = Cover::OUTSIDE;
+
+            for (const Capsule* capsule = capsules_ + span.first; capsule != capsules_ + span.first + span.count; ++capsule) {
+                Cover capsule_result = capsule_cover( *capsule, sw, ne );
+
+                if (capsule_result == Cover::INSIDE) {
+                    return Cover::INSIDE;
+                }
+
+                if (capsule_result == Cover::MIXED) {
+                    cover = Cover::MIXED;
+                }
+            }
+
+            return cover;
+        }
+
+        case ShapeType::CIRCLE: {
+            // the sides of a box are not great circles; leave a margin of the box's diagonal on either side of the edge.
+            const Disc& disc = circles_[entry.index];
+            double margin = geo::Location::distance( sw.lat, sw.lon, ne.lat, ne.lon );
+            double farthest = 0.0;
+
+            for (const geo::Point* corner : { &sw, &nw, &ne, &se }) {
+                double d = geo::Location::distance( disc.center.lat, disc.center.lon, corner->lat, corner->lon );
+                if (d > farthest) farthest = d;
+            }
+
+            if (farthest + margin <= disc.radius) {
+                return Cover::INSIDE;
+            }
+
+            geo::Point nearest{ std::min( std::max( disc.center.lat, sw.lat ), ne.lat ), std::min( std::max( disc.center.lon, sw.lon ), ne.lon ) };
+            return geo::Location::distance( disc.center.lat, disc.center.lon, nearest.lat, nearest.lon ) > disc.radius + margin ? Cover::OUTSIDE : Cover::MIXED;
+        }
+
+        case ShapeType::GRID: {
+            const Box& box = grids_[entry.index];
+
+            if (geo::predicates::box_contains( box.sw, box.ne, sw ) && geo::predicates::box_contains( box.sw, box.ne, ne )) {
+                return Cover::INSIDE;
+            }
+
+            return geo::predicates::boxes_overlap( box.sw, box.ne, sw, ne ) ? Cover::MIXED : Cover::OUTSIDE;
+        }
+    }
+
+    return Cover::MIXED;
+}
+
+bool Geofence::shape_contains( uint32_t shape, const geo::Point& pt ) const
+{
+    const Shape& entry = shapes_[shape];
+
+    switch (entry.type) {
+        case ShapeType::AREA:
+            return geo::predicates::area_contains( area_corners_ + 4 * entry.index, pt );
+
+        case ShapeType::CIRCLE:
+            return geo::Location::distance( circles_[entry.index].center.lat, circles_[entry.index].center.lon, pt.lat, pt.lon ) <= circles_[entry.index].radius;
+
+        case ShapeType::GRID:
+            return geo::predicates::box_contains( grids_[entry.index].sw, grids_[entry.index].ne, pt );
+
+        case ShapeType::POLYLINE: {
+            // the run's areas are contiguous, so this is one pass over an array of corners with no lookups.
+            const Span& span = spans_[entry.index];
+            const geo::Point* corners = area_corners_ + 4 * span.first;
+            const geo::Point* last = corners + 4 * span.count;
+
+            for (; corners != last; corners += 4) {
+                if (geo::predicates::area_contains( corners, pt )) return true;
+            }
+
+            return false;
+        }
+
+        case ShapeType::CAPSULE:
+            return capsule_distance2( capsules_[entry.index], pt ) <= capsules_[entry.index].radius2;
+
+        case ShapeType::CAPSULE_RUN: {
+            const Span& span = spans_[entry.index];
+
+            for (const Capsule* capsule = capsules_ + span.first; capsule != capsules_ + span.first + span.count; ++capsule) {
+                if (capsule_distance2( *capsule, pt ) <= capsule->radius2) return true;
+            }
+
+            return false;
+        }
+    }
+
+    return false;
+}
+
+bool Geofence::coverage_contains( const Node& leaf, const geo::Point& pt ) const
+{
+    const Slab* first = slabs_ + leaf.first_slab;
+    const Slab* last = first + leaf.slab_count;
+    std::size_t west_of = std::upper_bound( first, last, pt.lon, []( double lon, const Slab& s ) { return lon < s.west; } ) - first;
+
+    // a point on the edge between two slabs is in both; the one to the west also has the areas that end there.
+    for (std::size_t k = west_of; k > 0 && k + 2 > west_of; --k) {
+        const Slab& slab = first[k - 1];
+        if (pt.lon > slab.east) break;
+
+        double t = (pt.lon - slab.west) / (slab.east - slab.west);
+
+        for (const Piece* piece = pieces_ + slab.first_piece; piece != pieces_ + slab.first_piece + slab.piece_count; ++piece) {
+            // the pieces are disjoint and ordered south to north.
+            if (pt.lat < piece->lower_west + t * (piece->lower_east - piece->lower_west)) break;
+            if (pt.lat <= piece->upper_west + t * (piece->upper_east - piece->upper_west)) return true;
+        }
+
+        if (pt.lon != slab.west) break;
+    }
+
+    return false;
+}
+
+bool Geofence::shape_core( uint32_t shape, const geo::Point& pt ) const
+{
+    const Shape& entry = shapes_[shape];
+
+    switch (entry.type) {
+        case ShapeType::AREA:
+            return area_core( area_corners_ + 4 * entry.index, pt );
+
+        case ShapeType::CIRCLE:
+        case ShapeType::GRID:
+            // circles and grid cells are not extended.
+            return true;
+
+        case ShapeType::POLYLINE: {
+            const Span& span = spans_[entry.index];
+            const geo::Point* corners = area_corners_ + 4 * span.first;
+            const geo::Point* last = corners + 4 * span.count;
+
+            for (; corners != last; corners += 4) {
+                if (geo::predicates::area_contains( corners, pt ) && area_core( corners, pt )) return true;
+            }
+
+            return false;
+        }
+
+        case ShapeType::CAPSULE: {
+            double core = capsules_[entry.index].radius - extension_;
+            return core > 0.0 && capsule_distance2( capsules_[entry.index], pt ) <= core * core;
+        }
+
+        case ShapeType::CAPSULE_RUN: {
+            const Span& span = spans_[entry.index];
+
+            for (const Capsule* capsule = capsules_ + span.first; capsule != capsules_ + span.first + span.count; ++capsule) {
+                double core = capsule->radius - extension_;
+                if (core > 0.0 && capsule_distance2( *capsule, pt ) <= core * core) return true;
+            }
+
+            return false;
+        }
+    }
+
+    return false;
+}
+
+bool Geofence::area_core( const geo::Point* corners, const geo::Point& pt ) const
+{
+    // the first two corners are on one side of the edge extended from both ends (see Edge::make_area); the way's width
+    // is the whole area across, so only the distance along the edge can put the point in the extension.
+    double lon_scale = kMetersPerDegree * std::cos( corners[0].lat * M_PI / 180.0 );
+    double ax = (corners[1].lon - corners[0].lon) * lon_scale;
+    double ay = (corners[1].lat - corners[0].lat) * kMetersPerDegree;
+    double length = std::sqrt( ax * ax + ay * ay );
+
+    if (length <= 0.0) {
+        return false;
+    }
+
+    double along = ((pt.lon - corners[0].lon) * lon_scale * ax + (pt.lat - corners[0].lat) * kMetersPerDegree * ay) / length;
+    return along >= extension_ && along <= length - extension_;
+}
+
+const Geofence::Shape& Geofence::get_shape( uint32_t shape ) const
+{
+    return shapes_[shape];
+}
+
+uint32_t Geofence::shape_count() const
+{
+    return shape_count_;
+}
+
+uint32_t Geofence::node_count() const
+{
+    return node_count_;
+}
+
+uint32_t Geofence::region_count() const
+{
+    return region_count_;
+}
+
+std::size_t Geofence::lattice_cell_count() const
+{
+    std::size_t cells = 0;
+
+    for (const Lattice* lattice = lattices_; lattice != lattices_ + region_count_; ++lattice) {
+        cells += lattice->cell_count;
+    }
+
+    return cells;
+}
+
+uint32_t Geofence::window_count() const
+{
+    return window_count_;
+}
+
+uint32_t Geofence::coverage_leaf_count() const
+{
+    return static_cast<uint32_t>( std::count_if( nodes_, nodes_ + node_count_, []( const Node& node ) { return node.slab_count > 0; } ) );
+}
+
+std::size_t Geofence::memory_usage() const
+{
+    return buffer_size_;
+}
+
+geo::PageMode Geofence::page_mode() const
+{
+    return page_mode_;
+}
+
+std::size_t Geofence::warm_up() const
+{
+    const std::size_t kLineSize = 64;
+    const char* first = buffer_.get();
+    const char* last = first + buffer_size_;
+    volatile char sink = 0;
+
+    for (const char* line = first; line < last; line += kLineSize) {
+        sink = static_cast<char>( sink + *line );
+    }
+
+    // the pages the buffer spans, counting partial pages at either end.
+    std::size_t page = geo::page_size( page_mode_ );
+    std::uintptr_t first_page = reinterpret_cast<std::uintptr_t>( first ) / page;
+    std::uintptr_t last_page = (reinterpret_cast<std::uintptr_t>( last ) - 1) / page;
+    return static_cast<std::size_t>( last_page - first_page + 1 );
+}
+
+Geofence::Hits::Hits( uint32_t size ) :
+    counts_{ new std::atomic<uint32_t>[size] }
+{
+    for (uint32_t i = 0; i < size; ++i) {
+        counts_[i].store( 0, std::memory_order_relaxed );
+    }
+}
+
+void Geofence::Hits::add( uint32_t entry )
+{
+    // the owner is the only writer, so a load and a store lose nothing and need no locked increment.
+    uint32_t count = counts_[entry].load( std::memory_order_relaxed );
+    if (count != UINT32_MAX) counts_[entry].store( count + 1, std::memory_order_relaxed );
+}
+
+uint32_t Geofence::Hits::get( uint32_t entry ) const
+{
+    return counts_[entry].load( std::memory_order_relaxed );
+}
+
+Geofence::Hits::Ptr Geofence::count_hits() const
+{
+    Hits::Ptr hits_ptr = std::make_shared<Hits>( leaf_shape_count_ );
+    std::lock_guard<std::mutex> lock{ hits_mutex_ };
+    hit_tables_.push_back( hits_ptr );
+    return hits_ptr;
+}
+
+std::vector<uint32_t> Geofence::merged_hits() const
+{
+    std::vector<uint64_t> sums( leaf_shape_count_, 0 );
+    for (uint32_t i = 0; i < start_hits_.size(); ++i) {
+        sums[i] = start_hits_[i];
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ hits_mutex_ };
+        for (auto& hits_ptr : hit_tables_) {
+            for (uint32_t i = 0; i < leaf_shape_count_; ++i) {
+                sums[i] += hits_ptr->get( i );
+            }
+        }
+    }
+
+    std::vector<uint32_t> hits( leaf_shape_count_ );
+    for (uint32_t i = 0; i < leaf_shape_count_; ++i) {
+        hits[i] = static_cast<uint32_t>( std::min<uint64_t>( sums[i], UINT32_MAX ) );
+    }
+
+    return hits;
+}
+
+uint64_t Geofence::hit_count() const
+{
+    std::vector<uint32_t> hits = merged_hits();
+    return std::accumulate( hits.begin(), hits.end(), uint64_t{ 0 } );
+}
+
+Geofence::CPtr Geofence::reordered() const
+{
+    std::vector<uint32_t> hits = merged_hits();
+
+    // the entry of leaf_shapes_ each entry of the copy comes from; ties keep their order.
+    std::vector<uint32_t> source( leaf_shape_count_ );
+    std::iota( source.begin(), source.end(), 0 );
+    bool changed = false;
+
+    for (const Node* node = nodes_; node != nodes_ + node_count_; ++node) {
+        if (node->child_count > 0 || node->shape_count < 2) continue;
+
+        // the entries the coverage answers for stay in front of the others.
+        auto first = source.begin() + node->first_shape;
+        auto last = first + node->shape_count;
+        auto by_hits = [&hits]( uint32_t a, uint32_t b ) { return hits[a] > hits[b]; };
+        std::stable_sort( first, first + node->covered_count, by_hits );
+        std::stable_sort( first + node->covered_count, last, by_hits );
+
+        for (auto entry = first; entry != last && !changed; ++entry) {
+            changed = *entry != static_cast<uint32_t>( entry - source.begin() );
+        }
+    }
+
+    if (!changed) {
+        return nullptr;
+    }
+
+    // only leaf_shapes_ differs, and every array is addressed by its offset, so the rest of the image is copied as is.
+    geo::PageMode mode = page_mode_;
+    std::shared_ptr<char> pages = geo::allocate_pages( buffer_size_, mode );
+    std::memcpy( pages.get(), buffer_.get(), buffer_size_ );
+    uint32_t* leaf_shapes = reinterpret_cast<uint32_t*>( pages.get() + (reinterpret_cast<const char*>( leaf_shapes_ ) - buffer_.get()) );
+
+    for (uint32_t i = 0; i < leaf_shape_count_; ++i) {
+        leaf_shapes[i] = leaf_shapes_[source[i]];
+    }
+
+    std::shared_ptr<Geofence> copy = std::make_shared<Geofence>( pages, buffer_size_ );
+    copy->regions_ = regions_;
+    copy->page_mode_ = mode;
+
+    copy->start_hits_.resize( leaf_shape_count_ );
+    for (uint32_t i = 0; i < leaf_shape_count_; ++i) {
+        copy->start_hits_[i] = hits[source[i]] / 2;
+    }
+
+    copy->answers_ = answers_;
+    return copy;
+}
+
+uint64_t Geofence::answers() const
+{
+    return answers_;
+}
+
+const char* Geofence::image() const
+{
+    return buffer_.get();
+}
+
+uint32_t Geofence::image_version()
+{
+    return kVersion;
+}
+
+bool Geofence::has_source() const
+{
+    return !regions_.empty();
+}
+
+double Geofence::get_extension() const
+{
+    return extension_;
+}
+
+Geofence::EdgeModel Geofence::edge_model() const
+{
+    return edge_model_;
+}
+
+const Quad& Geofence::get_quad( uint32_t region ) const
+{
+    return *regions_.at( region );
+}
@@ -23,6 +23,8 @@
  * UT Battelle.
  */
 
+#include <algorithm>
+
 #include "quad.hpp"
 #include "utilities.hpp"
 
@@ -156,6 +158,89 @@ bool Quad::insert( Quad::Ptr& quadptr, geo::Entity::CPtr entity_ptr )
     return true;
 }
 
+bool Quad::remove( Quad::Ptr& quadptr, geo::Entity::CPtr entity_ptr )
+{
+    if ( quadptr->remove_matching( entity_ptr, entity_ptr->get_type(), entity_ptr->get_uid() ) ) return true;
+
+    // the geometry provided may not be the geometry that was inserted; fall back to a full search.
+    return quadptr->remove_matching( nullptr, entity_ptr->get_type(), entity_ptr->get_uid() );
+}
+
+bool Quad::remove( Quad::Ptr& quadptr, const std::string& type, uint64_t uid )
+{
+    return quadptr->remove_matching( nullptr, type, uid );
+}
+
+bool Quad::remove_matching( const geo::Entity::CPtr& prune_ptr, const std::string& type, uint64_t uid )
+{
+    // insertion only places entities in quads whose fuzzy bounds they touch.
+    if ( prune_ptr && !prune_ptr->touches(fuzzybounds_) ) return false;
+
+    bool removed = false;
+
+    if (haschildren()) {
+        for ( auto& quad : children_ ) {
+            removed = quad->remove_matching( prune_ptr, type, uid ) || removed;
+        }
+
+        if (removed) {
+            merge();
+        }
+
+        return removed;
+    }
+
+    auto it = std::remove_if( element_list_.begin(), element_list_.end(), [&]( const geo::Entity::CPtr& e ) {
+        return e->get_uid() == uid && e->get_type() == type;
+    });
+
+    removed = it != element_list_.end();
+    element_list_.erase( it, element_list_.end() );
+    return removed;
+}
+
+void Quad::merge()
+{
+    std::unordered_set<const geo::Entity*> seen;
+    geo::Entity::PtrList merged;
+
+    for ( auto& quad : children_ ) {
+        if (quad->haschildren()) return;
+
+        for ( auto& e : quad->element_list_ ) {
+            // entities that cross child boundaries are in several children.
+            if (seen.insert( e.get() ).second) {
+                merged.push_back( e );
+                if (merged.size() > MAX_ELEMENTS / 2) return;
+            }
+        }
+    }
+
+    children_.clear();
+    element_list_ = std::move( merged );
+}
+
+Quad::Ptr Quad::clone( const Quad& quad )
+{
+    // copies the bounds, elements, and the pointers to the children; the children are copied below.
+    Ptr root = std::make_shared<Quad>( quad );
+
+    PtrStack quadstack;
+    quadstack.push(root);
+
+    while (!quadstack.empty()) {
+        Ptr currquad = quadstack.top();
+        quadstack.pop();
+
+        for ( auto& child : currquad->children_ ) {
+            child = std::make_shared<Quad>( *child );
+            quadstack.push( child );
+        }
+    }
+
+    return root;
+}
+
 std::ostream& operator<<( std::ostream& os, const Quad& quad )
 {
     return os << "Quad: {" << quad.sw << ", " << quad.ne << "} element count: " << quad.element_list_.size() << " level: " << quad.level_ << " children: " << quad.children_.size() << " fuzzy: {" << quad.fuzzybounds_.sw << ", " << quad.fuzzybounds_.ne << ", " << quad.fuzzybounds_.height() << ", " << quad.fuzzybounds_.width() << "}";
@@ -0,0 +1,232 @@
+/**
+ * @file
+ * @author   Jason M. Carter (carterjm@ornl.gov)
+ * @author   Aaron E. Ferber (ferberae@ornl.gov)
+ * @date     April 2017
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors: Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems,
+ * UT Battelle.
+ */
+
+#include <stdexcept>
+
+#include "predicates.hpp"
+#include "roadgraph.hpp"
+
+namespace geo {
+
+constexpr uint32_t RoadGraph::kNoIndex;
+
+RoadGraph::RoadGraph() :
+    final_{ false },
+    lat_{},
+    lon_{},
+    vertex_uid_{},
+    edges_{},
+    offsets_{},
+    incident_{},
+    uid_index_{}
+{}
+
+uint32_t RoadGraph::find_vertex( uint64_t uid ) const
+{
+    auto item = uid_index_.find( uid );
+    return item == uid_index_.end() ? kNoIndex : item->second;
+}
+
+uint32_t RoadGraph::add_vertex( uint64_t uid, double lat, double lon )
+{
+    if (final_) {
+        throw std::logic_error{ "cannot add a vertex to a finalized graph." };
+    }
+
+    auto result = uid_index_.emplace( uid, static_cast<uint32_t>( vertex_uid_.size() ) );
+
+    if (result.second) {
+        lat_.push_back( lat );
+        lon_.push_back( lon );
+        vertex_uid_.push_back( uid );
+    }
+
+    return result.first->second;
+}
+
+uint32_t RoadGraph::add_edge( uint32_t v1, uint32_t v2, osm::Highway way_type, uint64_t uid )
+{
+    if (final_) {
+        throw std::logic_error{ "cannot add an edge to a finalized graph." };
+    }
+
+    if (v1 >= vertex_count() || v2 >= vertex_count()) {
+        throw std::out_of_range{ "edge vertex index is not in the graph." };
+    }
+
+    edges_.push_back( EdgeRecord{ v1, v2, uid, way_type } );
+    return static_cast<uint32_t>( edges_.size() - 1 );
+}
+
+void RoadGraph::finalize()
+{
+    if (final_) return;
+
+    // count the degree of each vertex, then turn the counts into offsets.
+    offsets_.assign( vertex_count() + 1, 0 );
+    for (auto& edge : edges_) {
+        ++offsets_[edge.v1 + 1];
+        if (edge.v2 != edge.v1) ++offsets_[edge.v2 + 1];
+    }
+
+    for (std::size_t v = 1; v < offsets_.size(); ++v) {
+        offsets_[v] += offsets_[v - 1];
+    }
+
+    incident_.resize( offsets_.back() );
+    std::vector<uint32_t> next{ offsets_.begin(), offsets_.end() - 1 };
+
+    for (uint32_t e = 0; e < edge_count(); ++e) {
+        incident_[next[edges_[e].v1]++] = e;
+        if (edges_[e].v2 != edges_[e].v1) incident_[next[edges_[e].v2]++] = e;
+    }
+
+    // the arrays are complete; drop the excess capacity and the build-only lookup table.
+    lat_.shrink_to_fit();
+    lon_.shrink_to_fit();
+    vertex_uid_.shrink_to_fit();
+    edges_.shrink_to_fit();
+    std::unordered_map<uint64_t, uint32_t>{}.swap( uid_index_ );
+
+    final_ = true;
+}
+
+bool RoadGraph::is_final() const
+{
+    return final_;
+}
+
+uint32_t RoadGraph::vertex_count() const
+{
+    return static_cast<uint32_t>( vertex_uid_.size() );
+}
+
+uint32_t RoadGraph::edge_count() const
+{
+    return static_cast<uint32_t>( edges_.size() );
+}
+
+double RoadGraph::lat( uint32_t v ) const
+{
+    return lat_[v];
+}
+
+double RoadGraph::lon( uint32_t v ) const
+{
+    return lon_[v];
+}
+
+uint64_t RoadGraph::vertex_uid( uint32_t v ) const
+{
+    return vertex_uid_[v];
+}
+
+Location RoadGraph::location( uint32_t v ) const
+{
+    return Location{ lat_[v], lon_[v], vertex_uid_[v] };
+}
+
+uint32_t RoadGraph::edge_v1( uint32_t e ) const
+{
+    return edges_[e].v1;
+}
+
+uint32_t RoadGraph::edge_v2( uint32_t e ) const
+{
+    return edges_[e].v2;
+}
+
+osm::Highway RoadGraph::way_type( uint32_t e ) const
+{
+    return edges_[e].way_type;
+}
+
+uint64_t RoadGraph::edge_uid( uint32_t e ) const
+{
+    return edges_[e].uid;
+}
+
+uint32_t RoadGraph::degree( uint32_t v ) const
+{
+    return offsets_[v + 1] - offsets_[v];
+}
+
+IndexRange RoadGraph::incident_edges( uint32_t v ) const
+{
+    return IndexRange{ incident_.data() + offsets_[v], incident_.data() + offsets_[v + 1] };
+}
+
+std::size_t RoadGraph::memory_usage() const
+{
+    return lat_.capacity() * sizeof(double) + lon_.capacity() * sizeof(double) + vertex_uid_.capacity() * sizeof(uint64_t) +
+        edges_.capacity() * sizeof(EdgeRecord) + offsets_.capacity() * sizeof(uint32_t) + incident_.capacity() * sizeof(uint32_t);
+}
+
+GraphEdge::GraphEdge( RoadGraph::CPtr graph_ptr, uint32_t index ) :
+    graph_ptr_{ graph_ptr },
+    index_{ index }
+{}
+
+const std::string GraphEdge::get_type(void) const {
+    return "edge";
+}
+
+uint64_t GraphEdge::get_uid(void) const {
+    return graph_ptr_->edge_uid( index_ );
+}
+
+bool GraphEdge::touches(const Bounds& bounds) const {
+    Point p1{ graph_ptr_->lat( graph_ptr_->edge_v1( index_ ) ), graph_ptr_->lon( graph_ptr_->edge_v1( index_ ) ) };
+    Point p2{ graph_ptr_->lat( graph_ptr_->edge_v2( index_ ) ), graph_ptr_->lon( graph_ptr_->edge_v2( index_ ) ) };
+
+    return predicates::box_touches_segment( bounds.sw, bounds.ne, p1, p2 );
+}
+
+osm::Highway GraphEdge::get_way_type() const
+{
+    return graph_ptr_->way_type( index_ );
+}
+
+double GraphEdge::get_way_width() const
+{
+    return osm::highway_width_map[static_cast<int>( get_way_type() )];
+}
+
+AreaPtr GraphEdge::to_area( double extension ) const
+{
+    return Edge::make_area( graph_ptr_->location( graph_ptr_->edge_v1( index_ ) ), graph_ptr_->location( graph_ptr_->edge_v2( index_ ) ), get_way_width(), extension );
+}
+
+const RoadGraph& GraphEdge::get_graph() const
+{
+    return *graph_ptr_;
+}
+
+uint32_t GraphEdge::get_index() const
+{
+    return index_;
+}
+
+}
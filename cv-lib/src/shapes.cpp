@@ -24,8 +24,14 @@
  */
 
 #include <algorithm>
+#include <array>
+#include <cmath>
 #include <fstream>
 #include <iomanip>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "shapes.hpp"
 #include "osm.hpp"
@@ -35,12 +41,394 @@ namespace shapes {
 
 using StreamPtr = std::shared_ptr<std::istream>;
 
+namespace {
+
+/**
+ * @brief Mark the vertices of a chain that Douglas-Peucker keeps: the ends, and every vertex that is more than the
+ * tolerance from the segment between the vertices kept on either side of it.
+ *
+ * Distances are measured on a plane tangent at the first vertex, which is accurate to well under a meter over the
+ * length of a way.
+ *
+ * @param vertices the chain.
+ * @param tolerance the tolerance in meters.
+ * @return for each vertex, true when it is kept.
+ */
+std::vector<bool> douglas_peucker(const std::vector<geo::Location>& vertices, double tolerance) {
+    const double kMetersPerRadian = geo::kEarthRadiusM;
+    const double kDegreesToRadians = M_PI / 180.0;
+    double cos_lat = std::cos( vertices.front().lat * kDegreesToRadians );
+
+    std::vector<double> x( vertices.size() );
+    std::vector<double> y( vertices.size() );
+    for (std::size_t v = 0; v < vertices.size(); ++v) {
+        x[v] = (vertices[v].lon - vertices.front().lon) * kDegreesToRadians * cos_lat * kMetersPerRadian;
+        y[v] = (vertices[v].lat - vertices.front().lat) * kDegreesToRadians * kMetersPerRadian;
+    }
+
+    std::vector<bool> keep( vertices.size(), false );
+    keep.front() = true;
+    keep.back() = true;
+
+    std::vector<std::pair<std::size_t, std::size_t>> ranges{ { 0, vertices.size() - 1 } };
+
+    while (!ranges.empty()) {
+        std::size_t first = ranges.back().first;
+        std::size_t last = ranges.back().second;
+        ranges.pop_back();
+
+        double dx = x[last] - x[first];
+        double dy = y[last] - y[first];
+        double length2 = dx * dx + dy * dy;
+        double farthest = 0.0;
+        std::size_t farthest_vertex = first;
+
+        for (std::size_t v = first + 1; v < last; ++v) {
+            // the squared distance from the vertex to the segment between first and last.
+            double t = length2 > 0.0 ? std::min( std::max( ((x[v] - x[first]) * dx + (y[v] - y[first]) * dy) / length2, 0.0 ), 1.0 ) : 0.0;
+            double ex = x[v] - (x[first] + t * dx);
+            double ey = y[v] - (y[first] + t * dy);
+            double d2 = ex * ex + ey * ey;
+
+            if (d2 > farthest) {
+                farthest = d2;
+                farthest_vertex = v;
+            }
+        }
+
+        if (farthest > tolerance * tolerance) {
+            keep[farthest_vertex] = true;
+            ranges.emplace_back( first, farthest_vertex );
+            ranges.emplace_back( farthest_vertex, last );
+        }
+    }
+
+    return keep;
+}
+
+
+/**
+ * @brief Split the attributes of a shape specification into key=value pairs; pairs with an empty key or value are
+ * dropped. The times of valid_from and valid_to may have colons (HH:MM:SS), so the parts after them without an '=' are
+ * put back.
+ */
+StrStrMap parse_attributes( const std::string& attributes )
+{
+    StrStrMap atts;
+    StrVector parts;
+
+    for (auto& part : string_utilities::split( attributes, ':' )) {
+        if (!parts.empty() && part.find( '=' ) == std::string::npos &&
+                (parts.back().compare( 0, 11, "valid_from=" ) == 0 || parts.back().compare( 0, 9, "valid_to=" ) == 0)) {
+            parts.back() += ":" + part;
+        } else {
+            parts.push_back( part );
+        }
+    }
+
+    for (auto& att_string : parts) {
+        // att_string format: <attribute>=<value>
+        StrPair att = string_utilities::split_attribute( att_string );
+
+        string_utilities::strip( att.first );
+        string_utilities::strip( att.second );
+
+        // a pair of empty strings could be returned. If any component is empty do nothing.
+        if ( !att.first.empty() && !att.second.empty() ) {
+            atts[att.first] = att.second;
+        }
+    }
+
+    return atts;
+}
+
+/**
+ * @brief Return the validity given by the valid_from and valid_to attributes; a missing attribute leaves that end open.
+ *
+ * @throws invalid_argument for a time that cannot be read or an empty interval.
+ */
+geo::Validity parse_validity( const StrStrMap& atts )
+{
+    geo::Validity validity;
+
+    auto from_item = atts.find( "valid_from" );
+    if (from_item != atts.end() && !time_utilities::parse_utc( from_item->second, validity.from )) {
+        throw std::invalid_argument{ "bad valid_from time: " + from_item->second };
+    }
+
+    auto to_item = atts.find( "valid_to" );
+    if (to_item != atts.end() && !time_utilities::parse_utc( to_item->second, validity.to )) {
+        throw std::invalid_argument{ "bad valid_to time: " + to_item->second };
+    }
+
+    if (validity.from >= validity.to) {
+        throw std::invalid_argument{ "valid_from must be before valid_to." };
+    }
+
+    return validity;
+}
+
+/**
+ * @brief Return the validity given by the attributes of a shape specification, if it has them.
+ */
+geo::Validity parse_validity( const StrVector& line_parts )
+{
+    return line_parts.size() > SHAPE_ATTS ? parse_validity( parse_attributes( line_parts[SHAPE_ATTS] ) ) : geo::Validity{};
+}
+
+/**
+ * @brief Write the valid_from and valid_to attributes of a limited validity, each preceded by a separator.
+ */
+void write_validity( std::ostream& os, const geo::Validity& validity, char separator )
+{
+    if (validity.from != geo::Validity::kBeginning) {
+        os << separator << "valid_from=" << time_utilities::format_utc( validity.from );
+        separator = ':';
+    }
+
+    if (validity.to != geo::Validity::kEnd) {
+        os << separator << "valid_to=" << time_utilities::format_utc( validity.to );
+    }
+}
+
+/**
+ * @brief Read the tags of an XML document one at a time from a stream, e.g., an OSM extract; only the current tag is
+ * held, so a document of any size is read in constant memory.
+ *
+ * Text between tags, comments, processing instructions, and declarations are skipped. Attribute values have the five
+ * predefined entities replaced; character references are kept as they are.
+ */
+class XMLTagReader
+{
+    public:
+        explicit XMLTagReader( std::istream& is ) :
+            is_( is ),
+            closing_{ false },
+            empty_{ false },
+            attribute_count_{ 0 }
+        {}
+
+        /**
+         * @brief Read the next start, end, or empty-element tag.
+         *
+         * @return true when a tag was read; false at the end of the stream.
+         */
+        bool next()
+        {
+            while (std::getline( is_, text_, '>' )) {
+                std::size_t start = text_.find( '<' );
+                if (start == std::string::npos) {
+                    continue;
+                }
+
+                if (text_.compare( start, 4, "<!--" ) == 0) {
+                    // a comment may contain '>'; it ends at "-->".
+                    while (text_.size() < start + 6 || text_.compare( text_.size() - 2, 2, "--" ) != 0) {
+                        if (!read_more()) {
+                            return false;
+                        }
+                    }
+                    continue;
+                }
+
+                // an attribute value may contain '>'; the tag ends at the first '>' outside quotes.
+                while (open_quote( start ) != 0) {
+                    if (!read_more()) {
+                        return false;
+                    }
+                }
+
+                if (text_[start + 1] == '?' || text_[start + 1] == '!') {
+                    continue;
+                }
+
+                parse( start + 1 );
+                return true;
+            }
+
+            return false;
+        }
+
+        const std::string& name() const { return name_; }      ///< The name of the tag's element.
+        bool closing() const { return closing_; }              ///< True for an end tag, e.g., </way>.
+        bool empty() const { return empty_; }                  ///< True for an empty-element tag, e.g., <nd ref="1"/>.
+
+        /**
+         * @brief Find the value of one of the tag's attributes.
+         *
+         * @param key the attribute's name.
+         * @param value set to the attribute's value when it is found.
+         * @return true if the tag has the attribute; false otherwise.
+         */
+        bool attribute( const char* key, std::string& value ) const
+        {
+            for (std::size_t i = 0; i < attribute_count_; ++i) {
+                if (attributes_[i].first == key) {
+                    value = attributes_[i].second;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+    private:
+        std::istream& is_;                                          ///< The document.
+        std::string text_;                                          ///< The text up to the end of the current tag.
+        std::string part_;                                          ///< The next part of a tag that contains '>'.
+        std::string name_;                                          ///< The current tag's element name.
+        bool closing_;                                              ///< True when the current tag is an end tag.
+        bool empty_;                                                ///< True when the current tag is an empty-element tag.
+        std::vector<std::pair<std::string, std::string>> attributes_;   ///< The attributes of this and earlier tags; reused.
+        std::size_t attribute_count_;                               ///< The number of attributes_ that are the current tag's.
+
+        /**
+         * @brief Append the '>' that ended the text read so far and the text up to the next '>'.
+         */
+        bool read_more()
+        {
+            if (!std::getline( is_, part_, '>' )) {
+                return false;
+            }
+
+            text_ += '>';
+            text_ += part_;
+            return true;
+        }
+
+        /**
+         * @brief Return the quote character of a value that is open at the end of the text; 0 when none is open.
+         */
+        char open_quote( std::size_t start ) const
+        {
+            char quote = 0;
+            for (std::size_t i = start; i < text_.size(); ++i) {
+                char c = text_[i];
+                if (quote == 0 && (c == '"' || c == '\'')) {
+                    quote = c;
+                } else if (c == quote) {
+                    quote = 0;
+                }
+            }
+
+            return quote;
+        }
+
+        /**
+         * @brief Split the tag that starts at a position of the text into its name and attributes.
+         */
+        void parse( std::size_t pos )
+        {
+            const std::size_t end = text_.size();
+            closing_ = pos < end && text_[pos] == '/';
+            if (closing_) {
+                ++pos;
+            }
+
+            empty_ = end > pos && text_[end - 1] == '/';
+
+            std::size_t name_end = pos;
+            while (name_end < end && !is_space( text_[name_end] ) && text_[name_end] != '/') {
+                ++name_end;
+            }
+            name_.assign( text_, pos, name_end - pos );
+
+            // the attribute strings are reused from tag to tag.
+            attribute_count_ = 0;
+            pos = name_end;
+            while (true) {
+                while (pos < end && (is_space( text_[pos] ) || text_[pos] == '/')) {
+                    ++pos;
+                }
+
+                std::size_t eq = text_.find( '=', pos );
+                if (pos >= end || eq == std::string::npos) {
+                    break;
+                }
+
+                std::size_t key_end = eq;
+                while (key_end > pos && is_space( text_[key_end - 1] )) {
+                    --key_end;
+                }
+
+                std::size_t open = text_.find_first_of( "\"'", eq );
+                if (open == std::string::npos) {
+                    break;
+                }
+
+                std::size_t close = text_.find( text_[open], open + 1 );
+                if (close == std::string::npos) {
+                    break;
+                }
+
+                if (attribute_count_ == attributes_.size()) {
+                    attributes_.emplace_back();
+                }
+
+                auto& att = attributes_[attribute_count_++];
+                att.first.assign( text_, pos, key_end - pos );
+                unescape( open + 1, close, att.second );
+                pos = close + 1;
+            }
+        }
+
+        /**
+         * @brief Copy part of the text, replacing the predefined entities.
+         */
+        void unescape( std::size_t begin, std::size_t end, std::string& value ) const
+        {
+            static const std::array<std::pair<const char*, char>, 5> entities{ {
+                { "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' }, { "&quot;", '"' }, { "&apos;", '\'' } } };
+
+            value.clear();
+            for (std::size_t i = begin; i < end; ++i) {
+                char c = text_[i];
+                if (c == '&') {
+                    for (auto& entity : entities) {
+                        std::size_t length = std::char_traits<char>::length( entity.first );
+                        if (i + length <= end && text_.compare( i, length, entity.first ) == 0) {
+                            c = entity.second;
+                            i += length - 1;
+                            break;
+                        }
+                    }
+                }
+                value += c;
+            }
+        }
+
+        static bool is_space( char c )
+        {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+        }
+};
+}
+
 CSVInputFactory::CSVInputFactory() :
-    file_path_{}
+    CSVInputFactory{ std::string{}, false, false, 0.0 }
 {}
 
 CSVInputFactory::CSVInputFactory(const std::string& file_path) :
-    file_path_{file_path}
+    CSVInputFactory{ file_path, false, false, 0.0 }
+{}
+
+CSVInputFactory::CSVInputFactory(const std::string& file_path, bool use_graph) :
+    CSVInputFactory{ file_path, use_graph, false, 0.0 }
+{}
+
+CSVInputFactory::CSVInputFactory(const std::string& file_path, bool use_graph, bool merge_ways) :
+    CSVInputFactory{ file_path, use_graph, merge_ways, 0.0 }
+{}
+
+CSVInputFactory::CSVInputFactory(const std::string& file_path, bool use_graph, bool merge_ways, double simplify_tolerance) :
+    file_path_{file_path},
+    graph_{ use_graph ? std::make_shared<geo::RoadGraph>() : nullptr },
+    arena_{ std::make_shared<geo::Arena>() },
+    merge_ways_{ merge_ways && !use_graph },
+    simplify_tolerance_{ use_graph ? 0.0 : std::max( simplify_tolerance, 0.0 ) },
+    chain_ways_{ merge_ways_ || simplify_tolerance_ > 0.0 },
+    duplicate_count_{ 0 },
+    simplified_count_{ 0 }
 {}
 
 /**
@@ -58,6 +446,8 @@ void CSVInputFactory::make_edge(const StrVector& line_parts) {
     uint64_t edge_id;
     uint64_t vertex_id;
     osm::Highway way_type{osm::Highway::OTHER};                     // default value.
+    std::string way_id;
+    geo::Validity validity;
 
     if ( line_parts.size() < 3) {
         // lines cannot be defined without points.
@@ -66,22 +456,7 @@ void CSVInputFactory::make_edge(const StrVector& line_parts) {
 
     // Attributes must be processed first (if they exist) so we pickup the specified way_type.
     if ( line_parts.size() > 3 ) {
-        StrVector att_strings = string_utilities::split( line_parts[SHAPE_ATTS], ':' );
-        StrStrMap atts;
-
-        for (auto& att_string : att_strings) {
-            // att_string format: <attribute>=<value>
-            StrPair att = string_utilities::split_attribute( att_string );
-
-            string_utilities::strip( att.first );
-            string_utilities::strip( att.second );
-
-            // a pair of empty strings could be returned. If any component is empty do nothing.
-            if ( !att.first.empty() && !att.second.empty() ) {
-                // a non-empty key and value.
-                atts[att.first] = att.second;
-            }	
-        }
+        StrStrMap atts = parse_attributes( line_parts[SHAPE_ATTS] );
 
         auto s1 = atts.find("way_type");
         if ( s1 != atts.end() ) {
@@ -93,11 +468,18 @@ void CSVInputFactory::make_edge(const StrVector& line_parts) {
             } // othewise, use the default value.
         }
 
+        auto way_item = atts.find("way_id");
+        if ( way_item != atts.end() ) {
+            way_id = way_item->second;
+        }
+
         auto blacklist_item = osm::highway_blacklist.find( way_type );
         if (blacklist_item != osm::highway_blacklist.end()) {
             // this edge type should be ignored since it is in the blacklist.
             throw osm::invalid_way_exception{ way_type };
         }
+
+        validity = parse_validity( atts );                          // throws.
     }
 
     edge_id = std::stoull( line_parts[SHAPE_ID] );                  // throws.
@@ -108,7 +490,7 @@ void CSVInputFactory::make_edge(const StrVector& line_parts) {
         throw std::out_of_range{ "too many or too few points to define an edge: " + std::to_string(geo_parts.size()) };
     }
 
-    geo::Vertex::Ptr vp[2];
+    std::vector<geo::Location> locations;
     for ( int pi = 0; pi < 2; ++pi ) {
 
         // A point in a geometry is a triple: uid; latitude; longitude.
@@ -119,34 +501,93 @@ void CSVInputFactory::make_edge(const StrVector& line_parts) {
             throw std::out_of_range{ "too many or too few elements to define a point: " + std::to_string(point_parts.size()) };
         }
 
-        // convert all the parts so we can perform checks when the id was previously used.
         vertex_id = std::stoull( point_parts[POINT_ID] );           // throws.
         lat = std::stod( point_parts[POINT_LAT] );                  // throws.
         lon = std::stod( point_parts[POINT_LON] );                  // throws.
+        locations.emplace_back(lat, lon, vertex_id);
+    }
 
-        auto element_item = vertex_map_.find(vertex_id);
-        if (element_item != vertex_map_.end()) {
-            // point already defined; use existing instance.
-            // needed because we have an incident edge list.
-            vp[pi] = vertex_map_[vertex_id];
-            if ( !double_utilities::are_equal(vp[pi]->lat, lat, geo::kGPSEpsilon) || !double_utilities::are_equal(vp[pi]->lon, lon, geo::kGPSEpsilon)) {
-                std::cerr << "WARNING: identical vertex id with different coordinates!\n";
-            }
+    add_edge( edge_id, locations[0], locations[1], way_type, way_id, validity );
+}
 
-        } else {
-            // point must be instantiated.
+void CSVInputFactory::add_edge(uint64_t edge_id, const geo::Location& v1, const geo::Location& v2, osm::Highway way_type,
+        const std::string& way_id, const geo::Validity& validity) {
+    // the graph's edges are always valid; an edge with a limited validity is kept out of it, as an Edge.
+    bool in_graph = graph_ && validity.always();
 
-            if (lat > 80.0 || lat < -84.0) {
-                throw std::out_of_range{ "bad latitude: " + std::to_string(lat) };
+    const geo::Location* locations[2]{ &v1, &v2 };
+    geo::Vertex::Ptr vp[2];
+    uint32_t vi[2];
+    for ( int pi = 0; pi < 2; ++pi ) {
+        uint64_t vertex_id = locations[pi]->uid;
+        double lat = locations[pi]->lat;
+        double lon = locations[pi]->lon;
+
+        if (chain_ways_) {
+            // the vertices are copied into the chains; they are checked below.
+
+        } else if (in_graph) {
+            vi[pi] = graph_->find_vertex(vertex_id);
+            if (vi[pi] != geo::RoadGraph::kNoIndex) {
+                // point already defined; the graph keeps one copy.
+                if ( !double_utilities::are_equal(graph_->lat(vi[pi]), lat, geo::kGPSEpsilon) || !double_utilities::are_equal(graph_->lon(vi[pi]), lon, geo::kGPSEpsilon)) {
+                    std::cerr << "WARNING: identical vertex id with different coordinates!\n";
+                }
+                continue;
             }
 
-            if (lon >= 180.0 || lon <= -180.0) {
-                throw std::out_of_range{"bad longitude: " + std::to_string(lon) };
+        } else {
+            auto element_item = vertex_map_.find(vertex_id);
+            if (element_item != vertex_map_.end()) {
+                // point already defined; use existing instance.
+                // needed because we have an incident edge list.
+                vp[pi] = vertex_map_[vertex_id];
+                if ( !double_utilities::are_equal(vp[pi]->lat, lat, geo::kGPSEpsilon) || !double_utilities::are_equal(vp[pi]->lon, lon, geo::kGPSEpsilon)) {
+                    std::cerr << "WARNING: identical vertex id with different coordinates!\n";
+                }
+                continue;
             }
+        }
+
+        // point must be instantiated.
 
+        if (lat > 80.0 || lat < -84.0) {
+            throw std::out_of_range{ "bad latitude: " + std::to_string(lat) };
+        }
+
+        if (lon >= 180.0 || lon <= -180.0) {
+            throw std::out_of_range{"bad longitude: " + std::to_string(lon) };
+        }
+
+        if (chain_ways_) {
+            continue;
+        } else if (in_graph) {
+            vi[pi] = graph_->add_vertex(vertex_id, lat, lon);
+        } else {
+            // Vertices and Edges refer to each other, so they are not placed in the arena; they would keep it alive.
             vp[pi] = std::make_shared<geo::Vertex>(lat,lon,vertex_id);  
             vertex_map_[vertex_id] = vp[pi];
-        }    
+        }
+    }
+
+    if (chain_ways_) {
+        if ( v1.uid == v2.uid ) {
+            throw std::invalid_argument("The identifiers for the edges points are the same.");
+        }
+
+        // the edges are chained once the whole file has been read; the edges of a way need not be in order.
+        way_edges_.push_back( WayEdge{ edge_id, v1, v2, way_type, way_id, validity } );
+        return;
+    }
+
+    if (in_graph) {
+        if ( vi[0] == vi[1] ) {
+            throw std::invalid_argument("The identifiers for the edges points are the same.");
+        }
+
+        // the GraphEdge instances are made once the graph is finalized.
+        graph_->add_edge( vi[0], vi[1], way_type, edge_id );
+        return;
     }
 
     if ( vp[0]->uid == vp[1]->uid ) {
@@ -155,6 +596,7 @@ void CSVInputFactory::make_edge(const StrVector& line_parts) {
 
     // NOTE: the way id does not uniquely identify the edge, as a way is sequence of edges.
     geo::EdgePtr edge_ptr = std::make_shared<geo::Edge>( vp[0], vp[1], way_type, edge_id ); 
+    edge_ptr->set_validity( validity );
     vp[0]->add_edge( edge_ptr );
     vp[1]->add_edge( edge_ptr );
     edges_.push_back(edge_ptr);
@@ -199,7 +641,9 @@ void CSVInputFactory::make_circle(const StrVector& line_parts)
         throw std::out_of_range{"bad radius: " + std::to_string(radius) };
     }
     
-    circles_.push_back(std::make_shared<geo::Circle>(lat, lon, uid, radius));
+    geo::Circle::Ptr circle_ptr = std::allocate_shared<geo::Circle>(geo::ArenaAllocator<geo::Circle>{ arena_ }, lat, lon, uid, radius);
+    circle_ptr->set_validity( parse_validity( line_parts ) );      // throws.
+    circles_.push_back(circle_ptr);
 }
 
 void CSVInputFactory::make_grid(const StrVector& line_parts) {
@@ -256,11 +700,152 @@ void CSVInputFactory::make_grid(const StrVector& line_parts) {
     }
     
     geo::Bounds bounds(geo::Point(sw_lat, sw_lon), geo::Point(ne_lat, ne_lon));
-    geo::Grid::CPtr grid_ptr = std::make_shared<const geo::Grid>(bounds, row, col);
+    geo::Grid::Ptr grid_ptr = std::allocate_shared<geo::Grid>(geo::ArenaAllocator<geo::Grid>{ arena_ }, bounds, row, col);
+    grid_ptr->set_validity( parse_validity( line_parts ) );          // throws.
     grids_.push_back(grid_ptr); 
 }
 
+void CSVInputFactory::make_osm_shapes() {
+    std::vector<uint64_t> node_ids;                                 // the nodes of the ways kept, in id order.
+    std::vector<geo::Point> node_points;                            // their positions; NaN until the node is read.
+    std::vector<uint64_t> refs;                                     // the nodes of the current way.
+    std::string value;
+    std::string way_id;
+    uint64_t edge_id = 0;
+
+    // The first pass finds the nodes the kept ways use and the second reads only their positions, so the positions of
+    // the rest of the extract (buildings, land use, etc.) are never held; edges are made as each way is read.
+    for (int pass = 0; pass < 2; ++pass) {
+        std::ifstream file(file_path_);
+
+        if (file.fail()) {
+            throw std::invalid_argument("Could not open OSM file: " + file_path_);
+        }
+
+        XMLTagReader reader{ file };
+        bool in_way = false;
+        bool kept = false;
+        osm::Highway way_type{ osm::Highway::OTHER };
+
+        while (reader.next()) {
+            try {
+                const std::string& name = reader.name();
+
+                if (name == "node") {
+                    if (pass == 0 || reader.closing() || !reader.attribute( "id", value )) {
+                        continue;
+                    }
+
+                    uint64_t node_id = std::stoull( value );
+                    auto node_item = std::lower_bound( node_ids.begin(), node_ids.end(), node_id );
+                    if (node_item == node_ids.end() || *node_item != node_id) {
+                        continue;
+                    }
+
+                    geo::Point& pt = node_points[ node_item - node_ids.begin() ];
+                    if (reader.attribute( "lat", value )) pt.lat = std::stod( value );
+                    if (reader.attribute( "lon", value )) pt.lon = std::stod( value );
+
+                } else if (name == "way") {
+                    if (!reader.closing()) {
+                        in_way = true;
+                        kept = false;
+                        refs.clear();
+                        way_id.clear();
+                        reader.attribute( "id", way_id );
+                    }
+
+                    if (!reader.closing() && !reader.empty()) {
+                        continue;
+                    }
+
+                    in_way = false;
+                    if (!kept) {
+                        continue;
+                    }
+
+                    if (pass == 0) {
+                        node_ids.insert( node_ids.end(), refs.begin(), refs.end() );
+                        continue;
+                    }
+
+                    // a way is a chain of edges; an edge to a node outside the extract is dropped.
+                    for (std::size_t i = 1; i < refs.size(); ++i) {
+                        auto first = std::lower_bound( node_ids.begin(), node_ids.end(), refs[i - 1] );
+                        auto second = std::lower_bound( node_ids.begin(), node_ids.end(), refs[i] );
+                        const geo::Point& p1 = node_points[ first - node_ids.begin() ];
+                        const geo::Point& p2 = node_points[ second - node_ids.begin() ];
+
+                        if (std::isnan( p1.lat ) || std::isnan( p1.lon ) || std::isnan( p2.lat ) || std::isnan( p2.lon )) {
+                            continue;
+                        }
+
+                        try {
+                            add_edge( ++edge_id, geo::Location{ p1.lat, p1.lon, refs[i - 1] }, geo::Location{ p2.lat, p2.lon, refs[i] },
+                                    way_type, way_id, geo::Validity{} );
+                        } catch (std::exception& e) {
+                            std::cerr << "Failed to make shape: " << e.what() << std::endl;
+                        }
+                    }
+
+                } else if (in_way && name == "nd") {
+                    if (reader.attribute( "ref", value )) {
+                        refs.push_back( std::stoull( value ) );
+                    }
+
+                } else if (in_way && name == "tag") {
+                    if (!reader.attribute( "k", value ) || value != "highway" || !reader.attribute( "v", value )) {
+                        continue;
+                    }
+
+                    // highway values that are not road types, e.g., platform, are not part of the geofence.
+                    std::transform( value.begin(), value.end(), value.begin(), ::tolower );
+                    auto highway_item = osm::highway_map.find( value );
+                    kept = highway_item != osm::highway_map.end() &&
+                        osm::highway_blacklist.find( highway_item->second ) == osm::highway_blacklist.end();
+                    if (kept) {
+                        way_type = highway_item->second;
+                    }
+                }
+
+            } catch (std::exception& e) {
+                // a node or way reference that cannot be read; skip it.
+                std::cerr << "Failed to read OSM element: " << e.what() << std::endl;
+            }
+        }
+
+        if (pass == 0) {
+            std::sort( node_ids.begin(), node_ids.end() );
+            node_ids.erase( std::unique( node_ids.begin(), node_ids.end() ), node_ids.end() );
+            node_points.assign( node_ids.size(), geo::Point{ std::nan( "" ), std::nan( "" ) } );
+        }
+    }
+}
+
 void CSVInputFactory::make_shapes() {
+    std::size_t suffix = file_path_.rfind( '.' );
+    if (suffix != std::string::npos && file_path_.compare( suffix, std::string::npos, ".osm" ) == 0) {
+        make_osm_shapes();
+    } else {
+        make_csv_shapes();
+    }
+
+    if (chain_ways_) {
+        build_ways();
+    }
+
+    if (graph_) {
+        graph_->finalize();
+
+        geo::RoadGraph::CPtr graph_ptr = graph_;
+        graph_edges_.reserve( graph_ptr->edge_count() );
+        for (uint32_t e = 0; e < graph_ptr->edge_count(); ++e) {
+            graph_edges_.push_back( std::allocate_shared<geo::GraphEdge>( geo::ArenaAllocator<geo::GraphEdge>{ arena_ }, graph_ptr, e ) );
+        }
+    }
+}
+
+void CSVInputFactory::make_csv_shapes() {
     std::string line;
     std::ifstream file(file_path_);
 
@@ -316,6 +901,401 @@ const std::vector<geo::Grid::CPtr>& CSVInputFactory::get_grids() const {
     return grids_;
 }
 
+const std::vector<geo::Polyline::CPtr>& CSVInputFactory::get_polylines() const {
+    return polylines_;
+}
+
+std::size_t CSVInputFactory::get_duplicate_count() const {
+    return duplicate_count_;
+}
+
+std::size_t CSVInputFactory::get_simplified_count() const {
+    return simplified_count_;
+}
+
+geo::Vertex::Ptr CSVInputFactory::make_vertex(const geo::Location& location) {
+    auto item = vertex_map_.find(location.uid);
+    if (item != vertex_map_.end()) {
+        return item->second;
+    }
+
+    geo::Vertex::Ptr vertex_ptr = std::make_shared<geo::Vertex>(location.lat, location.lon, location.uid);
+    vertex_map_[location.uid] = vertex_ptr;
+    return vertex_ptr;
+}
+
+void CSVInputFactory::remove_duplicate_edges() {
+    // edges with the same end points, in either order, are the same space; see geo::Edge::operator==. Candidates are
+    // found by their rounded end points and then compared the way Edge::operator== does.
+    auto same = [](const geo::Location& a, const geo::Location& b) {
+        return double_utilities::are_equal(a.lat, b.lat, geo::kGPSEpsilon) && double_utilities::are_equal(a.lon, b.lon, geo::kGPSEpsilon);
+    };
+
+    std::map<std::array<int64_t, 4>, std::vector<std::size_t>> seen;
+    std::vector<WayEdge> kept;
+    kept.reserve( way_edges_.size() );
+
+    for (auto& edge : way_edges_) {
+        std::array<int64_t, 2> p1{ std::llround( edge.v1.lat * 1e7 ), std::llround( edge.v1.lon * 1e7 ) };
+        std::array<int64_t, 2> p2{ std::llround( edge.v2.lat * 1e7 ), std::llround( edge.v2.lon * 1e7 ) };
+        if (p2 < p1) std::swap( p1, p2 );
+
+        std::vector<std::size_t>& candidates = seen[std::array<int64_t, 4>{ p1[0], p1[1], p2[0], p2[1] }];
+        bool duplicate = false;
+
+        for (std::size_t k : candidates) {
+            if (kept[k].validity != edge.validity) continue;
+
+            if ((same( kept[k].v1, edge.v1 ) && same( kept[k].v2, edge.v2 )) || (same( kept[k].v1, edge.v2 ) && same( kept[k].v2, edge.v1 ))) {
+                duplicate = true;
+                break;
+            }
+        }
+
+        if (duplicate) {
+            ++duplicate_count_;
+            continue;
+        }
+
+        candidates.push_back( kept.size() );
+        kept.push_back( edge );
+    }
+
+    way_edges_.swap( kept );
+}
+
+void CSVInputFactory::build_ways() {
+    if (simplify_tolerance_ > 0.0) {
+        remove_duplicate_edges();
+    }
+
+    // the edges of each way, in file order; edges without a way are not chained.
+    std::unordered_map<std::string, std::vector<std::size_t>> ways;
+    std::vector<bool> used( way_edges_.size(), false );
+
+    for (std::size_t e = 0; e < way_edges_.size(); ++e) {
+        if (!way_edges_[e].way_id.empty()) {
+            ways[way_edges_[e].way_id].push_back( e );
+        }
+    }
+
+    for (std::size_t e = 0; e < way_edges_.size(); ++e) {
+        if (used[e]) continue;
+
+        const WayEdge& first = way_edges_[e];
+        std::vector<std::size_t> chain{ e };
+        used[e] = true;
+
+        if (!first.way_id.empty()) {
+            const std::vector<std::size_t>& way = ways[first.way_id];
+
+            // walk back to the start of the chain, then forward to its end, so a way listed out of order is still
+            // one chain; every segment of a chain has the same width and validity.
+            for (bool extended = true; extended; ) {
+                extended = false;
+                for (std::size_t w : way) {
+                    if (!used[w] && way_edges_[w].way_type == first.way_type && way_edges_[w].validity == first.validity && way_edges_[w].v2.uid == way_edges_[chain.front()].v1.uid) {
+                        chain.insert( chain.begin(), w );
+                        used[w] = extended = true;
+                        break;
+                    }
+                }
+            }
+
+            for (bool extended = true; extended; ) {
+                extended = false;
+                for (std::size_t w : way) {
+                    if (!used[w] && way_edges_[w].way_type == first.way_type && way_edges_[w].validity == first.validity && way_edges_[w].v1.uid == way_edges_[chain.back()].v2.uid) {
+                        chain.push_back( w );
+                        used[w] = extended = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        // vertex v starts segment v, which is the edge chain[v].
+        std::vector<geo::Location> vertices{ way_edges_[chain.front()].v1 };
+        std::vector<uint64_t> edge_ids;
+        for (std::size_t w : chain) {
+            vertices.push_back( way_edges_[w].v2 );
+            edge_ids.push_back( way_edges_[w].uid );
+        }
+
+        if (simplify_tolerance_ > 0.0 && vertices.size() > 2) {
+            std::vector<bool> keep = douglas_peucker( vertices, simplify_tolerance_ );
+            std::vector<geo::Location> kept_vertices;
+            std::vector<uint64_t> kept_ids;
+
+            for (std::size_t v = 0; v < vertices.size(); ++v) {
+                if (!keep[v]) continue;
+
+                kept_vertices.push_back( vertices[v] );
+                if (v < edge_ids.size()) kept_ids.push_back( edge_ids[v] );
+            }
+
+            simplified_count_ += edge_ids.size() - kept_ids.size();
+            vertices.swap( kept_vertices );
+            edge_ids.swap( kept_ids );
+        }
+
+        if (merge_ways_) {
+            geo::Polyline::Ptr polyline_ptr = std::allocate_shared<geo::Polyline>( geo::ArenaAllocator<geo::Polyline>{ arena_ }, vertices, first.way_type, edge_ids.front() );
+            polyline_ptr->set_validity( first.validity );
+            polylines_.push_back( polyline_ptr );
+            continue;
+        }
+
+        for (std::size_t s = 0; s < edge_ids.size(); ++s) {
+            geo::Vertex::Ptr v1 = make_vertex( vertices[s] );
+            geo::Vertex::Ptr v2 = make_vertex( vertices[s + 1] );
+
+            geo::EdgePtr edge_ptr = std::make_shared<geo::Edge>( v1, v2, first.way_type, edge_ids[s] );
+            edge_ptr->set_validity( first.validity );
+            v1->add_edge( edge_ptr );
+            v2->add_edge( edge_ptr );
+            edges_.push_back( edge_ptr );
+        }
+    }
+
+    way_edges_.clear();
+}
+
+void CSVInputFactory::extend_bounds(geo::Bounds& bounds, bool& first, const geo::Point& pt) {
+    double south = first ? pt.lat : std::min(bounds.sw.lat, pt.lat);
+    double west = first ? pt.lon : std::min(bounds.sw.lon, pt.lon);
+    double north = first ? pt.lat : std::max(bounds.ne.lat, pt.lat);
+    double east = first ? pt.lon : std::max(bounds.ne.lon, pt.lon);
+    first = false;
+
+    // the corners are set in place; Bounds and Point declare copy constructors but no assignment.
+    bounds.sw.lat = bounds.se.lat = south;
+    bounds.nw.lat = bounds.ne.lat = north;
+    bounds.sw.lon = bounds.nw.lon = west;
+    bounds.se.lon = bounds.ne.lon = east;
+}
+
+bool CSVInputFactory::get_bounds(geo::Bounds& bounds) const {
+    bool first = true;
+
+    for (auto& circle_ptr : circles_) {
+        extend_bounds(bounds, first, circle_ptr->north);
+        extend_bounds(bounds, first, circle_ptr->south);
+        extend_bounds(bounds, first, circle_ptr->east);
+        extend_bounds(bounds, first, circle_ptr->west);
+    }
+
+    for (auto& edge_ptr : edges_) {
+        extend_bounds(bounds, first, *edge_ptr->v1);
+        extend_bounds(bounds, first, *edge_ptr->v2);
+    }
+
+    for (auto& polyline_ptr : polylines_) {
+        for (auto& vertex : polyline_ptr->get_vertices()) {
+            extend_bounds(bounds, first, vertex);
+        }
+    }
+
+    for (auto& grid_ptr : grids_) {
+        extend_bounds(bounds, first, grid_ptr->sw);
+        extend_bounds(bounds, first, grid_ptr->ne);
+    }
+
+    if (graph_) {
+        for (uint32_t v = 0; v < graph_->vertex_count(); ++v) {
+            extend_bounds(bounds, first, geo::Point{ graph_->lat(v), graph_->lon(v) });
+        }
+    }
+
+    // bounds is only changed when there is a shape.
+    return !first;
+}
+
+geo::Arena::Ptr CSVInputFactory::get_arena() const {
+    return arena_;
+}
+
+geo::RoadGraph::CPtr CSVInputFactory::get_graph() const {
+    return graph_;
+}
+
+const std::vector<geo::GraphEdge::CPtr>& CSVInputFactory::get_graph_edges() const {
+    return graph_edges_;
+}
+
+CSVDeltaFactory::CSVDeltaFactory(const std::string& file_path) :
+    file_path_{file_path},
+    shape_factory_{},
+    changes_{}
+{}
+
+void CSVDeltaFactory::make_change(const StrVector& line_parts) {
+    if ( line_parts.size() < 3 ) {
+        throw std::invalid_argument("insufficient number of components to specify a change: " + std::to_string(line_parts.size()) + "; requires 3." );
+    }
+
+    Change change;
+
+    if ( line_parts[0] == "add" ) {
+        change.op = Operation::ADD;
+    } else if ( line_parts[0] == "remove" ) {
+        change.op = Operation::REMOVE;
+    } else {
+        throw std::invalid_argument("unknown change operation: " + line_parts[0]);
+    }
+
+    // the remaining parts are a shape specification.
+    StrVector shape_parts{ line_parts.begin() + 1, line_parts.end() };
+    change.type = shape_parts[SHAPE_TYPE];
+
+    if ( change.type == "grid" ) {
+        StrVector id_parts = string_utilities::split(shape_parts[SHAPE_ID], '_');
+
+        if (id_parts.size() != 2) {
+            throw std::out_of_range("geo::Grid missing row/col fields.");
+        }
+
+        change.uid = geo::Grid::make_uid( std::stoul(id_parts[0]), std::stoul(id_parts[1]) );      // throws.
+
+    } else if ( change.type == "edge" || change.type == "circle" || change.type == "polyline" ) {
+        change.uid = std::stoull( shape_parts[SHAPE_ID] );                                          // throws.
+
+    } else {
+        throw std::invalid_argument("unknown shape type: " + change.type);
+    }
+
+    if ( shape_parts.size() < 3 ) {
+        if ( change.op == Operation::ADD ) {
+            throw std::invalid_argument("a shape cannot be added without a geography.");
+        }
+
+        changes_.push_back( change );
+        return;
+    }
+
+    if ( change.type == "polyline" ) {
+        // polylines are made by merging the edges of a map file; a delta can only remove one.
+        throw std::invalid_argument("a polyline can only be removed by its id.");
+    }
+
+    if ( change.type == "grid" ) {
+        shape_factory_.make_grid( shape_parts );
+        change.entity_ptr = shape_factory_.get_grids().back();
+
+    } else if ( change.type == "edge" ) {
+        shape_factory_.make_edge( shape_parts );
+        change.entity_ptr = shape_factory_.get_edges().back();
+
+    } else {
+        shape_factory_.make_circle( shape_parts );
+        change.entity_ptr = shape_factory_.get_circles().back();
+    }
+
+    changes_.push_back( change );
+}
+
+void CSVDeltaFactory::make_changes() {
+    std::string line;
+    std::ifstream file(file_path_);
+
+    if (file.fail()) {
+        throw std::invalid_argument("Could not open delta file: " + file_path_);
+    }
+
+    // Get the header.
+    if (!std::getline(file, line)) {
+        throw std::invalid_argument("Delta file missing header!");
+    }
+
+    while (std::getline(file, line)) {
+        try {
+            StrVector parts = string_utilities::split(line, ',');
+
+            if (parts.size() < 3 || parts.size() > 5) {
+                // Delta file attribute order: op,type,id[,geography[,attributes]]
+                std::cerr << "Too few or too many elements in change specification: " << parts.size() << " fields.\n";
+                continue;
+            }
+
+            make_change(parts);
+
+        } catch (std::exception& e) {
+            // Skip the specification and move to the next change.
+            std::cerr << "Failed to make change: " << e.what() << std::endl;
+        }
+    }
+    file.close();
+}
+
+const std::vector<CSVDeltaFactory::Change>& CSVDeltaFactory::get_changes() const {
+    return changes_;
+}
+
+std::size_t CSVDeltaFactory::apply_changes(Quad::Ptr& quadptr) const {
+    std::size_t applied = 0;
+
+    for (auto& change : changes_) {
+        bool removed;
+
+        if (change.entity_ptr) {
+            removed = Quad::remove( quadptr, change.entity_ptr );
+        } else {
+            removed = Quad::remove( quadptr, change.type, change.uid );
+        }
+
+        if (change.op == Operation::ADD) {
+            // an add replaces the previous definition of the shape, if any.
+            if (Quad::insert( quadptr, change.entity_ptr )) {
+                ++applied;
+            }
+
+        } else if (removed) {
+            ++applied;
+        }
+    }
+
+    return applied;
+}
+
+std::size_t CSVDeltaFactory::apply_changes(std::vector<Quad::Ptr>& quads, std::vector<const Change*>& unplaced) const {
+    std::size_t applied = 0;
+    unplaced.clear();
+
+    for (auto& change : changes_) {
+        bool changed = false;
+        bool placed = false;
+
+        for (auto& quadptr : quads) {
+            bool removed;
+
+            if (change.entity_ptr) {
+                removed = Quad::remove( quadptr, change.entity_ptr );
+            } else {
+                removed = Quad::remove( quadptr, change.type, change.uid );
+            }
+
+            if (change.op == Operation::ADD) {
+                // an add replaces the previous definition of the shape, if any.
+                if (Quad::insert( quadptr, change.entity_ptr )) {
+                    placed = true;
+                }
+            }
+
+            changed = changed || placed || removed;
+        }
+
+        if (change.op == Operation::ADD && !placed) {
+            unplaced.push_back( &change );
+        }
+
+        if (change.op == Operation::ADD ? placed : changed) {
+            ++applied;
+        }
+    }
+
+    return applied;
+}
+
 CSVOutputFactory::CSVOutputFactory(const std::string& file_path) :
     file_path_{file_path}
     {}
@@ -333,7 +1313,9 @@ void CSVOutputFactory::add_grid(geo::Grid::CPtr grid_ptr) {
 }
 
 void CSVOutputFactory::write_circle(std::ofstream& os, geo::Circle::CPtr circle_ptr) const {
-    os << std::setprecision(16) << "circle," << circle_ptr->uid << "," << circle_ptr->lat << ":" << circle_ptr->lon << ":" << circle_ptr->radius << std::endl;
+    os << std::setprecision(16) << "circle," << circle_ptr->uid << "," << circle_ptr->lat << ":" << circle_ptr->lon << ":" << circle_ptr->radius;
+    write_validity(os, circle_ptr->get_validity(), ',');
+    os << std::endl;
 }
 
 void CSVOutputFactory::write_edge(std::ofstream& os, geo::EdgeCPtr edge_ptr) const {
@@ -345,11 +1327,15 @@ void CSVOutputFactory::write_edge(std::ofstream& os, geo::EdgeCPtr edge_ptr) con
         highway_name = "unknown";
     }
 
-    os << std::setprecision(16) << "edge," << edge_ptr->get_uid() << "," << edge_ptr->v1->uid << ";" << edge_ptr->v1->lat << ";" << edge_ptr->v1->lon << ":" << edge_ptr->v2->uid << ";" << edge_ptr->v2->lat << ";" << edge_ptr->v2->lon << ",way_type=" << highway_name << ":way_id=" << edge_ptr->get_uid() << std::endl;
+    os << std::setprecision(16) << "edge," << edge_ptr->get_uid() << "," << edge_ptr->v1->uid << ";" << edge_ptr->v1->lat << ";" << edge_ptr->v1->lon << ":" << edge_ptr->v2->uid << ";" << edge_ptr->v2->lat << ";" << edge_ptr->v2->lon << ",way_type=" << highway_name << ":way_id=" << edge_ptr->get_uid();
+    write_validity(os, edge_ptr->get_validity(), ':');
+    os << std::endl;
 }
 
 void CSVOutputFactory::write_grid(std::ofstream& os, geo::Grid::CPtr grid_ptr) const {
-    os << "grid," << std::setprecision(16) << grid_ptr->row << "_" << grid_ptr->col << "," << grid_ptr->sw.lat << ":" << grid_ptr->sw.lon << ":" << grid_ptr->ne.lat << ":" << grid_ptr->ne.lon << std::endl;
+    os << "grid," << std::setprecision(16) << grid_ptr->row << "_" << grid_ptr->col << "," << grid_ptr->sw.lat << ":" << grid_ptr->sw.lon << ":" << grid_ptr->ne.lat << ":" << grid_ptr->ne.lon;
+    write_validity(os, grid_ptr->get_validity(), ',');
+    os << std::endl;
 }
 
 void CSVOutputFactory::write_shapes() const {
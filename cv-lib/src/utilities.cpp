@@ -26,6 +26,8 @@
 #include "utilities.hpp"
 
 #include <cmath>
+#include <cstdio>
+#include <stdexcept>
 
 const std::string string_utilities::DELIMITERS = " \f\n\r\t\v";
 
@@ -67,3 +69,106 @@ StrPair string_utilities::split_attribute( const std::string& s, char delim) {
 bool double_utilities::are_equal(double a, double b, double epsilon) {
     return std::fabs(a - b) < epsilon;
 }
+
+namespace {
+
+/**
+ * @brief Read a fixed number of decimal digits starting at pos; pos is advanced past them.
+ */
+bool read_digits( const std::string& s, std::size_t& pos, std::size_t count, int& value ) {
+    if (pos + count > s.size()) return false;
+
+    value = 0;
+    for (std::size_t end = pos + count; pos < end; ++pos) {
+        if (s[pos] < '0' || s[pos] > '9') return false;
+        value = value * 10 + (s[pos] - '0');
+    }
+
+    return true;
+}
+
+/**
+ * @brief The number of days from 1970-01-01 to a date in the proleptic Gregorian calendar.
+ */
+int64_t days_from_civil( int64_t y, int m, int d ) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+}
+
+bool time_utilities::parse_utc( const std::string& s, int64_t& seconds ) {
+    if (s.empty()) return false;
+
+    if (s.find( '-', 1 ) == std::string::npos) {
+        // a plain number of seconds.
+        std::size_t end = 0;
+        try {
+            long long value = std::stoll( s, &end );
+            if (end != s.size()) return false;
+            seconds = static_cast<int64_t>( value );
+            return true;
+        } catch (std::exception&) {
+            return false;
+        }
+    }
+
+    std::size_t pos = 0;
+    int year, month, day, hour = 0, minute = 0, second = 0;
+
+    if (!read_digits( s, pos, 4, year ) || pos >= s.size() || s[pos++] != '-' ||
+            !read_digits( s, pos, 2, month ) || pos >= s.size() || s[pos++] != '-' ||
+            !read_digits( s, pos, 2, day )) {
+        return false;
+    }
+
+    if (pos < s.size() && (s[pos] == 'T' || s[pos] == ' ')) {
+        ++pos;
+
+        if (!read_digits( s, pos, 2, hour ) || pos >= s.size() || s[pos++] != ':' ||
+                !read_digits( s, pos, 2, minute ) || pos >= s.size() || s[pos++] != ':' ||
+                !read_digits( s, pos, 2, second )) {
+            return false;
+        }
+
+        if (pos < s.size() && s[pos] == '.') {
+            // fractions of a second are dropped.
+            for (++pos; pos < s.size() && s[pos] >= '0' && s[pos] <= '9'; ++pos);
+        }
+    }
+
+    if (pos < s.size() && s[pos] == 'Z') ++pos;
+
+    if (pos != s.size() || month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+        return false;
+    }
+
+    seconds = days_from_civil( year, month, day ) * 86400 + hour * 3600 + minute * 60 + second;
+    return true;
+}
+
+std::string time_utilities::format_utc( int64_t seconds ) {
+    int64_t days = (seconds >= 0 ? seconds : seconds - 86399) / 86400;
+    int64_t rest = seconds - days * 86400;
+
+    // the inverse of days_from_civil.
+    int64_t z = days + 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int64_t doe = z - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    int64_t day = doy - (153 * mp + 2) / 5 + 1;
+    int64_t month = mp < 10 ? mp + 3 : mp - 9;
+    int64_t year = yoe + era * 400 + (month <= 2);
+
+    char buffer[96];
+    std::snprintf( buffer, sizeof(buffer), "%04lld-%02lld-%02lldT%02lld:%02lld:%02lldZ", static_cast<long long>( year ),
+            static_cast<long long>( month ), static_cast<long long>( day ), static_cast<long long>( rest / 3600 ),
+            static_cast<long long>( rest / 60 % 60 ), static_cast<long long>( rest % 60 ) );
+    return std::string{ buffer };
+}
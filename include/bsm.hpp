@@ -85,6 +85,20 @@ class BSM : public geo::Point {
          */
         uint16_t get_secmark() const;
 
+        /**
+         * @brief Set the time the BSM is checked against the shapes of the geofence at.
+         *
+         * @param seconds the time in seconds since the Unix epoch (UTC); see geo::Validity.
+         */
+        void set_time( int64_t seconds );
+
+        /**
+         * @brief Get the time set for this BSM.
+         *
+         * @return the time in seconds since the Unix epoch (UTC); 0 when it was not set.
+         */
+        int64_t get_time() const;
+
         /**
          * @brief Set the temporary ID field for the BSM
          *
@@ -159,6 +173,7 @@ class BSM : public geo::Point {
     private:
         double velocity_;                       ///< the velocity of the BSM.
         uint16_t dsec_;                         ///< the dsecond field if it exists.
+        int64_t time_;                          ///< the time the BSM was received in seconds since the Unix epoch.
         std::string id_;                        ///< the id of the BSM.
         std::string oid_;                        ///< the original id of the BSM.
         std::string partII_;                    ///< the partII field of the BSM (after redaction)
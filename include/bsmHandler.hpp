@@ -38,6 +38,11 @@
 #include "velocityFilter.hpp"
 #include "idRedactor.hpp"
 #include "ppmLogger.hpp"
+#include "geofenceSlot.hpp"
+#include "geofenceCache.hpp"
+#include "geofenceTiles.hpp"
+#include "privacyZones.hpp"
+#include "jsonSplice.hpp"
 
 /**
  * @mainpage
@@ -101,6 +106,7 @@ struct EnumHash {
  *
  * - The velocity is within a specified interval [min,max].
  * - The position is within a prescribed geofence; the geofence is defined using OSM road segments.
+ * - The position is not within a privacy zone around where a vehicle was first observed (see PrivacyZones).
  *
  * Currently the following BSM fields are redacted:
  *
@@ -112,7 +118,7 @@ class BSMHandler {
         /**
          * records the status of the parsing including what caused parsing to stop, i.e., the point to be suppressed.
          */
-        enum ResultStatus : uint16_t { SUCCESS, SPEED, GEOPOSITION, PARSE, MISSING, OTHER };
+        enum ResultStatus : uint16_t { SUCCESS, SPEED, GEOPOSITION, PARSE, MISSING, OTHER, ZONE };
 
         using Ptr = std::shared_ptr<BSMHandler>;                                ///< Handle to pass this handler around efficiently.
         using ResultStringMap = std::unordered_map<ResultStatus,std::string,EnumHash>;   ///< Quick retrieval of result string.
@@ -122,6 +128,7 @@ class BSMHandler {
         static constexpr uint32_t kVelocityFilterFlag = 0x1 << 0;
         static constexpr uint32_t kGeofenceFilterFlag = 0x1 << 1;
         static constexpr uint32_t kIdRedactFlag       = 0x1 << 2;
+        static constexpr uint32_t kZoneFilterFlag     = 0x1 << 3;
         static constexpr uint32_t kSizeRedactFlag     = 0x1 << 4;
         static constexpr uint32_t kGeneralRedactFlag  = 0x1 << 8;
 
@@ -133,31 +140,76 @@ class BSMHandler {
         // must be static const to compose these flags and use in template specialization.
         static const unsigned flags = rapidjson::kParseDefaultFlags | rapidjson::kParseNumbersAsStringsFlag;
 
+        static constexpr std::size_t kDefaultParseArenaBytes = 64 * 1024;     ///< The default size of the parse arena.
+        static constexpr std::size_t kParseStackBytes = 4096;                  ///< The initial size of the parser's stack.
+
+        /**
+         * @brief The document type BSMs are parsed into: its values and its parser stack are both allocated from the
+         * handler's parse arena.
+         */
+        using ArenaDocument = rapidjson::GenericDocument<rapidjson::UTF8<>, rapidjson::MemoryPoolAllocator<>, rapidjson::MemoryPoolAllocator<>>;
+
 
         /**
          * @brief Construct a BSMHandler instance using a quad tree of the map data defining the geofence and user-specified
          * configuration.
          *
-         * @param quad_ptr the quad tree containing the map elements.
+         * @param quad_ptr the quad tree containing the map elements; it is indexed (see Geofence) using the configured
+         * extension and must not be changed afterwards.
          * @param conf the user-specified configuration.
          */
         BSMHandler(Quad::Ptr quad_ptr, const ConfigMap& conf, std::shared_ptr<PpmLogger> logger);
 
         /**
-         * @brief Predicate indicating whether the BSM's position is within the prescribed geofence.
+         * @brief Use the geofence published in a slot in place of the quad tree given at construction. A geofence
+         * published to the slot later is picked up before the next BSM is processed.
+         *
+         * @param slot_ptr the slot publishing the geofence index of the map elements.
+         */
+        void set_geofence_slot(GeofenceSlot::Ptr slot_ptr);
+
+        /**
+         * @brief Use the tiles of a tile file in place of a geofence index of the whole map; each position is checked
+         * against the tile it falls in, which is read the first time it is needed.
          *
-         * @todo: entities use string type values; numeric types would be faster.
+         * @param tiles_ptr the tiles; null returns to the geofence index.
+         */
+        void set_geofence_tiles(GeofenceTiles::Ptr tiles_ptr);
+
+        /**
+         * @brief Predicate indicating whether the BSM's position is within the prescribed geofence. The check uses the
+         * decision cache, when configured, and then the geofence index; it does not allocate or change any reference
+         * counts unless the geofence is loaded by tiles.
          *
          * @param bsm the BSM to be checked.
          * @return true if the BSM is within the geofence; false otherwise.
          */
         bool isWithinEntity(BSM &bsm) const;
 
+        /**
+         * @brief Grade the BSM's position against the prescribed geofence (see Geofence::grade) in the same search as
+         * #isWithinEntity; the decision cache, when configured, answers positions outside the geofence.
+         *
+         * @param bsm the BSM to be graded.
+         * @return the grade of the BSM's position; OUTSIDE exactly when #isWithinEntity is false.
+         */
+        Geofence::Grade geofenceGrade(BSM &bsm) const;
+
         /** 
          * @brief Process a BSM presented as a JSON string; the string should not have any newlines in it.
          *
          * The result of the processing besides SAX fail/succeed status can be obtained using the #get_result method.
          *
+         * In streaming mode (privacy.parse.streaming) the speed and position are first read by a SAX scan that stops
+         * as soon as the velocity or geofence filter suppresses the BSM, or both have passed it, so a suppressed BSM is
+         * never built into a document; only retained BSMs are parsed in full, redacted, and written. The scan reports
+         * the first filter that fails in document order, so a BSM that is also malformed later in the string is
+         * reported as suppressed by that filter rather than as a parse failure.
+         *
+         * In splice mode (privacy.output.splice) a retained BSM is written by copying the bytes of bsm_json that were not
+         * redacted and writing only the values that were (see JsonSplice), rather than writing the whole document; the
+         * document is written when a redaction cannot be located in bsm_json.
+         *
          * @param bsm_json a JSON string of the BSM.  
          * @return true if the SAX parser did not encounter any errors during parsing; false otherwise.
          *
@@ -167,8 +219,9 @@ class BSMHandler {
         /**
          * @brief Handle general redaction of fields, the paths for which are specified in fieldsToRedact.txt
          *
+         * @param document the root of the BSM's document.
          */
-        void handleGeneralRedaction(rapidjson::Document& document);
+        void handleGeneralRedaction(rapidjson::Value& document);
 
         /**
          * @brief Return the result of the most recent BSM processing.
@@ -224,6 +277,44 @@ class BSMHandler {
             return activated_;
         }
 
+        /**
+         * @brief Return the geofence decision cache, e.g., for its hit and miss counts.
+         *
+         * @return the cache; null when it is not configured.
+         */
+        GeofenceCache::Ptr get_geofence_cache() const;
+
+        /**
+         * @brief Return the hits this handler counts in the current geofence index for the reorderer; see
+         * Geofence::count_hits.
+         *
+         * @return the table; null when the index is not reordered.
+         */
+        Geofence::Hits::Ptr get_geofence_hits() const;
+
+        /**
+         * @brief Return the grade of the most recent BSM that passed the geofence filter when grading is configured
+         * (privacy.filter.geofence.grade); OUTSIDE otherwise.
+         *
+         * @return the geofence grade of the most recent BSM.
+         */
+        Geofence::Grade get_geofence_grade() const;
+
+        /**
+         * @brief Return the privacy zones around the first positions of the vehicles, e.g., for their counts.
+         *
+         * @return the zones; null when they are not configured.
+         */
+        PrivacyZones::Ptr get_privacy_zones() const;
+
+        /**
+         * @brief Return the bytes the parse arena holds: its fixed buffer, and any chunks the most recent BSM needed
+         * beyond it, which are released when the next BSM is processed.
+         *
+         * @return the capacity of the parse arena in bytes.
+         */
+        std::size_t get_parse_arena_capacity() const;
+
         const uint32_t get_activation_flag() const;
         const VelocityFilter& get_velocity_filter() const;
         const IdRedactor& get_id_redactor() const;
@@ -237,18 +328,64 @@ class BSMHandler {
         
     private:
 
+        /**
+         * @brief Scan a BSM for the fields the velocity and geofence filters use and apply the filters, stopping as soon
+         * as the BSM is suppressed or passes both; see #process.
+         *
+         * @param bsm_json a JSON string of the BSM.
+         * @return true if the BSM is suppressed, in which case the result is set; false otherwise.
+         */
+        bool prefilter( const std::string& bsm_json );
+
+        /**
+         * @brief Search a geofence index from here on, counting hits in a table of this handler's own when the index is
+         * reordered; the cached answers are forgotten unless the index answers as the last one did, e.g., it is a
+         * reordered copy of it.
+         */
+        void use_geofence( Geofence::CPtr geofence_ptr );
+
+        /**
+         * @brief Observe a vehicle in the privacy zones; see PrivacyZones::observe. A zone or id dropped before it
+         * expired exposes a trip start early, so the drops are logged as warnings: the first, and each time their count
+         * doubles.
+         *
+         * @return true if the BSM is suppressed.
+         */
+        bool observe_zones( const std::string& id );
+
         // JMC: The leak seems to be caused by re-using the RapidJSON document instance.
         // JMC: We will use a unique instance for each message.
         // rapidjson::Document document_;              ///< JSON DOM
+        // Each message still gets its own document, but the document allocates from parse_arena_, which is cleared
+        // for every message, so nothing accumulates and the fixed buffer is reused rather than the heap.
+        std::size_t parse_arena_bytes_;             ///< The size of the parse arena's fixed buffer.
+        std::unique_ptr<char[]> parse_buffer_;      ///< The parse arena's fixed buffer.
+        rapidjson::MemoryPoolAllocator<> parse_arena_;  ///< The allocator of the current BSM's document and parser stacks.
+        std::vector<char> insitu_;                  ///< The current BSM's JSON, parsed in place; strings point into it.
 
         uint32_t activated_;                        ///< A flag word indicating which features of the privacy protection are activiated.
 
         bool finalized_;                            ///< Indicates the JSON string after redaction has been created and retrieved.
         ResultStatus result_;                       ///< Indicates the current state of BSM parsing and what causes failure.
         BSM bsm_;                                   ///< The BSM instance that is being built through parsing.
-        Quad::Ptr quad_ptr_;                        ///< A pointer to the quad tree containing the map elements.
+        GeofenceSlot::Ptr slot_ptr_;                ///< The slot publishing the current geofence index.
+        uint64_t generation_;                       ///< The slot generation geofence_ptr_ was loaded from.
+        Geofence::CPtr geofence_ptr_;               ///< The geofence index of the map elements.
+        bool counting_hits_;                        ///< Indicates the index is reordered by the hits the handlers count.
+        Geofence::Hits::Ptr hits_ptr_;              ///< This handler's hits in geofence_ptr_; null if not counted.
+        GeofenceCache::Ptr cache_ptr_;              ///< Geofence answers for recently seen position cells; null if not used.
+        GeofenceTiles::Ptr tiles_ptr_;              ///< The tiles used in place of geofence_ptr_; null if not used.
+        bool streaming_;                            ///< Indicates BSMs are scanned for the filtered fields before they are parsed.
+        bool speed_checked_;                        ///< Indicates the scan passed the current BSM's speed.
+        bool position_checked_;                     ///< Indicates the scan passed the current BSM's position; grade_ is set.
+        PrivacyZones::Ptr zones_ptr_;               ///< The zones around the vehicles' first positions; null if not used.
+        uint64_t zone_evictions_warned_;            ///< The zone evictions counted when the last warning was logged.
+        bool graded_;                               ///< Indicates retained BSMs are graded and the grade is added to their metadata.
+        Geofence::Grade grade_;                     ///< The geofence grade of the most recent BSM.
         bool get_value_;                            ///< Indicates the next value should be saved.
         std::string json_;                          ///< The JSON string after redaction.
+        bool splicing_;                             ///< Indicates json_ is spliced from the BSM's JSON rather than written from its document.
+        JsonSplice splice_;                         ///< The redactions of the current BSM located in its JSON.
 
         VelocityFilter vf_;                         ///< The velocity filter functor instance.
         IdRedactor idr_;                            ///< The ID Redactor to use during parsing of BSMs.
@@ -3,6 +3,7 @@
 #include "rapidjson/document.h"
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
+#include "jsonSplice.hpp"
 
 static const char* kTypeNames[] = { "Null", "False", "True", "Object", "Array", "String", "Number" };
 
@@ -19,8 +20,9 @@ class RapidjsonRedactor {
          * 
          * @param value The rapidjson::Value to redact from
          * @param path The path to the member to redact
+         * @param splice When not null, records the members that are changed or removed
          */
-        bool redactMemberByPath(rapidjson::Value& value, std::string path);
+        bool redactMemberByPath(rapidjson::Value& value, std::string path, JsonSplice* splice = nullptr);
 
         /**
          * @brief Searches for a member by name
@@ -89,4 +91,14 @@ class RapidjsonRedactor {
          * @return A boolean signifying whether the value was identified to be a bitstring.
         */
         bool isBitstring(rapidjson::Value& value);
+
+        /**
+         * @brief Record a member whose value was set in the splice, if any
+         * 
+         * @param value The object holding the member
+         * @param member The name of the member
+         * @param splice The splice; may be null
+         * @return true, the member was redacted
+         */
+        bool replaced(rapidjson::Value& value, const char* member, JsonSplice* splice);
 };
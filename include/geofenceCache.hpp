@@ -0,0 +1,121 @@
+#ifndef CVDP_GEOFENCE_CACHE_H
+#define CVDP_GEOFENCE_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include "cvlib.hpp"
+
+/**
+ * @brief A GeofenceCache remembers the geofence answer for small cells of positions so the BSMs of a busy corridor,
+ * which repeatedly report positions in the same few meters of road, do not each search the index.
+ *
+ * A position is quantized to a cell of about the configured size (the cells are square in degrees, so they are
+ * narrower than that east to west). The first lookup in a cell searches the index and classifies the cell (see
+ * Geofence::classify); only cells that are entirely inside or entirely outside the geofence are answered from the cache
+ * afterwards. Cells on the border of a shape are remembered as ambiguous so they go straight to the index.
+ *
+ * The cache is a fixed-size, direct-mapped table of atomic words; a word holds the complete cell key and its state, so
+ * lookups and stores are single lock-free loads and stores and a collision only replaces the older cell. Every user of
+ * one cache must query the same index; #clear must be called when the index changes.
+ */
+class GeofenceCache {
+    public:
+        using Ptr = std::shared_ptr<GeofenceCache>;                 ///< Handle to share the cache.
+
+        static constexpr double kMinCellSize = 0.05;                ///< The smallest cell size in meters the key can represent.
+        static constexpr double kMetersPerDegree = 111319.9;        ///< Meters per degree of latitude.
+        static constexpr std::size_t kDefaultCapacity = 65536;      ///< The default number of cells held.
+
+        /**
+         * @brief Construct an empty cache.
+         *
+         * @param cell_size the size of a cell in meters; smaller values are raised to kMinCellSize.
+         * @param capacity the number of cells held; rounded up to a power of two of at least 2.
+         */
+        GeofenceCache( double cell_size, std::size_t capacity = kDefaultCapacity );
+
+        GeofenceCache( const GeofenceCache& ) = delete;
+        GeofenceCache& operator=( const GeofenceCache& ) = delete;
+
+        /**
+         * @brief Predicate indicating whether a position is inside the geofence; the same as Geofence::contains, but
+         * answered from the cache when the position's cell is known to be inside or outside.
+         *
+         * @param geofence the index the cache is for.
+         * @param pt the position.
+         * @return true if the position is inside the geofence.
+         */
+        bool contains( const Geofence& geofence, const geo::Point& pt );
+
+        /**
+         * @brief Predicate indicating whether a position is inside the shapes of the geofence valid at a time; the same
+         * as Geofence::contains with a time. Cells near shapes with a limited validity are ambiguous, so the answers
+         * held do not depend on the time.
+         *
+         * @param geofence the index the cache is for.
+         * @param pt the position.
+         * @param time the time in seconds since the Unix epoch (UTC).
+         * @param hits the table the index counts a hit in when it is searched; see Geofence::count_hits.
+         * @return true if the position is inside the geofence at that time.
+         */
+        bool contains( const Geofence& geofence, const geo::Point& pt, int64_t time, Geofence::Hits* hits = nullptr );
+
+        /**
+         * @brief Grade a position; the same as Geofence::grade, but answered from the cache when the position's cell is
+         * known to be outside. Cells inside the geofence do not say whether they are in a core or a buffer, so their
+         * positions are graded by the index and counted as ambiguous.
+         *
+         * @param geofence the index the cache is for.
+         * @param pt the position.
+         * @return the position's grade.
+         */
+        Geofence::Grade grade( const Geofence& geofence, const geo::Point& pt );
+
+        /**
+         * @brief Grade a position against the shapes of the geofence valid at a time; see #grade and #contains.
+         *
+         * @param geofence the index the cache is for.
+         * @param pt the position.
+         * @param time the time in seconds since the Unix epoch (UTC).
+         * @param hits the table the index counts a hit in when it is searched; see Geofence::count_hits.
+         * @return the position's grade at that time.
+         */
+        Geofence::Grade grade( const Geofence& geofence, const geo::Point& pt, int64_t time, Geofence::Hits* hits = nullptr );
+
+        /**
+         * @brief Forget every cell; used when the index changes.
+         */
+        void clear();
+
+        double cell_size() const;                                   ///< The size of a cell in meters.
+        std::size_t capacity() const;                               ///< The number of cells held.
+        uint64_t hits() const;                                      ///< Lookups answered from the cache.
+        uint64_t misses() const;                                    ///< Lookups of cells not in the cache; the index was searched.
+        uint64_t ambiguous() const;                                 ///< Lookups of cells known to be ambiguous; the index was searched.
+
+    private:
+        static constexpr uint64_t kEmpty = 0;                       ///< The state of an unused entry.
+        static constexpr uint64_t kStateMask = 0x3;                 ///< The state bits of an entry; the rest is the key.
+
+        /**
+         * @brief Answer a lookup; see #contains and #grade.
+         *
+         * @param time the time the shapes must be valid at; null to count every shape.
+         * @param graded false to answer CORE for every position inside the geofence.
+         * @param hits the table the index counts a hit in; null to count nothing.
+         */
+        Geofence::Grade lookup( const Geofence& geofence, const geo::Point& pt, const int64_t* time, bool graded, Geofence::Hits* hits );
+
+        double cell_size_;                                          ///< The size of a cell in meters.
+        double step_;                                               ///< The size of a cell in degrees.
+        std::size_t capacity_;                                      ///< The number of entries; a power of two.
+        int shift_;                                                 ///< Right shift of the key hash that leaves an entry index.
+        std::unique_ptr<std::atomic<uint64_t>[]> entries_;          ///< The cells: the key shifted left 2 bits and the state.
+
+        std::atomic<uint64_t> hits_;                                ///< See #hits.
+        std::atomic<uint64_t> misses_;                              ///< See #misses.
+        std::atomic<uint64_t> ambiguous_;                           ///< See #ambiguous.
+};
+
+#endif
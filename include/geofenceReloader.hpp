@@ -0,0 +1,241 @@
+#ifndef CVDP_GEOFENCE_RELOADER_H
+#define CVDP_GEOFENCE_RELOADER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cvlib.hpp"
+#include "geofenceSlot.hpp"
+#include "ppmLogger.hpp"
+
+/**
+ * @brief A GeofenceReloader rebuilds the geofence index on a background thread and publishes it through a
+ * GeofenceSlot, so the map can change without restarting the PPM (and without the consumer group rebalancing).
+ *
+ * A rebuild is triggered by SIGHUP (see #sighup) or, when a watch file is given, by a change to that file's
+ * modification time, size, or inode. The consume loop never waits on a rebuild: the new index is built completely
+ * before it is published, and an index that is replaced is destroyed on the reloader's thread once no handler holds it.
+ *
+ * A reloader can also watch a delta file (see #watch_deltas); the file holds every change to the map, not just the
+ * latest ones. Every index the reloader builds (see #load) has the delta file applied, and when the file changes the
+ * current version is applied to the index last built from the map, which the reloader keeps, and published instead of
+ * rebuilding the whole index. The published index is always the map plus the current delta file, whatever the order of
+ * rebuilds and updates, so a change dropped from the file is dropped from the index too.
+ *
+ * A reloader can also publish a reordered copy of the index periodically (see #reorder_every), so the handlers test the
+ * shapes the traffic is in first; see Geofence::reordered.
+ */
+class GeofenceReloader {
+    public:
+        using Builder = std::function<Geofence::CPtr(void)>;                   ///< Builds a complete index; may throw.
+        using Updater = std::function<Geofence::CPtr(const Geofence&)>;        ///< Builds an updated copy of an index; may throw.
+
+        static constexpr int kDefaultIntervalMs = 1000;            ///< Default polling interval for triggers.
+
+        /**
+         * @brief Signal handler that requests a rebuild.
+         *
+         * Only sets a lock-free flag so it is safe to install with signal().
+         *
+         * @param sig the signal number (unused).
+         */
+        static void sighup( int sig );
+
+        /**
+         * @brief Construct a reloader; the background thread is not started until #start is called.
+         *
+         * @param slot the slot where new indices are published.
+         * @param builder the function that builds a new index.
+         * @param watch_files the files whose changes trigger a rebuild; empty disables file watching.
+         * @param interval how often the triggers are checked.
+         * @param logger the PPM logger.
+         */
+        GeofenceReloader( GeofenceSlot::Ptr slot, Builder builder, const std::vector<std::string>& watch_files,
+                std::chrono::milliseconds interval, std::shared_ptr<PpmLogger> logger );
+
+        /**
+         * @brief Stop the background thread, if running.
+         */
+        ~GeofenceReloader();
+
+        GeofenceReloader( const GeofenceReloader& ) = delete;
+        GeofenceReloader& operator=( const GeofenceReloader& ) = delete;
+
+        /**
+         * @brief Apply changes from a delta file to each index built and to the published index whenever that file
+         * changes; must be called before #load and #start.
+         *
+         * @param delta_file the file whose changes trigger an update.
+         * @param updater the function that makes an updated copy of an index.
+         */
+        void watch_deltas( const std::string& delta_file, Updater updater );
+
+        /**
+         * @brief Publish a reordered copy of the published index every period; must be called before #start.
+         *
+         * @param period how often the index is reordered.
+         * @param reorderer the function that makes the reordered copy of an index; null when the order would not change.
+         */
+        void reorder_every( std::chrono::milliseconds period, Updater reorderer );
+
+        /**
+         * @brief Build the first index, with the delta file applied, and publish it on the calling thread.
+         *
+         * @throws the exceptions of the builder and the updater; nothing is published.
+         */
+        void load();
+
+        /**
+         * @brief Start the background thread.
+         */
+        void start();
+
+        /**
+         * @brief Stop and join the background thread.
+         */
+        void stop();
+
+        /**
+         * @brief Request a rebuild at the next polling interval; thread safe.
+         */
+        void request_reload();
+
+        /**
+         * @brief Return the number of indices this reloader has successfully published.
+         *
+         * @return the count of successful rebuilds.
+         */
+        uint64_t reload_count() const;
+
+        /**
+         * @brief Return the number of updated indices this reloader has published from the delta file.
+         *
+         * @return the count of successful updates.
+         */
+        uint64_t update_count() const;
+
+        /**
+         * @brief Return the number of reordered indices this reloader has published.
+         *
+         * @return the count of reorders that changed the order.
+         */
+        uint64_t reorder_count() const;
+
+    private:
+        /**
+         * @brief A version of a file.
+         */
+        struct Stamp {
+            int64_t mtime;                                         ///< The modification time in nanoseconds.
+            int64_t size;                                          ///< The size.
+            uint64_t inode;                                        ///< The inode; a replaced file has a new one.
+
+            bool operator==( const Stamp& other ) const;
+        };
+
+        /**
+         * @brief The state of a file watched for changes.
+         */
+        struct WatchedFile {
+            std::string path;                                      ///< The file; empty when not watching.
+            bool have_stamp;                                       ///< True once the file has been stat'ed successfully.
+            Stamp stamp;                                           ///< Last observed version.
+            bool pending_change;                                   ///< A change was seen; act once the file stops changing.
+        };
+
+        static std::atomic<bool> signalled_;                       ///< Set by #sighup.
+
+        GeofenceSlot::Ptr slot_;                                   ///< Where rebuilt indices are published.
+        Builder builder_;                                          ///< Builds a new index.
+        Updater updater_;                                          ///< Makes an updated copy of an index.
+        Updater reorderer_;                                        ///< Makes a reordered copy of an index.
+        std::chrono::milliseconds reorder_period_;                 ///< How often the index is reordered.
+        std::chrono::steady_clock::time_point next_reorder_;       ///< When the index is next reordered.
+        std::chrono::milliseconds interval_;                       ///< Polling interval.
+        std::shared_ptr<PpmLogger> logger_;                        ///< The PPM logger.
+
+        std::thread thread_;                                       ///< The background thread.
+        std::mutex mutex_;                                         ///< Guards the wake up of the background thread.
+        std::condition_variable wakeup_;                           ///< Used to stop the thread without waiting out the interval.
+        bool running_;                                             ///< Guarded by mutex_.
+        std::atomic<bool> requested_;                              ///< Set by #request_reload.
+        std::atomic<uint64_t> reload_count_;                       ///< Number of successful rebuilds.
+        std::atomic<uint64_t> update_count_;                       ///< Number of successful delta updates.
+        std::atomic<uint64_t> reorder_count_;                      ///< Number of reordered indices published.
+
+        std::vector<WatchedFile> watch_files_;                     ///< Changes to any of these trigger a rebuild.
+        WatchedFile delta_file_;                                   ///< Changes trigger a delta update.
+        bool delta_tried_;                                         ///< True once a version of the delta file was applied.
+        Stamp delta_stamp_;                                        ///< The version last applied, or that failed to apply.
+
+        Geofence::CPtr base_;                                      ///< The last index built from the map alone; null until one is built.
+
+        std::vector<Geofence::CPtr> retired_;                      ///< Replaced indices waiting for readers to let go.
+
+        /**
+         * @brief The background thread body.
+         */
+        void run();
+
+        /**
+         * @brief Read the version of a file.
+         *
+         * @param path the file.
+         * @param stamp set to the version.
+         * @return false if the file cannot be stat'ed, e.g., it does not exist.
+         */
+        static bool stamp_of( const std::string& path, Stamp& stamp );
+
+        /**
+         * @brief Predicate indicating whether a watched file changed and has been stable for one interval.
+         *
+         * @param file the watched file; its state is updated.
+         * @return true if the file's change should be acted on.
+         */
+        static bool settled( WatchedFile& file );
+
+        /**
+         * @brief Build a new index and apply the delta file to it when the file exists; the version applied is recorded,
+         * and the index built from the map alone is kept for #update.
+         *
+         * @return the index.
+         * @throws the exceptions of the builder and the updater.
+         */
+        Geofence::CPtr build();
+
+        /**
+         * @brief Build and publish a new index; failures are logged and the current index stays in place.
+         */
+        void reload();
+
+        /**
+         * @brief Apply the current delta file to the index last built from the map, building one if there is none, and
+         * publish the result; failures are logged and the current index stays in place.
+         */
+        void update();
+
+        /**
+         * @brief Publish a reordered copy of the published index when its order changes; failures are logged and the
+         * current index stays in place.
+         */
+        void reorder();
+
+        /**
+         * @brief Publish an index and retire the one it replaces.
+         *
+         * @param geofence_ptr the index to publish.
+         */
+        void publish( Geofence::CPtr geofence_ptr );
+
+        /**
+         * @brief Destroy retired indices that are no longer referenced by any reader.
+         */
+        void release_retired();
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef CVDP_GEOFENCE_SHARE_H
+#define CVDP_GEOFENCE_SHARE_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "cvlib.hpp"
+#include "ppmLogger.hpp"
+
+/**
+ * @brief A GeofenceShare lets the PPM processes on one host use a single copy of the geofence index.
+ *
+ * The index image (see Geofence::image) is kept in a file, normally on a memory file system such as /dev/shm, that
+ * every process maps read only. The first process to need an index builds it and writes the file; the others find the
+ * file and map it instead of reading the map file and building their own copy. The pages of the mapping are shared, so
+ * the memory used by the index on a host does not grow with the number of processes, and only the first process pays
+ * for the build.
+ *
+ * The file starts with a stamp computed from the map files (names, sizes, and modification times) and the settings used
+ * to build the index (see #fingerprint); a file with a different stamp is replaced. A file is written under a new name
+ * and renamed into place, so a process that has the old file mapped keeps using it until it maps the new one, and a
+ * lock file serializes the processes so only one of them builds.
+ */
+class GeofenceShare {
+    public:
+        using Builder = std::function<Geofence::CPtr(void)>;       ///< Builds a complete index; may throw.
+
+        /**
+         * @brief Compute the stamp of an index from the files and settings it is built from.
+         *
+         * @param files the map files.
+         * @param settings the settings that change the index, e.g., its boundaries and edge extension.
+         * @return the stamp.
+         */
+        static uint64_t fingerprint( const std::vector<std::string>& files, const std::string& settings );
+
+        /**
+         * @brief Construct a share that uses the provided index file.
+         *
+         * @param path the index file; the lock file is the same path with ".lock" appended.
+         * @param logger the PPM logger.
+         */
+        GeofenceShare( const std::string& path, std::shared_ptr<PpmLogger> logger );
+
+        /**
+         * @brief Return an index with the provided stamp mapped from the index file, building it and writing the file
+         * first if the file is missing, invalid, or has a different stamp.
+         *
+         * When the file cannot be written or mapped the index that was built is returned; it is not shared.
+         *
+         * @param stamp the stamp of the index that is needed.
+         * @param builder the function that builds the index.
+         * @return the index.
+         * @throws whatever builder throws.
+         */
+        Geofence::CPtr acquire( uint64_t stamp, Builder builder );
+
+        /**
+         * @brief Predicate indicating whether the last index returned by #acquire was mapped from an existing file
+         * rather than built by this process.
+         *
+         * @return true if it was mapped from an existing file.
+         */
+        bool attached() const;
+
+    private:
+        /**
+         * @brief The start of the index file; the index image follows.
+         */
+        struct Header {
+            char magic[8];                                          ///< Identifies an index file.
+            uint64_t stamp;                                         ///< The stamp of the index.
+            uint64_t image_size;                                    ///< The size of the index image in bytes.
+            uint64_t reserved[5];                                   ///< Pads the header so the image is 64-byte aligned.
+        };
+
+        std::string path_;                                          ///< The index file.
+        std::shared_ptr<PpmLogger> logger_;                         ///< The PPM logger.
+        bool attached_;                                             ///< See #attached.
+
+        /**
+         * @brief Map the index file and make an index of its image.
+         *
+         * @param stamp the stamp the file must have.
+         * @return the index, or null when the file is missing, invalid, or has a different stamp.
+         */
+        Geofence::CPtr map( uint64_t stamp ) const;
+
+        /**
+         * @brief Write an index to the index file, replacing it.
+         *
+         * @param stamp the stamp of the index.
+         * @param geofence the index to write.
+         * @return true if the file was written.
+         */
+        bool write( uint64_t stamp, const Geofence& geofence ) const;
+};
+
+#endif
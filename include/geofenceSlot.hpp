@@ -0,0 +1,55 @@
+#ifndef CVDP_GEOFENCE_SLOT_H
+#define CVDP_GEOFENCE_SLOT_H
+
+#include <atomic>
+#include <memory>
+#include "cvlib.hpp"
+
+/**
+ * @brief A GeofenceSlot publishes the geofence index currently in use by the PPM.
+ *
+ * Readers (BSMHandler instances) take a snapshot of the published index and keep using it until the slot's generation
+ * changes; a writer (the GeofenceReloader) publishes a completely built index with a single atomic shared pointer store.
+ * A BSM that is being processed when a new index is published finishes on the index it started with.
+ */
+class GeofenceSlot {
+    public:
+        using Ptr = std::shared_ptr<GeofenceSlot>;                 ///< Handle to share the slot between the handler and the reloader.
+
+        /**
+         * @brief Construct a slot that publishes the provided index as generation 0.
+         *
+         * @param geofence_ptr the initial geofence index; this may be null when the geofence is not used.
+         */
+        explicit GeofenceSlot( Geofence::CPtr geofence_ptr );
+
+        /**
+         * @brief Atomically retrieve the currently published index.
+         *
+         * @return a pointer to the published index; the index remains valid as long as the pointer is held.
+         */
+        Geofence::CPtr load() const;
+
+        /**
+         * @brief Atomically publish a new index and advance the generation.
+         *
+         * @param geofence_ptr the new geofence index.
+         */
+        void store( Geofence::CPtr geofence_ptr );
+
+        /**
+         * @brief Return the number of indices published after the initial one.
+         *
+         * Readers compare this value with the generation of their snapshot to decide whether they need to call
+         * #load; this keeps the reference count of the index out of the per-BSM path.
+         *
+         * @return the current generation.
+         */
+        uint64_t generation() const;
+
+    private:
+        Geofence::CPtr geofence_ptr_;                              ///< The published index; only accessed with the std::atomic_* shared_ptr functions.
+        std::atomic<uint64_t> generation_;                         ///< Incremented after each store.
+};
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef CVDP_GEOFENCE_TILES_H
+#define CVDP_GEOFENCE_TILES_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "cvlib.hpp"
+#include "ppmLogger.hpp"
+
+/**
+ * @brief GeofenceTiles loads the geofence of a large map one fixed-size tile at a time, as the BSMs reach it.
+ *
+ * The map is cut into square tiles of a fixed number of degrees and each tile's index (see Geofence::image) is written to
+ * a tile file (see #write). A tile holds every shape that touches it or lies within the widest possible buffer of its
+ * border, so a tile answers Geofence::contains for the positions in it exactly as an index of the whole map would.
+ *
+ * Opening a tile file only reads its directory, so it takes the same time for a city or a continent. The first position
+ * in a tile reads the tile's image from the file; the tiles that have not been used for the longest time are dropped
+ * when the tiles held use more than the memory cap, and are read again if they are needed again. The memory used tracks
+ * the area the traffic actually covers rather than the size of the map.
+ *
+ * A tile that is dropped while a caller still holds it is released when the caller lets it go. Lookups are serialized by
+ * a mutex, so a GeofenceTiles can be shared by threads.
+ *
+ * A position in no tile of the file is outside the geofence. A tile that is in the file but cannot be read (the file
+ * was damaged after it was opened) is different: the failure is logged and counted once and remembered, so the tile is
+ * not read again, and its positions are taken as outside or, when the tiles fail open, as inside (see #fail_open).
+ */
+class GeofenceTiles {
+    public:
+        using Ptr = std::shared_ptr<GeofenceTiles>;
+
+        static constexpr double kDefaultTileDegrees = 0.25;        ///< The default tile size in degrees of latitude and longitude.
+
+        /**
+         * @brief Write a tile file of the provided shapes.
+         *
+         * The file is written under the path with ".tmp" appended and renamed into place, so a process reading the old
+         * file keeps reading it until it opens the new one.
+         *
+         * @param path the tile file.
+         * @param stamp the stamp of the map files and settings the shapes were read with; see GeofenceShare::fingerprint.
+         * @param shapes the shapes of the map.
+         * @param tile_degrees the tile size in degrees.
+         * @param extension the edge extension in meters; see Geofence.
+         * @param edges the edge model; see Geofence.
+         * @return the number of tiles written; tiles without shapes are not written.
+         * @throws invalid_argument for a tile size that is not positive; runtime_error when the file cannot be written.
+         */
+        static std::size_t write( const std::string& path, uint64_t stamp, const std::vector<geo::Entity::CPtr>& shapes,
+                double tile_degrees, double extension, Geofence::EdgeModel edges = Geofence::EdgeModel::AREA );
+
+        /**
+         * @brief Open a tile file; only its directory is read.
+         *
+         * @param path the tile file.
+         * @param memory_cap the number of bytes of tiles held before the coldest are dropped; at least one tile is always
+         * held.
+         * @param fail_open true if the positions in a tile that cannot be read are inside the geofence; false if outside.
+         * @param logger the PPM logger for tiles that cannot be read; may be null.
+         * @throws invalid_argument when the file is missing or is not a tile file.
+         */
+        GeofenceTiles( const std::string& path, std::size_t memory_cap, bool fail_open = false, std::shared_ptr<PpmLogger> logger = nullptr );
+        ~GeofenceTiles();
+
+        GeofenceTiles( const GeofenceTiles& ) = delete;
+        GeofenceTiles& operator=( const GeofenceTiles& ) = delete;
+
+        /**
+         * @brief Return the index of the tile containing a position, reading it from the file if it is not held.
+         *
+         * @param pt the position.
+         * @param failed set to true if the tile is in the file but cannot be read; false otherwise.
+         * @return the tile's index; null if the tile has no shapes or cannot be read.
+         */
+        Geofence::CPtr tile( const geo::Point& pt, bool& failed );
+
+        /**
+         * @brief Return the index of the tile containing a position; see above.
+         */
+        Geofence::CPtr tile( const geo::Point& pt );
+
+        /**
+         * @brief Predicate indicating whether a position is inside the geofence; see Geofence::contains. A position in a
+         * tile that cannot be read is inside when the tiles fail open.
+         *
+         * @param pt the position.
+         * @return true if pt is inside the geofence; false otherwise.
+         */
+        bool contains( const geo::Point& pt );
+
+        bool fail_open() const;                                     ///< True if the positions in a tile that cannot be read are inside.
+
+        uint64_t stamp() const;                                     ///< The stamp the file was written with.
+        double tile_degrees() const;                                ///< The tile size in degrees.
+        std::size_t tile_count() const;                             ///< The number of tiles in the file.
+        std::size_t loaded_count() const;                           ///< The number of tiles held.
+        std::size_t memory_usage() const;                           ///< The bytes of the tiles held.
+        uint64_t loads() const;                                     ///< The number of tile reads.
+        uint64_t evictions() const;                                 ///< The number of tiles dropped under the memory cap.
+        std::size_t failures() const;                               ///< The number of tiles in the file that could not be read.
+        uint64_t failed_lookups() const;                            ///< The number of positions looked up in those tiles.
+
+    private:
+        struct Entry {
+            uint64_t key;                                           ///< The tile's row and column; see #tile_key.
+            uint64_t offset;                                        ///< The file offset of the tile's image.
+            uint64_t size;                                          ///< The size of the tile's image.
+        };
+
+        struct Loaded {
+            Geofence::CPtr geofence_ptr;                            ///< The tile's index.
+            std::list<uint64_t>::iterator use;                      ///< The tile's place in #lru_.
+        };
+
+        static uint64_t tile_key( int64_t row, int64_t col );
+
+        uint64_t key_of( const geo::Point& pt ) const;
+        /**
+         * @brief Read a tile's index from the file.
+         *
+         * @param error set to the reason when the tile cannot be read.
+         * @return the index; null when it cannot be read.
+         */
+        Geofence::CPtr load( const Entry& entry, std::string& error ) const;
+
+        std::string path_;                                          ///< The tile file.
+        int fd_;                                                    ///< The open tile file.
+        uint64_t stamp_;                                            ///< The stamp the file was written with.
+        double tile_degrees_;                                       ///< The tile size in degrees.
+        std::vector<Entry> directory_;                              ///< The tiles in the file ordered by key.
+        std::size_t memory_cap_;                                    ///< The bytes of tiles held before the coldest are dropped.
+        bool fail_open_;                                            ///< See #fail_open.
+        std::shared_ptr<PpmLogger> logger_;                         ///< The PPM logger; may be null.
+
+        mutable std::mutex mutex_;                                  ///< Guards the members below.
+        std::unordered_map<uint64_t, Loaded> loaded_;               ///< The tiles held by key.
+        std::list<uint64_t> lru_;                                   ///< The keys of the tiles held, most recently used first.
+        std::size_t memory_usage_;                                  ///< The bytes of the tiles held.
+        uint64_t loads_;                                            ///< The number of tile reads.
+        uint64_t evictions_;                                        ///< The number of tiles dropped.
+        std::unordered_set<uint64_t> failed_;                       ///< The keys of the tiles that could not be read.
+        uint64_t failed_lookups_;                                   ///< See #failed_lookups.
+};
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef CVDP_JSON_SPLICE_H
+#define CVDP_JSON_SPLICE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+
+/**
+ * @brief JsonSplice writes an edited JSON document by copying the bytes of the original JSON that were not edited and
+ * writing only the values that were.
+ *
+ * The document must have been parsed in place (ParseInsitu) from a copy of the original JSON. In place parsing leaves
+ * every member name pointing into the copy at the offset of the name in the original, so the span of a member, and of
+ * its value, is found from its name alone. As a document is edited the changed members are recorded with #replace,
+ * #remove, and #append; #write then copies the original around the recorded spans. The formatting and the member order
+ * of the original are kept, where writing the document would make it compact and RemoveMember reorders members.
+ *
+ * A member whose name does not point into the copy, one that was added to the document, cannot be located; recording
+ * it makes the splice invalid and #write refuses, so the caller writes the document instead.
+ */
+class JsonSplice {
+    public:
+        JsonSplice();
+
+        /**
+         * @brief Forget the edits of the previous document and start on a new one.
+         *
+         * @param original the JSON the document was parsed from; it must not change until #write.
+         * @param insitu the copy of original the document was parsed from in place.
+         */
+        void reset( const std::string& original, const char* insitu );
+
+        /**
+         * @brief Record that the value of a member was changed; its current value is written in place of the original.
+         *
+         * @param object the object holding the member.
+         * @param name the name of the member.
+         */
+        void replace( const rapidjson::Value& object, const char* name );
+
+        /**
+         * @brief Record that a member is about to be removed; call before the member is removed.
+         *
+         * @param object the object holding the member.
+         * @param name the name of the member.
+         */
+        void remove( const rapidjson::Value& object, const char* name );
+
+        /**
+         * @brief Record that a member was added to an object; its current value is written at the end of the object.
+         *
+         * @param parent the object holding the object that was added to.
+         * @param object the name of the object that was added to.
+         * @param name the name of the added member.
+         */
+        void append( const rapidjson::Value& parent, const char* object, const char* name );
+
+        /**
+         * @brief Predicate indicating whether every edit since #reset was located in the original.
+         */
+        bool valid() const;
+
+        std::size_t edit_count() const;                             ///< The number of edits recorded since #reset.
+
+        /**
+         * @brief Write the original JSON with the recorded edits.
+         *
+         * @param out set to the edited JSON; not changed when the splice is not valid.
+         * @return true if the JSON was written; false if the splice is not valid.
+         */
+        bool write( std::string& out ) const;
+
+    private:
+        enum class Kind {
+            REPLACE,                                                ///< Write new bytes in place of a value.
+            REMOVE,                                                 ///< Drop a member and the comma after it.
+            REMOVE_LAST,                                            ///< Drop the last member of an object and the comma before it.
+            APPEND                                                  ///< Write a member before the end of an object.
+        };
+
+        struct Edit {
+            std::size_t begin;                                      ///< The offset of the first original byte edited.
+            std::size_t end;                                        ///< The offset after the last original byte edited.
+            std::size_t text_begin;                                 ///< The offset of the new bytes in text_.
+            std::size_t text_end;                                   ///< The offset after the new bytes in text_.
+            Kind kind;
+        };
+
+        /**
+         * @brief Find the span of a member in the original.
+         *
+         * @param name the name of the member.
+         * @param key set to the offset of the opening quote of the member's name.
+         * @param value set to the offset of the member's value.
+         * @param end set to the offset after the member's value.
+         * @return false if the name does not point into the in place copy.
+         */
+        bool locate( const rapidjson::Value& name, std::size_t& key, std::size_t& value, std::size_t& end ) const;
+
+        /**
+         * @brief Append the JSON of a value to text_.
+         */
+        void write_value( const rapidjson::Value& value );
+
+        const char* original_;                                      ///< The original JSON.
+        std::size_t size_;                                          ///< The bytes of the original JSON.
+        const char* insitu_;                                        ///< The copy of the original parsed in place.
+        bool valid_;                                                ///< See #valid.
+        std::vector<Edit> edits_;                                   ///< The edits in the order they were recorded.
+        rapidjson::StringBuffer text_;                              ///< The new bytes of the edits.
+        mutable std::vector<Edit> sorted_;                          ///< The edits ordered by offset while writing.
+};
+
+#endif
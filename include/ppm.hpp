@@ -55,6 +55,10 @@
 #include "cvlib.hpp"
 #include "spdlog/spdlog.h"
 #include "ppmLogger.hpp"
+#include "geofenceSlot.hpp"
+#include "geofenceReloader.hpp"
+#include "geofenceShare.hpp"
+#include "geofenceTiles.hpp"
 
 class PPM : public tool::Tool {
 
@@ -73,7 +77,11 @@ class PPM : public tool::Tool {
         bool launch_consumer();
         bool launch_producer();
         bool msg_consume(RdKafka::Message* message, void* opaque, BSMHandler& handler);
-        Quad::Ptr BuildGeofence( const std::string& mapfile );
+        Geofence::CPtr BuildGeofence( const std::string& mapfile );
+        Geofence::CPtr LoadGeofence( const std::string& mapfile );
+        GeofenceTiles::Ptr LoadTiles( const std::string& mapfile, const std::string& tilefile );
+        void WarmGeofence( const Geofence& geofence );
+        Geofence::CPtr UpdateGeofence( const Geofence& geofence, const std::string& deltafile );
         int operator()(void);
 
         /**
@@ -122,7 +130,17 @@ class PPM : public tool::Tool {
         RdKafka::Conf *conf;
         RdKafka::Conf *tconf;
 
-        Quad::Ptr qptr;
+        std::string mapfile;                                            ///> The map file used to build the geofence.
+        std::string deltafile;                                          ///> The file of changes to apply to the geofence; empty if not used.
+        GeofenceSlot::Ptr geofence_slot;                                ///> Publishes the geofence currently used by the handler.
+        std::unique_ptr<GeofenceReloader> geofence_reloader;            ///> Rebuilds the geofence on SIGHUP or map file change.
+        std::unique_ptr<GeofenceShare> geofence_share;                  ///> Shares the geofence index with the other PPMs on the host; null if not used.
+        GeofenceTiles::Ptr geofence_tiles;                              ///> Loads the geofence by tiles in place of geofence_slot; null if not used.
+        geo::PageMode geofence_pages;                                   ///> The kind of pages requested for the geofence index.
+        bool geofence_warmup;                                           ///> flag to touch every page of a new geofence index before it is used.
+        bool geofence_watch;                                            ///> flag to rebuild the geofence when the map file changes.
+        int geofence_reload_interval;                                   ///> milliseconds between checks for a geofence rebuild.
+        int geofence_reorder_interval;                                  ///> milliseconds between reorders of the geofence's leaves; 0 if not used.
 
         std::shared_ptr<RdKafka::KafkaConsumer> consumer;
         int consumer_timeout;
@@ -0,0 +1,144 @@
+#ifndef CVDP_PRIVACY_ZONES_H
+#define CVDP_PRIVACY_ZONES_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "cvlib.hpp"
+
+/**
+ * @brief PrivacyZones suppresses the BSMs near where each vehicle was first observed, the start of its trip, for a
+ * period after it was seen there.
+ *
+ * The first BSM of a vehicle id that is not known makes a zone, a circle of the configured radius around its position
+ * that expires after the configured period; an id is forgotten when it has not been seen for that period, so its next
+ * BSM starts a new zone. Every BSM, of any vehicle, inside a zone that has not expired is suppressed.
+ *
+ * Unlike the geofence, the zones change with every new vehicle, so they are held in a structure built for insertion and
+ * expiry rather than search alone:
+ * - a hashed grid: the zones are chained by the grid cell of their center, in cells at least the radius on a side, so
+ *   a query looks at the zones of 3 x 3 cells.
+ * - a timing wheel: the zones and the vehicle ids are also chained in a ring of one-second buckets by the second they
+ *   expire, so expiring them costs one bucket per second that passes, however many there are.
+ *
+ * The zones and ids are fixed-size slots allocated when the instance is constructed, so the memory used does not grow
+ * with traffic. When every slot is in use the zone or id closest to expiring is dropped to make room (see #evictions).
+ * An instance is used by one thread.
+ */
+class PrivacyZones {
+    public:
+        using Ptr = std::shared_ptr<PrivacyZones>;                  ///< Handle to pass the zones around.
+
+        static constexpr std::size_t kDefaultCapacity = 65536;      ///< The default number of zones (and vehicle ids) held.
+        static constexpr double kMetersPerDegree = 111319.9;        ///< Meters per degree of latitude.
+
+        /**
+         * @brief Construct an instance without zones.
+         *
+         * @param radius the radius of a zone in meters.
+         * @param duration the seconds a zone, and a vehicle id that is not seen, is held.
+         * @param capacity the number of zones held, and of vehicle ids; at least 1.
+         * @throws invalid_argument when the radius or the duration is not positive.
+         */
+        PrivacyZones( double radius, int64_t duration, std::size_t capacity = kDefaultCapacity );
+
+        PrivacyZones( const PrivacyZones& ) = delete;
+        PrivacyZones& operator=( const PrivacyZones& ) = delete;
+
+        /**
+         * @brief Record a BSM: make a zone at its position when its vehicle id is not known, and decide whether it is
+         * suppressed.
+         *
+         * @param id the vehicle id of the BSM.
+         * @param pt the position of the BSM.
+         * @param time the time of the BSM in seconds since the Unix epoch (UTC).
+         * @return true if the position is inside a zone at that time, which is always the case for a new id.
+         */
+        bool observe( const std::string& id, const geo::Point& pt, int64_t time );
+
+        /**
+         * @brief Predicate indicating whether a position is inside a zone that has not expired at a time.
+         *
+         * @param pt the position.
+         * @param time the time in seconds since the Unix epoch (UTC).
+         * @return true if the position is inside a zone.
+         */
+        bool contains( const geo::Point& pt, int64_t time );
+
+        /**
+         * @brief Drop the zones and vehicle ids that expire at or before a time. Times earlier than one already seen do
+         * not bring anything back.
+         *
+         * @param time the time in seconds since the Unix epoch (UTC).
+         */
+        void expire( int64_t time );
+
+        double radius() const;                                      ///< The radius of a zone in meters.
+        int64_t duration() const;                                   ///< The seconds a zone is held.
+        std::size_t capacity() const;                               ///< The number of zones held at most.
+        std::size_t zone_count() const;                             ///< The number of zones held.
+        std::size_t vehicle_count() const;                          ///< The number of vehicle ids held.
+        uint64_t evictions() const;                                 ///< Zones and ids dropped before they expired to make room.
+        std::size_t memory_usage() const;                           ///< The bytes of the slots, hash buckets, and wheels.
+
+    private:
+        static constexpr uint32_t kNone = UINT32_MAX;               ///< The end of a chain.
+
+        /**
+         * @brief A fixed set of slots, each with a key and an expiry time, chained both by the hash of its key and by
+         * the wheel bucket of its expiry.
+         */
+        struct Table {
+            struct Slot {
+                uint64_t key;                                       ///< The grid cell or the hash of the vehicle id.
+                int64_t expiry;                                     ///< The second the slot expires.
+                uint32_t hash_prev;                                 ///< The previous slot with the same hash bucket.
+                uint32_t hash_next;                                 ///< The next slot with the same hash bucket; the free list.
+                uint32_t wheel_prev;                                ///< The previous slot with the same wheel bucket.
+                uint32_t wheel_next;                                ///< The next slot with the same wheel bucket.
+            };
+
+            std::vector<Slot> slots;                                ///< The slots.
+            std::vector<uint32_t> buckets;                          ///< The first slot of each hash bucket.
+            std::vector<uint32_t> wheel;                            ///< The first slot of each wheel bucket.
+            uint32_t free;                                          ///< The first unused slot.
+            std::size_t count;                                      ///< The number of slots in use.
+            int hash_shift;                                         ///< Right shift of the key hash that leaves a bucket index.
+
+            Table( std::size_t capacity, std::size_t wheel_size );
+
+            uint32_t bucket_of( uint64_t key ) const;
+            uint32_t first( uint64_t key ) const;                   ///< The first slot whose key hashes like key.
+            uint32_t insert( uint64_t key, int64_t expiry, int64_t now, uint64_t& evictions );
+            void remove( uint32_t s );
+            void schedule( uint32_t s, int64_t expiry );
+            void unschedule( uint32_t s );
+            void expire_bucket( std::size_t bucket, int64_t time );   ///< Remove the slots of a wheel bucket expiring by time.
+            std::size_t memory_usage() const;
+        };
+
+        /**
+         * @brief Return the grid row of a latitude.
+         */
+        int64_t row_of( double lat ) const;
+
+        /**
+         * @brief Return the grid column of a longitude in a row; cells are wider toward the poles so they are at least
+         * the radius east to west.
+         */
+        int64_t col_of( int64_t row, double lon ) const;
+
+        static uint64_t cell_key( int64_t row, int64_t col );
+
+        double radius_;                                             ///< The radius of a zone in meters.
+        int64_t duration_;                                          ///< The seconds a zone is held.
+        double step_;                                               ///< The height of a grid cell in degrees.
+        int64_t now_;                                               ///< The latest second expired.
+        Table zones_;                                               ///< The zones keyed by grid cell.
+        std::vector<geo::Point> centers_;                           ///< The center of the zone in each slot of zones_.
+        Table vehicles_;                                            ///< The vehicle ids keyed by hash.
+        uint64_t evictions_;                                        ///< See #evictions.
+};
+
+#endif
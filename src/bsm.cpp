@@ -4,6 +4,7 @@ BSM::BSM() :
     geo::Point{90.0, 180.0},
     velocity_{ -1 },
     dsec_{0},
+    time_{0},
     id_{""},
     oid_{""},
     partII_{""},
@@ -15,6 +16,7 @@ void BSM::reset() {
     lon = 180.0;
     velocity_ = -1.0;
     dsec_ = 0;
+    time_ = 0;
     id_ = "";
     oid_ = "";
     partII_ = "";
@@ -54,6 +56,14 @@ uint16_t BSM::get_secmark() const {
     return dsec_;
 }
 
+void BSM::set_time( int64_t seconds ) {
+    time_ = seconds;
+}
+
+int64_t BSM::get_time() const {
+    return time_;
+}
+
 void BSM::set_id( const std::string& s ) {
     id_ = s;
 }
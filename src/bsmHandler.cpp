@@ -29,6 +29,9 @@
 #include <sstream>
 #include <random>
 #include <limits>
+#include <cstring>
+#include <algorithm>
+#include <ctime>
 
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
@@ -38,22 +41,86 @@
 #include "spdlog/spdlog.h"
 #include "redactionPropertiesManager.hpp"
 
+constexpr std::size_t BSMHandler::kDefaultParseArenaBytes;
+constexpr std::size_t BSMHandler::kParseStackBytes;
+
+namespace {
+
+/**
+ * @brief Read a count of bytes from a setting.
+ *
+ * @param text the setting's value.
+ * @param bytes set to the count; not changed when the value is not a count.
+ * @return true if the whole value is a non-negative integer; false otherwise.
+ */
+bool parse_bytes( const std::string& text, std::size_t& bytes )
+{
+    // stoul would take a negative value as a huge one.
+    if (text.find('-') != std::string::npos) return false;
+
+    try {
+        std::size_t end = 0;
+        unsigned long value = std::stoul( text, &end );
+        if (end != text.size()) return false;
+        bytes = static_cast<std::size_t>( value );
+        return true;
+    } catch (std::exception&) {
+        return false;
+    }
+}
+
+/**
+ * @brief Return the size of the parse arena's fixed buffer: privacy.parse.arena bytes, or the default when it is not set
+ * or is not a count of bytes (the constructor logs it).
+ */
+std::size_t parse_arena_bytes( const ConfigMap& conf )
+{
+    auto search = conf.find("privacy.parse.arena");
+    std::size_t bytes = BSMHandler::kDefaultParseArenaBytes;
+    if (search != conf.end()) parse_bytes( search->second, bytes );
+
+    // the buffer also holds the arena's chunk header.
+    return std::max<std::size_t>( bytes, 1024 );
+}
+
+}
+
 BSMHandler::ResultStringMap BSMHandler::result_string_map{
             { ResultStatus::SUCCESS, "success" },
             { ResultStatus::SPEED, "speed" },
             { ResultStatus::GEOPOSITION, "geoposition" },
             { ResultStatus::PARSE, "parse" },
             { ResultStatus::MISSING, "missing" },
-            { ResultStatus::OTHER, "other" }
+            { ResultStatus::OTHER, "other" },
+            { ResultStatus::ZONE, "zone" }
         };
 
 BSMHandler::BSMHandler(Quad::Ptr quad_ptr, const ConfigMap& conf, std::shared_ptr<PpmLogger> logger ):
+    parse_arena_bytes_{ parse_arena_bytes(conf) },
+    parse_buffer_{ new char[parse_arena_bytes_] },
+    parse_arena_{ parse_buffer_.get(), parse_arena_bytes_ },
+    insitu_{},
     activated_{0},
+    finalized_{ false },
     result_{ ResultStatus::SUCCESS },
     bsm_{},
-    quad_ptr_{quad_ptr},
-    finalized_{ false },
+    slot_ptr_{ std::make_shared<GeofenceSlot>(nullptr) },
+    generation_{0},
+    geofence_ptr_{},
+    counting_hits_{ false },
+    hits_ptr_{},
+    cache_ptr_{},
+    tiles_ptr_{},
+    streaming_{ false },
+    speed_checked_{ false },
+    position_checked_{ false },
+    zones_ptr_{},
+    zone_evictions_warned_{ 0 },
+    graded_{ false },
+    grade_{ Geofence::Grade::OUTSIDE },
     json_{},
+    splicing_{ false },
+    splice_{},
     vf_{ conf },
     idr_{ conf },
     box_extension_{ 10.0 },
@@ -66,6 +133,13 @@ BSMHandler::BSMHandler(Quad::Ptr quad_ptr, const ConfigMap& conf, std::shared_pt
     
     logger_->trace("BSMHandler::BSMHandler(): Constructor called");
 
+    // the arena was sized in the initializer list, which cannot log.
+    auto arena = conf.find("privacy.parse.arena");
+    std::size_t arena_bytes;
+    if ( arena != conf.end() && !parse_bytes( arena->second, arena_bytes ) ) {
+        logger_->error("BSMHandler::BSMHandler(): privacy.parse.arena \"" + arena->second + "\" is not a number of bytes; using " + std::to_string(kDefaultParseArenaBytes) + ".");
+    }
+
     auto search = conf.find("privacy.filter.velocity");
     if ( search != conf.end() && search->second=="ON" ) {
         activate<BSMHandler::kVelocityFilterFlag>();
@@ -95,45 +169,162 @@ BSMHandler::BSMHandler(Quad::Ptr quad_ptr, const ConfigMap& conf, std::shared_pt
     if ( search != conf.end() ) {
         box_extension_ = std::stod( search->second );
     }
+
+    search = conf.find("privacy.filter.geofence.grade");
+    if ( search != conf.end() && search->second=="ON" ) {
+        graded_ = true;
+    }
+
+    search = conf.find("privacy.filter.geofence.cache.cell");
+    if ( search != conf.end() && std::stod( search->second ) > 0.0 ) {
+        std::size_t capacity = GeofenceCache::kDefaultCapacity;
+
+        auto size = conf.find("privacy.filter.geofence.cache.size");
+        if ( size != conf.end() ) {
+            capacity = std::stoul( size->second );
+        }
+
+        cache_ptr_ = std::make_shared<GeofenceCache>( std::stod( search->second ), capacity );
+        logger_->info("BSMHandler::BSMHandler(): geofence cache of " + std::to_string(cache_ptr_->capacity()) + " cells of " + std::to_string(cache_ptr_->cell_size()) + " m");
+    }
+
+    // the reloader reorders the index by the hits the handlers count; a shared index is not reordered.
+    search = conf.find("privacy.filter.geofence.reorder.interval.ms");
+    if ( search != conf.end() && conf.find("privacy.filter.geofence.shared.file") == conf.end() ) {
+        try {
+            counting_hits_ = std::stoi( search->second ) > 0;
+        } catch( std::exception& e ) {
+            counting_hits_ = false;
+        }
+    }
+
+    search = conf.find("privacy.parse.streaming");
+    if ( search != conf.end() && search->second=="ON" ) {
+        streaming_ = true;
+    }
+
+    search = conf.find("privacy.output.splice");
+    if ( search != conf.end() && search->second=="ON" ) {
+        splicing_ = true;
+    }
+
+    search = conf.find("privacy.filter.zones");
+    if ( search != conf.end() && search->second=="ON" ) {
+        double radius = 200.0;
+        int64_t duration = 300;
+        std::size_t capacity = PrivacyZones::kDefaultCapacity;
+
+        auto item = conf.find("privacy.filter.zones.radius");
+        if ( item != conf.end() ) {
+            radius = std::stod( item->second );
+        }
+
+        item = conf.find("privacy.filter.zones.duration");
+        if ( item != conf.end() ) {
+            duration = std::stoll( item->second );
+        }
+
+        item = conf.find("privacy.filter.zones.capacity");
+        if ( item != conf.end() ) {
+            capacity = std::stoul( item->second );
+        }
+
+        zones_ptr_ = std::make_shared<PrivacyZones>( radius, duration, capacity );      // throws.
+        activate<BSMHandler::kZoneFilterFlag>();
+        logger_->info("BSMHandler::BSMHandler(): privacy zones of " + std::to_string(zones_ptr_->radius()) + " m for " + std::to_string(zones_ptr_->duration()) + " s; " + std::to_string(zones_ptr_->capacity()) + " zones, " + std::to_string(zones_ptr_->memory_usage()) + " bytes");
+    }
+
+    if (quad_ptr) {
+        search = conf.find("privacy.filter.geofence.capsules");
+        Geofence::EdgeModel edge_model = search != conf.end() && search->second == "ON" ? Geofence::EdgeModel::CAPSULE : Geofence::EdgeModel::AREA;
+        geofence_ptr_ = std::make_shared<const Geofence>( std::vector<Quad::CPtr>{ quad_ptr }, box_extension_, geo::PageMode::NORMAL, edge_model );
+    }
+
+    slot_ptr_ = std::make_shared<GeofenceSlot>( geofence_ptr_ );
+    use_geofence( geofence_ptr_ );
+}
+
+void BSMHandler::set_geofence_slot(GeofenceSlot::Ptr slot_ptr) {
+    slot_ptr_ = slot_ptr;
+    generation_ = slot_ptr_->generation();
+    use_geofence( slot_ptr_->load() );
+}
+
+void BSMHandler::use_geofence(Geofence::CPtr geofence_ptr) {
+    // a reordered copy answers as the index it was made from, so only its hits start over.
+    bool same_answers = geofence_ptr_ && geofence_ptr && geofence_ptr_->answers() == geofence_ptr->answers();
+    geofence_ptr_ = geofence_ptr;
+    hits_ptr_ = counting_hits_ && geofence_ptr_ ? geofence_ptr_->count_hits() : nullptr;
+    // otherwise the cached answers are for the old geofence.
+    if (cache_ptr_ && !same_answers) cache_ptr_->clear();
+}
+
+void BSMHandler::set_geofence_tiles(GeofenceTiles::Ptr tiles_ptr) {
+    tiles_ptr_ = tiles_ptr;
+    if (cache_ptr_) cache_ptr_->clear();
 }
 
 bool BSMHandler::isWithinEntity(BSM &bsm) const {
-    geo::Circle::CPtr circle_ptr = nullptr;
-    geo::EdgeCPtr edge_ptr = nullptr;
-    geo::Grid::CPtr grid_ptr = nullptr;
-    geo::AreaPtr area_ptr = nullptr;
+    if (tiles_ptr_) {
+        // a tile answers for every position in it, and for the cache cells that reach a little past it.
+        bool failed = false;
+        Geofence::CPtr tile_ptr = tiles_ptr_->tile(bsm, failed);
+        if (!tile_ptr) return failed && tiles_ptr_->fail_open();
+        return cache_ptr_ ? cache_ptr_->contains(*tile_ptr, bsm, bsm.get_time()) : tile_ptr->contains(bsm, bsm.get_time());
+    }
 
-    geo::Entity::PtrList entity_set = quad_ptr_->retrieve_elements(bsm); 
+    if (!geofence_ptr_) {
+        return false;
+    }
 
-    for (auto& entity_ptr : entity_set) {
+    return cache_ptr_ ? cache_ptr_->contains(*geofence_ptr_, bsm, bsm.get_time(), hits_ptr_.get()) : geofence_ptr_->contains(bsm, bsm.get_time(), hits_ptr_.get());
+}
 
-        edge_ptr = std::static_pointer_cast<const geo::Edge>(entity_ptr); 
+Geofence::Grade BSMHandler::geofenceGrade(BSM &bsm) const {
+    if (tiles_ptr_) {
+        bool failed = false;
+        Geofence::CPtr tile_ptr = tiles_ptr_->tile(bsm, failed);
+        if (!tile_ptr) return failed && tiles_ptr_->fail_open() ? Geofence::Grade::BUFFER : Geofence::Grade::OUTSIDE;
+        return cache_ptr_ ? cache_ptr_->grade(*tile_ptr, bsm, bsm.get_time()) : tile_ptr->grade(bsm, bsm.get_time());
+    }
 
-        if (entity_ptr->get_type() == "edge") {
-            edge_ptr = std::static_pointer_cast<const geo::Edge>(entity_ptr); 
-            area_ptr = edge_ptr->to_area(box_extension_);
+    if (!geofence_ptr_) {
+        return Geofence::Grade::OUTSIDE;
+    }
 
-            if (area_ptr->contains(bsm)) {
-                return true;
-            }
+    return cache_ptr_ ? cache_ptr_->grade(*geofence_ptr_, bsm, bsm.get_time(), hits_ptr_.get()) : geofence_ptr_->grade(bsm, bsm.get_time(), hits_ptr_.get());
+}
 
-        }  else if (entity_ptr->get_type() == "circle") {
-            circle_ptr = std::static_pointer_cast<const geo::Circle>(entity_ptr);
+Geofence::Grade BSMHandler::get_geofence_grade() const {
+    return grade_;
+}
 
-            if (circle_ptr->contains(bsm)) {
-                return true;
-            }
+GeofenceCache::Ptr BSMHandler::get_geofence_cache() const {
+    return cache_ptr_;
+}
 
-        } else  if (entity_ptr->get_type() == "grid") {
-            grid_ptr = std::static_pointer_cast<const geo::Grid>(entity_ptr); 
+Geofence::Hits::Ptr BSMHandler::get_geofence_hits() const {
+    return hits_ptr_;
+}
 
-            if (grid_ptr->contains(bsm)) {
-                return true;
-            }
+PrivacyZones::Ptr BSMHandler::get_privacy_zones() const {
+    return zones_ptr_;
+}
 
-        }
+bool BSMHandler::observe_zones(const std::string& id) {
+    bool suppressed = zones_ptr_->observe(id, bsm_, bsm_.get_time());
+
+    uint64_t evictions = zones_ptr_->evictions();
+    if (evictions > 0 && evictions >= 2 * zone_evictions_warned_) {
+        zone_evictions_warned_ = evictions;
+        logger_->warn("BSMHandler::observe_zones(): " + std::to_string(evictions) + " privacy zones or vehicle ids dropped before they expired to make room for new vehicles, exposing their trip starts early; raise privacy.filter.zones.capacity above " + std::to_string(zones_ptr_->capacity()) + ".");
     }
-    return false;
+
+    return suppressed;
+}
+
+std::size_t BSMHandler::get_parse_arena_capacity() const {
+    return parse_arena_.Capacity();
 }
 
 bool BSMHandler::process( const std::string& message_json ) {
@@ -141,21 +332,48 @@ bool BSMHandler::process( const std::string& message_json ) {
     double latitude = 0.0;
     double longitude = 0.0;
     std::string id;
-    
-    // JMC: Attempt to fix memory leak; build and destroy JSON object each time to ensure memory is reclaimed.
-    rapidjson::Document document;
 
     finalized_ = false;
     result_ = ResultStatus::SUCCESS;
-    
+    grade_ = Geofence::Grade::OUTSIDE;
+
+    // pick up a newly published geofence; this BSM and all after it use the new one.
+    uint64_t generation = slot_ptr_->generation();
+    if (generation != generation_) {
+        generation_ = generation;
+        use_geofence( slot_ptr_->load() );
+    }
+
+    // a BSM the filters suppress is not parsed into a document.
+    speed_checked_ = false;
+    position_checked_ = false;
+    if (streaming_ && prefilter(message_json)) {
+        return false;
+    }
+
+    // JMC: Attempt to fix memory leak; build and destroy JSON object each time to ensure memory is reclaimed.
+    // The document's values and parser stacks are placed in the parse arena, which is emptied for every message; its
+    // strings are parsed in place in a copy of the message, so steady-state parsing does not touch the heap.
+    parse_arena_.Clear();
+    insitu_.assign(message_json.begin(), message_json.end());
+    insitu_.push_back('\0');
+    ArenaDocument document{ &parse_arena_, kParseStackBytes, &parse_arena_ };
+
     // create the DOM
     // check for errors
-    if (document.Parse(message_json.c_str()).HasParseError()) {
+    if (document.ParseInsitu(insitu_.data()).HasParseError()) {
         result_ = ResultStatus::PARSE;
 
         return false;
     }
 
+    // the redactions are located in message_json as they are made; see JsonSplice.
+    JsonSplice* splice = nullptr;
+    if (splicing_) {
+        splice_.reset(message_json, insitu_.data());
+        splice = &splice_;
+    }
+
     if (!document.IsObject()) {
         result_ = ResultStatus::PARSE;
 
@@ -184,13 +402,29 @@ bool BSMHandler::process( const std::string& message_json ) {
     }
 
     metadata["sanitized"] = true;
+    if (splice) splice->replace(metadata, "sanitized");
 
     if (metadata.HasMember("originIp")) {
         metadata["originIp"].SetString("", document.GetAllocator());
+        if (splice) splice->replace(metadata, "originIp");
     }
     
     if (metadata.HasMember("asn1")) {
         metadata["asn1"].SetString("", document.GetAllocator());
+        if (splice) splice->replace(metadata, "asn1");
+    }
+
+    // shapes with a limited validity, and privacy zones, are checked at the time the ODE received the BSM; the clock when
+    // it has none.
+    if (tiles_ptr_ || (geofence_ptr_ && geofence_ptr_->window_count() > 0) || is_active<kZoneFilterFlag>()) {
+        int64_t received_at = 0;
+
+        if (!metadata.HasMember("odeReceivedAt") || !metadata["odeReceivedAt"].IsString() ||
+                !time_utilities::parse_utc(metadata["odeReceivedAt"].GetString(), received_at)) {
+            received_at = static_cast<int64_t>(std::time(nullptr));
+        }
+
+        bsm_.set_time(received_at);
     }
 
     // get the payload type
@@ -268,7 +502,7 @@ bool BSMHandler::process( const std::string& message_json ) {
             speed = core_data["speed"].GetInt() * 0.02;
         }
 
-        if (is_active<kVelocityFilterFlag>() && vf_.suppress(speed)) {
+        if (is_active<kVelocityFilterFlag>() && !speed_checked_ && vf_.suppress(speed)) {
             result_ = ResultStatus::SPEED;
 
             return false;
@@ -301,7 +535,26 @@ bool BSMHandler::process( const std::string& message_json ) {
             bsm_.set_longitude(longitude);
         }
 
-        if (is_active<kGeofenceFilterFlag>() && !isWithinEntity(bsm_)) {
+        if (is_active<kGeofenceFilterFlag>() && graded_) {
+            if (!position_checked_) {
+                grade_ = geofenceGrade(bsm_);
+            }
+
+            if (grade_ == Geofence::Grade::OUTSIDE) {
+                result_ = ResultStatus::GEOPOSITION;
+
+                return false;
+            }
+
+            rapidjson::Value grade_value{ rapidjson::StringRef(grade_ == Geofence::Grade::CORE ? "core" : "buffer") };
+            if (metadata.HasMember("geofenceGrade")) {
+                metadata["geofenceGrade"] = grade_value;
+                if (splice) splice->replace(metadata, "geofenceGrade");
+            } else {
+                metadata.AddMember("geofenceGrade", grade_value, document.GetAllocator());
+                if (splice) splice->append(document, "metadata", "geofenceGrade");
+            }
+        } else if (is_active<kGeofenceFilterFlag>() && !position_checked_ && !isWithinEntity(bsm_)) {
             result_ = ResultStatus::GEOPOSITION;
 
             return false;
@@ -320,13 +573,20 @@ bool BSMHandler::process( const std::string& message_json ) {
         }
 
         id = core_data["id"].GetString();
-        
+
+        // the zones are keyed by the id the vehicle sent, before it is redacted.
+        if (is_active<kZoneFilterFlag>() && observe_zones(id)) {
+            result_ = ResultStatus::ZONE;
+
+            return false;
+        }
 
         if (is_active<kIdRedactFlag>()) {
             bsm_.set_original_id(id);
             idr_(id);
 
             core_data["id"].SetString(id.c_str(), static_cast<rapidjson::SizeType>(id.size()), document.GetAllocator());
+            if (splice) splice->replace(core_data, "id");
         }
 
         bsm_.set_id(id);
@@ -342,11 +602,13 @@ bool BSMHandler::process( const std::string& message_json ) {
             if (size.HasMember("length")) {
                 // length included; redact
                 size["length"] = 0; 
+                if (splice) splice->replace(size, "length");
             } 
 
             if (size.HasMember("width")) {
                 // width included; redact
                 size["width"] = 0; 
+                if (splice) splice->replace(size, "width");
             } 
         }
 
@@ -361,10 +623,12 @@ bool BSMHandler::process( const std::string& message_json ) {
     // JMC: Moving this here to finalize the json string instead of in get_json()
     // JMC: Go ahead and write out the BSM in redacted form using the document that we built in
     // JMC: this method.
-    rapidjson::StringBuffer buffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-    document.Accept(writer);
-    json_ = buffer.GetString();
+    if (!splice || !splice->write(json_)) {
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        document.Accept(writer);
+        json_ = buffer.GetString();
+    }
 
     // TODO: if we keep this model, this variable serves no purpose.
     finalized_ = true;
@@ -372,10 +636,171 @@ bool BSMHandler::process( const std::string& message_json ) {
     return result_ == ResultStatus::SUCCESS;
 }
 
-void BSMHandler::handleGeneralRedaction(rapidjson::Document& document) {
+bool BSMHandler::prefilter( const std::string& message_json ) {
+    // the filtered fields are in payload.data.value.BasicSafetyMessage.coreData; the time is in metadata.
+    static const char* const core_path[] = { "payload", "data", "value", "BasicSafetyMessage", "coreData" };
+    static const int core_depth = 6;
+
+    enum class Field { NONE, PATH, METADATA, RECEIVED_AT, SPEED, LAT, LONG };
+
+    struct Scanner : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, Scanner> {
+        BSMHandler& handler;
+        bool needs_time;                    // shapes with a limited validity need the time before the position is checked.
+        int depth = 0;                      // the depth of the current object or array; 1 is the message.
+        int core_level = 0;                 // the depth of the deepest object on the path to coreData.
+        bool in_metadata = false;
+        Field field = Field::NONE;          // the field the next value is for.
+        bool have_time = false;
+        bool have_lat = false;
+        bool have_long = false;
+        int lat = 0;
+        int lon = 0;
+        bool suppressed = false;
+
+        Scanner( BSMHandler& h, bool time ) : handler( h ), needs_time( time ) {}
+
+        bool done() const {
+            return (!handler.is_active<kVelocityFilterFlag>() || handler.speed_checked_) &&
+                (!handler.is_active<kGeofenceFilterFlag>() || handler.position_checked_);
+        }
+
+        bool StartObject() {
+            if (depth == core_level && (depth == 0 || field == Field::PATH)) {
+                ++core_level;
+            }
+
+            if (depth == 1) {
+                in_metadata = field == Field::METADATA;
+            }
+
+            ++depth;
+            field = Field::NONE;
+            return true;
+        }
+
+        bool EndObject( rapidjson::SizeType ) {
+            --depth;
+            core_level = std::min( core_level, depth );
+            in_metadata = in_metadata && depth > 1;
+            field = Field::NONE;
+            return true;
+        }
+
+        bool StartArray() {
+            ++depth;
+            field = Field::NONE;
+            return true;
+        }
+
+        bool EndArray( rapidjson::SizeType ) {
+            --depth;
+            field = Field::NONE;
+            return true;
+        }
+
+        static bool is( const char* str, rapidjson::SizeType length, const char* name ) {
+            return std::strlen( name ) == length && std::memcmp( str, name, length ) == 0;
+        }
+
+        bool Key( const char* str, rapidjson::SizeType length, bool ) {
+            field = Field::NONE;
+
+            if (depth == core_level && depth < core_depth && is( str, length, core_path[depth - 1] )) {
+                field = Field::PATH;
+            } else if (depth == 1 && is( str, length, "metadata" )) {
+                field = Field::METADATA;
+            } else if (depth == 2 && in_metadata && is( str, length, "odeReceivedAt" )) {
+                field = Field::RECEIVED_AT;
+            } else if (depth == core_depth && core_level == core_depth) {
+                if (is( str, length, "speed" )) field = Field::SPEED;
+                else if (is( str, length, "lat" )) field = Field::LAT;
+                else if (is( str, length, "long" )) field = Field::LONG;
+            }
+
+            return true;
+        }
+
+        bool String( const char* str, rapidjson::SizeType length, bool ) {
+            if (field == Field::RECEIVED_AT) {
+                int64_t received_at = 0;
+                if (time_utilities::parse_utc( std::string{ str, length }, received_at )) {
+                    handler.bsm_.set_time( received_at );
+                    have_time = true;
+                }
+            }
+
+            field = Field::NONE;
+            return true;
+        }
+
+        bool Uint( unsigned u ) {
+            return u <= static_cast<unsigned>( std::numeric_limits<int>::max() ) ? Int( static_cast<int>( u ) ) : Default();
+        }
+
+        bool Int( int i ) {
+            Field current = field;
+            field = Field::NONE;
+
+            if (current == Field::SPEED && handler.is_active<kVelocityFilterFlag>()) {
+                // as in process: J2735 units of 0.02 m/s; unavailable is 0.
+                double speed = i != J2735_SPEED_UNAVAILABLE ? i * 0.02 : 0.0;
+                if (handler.vf_.suppress( speed )) {
+                    handler.result_ = ResultStatus::SPEED;
+                    suppressed = true;
+                    return false;
+                }
+                handler.speed_checked_ = true;
+
+            } else if (current == Field::LAT || current == Field::LONG) {
+                (current == Field::LAT ? lat : lon) = i;
+                (current == Field::LAT ? have_lat : have_long) = true;
+
+                // a position that is unavailable, or that needs a time not seen yet, is left to the document.
+                if (!have_lat || !have_long || !handler.is_active<kGeofenceFilterFlag>() || lat == J2735_LATITUDE_UNAVAILABLE ||
+                        lon == J2735_LONGITUDE_UNAVAILABLE || (needs_time && !have_time)) {
+                    return !done();
+                }
+
+                handler.bsm_.set_latitude( lat * 1e-7 );
+                handler.bsm_.set_longitude( lon * 1e-7 );
+
+                bool inside;
+                if (handler.graded_) {
+                    handler.grade_ = handler.geofenceGrade( handler.bsm_ );
+                    inside = handler.grade_ != Geofence::Grade::OUTSIDE;
+                } else {
+                    inside = handler.isWithinEntity( handler.bsm_ );
+                }
+
+                if (!inside) {
+                    handler.result_ = ResultStatus::GEOPOSITION;
+                    suppressed = true;
+                    return false;
+                }
+                handler.position_checked_ = true;
+            }
+
+            // nothing more to learn from the rest of the string.
+            return !done();
+        }
+    };
+
+    Scanner scanner{ *this, tiles_ptr_ || (geofence_ptr_ && geofence_ptr_->window_count() > 0) };
+    if (scanner.done()) {
+        return false;
+    }
+
+    parse_arena_.Clear();
+    rapidjson::GenericReader<rapidjson::UTF8<>, rapidjson::UTF8<>, rapidjson::MemoryPoolAllocator<>> reader{ &parse_arena_, kParseStackBytes };
+    rapidjson::StringStream stream{ message_json.c_str() };
+    reader.Parse( stream, scanner );
+    return scanner.suppressed;
+}
+
+void BSMHandler::handleGeneralRedaction(rapidjson::Value& document) {
     if (is_active<kGeneralRedactFlag>()) {
         for (std::string memberPath : rpm.getFields()) {
-            bool memberRedacted = rapidjsonRedactor.redactMemberByPath(document, memberPath.c_str());
+            bool memberRedacted = rapidjsonRedactor.redactMemberByPath(document, memberPath.c_str(), splicing_ ? &splice_ : nullptr);
             if (!memberRedacted) {
                 logger_->info("Member not found while handling general redaction! Path: '" + memberPath + "'");
             }
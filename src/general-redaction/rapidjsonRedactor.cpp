@@ -14,7 +14,7 @@
  * - brakeBoost     (optional string, set to "unavailable")
  * - auxBrakes      (optional string, set to "unavailable")
  */
-bool RapidjsonRedactor::redactMemberByPath(rapidjson::Value &value, std::string path) {
+bool RapidjsonRedactor::redactMemberByPath(rapidjson::Value &value, std::string path, JsonSplice* splice) {
     std::string nextPathElement = getTopLevelFromPath(path);
     std::string target = getBottomLevelFromPath(path);
 
@@ -33,13 +33,14 @@ bool RapidjsonRedactor::redactMemberByPath(rapidjson::Value &value, std::string
                         nextPathElement == "doNotUse4" || 
                         nextPathElement == "events" || 
                         nextPathElement == "lights") {
+                        if (splice) splice->remove(value, nextPathElement.c_str());
                         value.RemoveMember(nextPathElement.c_str());
                         return true;
                     }
                 }
 
                 removeTopLevelFromPath(path);
-                return redactMemberByPath(nextValue, path);
+                return redactMemberByPath(nextValue, path, splice);
             }
             else {
                 // if the next path element is the target, remove it
@@ -49,44 +50,45 @@ bool RapidjsonRedactor::redactMemberByPath(rapidjson::Value &value, std::string
                     if (type == "Number" && target == "angle") {
                         // Set to 127 for J2735 angle which is indicative of the value being unavailable
                         value["angle"] = 127;
-                        return true;
+                        return replaced(value, "angle", splice);
                     }
                     else if (type == "String" && target == "transmission") {
                         // Set to "unavailable" for J2735 transmission which is defined as lowercase
                         value["transmission"] = "unavailable";
-                        return true;
+                        return replaced(value, "transmission", splice);
                     }
                     else if (type == "String" && target == "wheelBrakes") {
                         // Hex value representation for unavailable for J2735 wheelBrakes
                         value["wheelBrakes"] = "80";
-                        return true;
+                        return replaced(value, "wheelBrakes", splice);
                     }
                     else if (type == "String" && target == "traction") {
                         // Set to "unavailable" for J2735 traction which is defined as lowercase
                         value["traction"] = "unavailable";
-                        return true;
+                        return replaced(value, "traction", splice);
                     }
                     else if (type == "String" && target == "abs") {
                         // Set to "unavailable" for J2735 abs which is defined as lowercase
                         value["abs"] = "unavailable";
-                        return true;
+                        return replaced(value, "abs", splice);
                     }
                     else if (type == "String" && target == "scs") {
                         // Set to "unavailable" for J2735 scs which is defined as lowercase
                         value["scs"] = "unavailable";
-                        return true;
+                        return replaced(value, "scs", splice);
                     }
                     else if (type == "String" && target == "brakeBoost") {
                         // Set to "unavailable" for J2735 brakeBoost which is defined as lowercase
                         value["brakeBoost"] = "unavailable";
-                        return true;
+                        return replaced(value, "brakeBoost", splice);
                     }
                     else if (type == "String" && target == "auxBrakes") {
                         // Set to "unavailable" for J2735 auxBrakes which is defined as lowercase
                         value["auxBrakes"] = "unavailable";
-                        return true;
+                        return replaced(value, "auxBrakes", splice);
                     }
 
+                    if (splice) splice->remove(value, nextPathElement.c_str());
                     value.RemoveMember(nextPathElement.c_str());
                     return true;
                 }
@@ -102,7 +104,7 @@ bool RapidjsonRedactor::redactMemberByPath(rapidjson::Value &value, std::string
         for (auto &m : value.GetArray()) {
             std::string type = kTypeNames[m.GetType()];
             if (type == "Object" || type == "Array") {
-                if (redactMemberByPath(m, path)) {
+                if (redactMemberByPath(m, path, splice)) {
                     result = true;
                 }
             }
@@ -210,6 +212,13 @@ std::string RapidjsonRedactor::stringifyValue(rapidjson::Value &value) {
     return buffer.GetString();
 }
 
+bool RapidjsonRedactor::replaced(rapidjson::Value &value, const char* member, JsonSplice* splice) {
+    if (splice) {
+        splice->replace(value, member);
+    }
+    return true;
+}
+
 std::string RapidjsonRedactor::getTopLevelFromPath(std::string &path) {
     int firstDot = path.find(".");
     if (firstDot != std::string::npos) {
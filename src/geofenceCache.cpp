@@ -0,0 +1,128 @@
+#include "geofenceCache.hpp"
+
+#include <cmath>
+
+namespace {
+
+constexpr int64_t kIndexBias = int64_t{ 1 } << 30;                  ///< Makes cell row and column indices positive.
+constexpr uint64_t kIndexMask = (uint64_t{ 1 } << 31) - 1;          ///< A cell row or column index after the bias.
+
+}
+
+constexpr double GeofenceCache::kMinCellSize;
+constexpr double GeofenceCache::kMetersPerDegree;
+constexpr std::size_t GeofenceCache::kDefaultCapacity;
+constexpr uint64_t GeofenceCache::kEmpty;
+constexpr uint64_t GeofenceCache::kStateMask;
+
+GeofenceCache::GeofenceCache( double cell_size, std::size_t capacity ) :
+    cell_size_{ cell_size < kMinCellSize ? kMinCellSize : cell_size },
+    step_{ 0.0 },
+    capacity_{ 2 },
+    shift_{ 63 },
+    entries_{},
+    hits_{ 0 },
+    misses_{ 0 },
+    ambiguous_{ 0 }
+{
+    step_ = cell_size_ / kMetersPerDegree;
+
+    while (capacity_ < capacity) {
+        capacity_ <<= 1;
+        --shift_;
+    }
+
+    entries_.reset( new std::atomic<uint64_t>[capacity_] );
+    clear();
+}
+
+bool GeofenceCache::contains( const Geofence& geofence, const geo::Point& pt ) {
+    return lookup( geofence, pt, nullptr, false, nullptr ) != Geofence::Grade::OUTSIDE;
+}
+
+bool GeofenceCache::contains( const Geofence& geofence, const geo::Point& pt, int64_t time, Geofence::Hits* hits ) {
+    return lookup( geofence, pt, &time, false, hits ) != Geofence::Grade::OUTSIDE;
+}
+
+Geofence::Grade GeofenceCache::grade( const Geofence& geofence, const geo::Point& pt ) {
+    return lookup( geofence, pt, nullptr, true, nullptr );
+}
+
+Geofence::Grade GeofenceCache::grade( const Geofence& geofence, const geo::Point& pt, int64_t time, Geofence::Hits* hits ) {
+    return lookup( geofence, pt, &time, true, hits );
+}
+
+Geofence::Grade GeofenceCache::lookup( const Geofence& geofence, const geo::Point& pt, const int64_t* time, bool graded, Geofence::Hits* hits ) {
+    auto search = [&geofence, &pt, time, graded, hits]() {
+        if (graded) return time ? geofence.grade( pt, *time, hits ) : geofence.grade( pt );
+        bool inside = time ? geofence.contains( pt, *time, hits ) : geofence.contains( pt );
+        return inside ? Geofence::Grade::CORE : Geofence::Grade::OUTSIDE;
+    };
+
+    if (!(std::fabs( pt.lat ) <= 90.0 && std::fabs( pt.lon ) <= 180.0)) {
+        // not a position the key can hold (including NaN).
+        return search();
+    }
+
+    int64_t row = static_cast<int64_t>( std::floor( pt.lat / step_ ) );
+    int64_t column = static_cast<int64_t>( std::floor( pt.lon / step_ ) );
+    uint64_t key = ((static_cast<uint64_t>( row + kIndexBias ) & kIndexMask) << 31 | (static_cast<uint64_t>( column + kIndexBias ) & kIndexMask)) << 2;
+
+    // Fibonacci hashing spreads neighboring cells over the table.
+    std::atomic<uint64_t>& entry = entries_[(key * 0x9E3779B97F4A7C15ULL) >> shift_ & (capacity_ - 1)];
+    uint64_t value = entry.load( std::memory_order_relaxed );
+
+    if ((value & ~kStateMask) == key && (value & kStateMask) != kEmpty) {
+        Geofence::Cover cover = static_cast<Geofence::Cover>( (value & kStateMask) - 1 );
+
+        if (cover == Geofence::Cover::OUTSIDE || (cover == Geofence::Cover::INSIDE && !graded)) {
+            hits_.fetch_add( 1, std::memory_order_relaxed );
+            return cover == Geofence::Cover::INSIDE ? Geofence::Grade::CORE : Geofence::Grade::OUTSIDE;
+        }
+
+        ambiguous_.fetch_add( 1, std::memory_order_relaxed );
+        return search();
+    }
+
+    misses_.fetch_add( 1, std::memory_order_relaxed );
+    Geofence::Grade grade = search();
+    bool inside = grade != Geofence::Grade::OUTSIDE;
+
+    geo::Point sw{ static_cast<double>( row ) * step_, static_cast<double>( column ) * step_ };
+    geo::Point ne{ static_cast<double>( row + 1 ) * step_, static_cast<double>( column + 1 ) * step_ };
+    Geofence::Cover cover = geofence.classify( sw, ne );
+
+    if (cover != Geofence::Cover::MIXED && (cover == Geofence::Cover::INSIDE) != inside) {
+        // the position is on the cell's edge, where rounding can put it on either side; do not trust the cell.
+        cover = Geofence::Cover::MIXED;
+    }
+
+    entry.store( key | (static_cast<uint64_t>( cover ) + 1), std::memory_order_relaxed );
+    return grade;
+}
+
+void GeofenceCache::clear() {
+    for (std::size_t i = 0; i < capacity_; ++i) {
+        entries_[i].store( kEmpty, std::memory_order_relaxed );
+    }
+}
+
+double GeofenceCache::cell_size() const {
+    return cell_size_;
+}
+
+std::size_t GeofenceCache::capacity() const {
+    return capacity_;
+}
+
+uint64_t GeofenceCache::hits() const {
+    return hits_.load( std::memory_order_relaxed );
+}
+
+uint64_t GeofenceCache::misses() const {
+    return misses_.load( std::memory_order_relaxed );
+}
+
+uint64_t GeofenceCache::ambiguous() const {
+    return ambiguous_.load( std::memory_order_relaxed );
+}
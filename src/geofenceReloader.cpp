@@ -0,0 +1,327 @@
+#include "geofenceReloader.hpp"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace {
+
+/**
+ * @brief Return the modification time of a stat'ed file in nanoseconds.
+ */
+int64_t mtime_ns( const struct stat& info ) {
+#ifdef __APPLE__
+    return static_cast<int64_t>( info.st_mtimespec.tv_sec ) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    return static_cast<int64_t>( info.st_mtim.tv_sec ) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+}
+
+}
+
+std::atomic<bool> GeofenceReloader::signalled_{ false };
+
+void GeofenceReloader::sighup( int ) {
+    signalled_.store( true );
+}
+
+GeofenceReloader::GeofenceReloader( GeofenceSlot::Ptr slot, Builder builder, const std::vector<std::string>& watch_files,
+        std::chrono::milliseconds interval, std::shared_ptr<PpmLogger> logger ) :
+    slot_{ slot },
+    builder_{ builder },
+    updater_{},
+    reorderer_{},
+    reorder_period_{ 0 },
+    next_reorder_{},
+    interval_{ interval },
+    logger_{ logger },
+    thread_{},
+    mutex_{},
+    wakeup_{},
+    running_{ false },
+    requested_{ false },
+    reload_count_{ 0 },
+    update_count_{ 0 },
+    reorder_count_{ 0 },
+    watch_files_{},
+    delta_file_{ "", false, Stamp{ 0, 0, 0 }, false },
+    delta_tried_{ false },
+    delta_stamp_{ 0, 0, 0 },
+    base_{},
+    retired_{}
+{
+    // take the initial stamps so the files the current index was built from do not trigger a rebuild.
+    for (auto& watch_file : watch_files) {
+        watch_files_.push_back( WatchedFile{ watch_file, false, Stamp{ 0, 0, 0 }, false } );
+        settled( watch_files_.back() );
+    }
+}
+
+GeofenceReloader::~GeofenceReloader() {
+    stop();
+}
+
+void GeofenceReloader::watch_deltas( const std::string& delta_file, Updater updater ) {
+    updater_ = updater;
+    delta_file_ = WatchedFile{ delta_file, false, Stamp{ 0, 0, 0 }, false };
+    delta_tried_ = false;
+
+    // a delta file that exists now is applied by #load, or to the published index when the thread starts.
+    settled( delta_file_ );
+}
+
+void GeofenceReloader::load() {
+    publish( build() );
+}
+
+void GeofenceReloader::reorder_every( std::chrono::milliseconds period, Updater reorderer ) {
+    reorder_period_ = period;
+    reorderer_ = reorderer;
+    next_reorder_ = std::chrono::steady_clock::now() + period;
+}
+
+void GeofenceReloader::start() {
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    if (running_) return;
+
+    running_ = true;
+    thread_ = std::thread{ &GeofenceReloader::run, this };
+    std::string watching;
+    for (auto& watch_file : watch_files_) {
+        watching += (watching.empty() ? "; watching " : ", ") + watch_file.path;
+    }
+    logger_->info("Geofence reloader started" + watching + ".");
+    if (!delta_file_.path.empty()) {
+        logger_->info("Geofence reloader applying deltas from " + delta_file_.path + ".");
+    }
+    if (reorderer_) {
+        logger_->info("Geofence reloader reordering the index every " + std::to_string( reorder_period_.count() ) + " ms.");
+    }
+}
+
+void GeofenceReloader::stop() {
+    {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        running_ = false;
+    }
+
+    wakeup_.notify_all();
+
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void GeofenceReloader::request_reload() {
+    requested_.store( true );
+}
+
+uint64_t GeofenceReloader::reload_count() const {
+    return reload_count_.load();
+}
+
+uint64_t GeofenceReloader::update_count() const {
+    return update_count_.load();
+}
+
+uint64_t GeofenceReloader::reorder_count() const {
+    return reorder_count_.load();
+}
+
+void GeofenceReloader::run() {
+    std::unique_lock<std::mutex> lock{ mutex_ };
+
+    while (running_) {
+        wakeup_.wait_for( lock, interval_ );
+        if (!running_) break;
+
+        // never hold the lock while building; stop() must be able to get in.
+        lock.unlock();
+
+        bool signalled = signalled_.exchange( false );
+        bool requested = requested_.exchange( false );
+        // check every file so each one's stamp stays current.
+        bool changed = false;
+        for (auto& watch_file : watch_files_) {
+            changed = settled( watch_file ) || changed;
+        }
+
+        if (signalled || requested || changed) {
+            logger_->info(std::string{"Geofence rebuild triggered by "} + (signalled ? "SIGHUP." : (requested ? "request." : "map file change.")));
+            reload();
+        }
+
+        // apply a version of the delta file that has stopped changing, unless it was already applied.
+        settled( delta_file_ );
+        if (delta_file_.have_stamp && !delta_file_.pending_change && !(delta_tried_ && delta_file_.stamp == delta_stamp_)) {
+            update();
+        }
+
+        if (reorderer_ && std::chrono::steady_clock::now() >= next_reorder_) {
+            reorder();
+            next_reorder_ = std::chrono::steady_clock::now() + reorder_period_;
+        }
+
+        release_retired();
+        lock.lock();
+    }
+}
+
+bool GeofenceReloader::Stamp::operator==( const Stamp& other ) const {
+    return mtime == other.mtime && size == other.size && inode == other.inode;
+}
+
+bool GeofenceReloader::stamp_of( const std::string& path, Stamp& stamp ) {
+    struct stat info;
+
+    if (path.empty() || stat( path.c_str(), &info ) != 0) {
+        return false;
+    }
+
+    // a rewrite of the same size within the same second differs in the nanoseconds, and a replacement in the inode.
+    stamp = Stamp{ mtime_ns( info ), static_cast<int64_t>( info.st_size ), static_cast<uint64_t>( info.st_ino ) };
+    return true;
+}
+
+bool GeofenceReloader::settled( WatchedFile& file ) {
+    Stamp stamp;
+
+    if (!stamp_of( file.path, stamp )) {
+        // not watching, or the file is missing (possibly being replaced); try again next time.
+        return false;
+    }
+
+    if (!file.have_stamp) {
+        file.have_stamp = true;
+        file.stamp = stamp;
+        return false;
+    }
+
+    if (!(stamp == file.stamp)) {
+        // the file is changing; wait until it is unchanged for one interval so a partially written file is not used.
+        file.stamp = stamp;
+        file.pending_change = true;
+        return false;
+    }
+
+    if (file.pending_change) {
+        file.pending_change = false;
+        return true;
+    }
+
+    return false;
+}
+
+Geofence::CPtr GeofenceReloader::build() {
+    Geofence::CPtr base = builder_();
+    Geofence::CPtr geofence_ptr = base;
+    Stamp stamp;
+
+    // the map does not have the delta file's changes; a rebuild without them would drop changes already published.
+    if (updater_ && base && stamp_of( delta_file_.path, stamp )) {
+        delta_tried_ = true;
+        delta_stamp_ = stamp;
+        geofence_ptr = updater_( *base );
+    }
+
+    // kept only when there is a delta file to apply to it.
+    if (updater_) base_ = base;
+    return geofence_ptr;
+}
+
+void GeofenceReloader::reload() {
+    auto start = std::chrono::steady_clock::now();
+    Geofence::CPtr geofence_ptr;
+
+    try {
+        geofence_ptr = build();
+    } catch (std::exception& e) {
+        logger_->error("Geofence rebuild failed; the current geofence remains in use: " + std::string{ e.what() });
+        return;
+    }
+
+    publish( geofence_ptr );
+    reload_count_.fetch_add( 1 );
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now() - start );
+    logger_->info("Geofence rebuilt and published as generation " + std::to_string( slot_->generation() ) + " in " + std::to_string( elapsed.count() ) + " ms.");
+}
+
+void GeofenceReloader::update() {
+    auto start = std::chrono::steady_clock::now();
+    Geofence::CPtr geofence_ptr;
+
+    // the version read is not tried again whether or not it applies; a later version is.
+    Stamp stamp;
+    if (!stamp_of( delta_file_.path, stamp )) {
+        return;
+    }
+
+    delta_tried_ = true;
+    delta_stamp_ = stamp;
+
+    try {
+        // the file holds every change, so it is applied to the map alone; applied to the published index, which has
+        // the previous version, a change dropped from the file would stay until the next rebuild.
+        if (!base_) base_ = builder_();
+        if (!base_) {
+            logger_->warn("Geofence delta ignored; there is no geofence to update.");
+            return;
+        }
+
+        geofence_ptr = updater_( *base_ );
+    } catch (std::exception& e) {
+        logger_->error("Geofence delta failed; the current geofence remains in use: " + std::string{ e.what() });
+        return;
+    }
+
+    publish( geofence_ptr );
+    update_count_.fetch_add( 1 );
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now() - start );
+    logger_->info("Geofence delta applied and published as generation " + std::to_string( slot_->generation() ) + " in " + std::to_string( elapsed.count() ) + " ms.");
+}
+
+void GeofenceReloader::reorder() {
+    auto start = std::chrono::steady_clock::now();
+    Geofence::CPtr current = slot_->load();
+    Geofence::CPtr geofence_ptr;
+
+    if (!current) {
+        return;
+    }
+
+    try {
+        geofence_ptr = reorderer_( *current );
+    } catch (std::exception& e) {
+        logger_->error("Geofence reorder failed; the current geofence remains in use: " + std::string{ e.what() });
+        return;
+    }
+
+    // the traffic has not changed the order; there is nothing to publish.
+    if (!geofence_ptr) {
+        return;
+    }
+
+    publish( geofence_ptr );
+    reorder_count_.fetch_add( 1 );
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now() - start );
+    logger_->info("Geofence reordered and published as generation " + std::to_string( slot_->generation() ) + " in " + std::to_string( elapsed.count() ) + " ms.");
+}
+
+void GeofenceReloader::publish( Geofence::CPtr geofence_ptr ) {
+    // hold on to the old index so its (potentially large) teardown happens on this thread.
+    retired_.push_back( slot_->load() );
+    slot_->store( geofence_ptr );
+}
+
+void GeofenceReloader::release_retired() {
+    for (auto it = retired_.begin(); it != retired_.end(); ) {
+        if (!(*it) || it->use_count() == 1) {
+            // only this reloader refers to it; no handler can pick it up again.
+            it = retired_.erase( it );
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,208 @@
+#include "geofenceShare.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace {
+
+const char kShareMagic[8] = { 'C', 'V', 'D', 'P', 'S', 'H', 'R', '1' };
+
+/**
+ * @brief Add bytes to an FNV-1a hash.
+ */
+uint64_t hash_bytes( uint64_t hash, const void* bytes, std::size_t size )
+{
+    const unsigned char* p = static_cast<const unsigned char*>( bytes );
+
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Holds an exclusive lock on a file until it goes out of scope.
+ */
+class FileLock {
+    public:
+        explicit FileLock( const std::string& path ) :
+            fd_{ open( path.c_str(), O_RDWR | O_CREAT, 0644 ) }
+        {
+            if (fd_ >= 0 && flock( fd_, LOCK_EX ) != 0) {
+                close( fd_ );
+                fd_ = -1;
+            }
+        }
+
+        ~FileLock() {
+            // closing the descriptor releases the lock.
+            if (fd_ >= 0) close( fd_ );
+        }
+
+        FileLock( const FileLock& ) = delete;
+        FileLock& operator=( const FileLock& ) = delete;
+
+        bool locked() const { return fd_ >= 0; }
+
+    private:
+        int fd_;                                                    ///< The lock file; -1 when it is not locked.
+};
+
+/**
+ * @brief Write all of a buffer to a file descriptor.
+ *
+ * @return true if every byte was written.
+ */
+bool write_all( int fd, const char* bytes, std::size_t size )
+{
+    while (size > 0) {
+        ssize_t written = ::write( fd, bytes, size );
+
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        bytes += written;
+        size -= static_cast<std::size_t>( written );
+    }
+
+    return true;
+}
+
+}
+
+uint64_t GeofenceShare::fingerprint( const std::vector<std::string>& files, const std::string& settings ) {
+    uint64_t hash = hash_bytes( 14695981039346656037ULL, settings.data(), settings.size() );
+
+    for (auto& file : files) {
+        struct stat info;
+        hash = hash_bytes( hash, file.c_str(), file.size() + 1 );
+
+        if (stat( file.c_str(), &info ) == 0) {
+            int64_t mtime = static_cast<int64_t>( info.st_mtime );
+            int64_t size = static_cast<int64_t>( info.st_size );
+            hash = hash_bytes( hash, &mtime, sizeof(mtime) );
+            hash = hash_bytes( hash, &size, sizeof(size) );
+        }
+    }
+
+    return hash;
+}
+
+GeofenceShare::GeofenceShare( const std::string& path, std::shared_ptr<PpmLogger> logger ) :
+    path_{ path },
+    logger_{ logger },
+    attached_{ false }
+{}
+
+Geofence::CPtr GeofenceShare::acquire( uint64_t stamp, Builder builder ) {
+    attached_ = false;
+
+    // only one process looks for, builds, and writes the file at a time; the others wait and then map what it wrote.
+    FileLock lock{ path_ + ".lock" };
+
+    if (!lock.locked()) {
+        logger_->warn("Cannot lock " + path_ + ".lock: " + std::strerror( errno ) + "; the geofence index is not shared.");
+        return builder();
+    }
+
+    Geofence::CPtr geofence_ptr = map( stamp );
+
+    if (geofence_ptr) {
+        attached_ = true;
+        logger_->info("Geofence index mapped from " + path_ + ": " + std::to_string(geofence_ptr->memory_usage()) + " shared bytes.");
+        return geofence_ptr;
+    }
+
+    Geofence::CPtr built_ptr = builder();
+
+    if (!write( stamp, *built_ptr )) {
+        logger_->warn("Cannot write " + path_ + ": " + std::strerror( errno ) + "; the geofence index is not shared.");
+        return built_ptr;
+    }
+
+    geofence_ptr = map( stamp );
+
+    if (!geofence_ptr) {
+        logger_->warn("Cannot map " + path_ + "; the geofence index is not shared.");
+        return built_ptr;
+    }
+
+    // the built copy, and the map data it was built from, are released when built_ptr goes out of scope.
+    logger_->info("Geofence index written to " + path_ + " and mapped: " + std::to_string(geofence_ptr->memory_usage()) + " shared bytes.");
+    return geofence_ptr;
+}
+
+bool GeofenceShare::attached() const {
+    return attached_;
+}
+
+Geofence::CPtr GeofenceShare::map( uint64_t stamp ) const {
+    int fd = open( path_.c_str(), O_RDONLY );
+    if (fd < 0) return nullptr;
+
+    struct stat info;
+    if (fstat( fd, &info ) != 0 || static_cast<std::size_t>( info.st_size ) < sizeof(Header)) {
+        close( fd );
+        return nullptr;
+    }
+
+    std::size_t size = static_cast<std::size_t>( info.st_size );
+    void* base = mmap( nullptr, size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+
+    if (base == MAP_FAILED) return nullptr;
+
+    std::shared_ptr<const char> mapping{ static_cast<const char*>( base ), [size]( const char* p ) { munmap( const_cast<char*>( p ), size ); } };
+
+    Header header;
+    std::memcpy( &header, mapping.get(), sizeof(header) );
+
+    if (std::memcmp( header.magic, kShareMagic, sizeof(kShareMagic) ) != 0 || header.stamp != stamp || sizeof(Header) + header.image_size != size) {
+        // a file from an older map or build; it is replaced.
+        return nullptr;
+    }
+
+    try {
+        // the image shares ownership of the mapping, so the mapping lasts as long as the index.
+        return std::make_shared<const Geofence>( std::shared_ptr<const char>{ mapping, mapping.get() + sizeof(Header) }, header.image_size );
+    } catch (std::invalid_argument& e) {
+        logger_->warn("Geofence index file " + path_ + " is not usable: " + e.what());
+        return nullptr;
+    }
+}
+
+bool GeofenceShare::write( uint64_t stamp, const Geofence& geofence ) const {
+    Header header;
+    std::memset( &header, 0, sizeof(header) );
+    std::memcpy( header.magic, kShareMagic, sizeof(kShareMagic) );
+    header.stamp = stamp;
+    header.image_size = geofence.memory_usage();
+
+    // write under another name so no process ever maps a partial file.
+    std::string temp_path = path_ + ".tmp";
+    int fd = open( temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if (fd < 0) return false;
+
+    bool written = write_all( fd, reinterpret_cast<const char*>( &header ), sizeof(header) ) &&
+        write_all( fd, geofence.image(), geofence.memory_usage() );
+
+    if (close( fd ) != 0) written = false;
+
+    if (!written || std::rename( temp_path.c_str(), path_.c_str() ) != 0) {
+        std::remove( temp_path.c_str() );
+        return false;
+    }
+
+    return true;
+}
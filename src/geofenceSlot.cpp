@@ -0,0 +1,21 @@
+#include "geofenceSlot.hpp"
+
+GeofenceSlot::GeofenceSlot( Geofence::CPtr geofence_ptr ) :
+    geofence_ptr_{ geofence_ptr },
+    generation_{ 0 }
+{}
+
+Geofence::CPtr GeofenceSlot::load() const {
+    return std::atomic_load( &geofence_ptr_ );
+}
+
+void GeofenceSlot::store( Geofence::CPtr geofence_ptr ) {
+    std::atomic_store( &geofence_ptr_, geofence_ptr );
+    // The pointer is stored before the generation changes so a reader that sees the new generation loads at least
+    // this index.
+    generation_.fetch_add( 1, std::memory_order_release );
+}
+
+uint64_t GeofenceSlot::generation() const {
+    return generation_.load( std::memory_order_acquire );
+}
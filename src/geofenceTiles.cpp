@@ -0,0 +1,388 @@
+#include "geofenceTiles.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char kTileMagic[8] = { 'C', 'V', 'D', 'P', 'T', 'I', 'L', '1' };
+
+// tile images are aligned like the arrays inside them.
+constexpr uint64_t kTileAlignment = 64;
+
+const double kMetersPerDegree = 6378137.0 * M_PI / 180.0;
+
+struct Header {
+    char magic[8];
+    uint64_t stamp;
+    double tile_degrees;
+    double extension;
+    uint32_t tile_count;
+    uint32_t edge_model;
+    uint64_t directory_offset;
+    uint64_t reserved[2];
+};
+
+static_assert( sizeof(Header) == 64, "the tile file header is 64 bytes." );
+
+/**
+ * @brief Compute the latitude and longitude box of a shape; the buffers around edges are not included.
+ *
+ * @return false for a kind of shape without a box.
+ */
+bool shape_box( const geo::Entity& entity, geo::Point& sw, geo::Point& ne )
+{
+    std::vector<geo::Point> points;
+
+    if (auto circle = dynamic_cast<const geo::Circle*>( &entity )) {
+        points = { circle->north, circle->south, circle->east, circle->west };
+    } else if (auto edge = dynamic_cast<const geo::Edge*>( &entity )) {
+        points = { *edge->v1, *edge->v2 };
+    } else if (auto graph_edge = dynamic_cast<const geo::GraphEdge*>( &entity )) {
+        const geo::RoadGraph& graph = graph_edge->get_graph();
+        uint32_t e = graph_edge->get_index();
+        points = { graph.location( graph.edge_v1( e ) ), graph.location( graph.edge_v2( e ) ) };
+    } else if (auto grid = dynamic_cast<const geo::Grid*>( &entity )) {
+        points = { grid->sw, grid->ne };
+    } else if (auto polyline = dynamic_cast<const geo::Polyline*>( &entity )) {
+        points.assign( polyline->get_vertices().begin(), polyline->get_vertices().end() );
+    } else {
+        return false;
+    }
+
+    // the box starts at the first point; Point declares a copy constructor but no assignment.
+    sw.lat = ne.lat = points.front().lat;
+    sw.lon = ne.lon = points.front().lon;
+
+    for (auto& pt : points) {
+        sw.lat = std::min( sw.lat, pt.lat );
+        sw.lon = std::min( sw.lon, pt.lon );
+        ne.lat = std::max( ne.lat, pt.lat );
+        ne.lon = std::max( ne.lon, pt.lon );
+    }
+
+    return true;
+}
+
+/**
+ * @brief The degrees of longitude spanning a distance at the latitude farthest from the equator in a range.
+ */
+double longitude_margin( double meters, double lat1, double lat2 )
+{
+    double farthest = std::min( 89.0, std::max( std::fabs( lat1 ), std::fabs( lat2 ) ) );
+    return meters / (kMetersPerDegree * std::cos( farthest * M_PI / 180.0 ));
+}
+
+}
+
+constexpr double GeofenceTiles::kDefaultTileDegrees;
+
+uint64_t GeofenceTiles::tile_key( int64_t row, int64_t col )
+{
+    // offset so negative rows and columns order before positive ones.
+    return (static_cast<uint64_t>( row + 0x80000000LL ) << 32) | static_cast<uint32_t>( col + 0x80000000LL );
+}
+
+std::size_t GeofenceTiles::write( const std::string& path, uint64_t stamp, const std::vector<geo::Entity::CPtr>& shapes,
+        double tile_degrees, double extension, Geofence::EdgeModel edges )
+{
+    if (!(tile_degrees > 0.0)) {
+        throw std::invalid_argument{ "geofence tile size must be positive." };
+    }
+
+    // a shape's buffer reaches at most the widest way plus the extension past its box; a tile takes every shape that
+    // comes that close to it.
+    double margin = extension + *std::max_element( osm::highway_width_map.begin(), osm::highway_width_map.end() );
+    double lat_margin = margin / kMetersPerDegree;
+
+    std::map<uint64_t, std::vector<uint32_t>> tiles;
+
+    for (uint32_t s = 0; s < shapes.size(); ++s) {
+        geo::Point sw, ne;
+        if (!shape_box( *shapes[s], sw, ne )) continue;
+
+        double lon_margin = longitude_margin( margin, sw.lat - lat_margin, ne.lat + lat_margin );
+        int64_t row1 = static_cast<int64_t>( std::floor( (sw.lat - lat_margin) / tile_degrees ) );
+        int64_t row2 = static_cast<int64_t>( std::floor( (ne.lat + lat_margin) / tile_degrees ) );
+        int64_t col1 = static_cast<int64_t>( std::floor( (sw.lon - lon_margin) / tile_degrees ) );
+        int64_t col2 = static_cast<int64_t>( std::floor( (ne.lon + lon_margin) / tile_degrees ) );
+
+        for (int64_t row = row1; row <= row2; ++row) {
+            for (int64_t col = col1; col <= col2; ++col) {
+                tiles[ tile_key( row, col ) ].push_back( s );
+            }
+        }
+    }
+
+    Header header;
+    std::memset( &header, 0, sizeof(header) );
+    std::memcpy( header.magic, kTileMagic, sizeof(kTileMagic) );
+    header.stamp = stamp;
+    header.tile_degrees = tile_degrees;
+    header.extension = extension;
+    header.tile_count = static_cast<uint32_t>( tiles.size() );
+    header.edge_model = static_cast<uint32_t>( edges );
+    header.directory_offset = sizeof(Header);
+
+    // write under another name so no process ever opens a partial file.
+    std::string temp_path = path + ".tmp";
+    std::ofstream file{ temp_path, std::ios::binary | std::ios::trunc };
+
+    if (!file) {
+        throw std::runtime_error{ "cannot write geofence tile file " + temp_path + "." };
+    }
+
+    std::vector<Entry> directory;
+    directory.reserve( tiles.size() );
+
+    uint64_t offset = sizeof(Header) + tiles.size() * sizeof(Entry);
+    offset = (offset + kTileAlignment - 1) & ~(kTileAlignment - 1);
+    file.seekp( static_cast<std::streamoff>( offset ) );
+
+    for (auto& tile : tiles) {
+        int64_t row = static_cast<int64_t>( tile.first >> 32 ) - 0x80000000LL;
+        int64_t col = static_cast<int64_t>( tile.first & 0xFFFFFFFF ) - 0x80000000LL;
+
+        // the tree covers the tile and the margin around it, so the shapes that only come close are inserted.
+        double south = row * tile_degrees - lat_margin;
+        double north = (row + 1) * tile_degrees + lat_margin;
+        double lon_margin = longitude_margin( margin, south, north );
+        Quad::Ptr qptr = std::make_shared<Quad>( geo::Point{ south, col * tile_degrees - lon_margin },
+                                                 geo::Point{ north, (col + 1) * tile_degrees + lon_margin } );
+
+        for (uint32_t s : tile.second) {
+            Quad::insert( qptr, shapes[s] );
+        }
+
+        Geofence geofence{ std::vector<Quad::CPtr>{ qptr }, extension, geo::PageMode::NORMAL, edges };
+        directory.push_back( Entry{ tile.first, offset, geofence.memory_usage() } );
+
+        file.write( geofence.image(), static_cast<std::streamsize>( geofence.memory_usage() ) );
+        offset = (offset + geofence.memory_usage() + kTileAlignment - 1) & ~(kTileAlignment - 1);
+        file.seekp( static_cast<std::streamoff>( offset ) );
+    }
+
+    file.seekp( 0 );
+    file.write( reinterpret_cast<const char*>( &header ), sizeof(header) );
+    file.write( reinterpret_cast<const char*>( directory.data() ), static_cast<std::streamsize>( directory.size() * sizeof(Entry) ) );
+    file.close();
+
+    if (!file || std::rename( temp_path.c_str(), path.c_str() ) != 0) {
+        std::remove( temp_path.c_str() );
+        throw std::runtime_error{ "cannot write geofence tile file " + path + "." };
+    }
+
+    return directory.size();
+}
+
+GeofenceTiles::GeofenceTiles( const std::string& path, std::size_t memory_cap, bool fail_open, std::shared_ptr<PpmLogger> logger ) :
+    path_{ path },
+    fd_{ open( path.c_str(), O_RDONLY ) },
+    stamp_{ 0 },
+    tile_degrees_{ 0.0 },
+    directory_{},
+    memory_cap_{ memory_cap },
+    fail_open_{ fail_open },
+    logger_{ logger },
+    mutex_{},
+    loaded_{},
+    lru_{},
+    memory_usage_{ 0 },
+    loads_{ 0 },
+    evictions_{ 0 },
+    failed_{},
+    failed_lookups_{ 0 }
+{
+    if (fd_ < 0) {
+        throw std::invalid_argument{ "cannot open geofence tile file " + path + "." };
+    }
+
+    struct stat info;
+    Header header;
+
+    if (fstat( fd_, &info ) != 0 || pread( fd_, &header, sizeof(header), 0 ) != static_cast<ssize_t>( sizeof(header) ) ||
+            std::memcmp( header.magic, kTileMagic, sizeof(kTileMagic) ) != 0 || !(header.tile_degrees > 0.0)) {
+        close( fd_ );
+        throw std::invalid_argument{ path + " is not a geofence tile file." };
+    }
+
+    uint64_t file_size = static_cast<uint64_t>( info.st_size );
+    std::size_t directory_size = header.tile_count * sizeof(Entry);
+    directory_.resize( header.tile_count );
+
+    if (header.directory_offset + directory_size > file_size ||
+            pread( fd_, directory_.data(), directory_size, static_cast<off_t>( header.directory_offset ) ) != static_cast<ssize_t>( directory_size )) {
+        close( fd_ );
+        throw std::invalid_argument{ "geofence tile file " + path + " is truncated." };
+    }
+
+    for (auto& entry : directory_) {
+        if (entry.offset + entry.size > file_size) {
+            close( fd_ );
+            throw std::invalid_argument{ "geofence tile file " + path + " is truncated." };
+        }
+    }
+
+    stamp_ = header.stamp;
+    tile_degrees_ = header.tile_degrees;
+}
+
+GeofenceTiles::~GeofenceTiles()
+{
+    close( fd_ );
+}
+
+uint64_t GeofenceTiles::key_of( const geo::Point& pt ) const
+{
+    return tile_key( static_cast<int64_t>( std::floor( pt.lat / tile_degrees_ ) ), static_cast<int64_t>( std::floor( pt.lon / tile_degrees_ ) ) );
+}
+
+Geofence::CPtr GeofenceTiles::load( const Entry& entry, std::string& error ) const
+{
+    geo::PageMode mode = geo::PageMode::NORMAL;
+    std::shared_ptr<char> buffer = geo::allocate_pages( entry.size, mode );
+
+    ssize_t bytes = pread( fd_, buffer.get(), entry.size, static_cast<off_t>( entry.offset ) );
+    if (bytes != static_cast<ssize_t>( entry.size )) {
+        error = bytes < 0 ? std::string{ std::strerror( errno ) } : "read " + std::to_string( bytes ) + " of " + std::to_string( entry.size ) + " bytes";
+        return nullptr;
+    }
+
+    try {
+        return std::make_shared<const Geofence>( std::shared_ptr<const char>{ buffer }, entry.size );
+    } catch (std::invalid_argument& e) {
+        error = e.what();
+        return nullptr;
+    }
+}
+
+Geofence::CPtr GeofenceTiles::tile( const geo::Point& pt )
+{
+    bool failed;
+    return tile( pt, failed );
+}
+
+Geofence::CPtr GeofenceTiles::tile( const geo::Point& pt, bool& failed )
+{
+    uint64_t key = key_of( pt );
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    failed = false;
+
+    auto held = loaded_.find( key );
+    if (held != loaded_.end()) {
+        lru_.splice( lru_.begin(), lru_, held->second.use );
+        return held->second.geofence_ptr;
+    }
+
+    auto entry = std::lower_bound( directory_.begin(), directory_.end(), key, []( const Entry& e, uint64_t k ) { return e.key < k; } );
+    if (entry == directory_.end() || entry->key != key) return nullptr;
+
+    // a tile that could not be read is not read again.
+    if (failed_.count( key ) > 0) {
+        failed = true;
+        ++failed_lookups_;
+        return nullptr;
+    }
+
+    std::string error;
+    Geofence::CPtr geofence_ptr = load( *entry, error );
+    if (!geofence_ptr) {
+        failed_.insert( key );
+        failed = true;
+        ++failed_lookups_;
+        if (logger_) {
+            logger_->error("Geofence tile file " + path_ + ": the tile at " + std::to_string( pt.lat ) + ", " + std::to_string( pt.lon ) +
+                    " cannot be read (" + error + "); the BSMs in it are " + (fail_open_ ? "retained." : "suppressed."));
+        }
+        return nullptr;
+    }
+
+    ++loads_;
+    lru_.push_front( key );
+    loaded_.emplace( key, Loaded{ geofence_ptr, lru_.begin() } );
+    memory_usage_ += geofence_ptr->memory_usage();
+
+    // the tile just read is never the coldest, so it stays.
+    while (memory_usage_ > memory_cap_ && lru_.size() > 1) {
+        auto cold = loaded_.find( lru_.back() );
+        memory_usage_ -= cold->second.geofence_ptr->memory_usage();
+        loaded_.erase( cold );
+        lru_.pop_back();
+        ++evictions_;
+    }
+
+    return geofence_ptr;
+}
+
+bool GeofenceTiles::contains( const geo::Point& pt )
+{
+    bool failed;
+    Geofence::CPtr geofence_ptr = tile( pt, failed );
+    if (!geofence_ptr) return failed && fail_open_;
+    return geofence_ptr->contains( pt );
+}
+
+bool GeofenceTiles::fail_open() const
+{
+    return fail_open_;
+}
+
+uint64_t GeofenceTiles::stamp() const
+{
+    return stamp_;
+}
+
+double GeofenceTiles::tile_degrees() const
+{
+    return tile_degrees_;
+}
+
+std::size_t GeofenceTiles::tile_count() const
+{
+    return directory_.size();
+}
+
+std::size_t GeofenceTiles::loaded_count() const
+{
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    return loaded_.size();
+}
+
+std::size_t GeofenceTiles::memory_usage() const
+{
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    return memory_usage_;
+}
+
+uint64_t GeofenceTiles::loads() const
+{
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    return loads_;
+}
+
+uint64_t GeofenceTiles::evictions() const
+{
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    return evictions_;
+}
+
+std::size_t GeofenceTiles::failures() const
+{
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    return failed_.size();
+}
+
+uint64_t GeofenceTiles::failed_lookups() const
+{
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    return failed_lookups_;
+}
@@ -0,0 +1,284 @@
+#include "jsonSplice.hpp"
+
+#include <algorithm>
+#include "rapidjson/writer.h"
+
+namespace {
+
+bool is_whitespace( char c )
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+std::size_t skip_whitespace( const char* json, std::size_t size, std::size_t i )
+{
+    while (i < size && is_whitespace( json[i] )) {
+        ++i;
+    }
+
+    return i;
+}
+
+/**
+ * @brief Return the offset after the closing quote of a string whose contents start at i.
+ */
+std::size_t string_end( const char* json, std::size_t size, std::size_t i )
+{
+    while (i < size && json[i] != '"') {
+        i += json[i] == '\\' ? 2 : 1;
+    }
+
+    return std::min( i + 1, size );
+}
+
+/**
+ * @brief Return the offset after the value that starts at i; the JSON has already been parsed, so it is well formed.
+ */
+std::size_t value_end( const char* json, std::size_t size, std::size_t i )
+{
+    if (i >= size) {
+        return size;
+    }
+
+    if (json[i] == '"') {
+        return string_end( json, size, i + 1 );
+    }
+
+    if (json[i] == '{' || json[i] == '[') {
+        int depth = 0;
+        while (i < size) {
+            char c = json[i];
+            if (c == '"') {
+                i = string_end( json, size, i + 1 );
+                continue;
+            }
+
+            if (c == '{' || c == '[') {
+                ++depth;
+            } else if ((c == '}' || c == ']') && --depth == 0) {
+                return i + 1;
+            }
+
+            ++i;
+        }
+
+        return size;
+    }
+
+    // a number, true, false, or null.
+    while (i < size && json[i] != ',' && json[i] != '}' && json[i] != ']' && !is_whitespace( json[i] )) {
+        ++i;
+    }
+
+    return i;
+}
+
+}
+
+JsonSplice::JsonSplice() :
+    original_{ nullptr },
+    size_{ 0 },
+    insitu_{ nullptr },
+    valid_{ false },
+    edits_{},
+    text_{},
+    sorted_{}
+{}
+
+void JsonSplice::reset( const std::string& original, const char* insitu )
+{
+    original_ = original.data();
+    size_ = original.size();
+    insitu_ = insitu;
+    valid_ = true;
+    edits_.clear();
+    text_.Clear();
+}
+
+bool JsonSplice::locate( const rapidjson::Value& name, std::size_t& key, std::size_t& value, std::size_t& end ) const
+{
+    const char* s = name.GetString();
+    if (s <= insitu_ || s >= insitu_ + size_) {
+        return false;
+    }
+
+    // the name was decoded in place from just after its opening quote; an escape only makes it shorter.
+    key = static_cast<std::size_t>( s - insitu_ ) - 1;
+    if (original_[key] != '"') {
+        return false;
+    }
+
+    std::size_t i = skip_whitespace( original_, size_, string_end( original_, size_, key + 1 ) );
+    if (i >= size_ || original_[i] != ':') {
+        return false;
+    }
+
+    value = skip_whitespace( original_, size_, i + 1 );
+    end = value_end( original_, size_, value );
+    return value < end;
+}
+
+void JsonSplice::write_value( const rapidjson::Value& value )
+{
+    rapidjson::Writer<rapidjson::StringBuffer> writer{ text_ };
+    value.Accept( writer );
+}
+
+void JsonSplice::replace( const rapidjson::Value& object, const char* name )
+{
+    if (!valid_ || !object.IsObject()) {
+        return;
+    }
+
+    auto member = object.FindMember( name );
+    if (member == object.MemberEnd()) {
+        return;
+    }
+
+    std::size_t key, value, end;
+    if (!locate( member->name, key, value, end )) {
+        valid_ = false;
+        return;
+    }
+
+    std::size_t text_begin = text_.GetSize();
+    write_value( member->value );
+
+    // a value changed again is written as it is now.
+    for (Edit& edit : edits_) {
+        if (edit.kind == Kind::REPLACE && edit.begin == value) {
+            edit.text_begin = text_begin;
+            edit.text_end = text_.GetSize();
+            return;
+        }
+    }
+
+    edits_.push_back( Edit{ value, end, text_begin, text_.GetSize(), Kind::REPLACE } );
+}
+
+void JsonSplice::remove( const rapidjson::Value& object, const char* name )
+{
+    if (!valid_ || !object.IsObject()) {
+        return;
+    }
+
+    auto member = object.FindMember( name );
+    if (member == object.MemberEnd()) {
+        return;
+    }
+
+    std::size_t key, value, end;
+    if (!locate( member->name, key, value, end )) {
+        valid_ = false;
+        return;
+    }
+
+    // the comma after a member goes with it; the last member takes the comma before it, which is found as the output
+    // is written since the member before it may be removed too.
+    std::size_t next = skip_whitespace( original_, size_, end );
+    if (next < size_ && original_[next] == ',') {
+        edits_.push_back( Edit{ key, skip_whitespace( original_, size_, next + 1 ), 0, 0, Kind::REMOVE } );
+    } else {
+        edits_.push_back( Edit{ key, end, 0, 0, Kind::REMOVE_LAST } );
+    }
+}
+
+void JsonSplice::append( const rapidjson::Value& parent, const char* object, const char* name )
+{
+    if (!valid_ || !parent.IsObject()) {
+        return;
+    }
+
+    auto container = parent.FindMember( object );
+    if (container == parent.MemberEnd() || !container->value.IsObject()) {
+        return;
+    }
+
+    auto member = container->value.FindMember( name );
+    if (member == container->value.MemberEnd()) {
+        return;
+    }
+
+    std::size_t key, value, end;
+    if (!locate( container->name, key, value, end ) || original_[value] != '{') {
+        valid_ = false;
+        return;
+    }
+
+    std::size_t text_begin = text_.GetSize();
+    write_value( rapidjson::Value{ rapidjson::StringRef( name ) } );
+    text_.Put( ':' );
+    write_value( member->value );
+
+    edits_.push_back( Edit{ end - 1, end - 1, text_begin, text_.GetSize(), Kind::APPEND } );
+}
+
+bool JsonSplice::valid() const
+{
+    return valid_;
+}
+
+std::size_t JsonSplice::edit_count() const
+{
+    return edits_.size();
+}
+
+bool JsonSplice::write( std::string& out ) const
+{
+    if (!valid_) {
+        return false;
+    }
+
+    // an edit inside a member that is removed, or a value that is replaced, comes after it and is dropped.
+    sorted_.assign( edits_.begin(), edits_.end() );
+    std::stable_sort( sorted_.begin(), sorted_.end(), []( const Edit& a, const Edit& b ) {
+        return a.begin < b.begin || (a.begin == b.begin && a.end > b.end);
+    } );
+
+    const char* text = text_.GetString();
+    out.clear();
+    out.reserve( size_ + text_.GetSize() );
+
+    std::size_t cursor = 0;
+    for (const Edit& edit : sorted_) {
+        if (edit.begin < cursor) {
+            continue;
+        }
+
+        out.append( original_ + cursor, edit.begin - cursor );
+
+        switch (edit.kind) {
+            case Kind::REPLACE:
+                out.append( text + edit.text_begin, edit.text_end - edit.text_begin );
+                break;
+
+            case Kind::REMOVE:
+                break;
+
+            case Kind::REMOVE_LAST:
+                while (!out.empty() && is_whitespace( out.back() )) {
+                    out.pop_back();
+                }
+
+                if (!out.empty() && out.back() == ',') {
+                    out.pop_back();
+                }
+                break;
+
+            case Kind::APPEND: {
+                std::size_t last = out.find_last_not_of( " \t\n\r" );
+                if (last != std::string::npos && out[last] != '{') {
+                    out.push_back( ',' );
+                }
+
+                out.append( text + edit.text_begin, edit.text_end - edit.text_begin );
+                break;
+            }
+        }
+
+        cursor = edit.end;
+    }
+
+    out.append( original_ + cursor, size_ - cursor );
+    return true;
+}
@@ -51,8 +51,11 @@
 
 #include "ppm.hpp"
 #include "spdlog/spdlog.h"
+#include <algorithm>
 #include <csignal>
 #include <chrono>
+#include <iomanip>
+#include <sstream>
 #include <thread>
 
 // for both windows and linux.
@@ -103,7 +106,17 @@ PPM::PPM( const std::string& name, const std::string& description ) :
     consumed_topic{},
     conf{nullptr},
     tconf{nullptr},
-    qptr{},
+    mapfile{},
+    deltafile{},
+    geofence_slot{},
+    geofence_reloader{},
+    geofence_share{},
+    geofence_tiles{},
+    geofence_pages{geo::PageMode::NORMAL},
+    geofence_warmup{false},
+    geofence_watch{false},
+    geofence_reload_interval{GeofenceReloader::kDefaultIntervalMs},
+    geofence_reorder_interval{0},
     consumer{},
     consumer_timeout{500},
     producer{},
@@ -114,6 +127,7 @@ PPM::PPM( const std::string& name, const std::string& description ) :
 
 PPM::~PPM() 
 {
+    if (geofence_reloader) geofence_reloader->stop();
     if (consumer) consumer->close();
 
     // free raw librdkafka pointers.
@@ -305,8 +319,6 @@ bool PPM::configure() {
     // All configuration file settings are overridden, if supplied, by CLI options.
 
     // fail first on mapfile.
-    std::string mapfile;
-
     if ( optIsSet('m') ) {
         // map file is specified on command line.
         mapfile = optString('m');
@@ -323,7 +335,21 @@ bool PPM::configure() {
 
     logger->info("ppm mapfile: " + mapfile);
 
-    qptr = BuildGeofence( mapfile );                // throws.
+    auto pages = pconf.find("privacy.filter.geofence.hugepages");
+    if ( pages != pconf.end() && pages->second == "TRANSPARENT" ) {
+        geofence_pages = geo::PageMode::TRANSPARENT_HUGE;
+    } else if ( pages != pconf.end() && pages->second == "EXPLICIT" ) {
+        geofence_pages = geo::PageMode::EXPLICIT_HUGE;
+    }
+
+    auto warmup = pconf.find("privacy.filter.geofence.warmup");
+    geofence_warmup = warmup != pconf.end() && warmup->second == "ON";
+
+    auto share = pconf.find("privacy.filter.geofence.shared.file");
+    if ( share != pconf.end() && !share->second.empty() ) {
+        geofence_share.reset( new GeofenceShare{ share->second, logger } );
+        logger->info("geofence index shared through: " + share->second);
+    }
 
     if ( optIsSet('b') ) {
         // broker specified.
@@ -442,6 +468,69 @@ bool PPM::configure() {
         }
     }
 
+    search = pconf.find("privacy.filter.geofence.reload.watch");
+    if ( search != pconf.end() && search->second=="ON" ) {
+        geofence_watch = true;
+    }
+
+    search = pconf.find("privacy.filter.geofence.deltafile");
+    if ( search != pconf.end() ) {
+        deltafile = search->second;
+        logger->info("geofence delta file: " + deltafile);
+    }
+
+    search = pconf.find("privacy.filter.geofence.reload.interval.ms");
+    if ( search != pconf.end() ) {
+        int interval = 0;
+        try {
+            interval = stoi( search->second );
+        } catch( std::exception& e ) {
+        }
+
+        // an interval of 0 or less would have the reloader check the triggers without pause.
+        if ( interval > 0 ) {
+            geofence_reload_interval = interval;
+        } else {
+            logger->error("privacy.filter.geofence.reload.interval.ms \"" + search->second + "\" is not a positive number of milliseconds; using the default geofence reload interval.");
+        }
+    }
+
+    logger->info("geofence reload: SIGHUP" + std::string{ geofence_watch ? " or map file change" : "" } + "; checked every " + std::to_string(geofence_reload_interval) + " ms");
+
+    search = pconf.find("privacy.filter.geofence.reorder.interval.ms");
+    if ( search != pconf.end() ) {
+        int interval = -1;
+        try {
+            interval = stoi( search->second );
+        } catch( std::exception& e ) {
+        }
+
+        // 0 turns reordering off.
+        if ( interval >= 0 ) {
+            geofence_reorder_interval = interval;
+        } else {
+            logger->error("privacy.filter.geofence.reorder.interval.ms \"" + search->second + "\" is not a number of milliseconds; the geofence leaves are not reordered.");
+        }
+    }
+
+    auto tiles = pconf.find("privacy.filter.geofence.tiles.file");
+    if ( tiles != pconf.end() && !tiles->second.empty() ) {
+        // the geofence is read a tile at a time as the BSMs reach it; no index of the whole map is built.
+        geofence_tiles = LoadTiles( mapfile, tiles->second );  // throws.
+        geofence_slot = std::make_shared<GeofenceSlot>( nullptr );
+    } else {
+        // the reloader builds every index, the first included, so each one has the delta file's changes.
+        geofence_slot = std::make_shared<GeofenceSlot>( nullptr );
+        geofence_reloader.reset( new GeofenceReloader{ geofence_slot, [this]() { return LoadGeofence( mapfile ); },
+                geofence_watch ? string_utilities::split( mapfile, ',' ) : StrVector{}, std::chrono::milliseconds{ geofence_reload_interval }, logger } );
+
+        if (!deltafile.empty()) {
+            geofence_reloader->watch_deltas( deltafile, [this]( const Geofence& geofence ) { return UpdateGeofence( geofence, deltafile ); } );
+        }
+
+        geofence_reloader->load();  // throws.
+    }
+
     logger->trace("ending configure()");
     return true;
 }
@@ -530,54 +619,311 @@ bool PPM::msg_consume(RdKafka::Message* message, void* opaque, BSMHandler& handl
     return false;
 }
 
-Quad::Ptr PPM::BuildGeofence( const std::string& mapfile )  // throws
+Geofence::CPtr PPM::BuildGeofence( const std::string& mapfile )  // throws
 {
     geo::Point sw, ne;
+    double extension = 10.0;
+    bool have_root = false;
 
     logger->trace("Starting BuildGeofence.");
 
     auto search = pconf.find("privacy.filter.geofence.sw.lat");
     if ( search != pconf.end() ) {
         sw.lat = stod(search->second);
+        have_root = true;
     }
 
     search = pconf.find("privacy.filter.geofence.sw.lon");
     if ( search != pconf.end() ) {
         sw.lon = stod(search->second);
+        have_root = true;
     }
 
     search = pconf.find("privacy.filter.geofence.ne.lat");
     if ( search != pconf.end() ) {
         ne.lat = stod(search->second);
+        have_root = true;
     }
 
     search = pconf.find("privacy.filter.geofence.ne.lon");
     if ( search != pconf.end() ) {
         ne.lon = stod(search->second);
+        have_root = true;
     }
 
-    Quad::Ptr qptr = std::make_shared<Quad>(sw, ne);
+    // Must match the extension used by the BSMHandler.
+    search = pconf.find("privacy.filter.geofence.extension");
+    if ( search != pconf.end() ) {
+        extension = stod(search->second);
+    }
+
+    // Read the file and parse the shapes; the edges can be loaded into a compact road graph.
+    search = pconf.find("privacy.filter.geofence.graph");
+    bool use_graph = search != pconf.end() && search->second == "ON";
 
-    // Read the file and parse the shapes.
-    shapes::CSVInputFactory shape_factory( mapfile );
-    shape_factory.make_shapes();
+    // or the chained edges of each way can be merged into polylines.
+    search = pconf.find("privacy.filter.geofence.polylines");
+    bool merge_ways = search != pconf.end() && search->second == "ON";
 
-    // Add all the shapes to the quad.
-    // NOTE: we are only using Edges right now.
-    for (auto& circle_ptr : shape_factory.get_circles()) {
-        Quad::insert(qptr, std::dynamic_pointer_cast<const geo::Entity>(circle_ptr)); 
+    // and each way can be simplified to within a tolerance in meters.
+    double simplify_tolerance = 0.0;
+    search = pconf.find("privacy.filter.geofence.simplify");
+    if ( search != pconf.end() ) {
+        simplify_tolerance = stod(search->second);
     }
 
-    for (auto& edge_ptr : shape_factory.get_edges()) {
-        Quad::insert(qptr, std::dynamic_pointer_cast<const geo::Entity>(edge_ptr)); 
+    // Edges and polyline segments are buffered as rectangles or, in capsule mode, by their distance.
+    search = pconf.find("privacy.filter.geofence.capsules");
+    Geofence::EdgeModel edge_model = search != pconf.end() && search->second == "ON" ? Geofence::EdgeModel::CAPSULE : Geofence::EdgeModel::AREA;
+
+    // Each map file is an independent region with its own tree.
+    StrVector mapfiles = string_utilities::split( mapfile, ',' );
+    bool auto_root = !have_root || mapfiles.size() > 1;
+
+    if (have_root && mapfiles.size() > 1) {
+        logger->warn("Geofence region boundaries are ignored with more than one map file; each region's boundaries are computed from its shapes.");
     }
 
-    for (auto& grid_ptr : shape_factory.get_grids()) {
-        Quad::insert(qptr, std::dynamic_pointer_cast<const geo::Entity>(grid_ptr)); 
+    // A computed root must also contain the areas around the edges at its boundary.
+    double margin = extension + *std::max_element( osm::highway_width_map.begin(), osm::highway_width_map.end() );
+    std::vector<Quad::CPtr> regions;
+
+    for (auto& region_file : mapfiles) {
+        shapes::CSVInputFactory shape_factory( region_file, use_graph, merge_ways, simplify_tolerance );
+        shape_factory.make_shapes();
+
+        geo::Bounds bounds{ sw, ne };
+
+        if (auto_root) {
+            if (!shape_factory.get_bounds( bounds )) {
+                logger->warn("Geofence region " + region_file + " has no shapes; it is not used.");
+                continue;
+            }
+
+            bounds = geo::Bounds{ geo::Point{ geo::Location::project_position( bounds.sw.lat, bounds.sw.lon, 180.0, margin ).lat,
+                                              geo::Location::project_position( bounds.sw.lat, bounds.sw.lon, 270.0, margin ).lon },
+                                  geo::Point{ geo::Location::project_position( bounds.ne.lat, bounds.ne.lon, 0.0, margin ).lat,
+                                              geo::Location::project_position( bounds.ne.lat, bounds.ne.lon, 90.0, margin ).lon } };
+        }
+
+        Quad::Ptr qptr = std::make_shared<Quad>(bounds.sw, bounds.ne);
+
+        // Add all the shapes to the quad.
+        for (auto& circle_ptr : shape_factory.get_circles()) {
+            Quad::insert(qptr, std::dynamic_pointer_cast<const geo::Entity>(circle_ptr)); 
+        }
+
+        for (auto& edge_ptr : shape_factory.get_edges()) {
+            Quad::insert(qptr, std::dynamic_pointer_cast<const geo::Entity>(edge_ptr)); 
+        }
+
+        for (auto& grid_ptr : shape_factory.get_grids()) {
+            Quad::insert(qptr, std::dynamic_pointer_cast<const geo::Entity>(grid_ptr)); 
+        }
+
+        for (auto& polyline_ptr : shape_factory.get_polylines()) {
+            Quad::insert(qptr, polyline_ptr);
+        }
+
+        for (auto& graph_edge_ptr : shape_factory.get_graph_edges()) {
+            Quad::insert(qptr, graph_edge_ptr);
+        }
+
+        std::ostringstream region_bounds;
+        region_bounds << std::setprecision(10) << bounds.sw << " to " << bounds.ne;
+        logger->info("Geofence region " + region_file + ": " + region_bounds.str() + (auto_root ? " (computed)" : "") + "; shapes arena: " + std::to_string(shape_factory.get_arena()->bytes_reserved()) + " bytes.");
+
+        if (use_graph) {
+            geo::RoadGraph::CPtr graph_ptr = shape_factory.get_graph();
+            logger->info("Geofence road graph: " + std::to_string(graph_ptr->vertex_count()) + " vertices, " + std::to_string(graph_ptr->edge_count()) + " edges, " + std::to_string(graph_ptr->memory_usage()) + " bytes.");
+        }
+
+        if (merge_ways && !use_graph) {
+            logger->info("Geofence region " + region_file + ": edges merged into " + std::to_string(shape_factory.get_polylines().size()) + " polylines.");
+        }
+
+        if (simplify_tolerance > 0.0 && !use_graph) {
+            logger->info("Geofence region " + region_file + ": simplification to " + std::to_string(simplify_tolerance) + " m removed " + std::to_string(shape_factory.get_duplicate_count()) + " duplicate edges and " + std::to_string(shape_factory.get_simplified_count()) + " segments.");
+        }
+
+        regions.push_back( qptr );
+    }
+
+    if (regions.empty()) {
+        // nothing to compute a root from; the geofence contains nothing.
+        regions.push_back( std::make_shared<Quad>(sw, ne) );
+    }
+
+    // The handler queries a flat index of the trees.
+    Geofence::CPtr geofence_ptr = std::make_shared<const Geofence>(regions, extension, geofence_pages, edge_model);
+    logger->info("Geofence index: " + std::to_string(geofence_ptr->region_count()) + " regions, " + std::to_string(geofence_ptr->node_count()) + " nodes, " + std::to_string(geofence_ptr->shape_count()) + " shapes, " + std::to_string(geofence_ptr->lattice_cell_count()) + " grid lattice cells, " + std::to_string(geofence_ptr->memory_usage()) + " bytes" + (geofence_ptr->page_mode() == geo::PageMode::NORMAL ? "" : " on huge pages") + (edge_model == Geofence::EdgeModel::CAPSULE ? "; edges as capsules" : "") + ".");
+
+    if (geofence_pages != geo::PageMode::NORMAL && geofence_ptr->page_mode() != geofence_pages) {
+        logger->warn(std::string{"Geofence index: the requested huge pages are not available; using "} + (geofence_ptr->page_mode() == geo::PageMode::NORMAL ? "normal" : "transparent huge") + " pages.");
     }
 
     logger->trace("Completed BuildGeofence.");
-    return qptr;
+    return geofence_ptr;
+}
+
+Geofence::CPtr PPM::LoadGeofence( const std::string& mapfile )  // throws
+{
+    if (!geofence_share) {
+        Geofence::CPtr geofence_ptr = BuildGeofence( mapfile );
+        if (geofence_warmup) WarmGeofence( *geofence_ptr );
+        return geofence_ptr;
+    }
+
+    // the index depends on the map files and on the settings BuildGeofence reads.
+    std::string settings = mapfile;
+    for (auto key : { "sw.lat", "sw.lon", "ne.lat", "ne.lon", "extension", "graph", "polylines", "simplify", "capsules" }) {
+        auto search = pconf.find(std::string{ "privacy.filter.geofence." } + key);
+        settings += ";" + (search != pconf.end() ? search->second : std::string{});
+    }
+
+    uint64_t stamp = GeofenceShare::fingerprint( string_utilities::split( mapfile, ',' ), settings );
+    Geofence::CPtr geofence_ptr = geofence_share->acquire( stamp, [this, &mapfile]() { return BuildGeofence( mapfile ); } );
+    if (geofence_warmup) WarmGeofence( *geofence_ptr );
+    return geofence_ptr;
+}
+
+GeofenceTiles::Ptr PPM::LoadTiles( const std::string& mapfile, const std::string& tilefile )  // throws
+{
+    double extension = 10.0;
+    double tile_degrees = GeofenceTiles::kDefaultTileDegrees;
+    std::size_t memory_cap = 256;
+
+    logger->trace("Starting LoadTiles.");
+
+    // Must match the extension used by the BSMHandler.
+    auto search = pconf.find("privacy.filter.geofence.extension");
+    if ( search != pconf.end() ) {
+        extension = stod(search->second);
+    }
+
+    search = pconf.find("privacy.filter.geofence.tiles.size");
+    if ( search != pconf.end() ) {
+        tile_degrees = stod(search->second);
+    }
+
+    search = pconf.find("privacy.filter.geofence.tiles.memory");
+    if ( search != pconf.end() ) {
+        memory_cap = static_cast<std::size_t>( stoul(search->second) );
+    }
+
+    memory_cap *= 1024 * 1024;
+
+    // a tile that cannot be read suppresses its BSMs unless the tiles fail open.
+    search = pconf.find("privacy.filter.geofence.tiles.failopen");
+    bool fail_open = search != pconf.end() && search->second == "ON";
+
+    // the tiles depend on the map files, on the settings used to read the shapes and index each tile, and on the layout
+    // of the tile images.
+    std::string settings = mapfile + ";" + std::to_string( Geofence::image_version() );
+    for (auto key : { "extension", "graph", "polylines", "simplify", "capsules", "tiles.size" }) {
+        auto setting = pconf.find(std::string{ "privacy.filter.geofence." } + key);
+        settings += ";" + (setting != pconf.end() ? setting->second : std::string{});
+    }
+
+    StrVector mapfiles = string_utilities::split( mapfile, ',' );
+    uint64_t stamp = GeofenceShare::fingerprint( mapfiles, settings );
+
+    try {
+        GeofenceTiles::Ptr tiles_ptr = std::make_shared<GeofenceTiles>( tilefile, memory_cap, fail_open, logger );
+
+        if (tiles_ptr->stamp() == stamp) {
+            logger->info("Geofence tiles " + tilefile + ": " + std::to_string(tiles_ptr->tile_count()) + " tiles of " + std::to_string(tiles_ptr->tile_degrees()) + " degrees; " + std::to_string(memory_cap) + " bytes held at most.");
+            logger->trace("Completed LoadTiles.");
+            return tiles_ptr;
+        }
+
+        logger->info("Geofence tiles " + tilefile + " were written from another map or settings; rewriting them.");
+    } catch (std::invalid_argument& e) {
+        logger->info(std::string{ e.what() } + " Writing the geofence tiles.");
+    }
+
+    // Read the shapes once, as BuildGeofence does; the region boundaries are not used because each tile has its own.
+    search = pconf.find("privacy.filter.geofence.graph");
+    bool use_graph = search != pconf.end() && search->second == "ON";
+
+    search = pconf.find("privacy.filter.geofence.polylines");
+    bool merge_ways = search != pconf.end() && search->second == "ON";
+
+    double simplify_tolerance = 0.0;
+    search = pconf.find("privacy.filter.geofence.simplify");
+    if ( search != pconf.end() ) {
+        simplify_tolerance = stod(search->second);
+    }
+
+    search = pconf.find("privacy.filter.geofence.capsules");
+    Geofence::EdgeModel edge_model = search != pconf.end() && search->second == "ON" ? Geofence::EdgeModel::CAPSULE : Geofence::EdgeModel::AREA;
+
+    std::vector<geo::Entity::CPtr> shapes;
+
+    for (auto& region_file : mapfiles) {
+        shapes::CSVInputFactory shape_factory( region_file, use_graph, merge_ways, simplify_tolerance );
+        shape_factory.make_shapes();
+
+        // each shape keeps the arena or graph it was made in.
+        shapes.insert( shapes.end(), shape_factory.get_circles().begin(), shape_factory.get_circles().end() );
+        shapes.insert( shapes.end(), shape_factory.get_edges().begin(), shape_factory.get_edges().end() );
+        shapes.insert( shapes.end(), shape_factory.get_grids().begin(), shape_factory.get_grids().end() );
+        shapes.insert( shapes.end(), shape_factory.get_polylines().begin(), shape_factory.get_polylines().end() );
+        shapes.insert( shapes.end(), shape_factory.get_graph_edges().begin(), shape_factory.get_graph_edges().end() );
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::size_t tile_count = GeofenceTiles::write( tilefile, stamp, shapes, tile_degrees, extension, edge_model );  // throws.
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now() - start );
+
+    logger->info("Geofence tiles " + tilefile + ": wrote " + std::to_string(tile_count) + " tiles of " + std::to_string(tile_degrees) + " degrees from " + std::to_string(shapes.size()) + " shapes in " + std::to_string(elapsed.count()) + " ms; " + std::to_string(memory_cap) + " bytes held at most.");
+    logger->trace("Completed LoadTiles.");
+    return std::make_shared<GeofenceTiles>( tilefile, memory_cap, fail_open, logger );
+}
+
+void PPM::WarmGeofence( const Geofence& geofence )
+{
+    // a new index is cold; take its page faults here rather than on the first BSMs that reach each part of it.
+    auto start = std::chrono::steady_clock::now();
+    std::size_t pages = geofence.warm_up();
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - start );
+
+    logger->info("Geofence warm-up: touched " + std::to_string(pages) + " pages (" + std::to_string(geofence.memory_usage()) + " bytes) in " + std::to_string(elapsed.count()) + " us.");
+}
+
+Geofence::CPtr PPM::UpdateGeofence( const Geofence& geofence, const std::string& deltafile )  // throws
+{
+    logger->trace("Starting UpdateGeofence.");
+
+    if (!geofence.has_source()) {
+        // a shared index has no trees to copy; build this process's own from the map file and change that.
+        logger->info("Geofence delta " + deltafile + ": the shared index has no source trees; building a local index to apply it to.");
+        return UpdateGeofence( *BuildGeofence( mapfile ), deltafile );
+    }
+
+    shapes::CSVDeltaFactory delta_factory( deltafile );
+    delta_factory.make_changes();
+
+    // the published trees are being read by the handler; change copies. A shape is only added to the regions it
+    // touches.
+    std::vector<Quad::Ptr> quads;
+    for (uint32_t r = 0; r < geofence.region_count(); ++r) {
+        quads.push_back( Quad::clone( geofence.get_quad( r ) ) );
+    }
+
+    std::vector<const shapes::CSVDeltaFactory::Change*> unplaced;
+    std::size_t applied = delta_factory.apply_changes( quads, unplaced );
+    for (auto change : unplaced) {
+        logger->warn("Geofence delta " + deltafile + ": the add of " + change->type + " " + std::to_string(change->uid) + " is outside every region; it is not in the geofence.");
+    }
+
+    std::vector<Quad::CPtr> regions{ quads.begin(), quads.end() };
+    logger->info("Geofence delta " + deltafile + ": applied " + std::to_string(applied) + " of " + std::to_string(delta_factory.get_changes().size()) + " changes across " + std::to_string(regions.size()) + " regions.");
+    Geofence::CPtr geofence_ptr = std::make_shared<const Geofence>( regions, geofence.get_extension(), geofence_pages, geofence.edge_model() );
+    if (geofence_warmup) WarmGeofence( *geofence_ptr );
+
+    logger->trace("Completed UpdateGeofence.");
+    return geofence_ptr;
 }
 
 bool PPM::launch_producer()
@@ -736,6 +1082,9 @@ int PPM::operator()(void) {
 
     signal(SIGINT, sigterm);
     signal(SIGTERM, sigterm);
+#ifdef SIGHUP
+    signal(SIGHUP, GeofenceReloader::sighup);
+#endif
 
     try {
         // throws for mapfile and other items.
@@ -748,6 +1097,26 @@ int PPM::operator()(void) {
         return EXIT_FAILURE;
     }
 
+    if (geofence_tiles) {
+        // a tile file is only checked against the map when the PPM starts.
+        logger->info("Geofence tiles: the map is not reloaded and delta files are not applied; restart the PPM to use a changed map.");
+
+    } else {
+        // the geofence is rebuilt in the background; the handler picks up each new one between BSMs.
+        if (geofence_reorder_interval > 0 && geofence_share) {
+            // a reordered copy would be this process's own; the shared index stays shared.
+            logger->info("Geofence reorder: the shared index is not reordered.");
+        } else if (geofence_reorder_interval > 0) {
+            geofence_reloader->reorder_every( std::chrono::milliseconds{ geofence_reorder_interval }, [this]( const Geofence& geofence ) {
+                Geofence::CPtr geofence_ptr = geofence.reordered();
+                if (geofence_ptr && geofence_warmup) WarmGeofence( *geofence_ptr );
+                return geofence_ptr;
+            } );
+        }
+
+        geofence_reloader->start();
+    }
+
     while (bootstrap) {
         // reset flag here, or else nothing works below
         bsms_available = true;
@@ -765,7 +1134,9 @@ int PPM::operator()(void) {
         }
 
         // JMC: There was leak in here caused by RapidJSON.  It has been fixed.  The notes are in that class's code.
-        BSMHandler handler{qptr, pconf, logger};
+        BSMHandler handler{nullptr, pconf, logger};
+        handler.set_geofence_slot(geofence_slot);
+        handler.set_geofence_tiles(geofence_tiles);
 
         std::vector<RdKafka::TopicPartition*> partitions;
         RdKafka::ErrorCode err = consumer->position(partitions);
@@ -799,8 +1170,19 @@ int PPM::operator()(void) {
             // NOTE: good for troubleshooting, but bad for performance.
             logger->flush();
         }
+
+        GeofenceCache::Ptr cache = handler.get_geofence_cache();
+        if (cache) {
+            logger->info("PPM geofence cache: " + std::to_string(cache->hits()) + " hits, " + std::to_string(cache->misses()) + " misses, " + std::to_string(cache->ambiguous()) + " ambiguous");
+        }
+
+        if (geofence_tiles) {
+            logger->info("PPM geofence tiles: " + std::to_string(geofence_tiles->loads()) + " loads, " + std::to_string(geofence_tiles->evictions()) + " evictions, " + std::to_string(geofence_tiles->failures()) + " unreadable tiles (" + std::to_string(geofence_tiles->failed_lookups()) + " lookups), " + std::to_string(geofence_tiles->loaded_count()) + " tiles (" + std::to_string(geofence_tiles->memory_usage()) + " bytes) held");
+        }
     }
 
+    if (geofence_reloader) geofence_reloader->stop();
+
     logger->info("PPM operations complete; shutting down...");
     logger->info("PPM consumed  : " + std::to_string(bsm_recv_count) + " BSMs and " + std::to_string(bsm_recv_bytes) + " bytes");
     logger->info("PPM published : " + std::to_string(bsm_send_count) + " BSMs and " + std::to_string(bsm_send_bytes) + " bytes");
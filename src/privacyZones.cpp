@@ -0,0 +1,316 @@
+#include "privacyZones.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+constexpr std::size_t kMaxWheelSize = 65536;                        // zones expiring more than this many seconds out share buckets.
+
+std::size_t power_of_two( std::size_t n )
+{
+    std::size_t p = 2;
+    while (p < n) {
+        p <<= 1;
+    }
+
+    return p;
+}
+
+/**
+ * @brief The number of one-second buckets of a wheel: enough that every expiry of the duration has its own bucket, up to
+ * kMaxWheelSize.
+ */
+std::size_t wheel_size( int64_t duration )
+{
+    return power_of_two( static_cast<std::size_t>( std::min<int64_t>( std::max<int64_t>( duration, 0 ) + 2, kMaxWheelSize ) ) );
+}
+
+}
+
+PrivacyZones::Table::Table( std::size_t capacity, std::size_t wheel_size ) :
+    slots( capacity ),
+    buckets( power_of_two( capacity ), kNone ),
+    wheel( wheel_size, kNone ),
+    free{ 0 },
+    count{ 0 },
+    hash_shift{ 64 }
+{
+    for (std::size_t n = buckets.size(); n > 1; n >>= 1) {
+        --hash_shift;
+    }
+
+    for (std::size_t s = 0; s < slots.size(); ++s) {
+        slots[s].hash_next = s + 1 < slots.size() ? static_cast<uint32_t>(s + 1) : kNone;
+    }
+}
+
+uint32_t PrivacyZones::Table::bucket_of( uint64_t key ) const
+{
+    return static_cast<uint32_t>( (key * 0x9E3779B97F4A7C15ULL) >> hash_shift );
+}
+
+uint32_t PrivacyZones::Table::first( uint64_t key ) const
+{
+    return buckets[ bucket_of( key ) ];
+}
+
+uint32_t PrivacyZones::Table::insert( uint64_t key, int64_t expiry, int64_t now, uint64_t& evictions )
+{
+    if (free == kNone) {
+        // drop the slot closest to expiring: the earliest in the first bucket that is not empty after now.
+        uint32_t victim = kNone;
+        for (std::size_t i = 1; i <= wheel.size() && victim == kNone; ++i) {
+            for (uint32_t s = wheel[ static_cast<uint64_t>(now + i) & (wheel.size() - 1) ]; s != kNone; s = slots[s].wheel_next) {
+                if (victim == kNone || slots[s].expiry < slots[victim].expiry) {
+                    victim = s;
+                }
+            }
+        }
+
+        remove( victim );
+        ++evictions;
+    }
+
+    uint32_t s = free;
+    free = slots[s].hash_next;
+
+    Slot& slot = slots[s];
+    slot.key = key;
+    slot.hash_prev = kNone;
+    slot.hash_next = buckets[ bucket_of( key ) ];
+    if (slot.hash_next != kNone) {
+        slots[ slot.hash_next ].hash_prev = s;
+    }
+    buckets[ bucket_of( key ) ] = s;
+
+    schedule( s, expiry );
+    ++count;
+    return s;
+}
+
+void PrivacyZones::Table::remove( uint32_t s )
+{
+    Slot& slot = slots[s];
+    unschedule( s );
+
+    if (slot.hash_prev != kNone) {
+        slots[ slot.hash_prev ].hash_next = slot.hash_next;
+    } else {
+        buckets[ bucket_of( slot.key ) ] = slot.hash_next;
+    }
+
+    if (slot.hash_next != kNone) {
+        slots[ slot.hash_next ].hash_prev = slot.hash_prev;
+    }
+
+    slot.hash_next = free;
+    free = s;
+    --count;
+}
+
+void PrivacyZones::Table::schedule( uint32_t s, int64_t expiry )
+{
+    Slot& slot = slots[s];
+    uint32_t& head = wheel[ static_cast<uint64_t>(expiry) & (wheel.size() - 1) ];
+
+    slot.expiry = expiry;
+    slot.wheel_prev = kNone;
+    slot.wheel_next = head;
+    if (head != kNone) {
+        slots[ head ].wheel_prev = s;
+    }
+    head = s;
+}
+
+void PrivacyZones::Table::unschedule( uint32_t s )
+{
+    Slot& slot = slots[s];
+
+    if (slot.wheel_prev != kNone) {
+        slots[ slot.wheel_prev ].wheel_next = slot.wheel_next;
+    } else {
+        wheel[ static_cast<uint64_t>(slot.expiry) & (wheel.size() - 1) ] = slot.wheel_next;
+    }
+
+    if (slot.wheel_next != kNone) {
+        slots[ slot.wheel_next ].wheel_prev = slot.wheel_prev;
+    }
+}
+
+void PrivacyZones::Table::expire_bucket( std::size_t bucket, int64_t time )
+{
+    // a bucket can hold later laps of the wheel when the duration is longer than the wheel.
+    uint32_t s = wheel[bucket];
+    while (s != kNone) {
+        uint32_t next = slots[s].wheel_next;
+        if (slots[s].expiry <= time) {
+            remove( s );
+        }
+        s = next;
+    }
+}
+
+std::size_t PrivacyZones::Table::memory_usage() const
+{
+    return slots.capacity() * sizeof(Slot) + (buckets.capacity() + wheel.capacity()) * sizeof(uint32_t);
+}
+
+PrivacyZones::PrivacyZones( double radius, int64_t duration, std::size_t capacity ) :
+    radius_{ radius },
+    duration_{ duration },
+    step_{ radius / kMetersPerDegree },
+    now_{ std::numeric_limits<int64_t>::min() },
+    zones_{ std::max<std::size_t>( capacity, 1 ), wheel_size( duration ) },
+    centers_( std::max<std::size_t>( capacity, 1 ) ),
+    vehicles_{ std::max<std::size_t>( capacity, 1 ), wheel_size( duration ) },
+    evictions_{ 0 }
+{
+    if (!(radius > 0.0)) {
+        throw std::invalid_argument{ "privacy zone radius must be positive: " + std::to_string( radius ) };
+    }
+
+    if (duration <= 0) {
+        throw std::invalid_argument{ "privacy zone duration must be positive: " + std::to_string( duration ) };
+    }
+}
+
+int64_t PrivacyZones::row_of( double lat ) const
+{
+    return static_cast<int64_t>( std::floor( lat / step_ ) );
+}
+
+int64_t PrivacyZones::col_of( int64_t row, double lon ) const
+{
+    // the cell is as wide as the radius at its poleward edge.
+    double edge = std::min( std::max( std::fabs( row * step_ ), std::fabs( (row + 1) * step_ ) ), 89.0 );
+    return static_cast<int64_t>( std::floor( lon * std::cos( edge * M_PI / 180.0 ) / step_ ) );
+}
+
+uint64_t PrivacyZones::cell_key( int64_t row, int64_t col )
+{
+    return (static_cast<uint64_t>( row ) << 32) ^ static_cast<uint32_t>( col );
+}
+
+bool PrivacyZones::observe( const std::string& id, const geo::Point& pt, int64_t time )
+{
+    expire( time );
+    time = now_;
+
+    uint64_t id_hash = std::hash<std::string>{}( id );
+    uint32_t v = vehicles_.first( id_hash );
+    while (v != kNone && vehicles_.slots[v].key != id_hash) {
+        v = vehicles_.slots[v].hash_next;
+    }
+
+    if (v != kNone) {
+        // a vehicle that is still reporting is remembered until it has not been seen for the duration.
+        vehicles_.unschedule( v );
+        vehicles_.schedule( v, time + duration_ );
+    } else {
+        vehicles_.insert( id_hash, time + duration_, time, evictions_ );
+
+        int64_t row = row_of( pt.lat );
+        uint32_t z = zones_.insert( cell_key( row, col_of( row, pt.lon ) ), time + duration_, time, evictions_ );
+        // Point declares a copy constructor but no assignment.
+        centers_[z].lat = pt.lat;
+        centers_[z].lon = pt.lon;
+        return true;
+    }
+
+    return contains( pt, time );
+}
+
+bool PrivacyZones::contains( const geo::Point& pt, int64_t time )
+{
+    expire( time );
+
+    if (zones_.count == 0) {
+        return false;
+    }
+
+    double meters_per_lon = kMetersPerDegree * std::cos( pt.lat * M_PI / 180.0 );
+    double radius_squared = radius_ * radius_;
+    int64_t row = row_of( pt.lat );
+
+    for (int64_t r = row - 1; r <= row + 1; ++r) {
+        int64_t col = col_of( r, pt.lon );
+        for (int64_t c = col - 1; c <= col + 1; ++c) {
+            uint64_t key = cell_key( r, c );
+            for (uint32_t z = zones_.first( key ); z != kNone; z = zones_.slots[z].hash_next) {
+                if (zones_.slots[z].key != key) {
+                    continue;
+                }
+
+                double dlat = (pt.lat - centers_[z].lat) * kMetersPerDegree;
+                double dlon = (pt.lon - centers_[z].lon) * meters_per_lon;
+                if (dlat * dlat + dlon * dlon <= radius_squared) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+void PrivacyZones::expire( int64_t time )
+{
+    if (now_ == std::numeric_limits<int64_t>::min()) {
+        now_ = time;
+        return;
+    }
+
+    if (time <= now_) {
+        return;
+    }
+
+    // every bucket is visited at most once, however far time jumps.
+    std::size_t mask = zones_.wheel.size() - 1;
+    uint64_t steps = std::min<uint64_t>( static_cast<uint64_t>( time - now_ ), zones_.wheel.size() );
+    for (uint64_t i = 1; i <= steps; ++i) {
+        std::size_t bucket = static_cast<std::size_t>( static_cast<uint64_t>( now_ ) + i ) & mask;
+        zones_.expire_bucket( bucket, time );
+        vehicles_.expire_bucket( bucket, time );
+    }
+
+    now_ = time;
+}
+
+double PrivacyZones::radius() const
+{
+    return radius_;
+}
+
+int64_t PrivacyZones::duration() const
+{
+    return duration_;
+}
+
+std::size_t PrivacyZones::capacity() const
+{
+    return zones_.slots.size();
+}
+
+std::size_t PrivacyZones::zone_count() const
+{
+    return zones_.count;
+}
+
+std::size_t PrivacyZones::vehicle_count() const
+{
+    return vehicles_.count;
+}
+
+uint64_t PrivacyZones::evictions() const
+{
+    return evictions_;
+}
+
+std::size_t PrivacyZones::memory_usage() const
+{
+    return zones_.memory_usage() + vehicles_.memory_usage() + centers_.capacity() * sizeof(geo::Point);
+}
@@ -13,19 +13,28 @@
 
 #include <memory>
 #include <bitset>
+#include <cstring>
 #include <sstream>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <vector>
 // #include <iterator>
-// #include <algorithm>
+#include <algorithm>
 #include <regex>
 #include <iomanip>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <unistd.h>
 
 #include "cvlib.hpp"
 #include "bsmHandler.hpp"
 #include "bsm.hpp"
+#include "geofenceSlot.hpp"
+#include "geofenceReloader.hpp"
+#include "geofenceShare.hpp"
+#include "geofenceTiles.hpp"
 
 static std::shared_ptr<PpmLogger> testLogger = std::make_shared<PpmLogger>("test.log");
 
@@ -949,10 +958,1346 @@ TEST_CASE("Quad Tree", "[quad]") {
         CHECK(Quad::retrieve_all_bounds(quad_ptr, false, true).size() == 3);
         CHECK(Quad::retrieve_all_bounds(quad_ptr, true, true).size() == 2);
     }
+
+    SECTION("Removal and Merging") {
+        geo::Location loc{35.951959, -83.931815, 0};
+
+        // Fill up a single leaf. 4-way split.
+        for (uint32_t i = 0; i < Quad::MAX_ELEMENTS + 1; ++i) {
+            geo::Location::Ptr test_loc_ptr = std::make_shared<geo::Location>(35.951959, -83.931815, i);
+            Quad::insert(quad_ptr_2, test_loc_ptr);
+        }
+        REQUIRE(Quad::retrieve_all_bounds(quad_ptr_2, true).size() == 4);
+
+        // changes to a clone do not change the original.
+        Quad::Ptr clone_ptr = Quad::clone(*quad_ptr_2);
+        CHECK(Quad::retrieve_all_bounds(clone_ptr, true).size() == 4);
+        CHECK(clone_ptr->retrieve_elements(loc).size() == Quad::MAX_ELEMENTS + 1);
+
+        // remove by geometry and by identifier.
+        CHECK(Quad::remove(clone_ptr, std::make_shared<geo::Location>(35.951959, -83.931815, 0)));
+        CHECK_FALSE(Quad::remove(clone_ptr, std::make_shared<geo::Location>(35.951959, -83.931815, 0)));
+        CHECK(Quad::remove(clone_ptr, "location", 1));
+        CHECK_FALSE(Quad::remove(clone_ptr, "location", 1));
+        CHECK_FALSE(Quad::remove(clone_ptr, "circle", 2));
+        CHECK(clone_ptr->retrieve_elements(loc).size() == Quad::MAX_ELEMENTS - 1);
+
+        // children merge once they hold half of the maximum.
+        for (uint32_t i = 2; i < Quad::MAX_ELEMENTS / 2; ++i) {
+            CHECK(Quad::remove(clone_ptr, "location", i));
+        }
+        CHECK(Quad::retrieve_all_bounds(clone_ptr, true).size() == 4);
+        CHECK(Quad::remove(clone_ptr, "location", Quad::MAX_ELEMENTS / 2));
+        CHECK(Quad::retrieve_all_bounds(clone_ptr, true).size() == 1);
+        CHECK(clone_ptr->retrieve_elements(loc).size() == Quad::MAX_ELEMENTS / 2);
+
+        CHECK(Quad::retrieve_all_bounds(quad_ptr_2, true).size() == 4);
+        CHECK(quad_ptr_2->retrieve_elements(loc).size() == Quad::MAX_ELEMENTS + 1);
+    }
+}
+
+TEST_CASE( "Shape Delta File", "[quad][shapefile][delta]" ) {
+    auto count = []( const geo::Entity::PtrList& element_list, const std::string& type, uint64_t uid ) {
+        return std::count_if( element_list.begin(), element_list.end(), [&]( const geo::Entity::CPtr& e ) {
+            return e->get_type() == type && e->get_uid() == uid;
+        });
+    };
+
+    shapes::CSVInputFactory shape_factory{ "unit-test-data/test-data/test.shapes" };
+    shape_factory.make_shapes();
+
+    Quad::Ptr quad_ptr = std::make_shared<Quad>( geo::Point{ 42.27, -83.95 }, geo::Point{ 42.45, -83.65 } );
+    for (auto& circle_ptr : shape_factory.get_circles()) Quad::insert( quad_ptr, circle_ptr );
+    for (auto& edge_ptr : shape_factory.get_edges()) Quad::insert( quad_ptr, edge_ptr );
+    for (auto& grid_ptr : shape_factory.get_grids()) Quad::insert( quad_ptr, grid_ptr );
+
+    shapes::CSVDeltaFactory delta_factory{ "unit-test-data/test-data/test.delta" };
+    delta_factory.make_changes();
+
+    // the unknown operation and the add without a geography are skipped.
+    const std::vector<shapes::CSVDeltaFactory::Change>& changes = delta_factory.get_changes();
+    REQUIRE( changes.size() == 6 );
+    CHECK( changes[0].op == shapes::CSVDeltaFactory::Operation::REMOVE );
+    CHECK_FALSE( changes[0].entity_ptr );
+    CHECK( changes[1].entity_ptr );
+    CHECK( changes[2].op == shapes::CSVDeltaFactory::Operation::ADD );
+    CHECK( changes[4].uid == geo::Grid::make_uid( 0, 1 ) );
+
+    geo::Point circle_center{ 42.283135, -83.735670 };
+    geo::Point edge_point{ 42.293553, -83.734748 };
+    geo::Point grid_point{ 42.427, -83.89 };
+
+    CHECK( count( quad_ptr->retrieve_elements( circle_center ), "circle", 0 ) == 1 );
+    CHECK( count( quad_ptr->retrieve_elements( grid_point ), "grid", geo::Grid::make_uid( 0, 1 ) ) == 1 );
+
+    // the removal of an unknown circle does not count.
+    CHECK( delta_factory.apply_changes( quad_ptr ) == 5 );
+
+    CHECK( count( quad_ptr->retrieve_elements( circle_center ), "circle", 0 ) == 0 );
+    CHECK( count( quad_ptr->retrieve_elements( circle_center ), "circle", 7 ) == 1 );
+    CHECK( count( quad_ptr->retrieve_elements( edge_point ), "edge", 70297 ) == 0 );
+    CHECK( count( quad_ptr->retrieve_elements( grid_point ), "grid", geo::Grid::make_uid( 0, 1 ) ) == 0 );
+
+    // the add replaced the edge.
+    geo::Entity::PtrList element_list = quad_ptr->retrieve_elements( edge_point );
+    REQUIRE( count( element_list, "edge", 70296 ) == 1 );
+    for (auto& e : element_list) {
+        if (e->get_type() == "edge" && e->get_uid() == 70296) {
+            CHECK( std::static_pointer_cast<const geo::Edge>( e )->get_way_type() == osm::Highway::PRIMARY );
+        }
+    }
+
+    // across regions each change counts once, however many regions it changes, and an add in no region is reported.
+    auto make_region = [&shape_factory]( const geo::Point& sw, const geo::Point& ne ) {
+        Quad::Ptr region_ptr = std::make_shared<Quad>( sw, ne );
+        for (auto& circle_ptr : shape_factory.get_circles()) Quad::insert( region_ptr, circle_ptr );
+        for (auto& edge_ptr : shape_factory.get_edges()) Quad::insert( region_ptr, edge_ptr );
+        for (auto& grid_ptr : shape_factory.get_grids()) Quad::insert( region_ptr, grid_ptr );
+        return region_ptr;
+    };
+
+    std::vector<Quad::Ptr> regions{ make_region( geo::Point{ 42.27, -83.95 }, geo::Point{ 42.45, -83.65 } ),
+                                    make_region( geo::Point{ 42.27, -83.95 }, geo::Point{ 42.45, -83.65 } ),
+                                    make_region( geo::Point{ 10.0, 10.0 }, geo::Point{ 11.0, 11.0 } ) };
+    std::vector<const shapes::CSVDeltaFactory::Change*> unplaced;
+    CHECK( delta_factory.apply_changes( regions, unplaced ) == 5 );
+    CHECK( unplaced.empty() );
+    CHECK( count( regions[1]->retrieve_elements( circle_center ), "circle", 7 ) == 1 );
+
+    std::vector<Quad::Ptr> far{ make_region( geo::Point{ 10.0, 10.0 }, geo::Point{ 11.0, 11.0 } ) };
+    CHECK( delta_factory.apply_changes( far, unplaced ) == 0 );
+    REQUIRE( unplaced.size() == 2u );
+    CHECK( unplaced[0]->uid == 7u );
+    CHECK( unplaced[1]->uid == 70296u );
+}
+
+TEST_CASE( "Road Graph", "[quad][graph]" ) {
+    shapes::CSVInputFactory object_factory{ "unit-test-data/test-data/test.shapes" };
+    object_factory.make_shapes();
+
+    shapes::CSVInputFactory graph_factory{ "unit-test-data/test-data/test.shapes", true };
+    graph_factory.make_shapes();
+
+    // the other shapes are loaded the same way.
+    CHECK( graph_factory.get_circles().size() == object_factory.get_circles().size() );
+    CHECK( graph_factory.get_grids().size() == object_factory.get_grids().size() );
+    CHECK( graph_factory.get_edges().empty() );
+    CHECK_FALSE( object_factory.get_graph() );
+
+    geo::RoadGraph::CPtr graph_ptr = graph_factory.get_graph();
+    REQUIRE( graph_ptr );
+    CHECK( graph_ptr->is_final() );
+    CHECK( graph_ptr->vertex_count() == 5 );
+    REQUIRE( graph_ptr->edge_count() == 4 );
+    REQUIRE( graph_factory.get_graph_edges().size() == 4 );
+
+    // a chain of four edges: the ends have degree 1, the interior vertices degree 2.
+    uint32_t degree_1 = 0;
+    uint32_t degree_2 = 0;
+    for (uint32_t v = 0; v < graph_ptr->vertex_count(); ++v) {
+        if (graph_ptr->degree(v) == 1) ++degree_1;
+        if (graph_ptr->degree(v) == 2) ++degree_2;
+        for (uint32_t e : graph_ptr->incident_edges(v)) {
+            CHECK( (graph_ptr->edge_v1(e) == v || graph_ptr->edge_v2(e) == v) );
+        }
+    }
+    CHECK( degree_1 == 2 );
+    CHECK( degree_2 == 3 );
+
+    for (uint32_t e = 0; e < graph_ptr->edge_count(); ++e) {
+        geo::EdgeCPtr edge_ptr = object_factory.get_edges()[e];
+        geo::GraphEdge::CPtr graph_edge_ptr = graph_factory.get_graph_edges()[e];
+
+        CHECK( graph_edge_ptr->get_type() == "edge" );
+        CHECK( graph_edge_ptr->get_uid() == edge_ptr->get_uid() );
+        CHECK( graph_edge_ptr->get_way_type() == edge_ptr->get_way_type() );
+        CHECK( graph_ptr->vertex_uid( graph_ptr->edge_v1(e) ) == edge_ptr->v1->uid );
+        CHECK( graph_ptr->vertex_uid( graph_ptr->edge_v2(e) ) == edge_ptr->v2->uid );
+        CHECK( graph_ptr->degree( graph_ptr->edge_v1(e) ) == edge_ptr->v1->degree() );
+
+        // the same area is made from either representation.
+        const std::vector<geo::Point>& edge_corners = edge_ptr->to_area(5.2)->get_corners();
+        const std::vector<geo::Point>& graph_corners = graph_edge_ptr->to_area(5.2)->get_corners();
+        REQUIRE( graph_corners.size() == edge_corners.size() );
+        for (std::size_t c = 0; c < edge_corners.size(); ++c) {
+            CHECK( graph_corners[c].lat == Approx( edge_corners[c].lat ) );
+            CHECK( graph_corners[c].lon == Approx( edge_corners[c].lon ) );
+        }
+
+        geo::Bounds bounds{ geo::Point{ 42.29, -83.74 }, geo::Point{ 42.30, -83.73 } };
+        CHECK( graph_edge_ptr->touches( bounds ) == edge_ptr->touches( bounds ) );
+    }
+
+    // the graph is built incrementally and then frozen.
+    geo::RoadGraph graph;
+    uint32_t a = graph.add_vertex( 10, 35.952500, -83.932434 );
+    uint32_t b = graph.add_vertex( 20, 35.948878, -83.928081 );
+    CHECK( graph.add_vertex( 10, 35.952500, -83.932434 ) == a );
+    CHECK( graph.find_vertex( 20 ) == b );
+    CHECK( graph.find_vertex( 30 ) == geo::RoadGraph::kNoIndex );
+    CHECK_THROWS_AS( graph.add_edge( a, 7, osm::Highway::SECONDARY, 1 ), std::out_of_range );
+    CHECK( graph.add_edge( a, b, osm::Highway::SECONDARY, 1 ) == 0 );
+    graph.finalize();
+    CHECK( graph.degree( a ) == 1 );
+    CHECK_THROWS_AS( graph.add_vertex( 30, 35.0, -83.0 ), std::logic_error );
+}
+
+TEST_CASE( "Geometric Predicates", "[quad][predicates]" ) {
+    using namespace geo::predicates;
+
+    geo::Point sw{ 35.0, -84.0 };
+    geo::Point ne{ 36.0, -83.0 };
+
+    CHECK( box_contains( sw, ne, geo::Point{ 35.5, -83.5 } ) );
+    CHECK( box_contains( sw, ne, sw ) );
+    CHECK_FALSE( box_contains( sw, ne, geo::Point{ 36.1, -83.5 } ) );
+
+    // crossing, touching at an end, parallel, and disjoint segments.
+    CHECK( segments_intersect( geo::Point{ 0.0, 0.0 }, geo::Point{ 1.0, 1.0 }, geo::Point{ 0.0, 1.0 }, geo::Point{ 1.0, 0.0 } ) );
+    CHECK( segments_intersect( geo::Point{ 0.0, 0.0 }, geo::Point{ 1.0, 1.0 }, geo::Point{ 1.0, 1.0 }, geo::Point{ 2.0, 0.0 } ) );
+    CHECK_FALSE( segments_intersect( geo::Point{ 0.0, 0.0 }, geo::Point{ 1.0, 1.0 }, geo::Point{ 0.0, 1.0 }, geo::Point{ 1.0, 2.0 } ) );
+    CHECK_FALSE( segments_intersect( geo::Point{ 0.0, 0.0 }, geo::Point{ 1.0, 1.0 }, geo::Point{ 2.0, 0.0 }, geo::Point{ 3.0, -1.0 } ) );
+
+    // a segment passing through the box with both ends outside crosses it; one inside touches it.
+    CHECK( box_crosses_segment( sw, ne, geo::Point{ 35.5, -85.0 }, geo::Point{ 35.5, -82.0 } ) );
+    CHECK_FALSE( box_crosses_segment( sw, ne, geo::Point{ 35.4, -83.6 }, geo::Point{ 35.6, -83.4 } ) );
+    CHECK( box_touches_segment( sw, ne, geo::Point{ 35.4, -83.6 }, geo::Point{ 35.6, -83.4 } ) );
+    CHECK_FALSE( box_touches_segment( sw, ne, geo::Point{ 37.0, -85.0 }, geo::Point{ 37.0, -82.0 } ) );
+
+    // the kernels agree with the entity methods that use them.
+    geo::Bounds bounds{ sw, ne };
+    geo::Edge edge{ geo::Vertex{ 35.5, -85.0 }, geo::Vertex{ 35.5, -82.0 } };
+    CHECK( edge.touches( bounds ) );
+    CHECK( bounds.intersects( edge ) );
+
+    geo::Point corners[4] = { geo::Point{ 35.2, -83.8 }, geo::Point{ 35.8, -83.8 }, geo::Point{ 35.8, -83.2 }, geo::Point{ 35.2, -83.2 } };
+    geo::Area area{ corners[0], corners[1], corners[2], corners[3] };
+    CHECK( area_contains( corners, geo::Point{ 35.5, -83.5 } ) );
+    CHECK_FALSE( area_contains( corners, geo::Point{ 35.9, -83.5 } ) );
+    CHECK( area.contains( geo::Point{ 35.5, -83.5 } ) );
+    CHECK( box_touches_area( sw, ne, corners ) );
+    CHECK( area.touches( bounds ) );
+    CHECK_FALSE( box_touches_area( geo::Point{ 37.0, -84.0 }, geo::Point{ 38.0, -83.0 }, corners ) );
+
+    // boxes that overlap in a cross have no corner inside each other.
+    CHECK( boxes_overlap( sw, ne, geo::Point{ 34.0, -83.6 }, geo::Point{ 37.0, -83.4 } ) );
+    CHECK( geo::Grid( geo::Point{ 34.0, -83.6 }, geo::Point{ 37.0, -83.4 }, 0, 0 ).touches( bounds ) );
+    CHECK_FALSE( boxes_overlap( sw, ne, geo::Point{ 37.0, -84.0 }, geo::Point{ 38.0, -83.0 } ) );
+}
+
+TEST_CASE( "Batch Geodesy", "[quad][geodesy]" ) {
+    // pairs of locations from a millimeter to a thousand kilometers apart, and projections up to a thousand kilometers.
+    const std::size_t n = 2000;
+    std::vector<double> lat1( n ), lon1( n ), lat2( n ), lon2( n ), bearing( n ), distance( n );
+
+    for (std::size_t i = 0; i < n; ++i) {
+        double spread = std::pow( 10.0, -static_cast<double>( i % 8 ) ) * 10.0;
+        lat1[i] = -85.0 + 170.0 * std::fmod( i * 0.618034, 1.0 );
+        lon1[i] = -180.0 + 360.0 * std::fmod( i * 0.414214, 1.0 );
+        lat2[i] = std::max( -85.0, std::min( 85.0, lat1[i] + spread * std::sin( i * 1.7 ) ) );
+        lon2[i] = lon1[i] + spread * std::cos( i * 2.3 );
+        bearing[i] = 360.0 * std::fmod( i * 0.732051, 1.0 );
+        distance[i] = 1.0e6 * std::fmod( i * 0.236068, 1.0 );
+    }
+
+    std::vector<double> out1( n ), out2( n );
+
+    // the batch results agree with the Location methods to within the rounding of the two.
+    geo::batch::distance( lat1.data(), lon1.data(), lat2.data(), lon2.data(), out1.data(), n );
+    for (std::size_t i = 0; i < n; ++i) {
+        double expected = geo::Location::distance( lat1[i], lon1[i], lat2[i], lon2[i] );
+        CHECK( std::fabs( out1[i] - expected ) <= 1.0e-8 * expected + 1.0e-8 );
+    }
+
+    geo::batch::distance_haversine( lat1.data(), lon1.data(), lat2.data(), lon2.data(), out1.data(), n );
+    for (std::size_t i = 0; i < n; ++i) {
+        double expected = geo::Location::distance_haversine( lat1[i], lon1[i], lat2[i], lon2[i] );
+        CHECK( std::fabs( out1[i] - expected ) <= 1.0e-8 * expected + 1.0e-8 );
+    }
+
+    // a bearing's rounding grows as the locations get closer.
+    geo::batch::bearing( lat1.data(), lon1.data(), lat2.data(), lon2.data(), out1.data(), n );
+    for (std::size_t i = 0; i < n; ++i) {
+        double expected = geo::Location::bearing( lat1[i], lon1[i], lat2[i], lon2[i] );
+        double delta = std::fabs( out1[i] - expected );
+        CHECK( out1[i] >= 0.0 );
+        CHECK( out1[i] < 360.0 );
+        CHECK( std::min( delta, 360.0 - delta ) * geo::Location::distance( lat1[i], lon1[i], lat2[i], lon2[i] ) <= 1.0e-6 );
+    }
+
+    geo::batch::project_position( lat1.data(), lon1.data(), bearing.data(), distance.data(), out1.data(), out2.data(), n );
+    for (std::size_t i = 0; i < n; ++i) {
+        geo::Location expected = geo::Location::project_position( lat1[i], lon1[i], bearing[i], distance[i] );
+        double delta = std::fabs( out2[i] - expected.lon );
+        CHECK( std::fabs( out1[i] - expected.lat ) <= 1.0e-9 );
+        CHECK( std::min( delta, 360.0 - delta ) <= 1.0e-9 );
+    }
+
+    // the segment areas have the corners of Edge::make_area, with and without an extension.
+    std::vector<double> width( n, 10.0 );
+    std::vector<geo::Point> corners( 4 * n );
+
+    for (double extension : { 0.0, 5.2 }) {
+        geo::batch::segment_areas( lat1.data(), lon1.data(), lat2.data(), lon2.data(), width.data(), extension, corners.data(), n );
+
+        for (std::size_t i = 0; i < n; i += 7) {
+            geo::AreaPtr area_ptr = geo::Edge::make_area( geo::Location{ lat1[i], lon1[i] }, geo::Location{ lat2[i], lon2[i] }, width[i], extension );
+
+            for (std::size_t c = 0; c < 4; ++c) {
+                CHECK( corners[4 * i + c].lat == Approx( area_ptr->get_corners()[c].lat ).margin( 1.0e-11 ) );
+                CHECK( corners[4 * i + c].lon == Approx( area_ptr->get_corners()[c].lon ).margin( 1.0e-11 ) );
+            }
+        }
+    }
+
+    // nothing is read or written for no inputs.
+    geo::batch::distance( nullptr, nullptr, nullptr, nullptr, nullptr, 0 );
+    geo::batch::segment_areas( nullptr, nullptr, nullptr, nullptr, nullptr, 0.0, nullptr, 0 );
+}
+
+TEST_CASE( "Batch Geodesy Benchmark", "[.][benchmark][geodesy]" ) {
+    // run with: ppm_tests "[benchmark]"
+    const std::size_t n = 1 << 16;
+    const int rounds = 20;
+    std::vector<double> lat1( n ), lon1( n ), lat2( n ), lon2( n ), out( n ), out2( n );
+
+    for (std::size_t i = 0; i < n; ++i) {
+        lat1[i] = 35.0 + std::fmod( i * 0.618034, 1.0 );
+        lon1[i] = -84.0 + std::fmod( i * 0.414214, 1.0 );
+        lat2[i] = lat1[i] + 0.001 * std::sin( i * 1.7 );
+        lon2[i] = lon1[i] + 0.001 * std::cos( i * 2.3 );
+    }
+
+    auto time = [&]( const std::function<void()>& run ) {
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r) run();
+        return std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count() / (rounds * n);
+    };
+
+    double scalar = time( [&]() { for (std::size_t i = 0; i < n; ++i) out[i] = geo::Location::distance( lat1[i], lon1[i], lat2[i], lon2[i] ); } );
+    double batch = time( [&]() { geo::batch::distance( lat1.data(), lon1.data(), lat2.data(), lon2.data(), out.data(), n ); } );
+    std::cout << "distance: " << scalar << " ns scalar, " << batch << " ns batch\n";
+
+    scalar = time( [&]() { for (std::size_t i = 0; i < n; ++i) out[i] = geo::Location::distance_haversine( lat1[i], lon1[i], lat2[i], lon2[i] ); } );
+    batch = time( [&]() { geo::batch::distance_haversine( lat1.data(), lon1.data(), lat2.data(), lon2.data(), out.data(), n ); } );
+    std::cout << "distance_haversine: " << scalar << " ns scalar, " << batch << " ns batch\n";
+
+    scalar = time( [&]() { for (std::size_t i = 0; i < n; ++i) out[i] = geo::Location::bearing( lat1[i], lon1[i], lat2[i], lon2[i] ); } );
+    batch = time( [&]() { geo::batch::bearing( lat1.data(), lon1.data(), lat2.data(), lon2.data(), out.data(), n ); } );
+    std::cout << "bearing: " << scalar << " ns scalar, " << batch << " ns batch\n";
+
+    scalar = time( [&]() {
+        for (std::size_t i = 0; i < n; ++i) {
+            geo::Location location = geo::Location::project_position( lat1[i], lon1[i], lon2[i] + 84.0, 100.0 );
+            out[i] = location.lat;
+            out2[i] = location.lon;
+        }
+    } );
+    std::vector<double> bearing( n ), distance( n, 100.0 );
+    for (std::size_t i = 0; i < n; ++i) bearing[i] = lon2[i] + 84.0;
+    batch = time( [&]() { geo::batch::project_position( lat1.data(), lon1.data(), bearing.data(), distance.data(), out.data(), out2.data(), n ); } );
+    std::cout << "project_position: " << scalar << " ns scalar, " << batch << " ns batch\n";
+
+    std::vector<double> width( n, 10.0 );
+    std::vector<geo::Point> corners( 4 * n );
+    scalar = time( [&]() {
+        for (std::size_t i = 0; i < n; ++i) {
+            geo::AreaPtr area_ptr = geo::Edge::make_area( geo::Location{ lat1[i], lon1[i] }, geo::Location{ lat2[i], lon2[i] }, 10.0, 5.2 );
+            std::copy( area_ptr->get_corners().begin(), area_ptr->get_corners().end(), corners.begin() + 4 * i );
+        }
+    } );
+    batch = time( [&]() { geo::batch::segment_areas( lat1.data(), lon1.data(), lat2.data(), lon2.data(), width.data(), 5.2, corners.data(), n ); } );
+    std::cout << "segment_areas: " << scalar << " ns scalar, " << batch << " ns batch\n";
+
+    CHECK( out.size() == n );
+}
+
+TEST_CASE( "Arena Allocation", "[quad][arena]" ) {
+    geo::Arena::Ptr arena_ptr = std::make_shared<geo::Arena>( 256 );
+
+    // allocations are consecutive and aligned.
+    char* a = static_cast<char*>( arena_ptr->allocate( 3, 1 ) );
+    char* b = static_cast<char*>( arena_ptr->allocate( 8, 8 ) );
+    CHECK( b - a == 8 );
+    CHECK( reinterpret_cast<std::uintptr_t>( b ) % 8 == 0 );
+    CHECK( arena_ptr->bytes_allocated() == 11 );
+    CHECK( arena_ptr->block_count() == 1 );
+
+    // a full block starts a new one; a large request gets a block of its own.
+    arena_ptr->allocate( 250, 1 );
+    CHECK( arena_ptr->block_count() == 2 );
+    arena_ptr->allocate( 1000, 8 );
+    CHECK( arena_ptr->block_count() == 3 );
+    CHECK( arena_ptr->bytes_reserved() == 256 + 256 + 1000 );
+
+    // objects keep the arena alive; it is released with the last one.
+    std::weak_ptr<geo::Arena> arena_ref = arena_ptr;
+    geo::Circle::CPtr circle_ptr = std::allocate_shared<geo::Circle>( geo::ArenaAllocator<geo::Circle>{ arena_ptr }, 35.951250, -83.931861, 10.0 );
+    arena_ptr.reset();
+    CHECK_FALSE( arena_ref.expired() );
+    CHECK( circle_ptr->contains( geo::Point{ 35.951250, -83.931861 } ) );
+    circle_ptr.reset();
+    CHECK( arena_ref.expired() );
+
+    // the shape factory places its shapes in its arena.
+    shapes::CSVInputFactory factory{ "unit-test-data/test-data/test.shapes", true };
+    factory.make_shapes();
+    CHECK( factory.get_arena()->bytes_allocated() >= factory.get_graph_edges().size() * sizeof(geo::GraphEdge) );
+}
+
+TEST_CASE( "Geofence Index", "[quad][geofence]" ) {
+    Quad::Ptr qptr = buildTestQuadTree();
+    Geofence geofence{ qptr, 5.2 };
+
+    // 6 edges, 1 circle, and 1 grid cell; each has one entry however many leaves it is in.
+    CHECK( geofence.shape_count() == 8 );
+    CHECK( geofence.get_extension() == Approx( 5.2 ) );
+    CHECK( &geofence.get_quad() == qptr.get() );
+    CHECK_THROWS_AS( Geofence( nullptr, 5.2 ), std::invalid_argument );
+
+    // the index gives the same answer as checking the entities of the leaf.
+    uint32_t inside = 0;
+    for (int i = 0; i <= 50; ++i) {
+        for (int j = 0; j <= 50; ++j) {
+            geo::Point pt{ 35.946920 + i * (35.955526 - 35.946920) / 50.0, -83.938486 + j * (-83.926738 + 83.938486) / 50.0 };
+
+            const geo::Entity::PtrList& elements = qptr->retrieve_elements( pt );
+            bool expected = false;
+            for (auto& entity_ptr : elements) {
+                if (entity_ptr->get_type() == "edge") {
+                    expected = expected || std::static_pointer_cast<const geo::Edge>( entity_ptr )->to_area( 5.2 )->contains( pt );
+                } else if (entity_ptr->get_type() == "circle") {
+                    expected = expected || std::static_pointer_cast<const geo::Circle>( entity_ptr )->contains( pt );
+                } else if (entity_ptr->get_type() == "grid") {
+                    expected = expected || std::static_pointer_cast<const geo::Grid>( entity_ptr )->contains( pt );
+                }
+            }
+
+            CHECK( geofence.retrieve_shapes( pt ).size() == elements.size() );
+            CHECK( geofence.contains( pt ) == expected );
+            if (expected) ++inside;
+        }
+    }
+    CHECK( inside > 0 );
+
+    // the arrays are in one buffer.
+    CHECK( geofence.memory_usage() >= geofence.node_count() * 4 * sizeof(double) + 8 * sizeof(Geofence::Shape) );
+
+    // outside the root.
+    CHECK( geofence.retrieve_shapes( geo::Point{ 35.964, -83.926 } ).size() == 0 );
+    CHECK_FALSE( geofence.contains( geo::Point{ 35.964, -83.926 } ) );
+}
+
+TEST_CASE( "Geofence Regions", "[quad][geofence]" ) {
+    // a second region far from the first with one circle.
+    Quad::Ptr other_ptr = std::make_shared<Quad>( geo::Point{ 41.0, -105.0 }, geo::Point{ 41.2, -104.8 } );
+    Quad::insert( other_ptr, std::make_shared<geo::Circle>( 41.1, -104.9, 100.0 ) );
+
+    Geofence geofence{ std::vector<Quad::CPtr>{ buildTestQuadTree(), other_ptr }, 5.2 };
+    CHECK( geofence.region_count() == 2 );
+    CHECK( geofence.shape_count() == 9 );
+    CHECK( &geofence.get_quad( 1 ) == other_ptr.get() );
+    CHECK_THROWS_AS( geofence.get_quad( 2 ), std::out_of_range );
+    CHECK_THROWS_AS( Geofence( std::vector<Quad::CPtr>{}, 5.2 ), std::invalid_argument );
+
+    // on A - B in the first region, in the circle of the second, and outside both.
+    CHECK( geofence.contains( geo::Point{ 35.951090, -83.930716 } ) );
+    CHECK( geofence.contains( geo::Point{ 41.1, -104.9 } ) );
+    CHECK_FALSE( geofence.contains( geo::Point{ 41.15, -104.85 } ) );
+    CHECK_FALSE( geofence.contains( geo::Point{ 38.0, -95.0 } ) );
+    CHECK( geofence.retrieve_shapes( geo::Point{ 41.1, -104.9 } ).size() == 1 );
+
+    // region boundaries can be computed from the shapes.
+    shapes::CSVInputFactory factory{ "unit-test-data/test-data/test.shapes" };
+    factory.make_shapes();
+    geo::Bounds bounds;
+    REQUIRE( factory.get_bounds( bounds ) );
+    for (auto& edge_ptr : factory.get_edges()) {
+        CHECK( bounds.contains( *edge_ptr->v1 ) );
+        CHECK( bounds.contains( *edge_ptr->v2 ) );
+    }
+    for (auto& circle_ptr : factory.get_circles()) {
+        CHECK( bounds.contains( *circle_ptr ) );
+    }
+
+    shapes::CSVInputFactory empty_factory;
+    CHECK_FALSE( empty_factory.get_bounds( bounds ) );
+}
+
+TEST_CASE( "Geofence Image", "[quad][geofence]" ) {
+    Quad::Ptr other_ptr = std::make_shared<Quad>( geo::Point{ 41.0, -105.0 }, geo::Point{ 41.2, -104.8 } );
+    Quad::insert( other_ptr, std::make_shared<geo::Circle>( 41.1, -104.9, 100.0 ) );
+    Geofence geofence{ std::vector<Quad::CPtr>{ buildTestQuadTree(), other_ptr }, 5.2 };
+    CHECK( geofence.has_source() );
+
+    // a copy of the image at another address answers every query the same way.
+    std::size_t size = geofence.memory_usage();
+    std::shared_ptr<char> copy{ new char[size], std::default_delete<char[]>() };
+    std::memcpy( copy.get(), geofence.image(), size );
+    Geofence attached{ std::shared_ptr<const char>{ copy }, size };
+
+    CHECK_FALSE( attached.has_source() );
+    CHECK_THROWS_AS( attached.get_quad( 0 ), std::out_of_range );
+    CHECK( attached.region_count() == 2 );
+    CHECK( attached.node_count() == geofence.node_count() );
+    CHECK( attached.shape_count() == geofence.shape_count() );
+    CHECK( attached.get_extension() == 5.2 );
+
+    for (double lat = 35.946; lat < 35.956; lat += 0.0002) {
+        for (double lon = -83.939; lon < -83.926; lon += 0.0002) {
+            CHECK( attached.contains( geo::Point{ lat, lon } ) == geofence.contains( geo::Point{ lat, lon } ) );
+        }
+    }
+    CHECK( attached.contains( geo::Point{ 41.1, -104.9 } ) );
+    CHECK_FALSE( attached.contains( geo::Point{ 38.0, -95.0 } ) );
+
+    // only complete images of this version are used.
+    CHECK_THROWS_AS( Geofence( std::shared_ptr<const char>{}, size ), std::invalid_argument );
+    CHECK_THROWS_AS( Geofence( std::shared_ptr<const char>{ copy }, size - 16 ), std::invalid_argument );
+    copy.get()[0] = 'X';
+    CHECK_THROWS_AS( Geofence( std::shared_ptr<const char>{ copy }, size ), std::invalid_argument );
+}
+
+TEST_CASE( "Geofence Pages", "[quad][geofence]" ) {
+    Geofence normal{ std::vector<Quad::CPtr>{ buildTestQuadTree() }, 5.2 };
+    CHECK( normal.page_mode() == geo::PageMode::NORMAL );
+    CHECK( normal.warm_up() >= 1 );
+    CHECK( normal.warm_up() <= normal.memory_usage() / geo::page_size( geo::PageMode::NORMAL ) + 2 );
+
+    // huge pages may not be available here; whatever is used must give the same answers.
+    for (auto requested : { geo::PageMode::TRANSPARENT_HUGE, geo::PageMode::EXPLICIT_HUGE }) {
+        Geofence geofence{ std::vector<Quad::CPtr>{ buildTestQuadTree() }, 5.2, requested };
+        CHECK( static_cast<int>( geofence.page_mode() ) <= static_cast<int>( requested ) );
+        CHECK( geofence.warm_up() >= 1 );
+
+        if (geofence.page_mode() != geo::PageMode::NORMAL) {
+            CHECK( reinterpret_cast<std::uintptr_t>( geofence.image() ) % geo::kHugePageSize == 0 );
+            CHECK( geofence.warm_up() == 1 );
+        }
+
+        for (double lat = 35.946; lat < 35.956; lat += 0.0005) {
+            for (double lon = -83.939; lon < -83.926; lon += 0.0005) {
+                CHECK( geofence.contains( geo::Point{ lat, lon } ) == normal.contains( geo::Point{ lat, lon } ) );
+            }
+        }
+    }
+}
+
+TEST_CASE( "Geofence Classify", "[quad][geofence]" ) {
+    Quad::Ptr other_ptr = std::make_shared<Quad>( geo::Point{ 41.0, -105.0 }, geo::Point{ 41.2, -104.8 } );
+    Quad::insert( other_ptr, std::make_shared<geo::Circle>( 41.1, -104.9, 100.0 ) );
+    Quad::insert( other_ptr, std::make_shared<geo::Grid>( geo::Point{ 41.15, -104.85 }, geo::Point{ 41.16, -104.84 }, 1, 1 ) );
+    Geofence geofence{ std::vector<Quad::CPtr>{ buildTestQuadTree(), other_ptr }, 5.2 };
+
+    // every point of a classified cell must have the cell's answer.
+    int inside = 0;
+    int outside = 0;
+    const double step = 0.00002;
+    for (double lat = 35.946; lat < 35.956; lat += step) {
+        for (double lon = -83.939; lon < -83.926; lon += step) {
+            Geofence::Cover cover = geofence.classify( geo::Point{ lat, lon }, geo::Point{ lat + step, lon + step } );
+            if (cover == Geofence::Cover::MIXED) continue;
+
+            cover == Geofence::Cover::INSIDE ? ++inside : ++outside;
+            for (double f : { 0.0, 0.3, 0.7, 1.0 }) {
+                for (double g : { 0.0, 0.5, 1.0 }) {
+                    REQUIRE( geofence.contains( geo::Point{ lat + f * step, lon + g * step } ) == (cover == Geofence::Cover::INSIDE) );
+                }
+            }
+        }
+    }
+    CHECK( inside > 0 );
+    CHECK( outside > 0 );
+
+    CHECK( geofence.classify( geo::Point{ 38.0, -95.0 }, geo::Point{ 38.001, -94.999 } ) == Geofence::Cover::OUTSIDE );
+    CHECK( geofence.classify( geo::Point{ 41.1, -104.9 }, geo::Point{ 41.10001, -104.89999 } ) == Geofence::Cover::INSIDE );
+    CHECK( geofence.classify( geo::Point{ 41.152, -104.848 }, geo::Point{ 41.153, -104.847 } ) == Geofence::Cover::INSIDE );
+    CHECK( geofence.classify( geo::Point{ 41.159, -104.841 }, geo::Point{ 41.161, -104.839 } ) == Geofence::Cover::MIXED );
+    CHECK( geofence.classify( geo::Point{ 41.18, -104.82 }, geo::Point{ 41.181, -104.819 } ) == Geofence::Cover::OUTSIDE );
+    // crossing a region boundary.
+    CHECK( geofence.classify( geo::Point{ 40.99, -104.9 }, geo::Point{ 41.01, -104.89 } ) == Geofence::Cover::MIXED );
+}
+
+TEST_CASE( "Geofence Grid Lattice", "[quad][geofence]" ) {
+    geo::Location nw{ 35.953642, -83.932832 };
+    geo::Grid::GridPtrVector grids = geo::Grid::build_grid( nw, 10, 35.951853, -83.929975 );
+    REQUIRE( grids.size() == 520 );
+
+    // leave holes in the lattice.
+    Quad::Ptr qptr = std::make_shared<Quad>( geo::Point{ 35.9510, -83.9335 }, geo::Point{ 35.9545, -83.9290 } );
+    std::vector<geo::Grid::CPtr> present;
+    for (std::size_t i = 0; i < grids.size(); ++i) {
+        if (i % 7 == 3 || i % 11 == 5) continue;
+        Quad::insert( qptr, grids[i] );
+        present.push_back( grids[i] );
+    }
+
+    Geofence geofence{ qptr, 10.0 };
+    CHECK( geofence.lattice_cell_count() == present.size() );
+    CHECK( geofence.shape_count() == 0 );
+
+    // the same answers as checking each grid, including points on the cell edges.
+    auto expected = [&present]( const geo::Point& pt ) {
+        for (auto& grid_ptr : present) {
+            if (grid_ptr->contains( pt )) return true;
+        }
+        return false;
+    };
+
+    int inside = 0;
+    for (double lat = 35.9515; lat < 35.9540; lat += 0.000031) {
+        for (double lon = -83.9332; lon < -83.9295; lon += 0.000029) {
+            geo::Point pt{ lat, lon };
+            REQUIRE( geofence.contains( pt ) == expected( pt ) );
+            if (expected( pt )) ++inside;
+        }
+    }
+    CHECK( inside > 0 );
+
+    for (auto& grid_ptr : grids) {
+        for (const geo::Point& corner : { grid_ptr->sw, grid_ptr->ne, geo::Point{ grid_ptr->sw.lat, grid_ptr->ne.lon } }) {
+            REQUIRE( geofence.contains( corner ) == expected( corner ) );
+        }
+    }
+
+    // a lattice cell classifies as inside; a hole as outside.
+    const geo::Grid& cell = *present[10];
+    double dlat = (cell.ne.lat - cell.sw.lat) / 4;
+    double dlon = (cell.ne.lon - cell.sw.lon) / 4;
+    CHECK( geofence.classify( geo::Point{ cell.sw.lat + dlat, cell.sw.lon + dlon }, geo::Point{ cell.ne.lat - dlat, cell.ne.lon - dlon } ) == Geofence::Cover::INSIDE );
+    const geo::Grid& hole = *grids[3];
+    CHECK( geofence.classify( geo::Point{ hole.sw.lat + dlat, hole.sw.lon + dlon }, geo::Point{ hole.ne.lat - dlat, hole.ne.lon - dlon } ) == Geofence::Cover::OUTSIDE );
+
+    // the lattice survives the image.
+    std::shared_ptr<char> copy{ new char[geofence.memory_usage()], std::default_delete<char[]>() };
+    std::memcpy( copy.get(), geofence.image(), geofence.memory_usage() );
+    Geofence attached{ std::shared_ptr<const char>{ copy }, geofence.memory_usage() };
+    CHECK( attached.lattice_cell_count() == present.size() );
+    CHECK( attached.contains( geo::Point{ (cell.sw.lat + cell.ne.lat) / 2, (cell.sw.lon + cell.ne.lon) / 2 } ) );
+
+    // grids that do not fit a lattice are indexed as shapes.
+    Quad::Ptr irregular_ptr = std::make_shared<Quad>( geo::Point{ 35.9510, -83.9335 }, geo::Point{ 35.9545, -83.9290 } );
+    for (std::size_t i = 0; i < 8; ++i) {
+        Quad::insert( irregular_ptr, grids[i] );
+    }
+    Quad::insert( irregular_ptr, std::make_shared<geo::Grid>( geo::Point{ 35.9520, -83.9310 }, geo::Point{ 35.9521, -83.9300 }, 3, 3 ) );
+    Geofence irregular{ irregular_ptr, 10.0 };
+    CHECK( irregular.lattice_cell_count() == 0 );
+    CHECK( irregular.shape_count() == 9 );
+    CHECK( irregular.contains( geo::Point{ 35.95205, -83.9305 } ) );
+}
+
+TEST_CASE( "Geofence Polylines", "[quad][geofence][polyline]" ) {
+    shapes::CSVInputFactory edge_factory{ "unit-test-data/test-data/test.shapes" };
+    edge_factory.make_shapes();
+
+    // the four chained edges of way 234816700 become one polyline named by the first edge.
+    shapes::CSVInputFactory polyline_factory{ "unit-test-data/test-data/test.shapes", false, true };
+    polyline_factory.make_shapes();
+    CHECK( polyline_factory.get_edges().empty() );
+    CHECK( polyline_factory.get_circles().size() == edge_factory.get_circles().size() );
+    CHECK( polyline_factory.get_grids().size() == edge_factory.get_grids().size() );
+    REQUIRE( polyline_factory.get_polylines().size() == 1 );
+
+    geo::Polyline::CPtr polyline_ptr = polyline_factory.get_polylines()[0];
+    CHECK( polyline_ptr->get_type() == "polyline" );
+    CHECK( polyline_ptr->get_uid() == 70296 );
+    CHECK( polyline_ptr->get_way_type() == osm::Highway::SECONDARY );
+    REQUIRE( polyline_ptr->segment_count() == 4 );
+    for (std::size_t s = 0; s < 4; ++s) {
+        CHECK( polyline_ptr->get_vertices()[s].uid == edge_factory.get_edges()[s]->v1->uid );
+        CHECK( polyline_ptr->get_vertices()[s + 1].uid == edge_factory.get_edges()[s]->v2->uid );
+    }
+    CHECK_THROWS_AS( geo::Polyline( std::vector<geo::Location>{ geo::Location{ 42.29, -83.73, 1 } }, osm::Highway::SECONDARY, 1 ), std::invalid_argument );
+
+    geo::Bounds edge_bounds;
+    geo::Bounds polyline_bounds;
+    REQUIRE( edge_factory.get_bounds( edge_bounds ) );
+    REQUIRE( polyline_factory.get_bounds( polyline_bounds ) );
+    CHECK( polyline_bounds.sw.lat == edge_bounds.sw.lat );
+    CHECK( polyline_bounds.ne.lon == edge_bounds.ne.lon );
+
+    // enough small circles to split the trees, so the polyline is split into runs across several leaves.
+    Quad::Ptr edge_ptr = std::make_shared<Quad>( geo::Point{ 42.2878, -83.7402 }, geo::Point{ 42.2998, -83.7282 } );
+    Quad::Ptr polyline_quad_ptr = std::make_shared<Quad>( geo::Point{ 42.2878, -83.7402 }, geo::Point{ 42.2998, -83.7282 } );
+    for (auto& e : edge_factory.get_edges()) {
+        Quad::insert( edge_ptr, std::dynamic_pointer_cast<const geo::Entity>( e ) );
+    }
+    Quad::insert( polyline_quad_ptr, polyline_ptr );
+    for (int i = 0; i < 40; ++i) {
+        geo::Circle::CPtr circle_ptr = std::make_shared<geo::Circle>( 42.2927 + i * 0.00002, -83.7350 + i * 0.00008, 0.5 );
+        Quad::insert( edge_ptr, circle_ptr );
+        Quad::insert( polyline_quad_ptr, circle_ptr );
+    }
+
+    Geofence edges{ edge_ptr, 5.2 };
+    Geofence polylines{ polyline_quad_ptr, 5.2 };
+    CHECK( polylines.node_count() > 1 );
+    CHECK( polylines.shape_count() > 40 + 1 );
+
+    bool found_polyline = false;
+    for (uint32_t s = 0; s < polylines.shape_count(); ++s) {
+        found_polyline = found_polyline || polylines.get_shape( s ).type == Geofence::ShapeType::POLYLINE;
+    }
+    CHECK( found_polyline );
+
+    // the same space is covered either way, and by the image of the polyline index.
+    std::size_t size = polylines.memory_usage();
+    std::shared_ptr<char> copy{ new char[size], std::default_delete<char[]>() };
+    std::memcpy( copy.get(), polylines.image(), size );
+    Geofence attached{ std::shared_ptr<const char>{ copy }, size };
+
+    uint32_t inside = 0;
+    for (double lat = 42.2926; lat < 42.2954; lat += 0.00002) {
+        for (double lon = -83.7359; lon < -83.7321; lon += 0.00002) {
+            geo::Point pt{ lat, lon };
+            bool expected = edges.contains( pt );
+            CHECK( polylines.contains( pt ) == expected );
+            CHECK( attached.contains( pt ) == expected );
+            if (expected) ++inside;
+
+            geo::Point ne{ lat + 0.00001, lon + 0.00001 };
+            Geofence::Cover cover = polylines.classify( pt, ne );
+            if (cover == Geofence::Cover::INSIDE) CHECK( expected );
+            if (cover == Geofence::Cover::OUTSIDE) CHECK_FALSE( expected );
+        }
+    }
+    CHECK( inside > 0 );
+
+    // a way listed out of order is still one chain; a different way or a gap starts another polyline.
+    const std::string path{ "unit-test-data/test-data/test.polyline.shapes" };
+    {
+        std::ofstream file{ path };
+        file << "type,id,geography,attributes\n";
+        file << "edge,3,3;42.2941;-83.7339:4;42.2948;-83.7327,way_type=secondary:way_id=7\n";
+        file << "edge,1,1;42.2930;-83.7353:2;42.2935;-83.7347,way_type=secondary:way_id=7\n";
+        file << "edge,2,2;42.2935;-83.7347:3;42.2941;-83.7339,way_type=secondary:way_id=7\n";
+        file << "edge,5,5;42.2950;-83.7320:6;42.2952;-83.7318,way_type=secondary:way_id=7\n";
+        file << "edge,6,4;42.2948;-83.7327:7;42.2949;-83.7310,way_type=primary:way_id=8\n";
+    }
+    shapes::CSVInputFactory chain_factory{ path, false, true };
+    chain_factory.make_shapes();
+    std::remove( path.c_str() );
+
+    REQUIRE( chain_factory.get_polylines().size() == 3 );
+    CHECK( chain_factory.get_polylines()[0]->get_uid() == 1 );
+    CHECK( chain_factory.get_polylines()[0]->segment_count() == 3 );
+    CHECK( chain_factory.get_polylines()[1]->get_uid() == 5 );
+    CHECK( chain_factory.get_polylines()[2]->get_way_type() == osm::Highway::PRIMARY );
+
+    // a delta can remove a polyline by its id only.
+    shapes::CSVDeltaFactory delta_factory{ "" };
+    delta_factory.make_change( shapes::StrVector{ "remove", "polyline", "70296" } );
+    CHECK( delta_factory.get_changes().back().type == "polyline" );
+    CHECK( delta_factory.get_changes().back().uid == 70296 );
+    CHECK_THROWS_AS( delta_factory.make_change( shapes::StrVector{ "add", "polyline", "70296", "1;42.29;-83.73:2;42.30;-83.72" } ), std::invalid_argument );
+}
+
+TEST_CASE( "Geofence Capsules", "[quad][geofence][capsule]" ) {
+    shapes::CSVInputFactory factory{ "unit-test-data/test-data/test.shapes" };
+    factory.make_shapes();
+    shapes::CSVInputFactory polyline_factory{ "unit-test-data/test-data/test.shapes", false, true };
+    polyline_factory.make_shapes();
+    shapes::CSVInputFactory graph_factory{ "unit-test-data/test-data/test.shapes", true };
+    graph_factory.make_shapes();
+
+    geo::Point sw{ 42.2920, -83.7365 };
+    geo::Point ne{ 42.2960, -83.7315 };
+    Quad::Ptr edge_ptr = std::make_shared<Quad>( sw, ne );
+    Quad::Ptr polyline_ptr = std::make_shared<Quad>( sw, ne );
+    Quad::Ptr graph_ptr = std::make_shared<Quad>( sw, ne );
+    for (auto& e : factory.get_edges()) {
+        Quad::insert( edge_ptr, std::dynamic_pointer_cast<const geo::Entity>( e ) );
+    }
+    Quad::insert( polyline_ptr, polyline_factory.get_polylines()[0] );
+    for (auto& e : graph_factory.get_graph_edges()) {
+        Quad::insert( graph_ptr, e );
+    }
+
+    const double extension = 1.0;
+    Geofence areas{ std::vector<Quad::CPtr>{ edge_ptr }, extension };
+    Geofence capsules{ std::vector<Quad::CPtr>{ edge_ptr }, extension, geo::PageMode::NORMAL, Geofence::EdgeModel::CAPSULE };
+    Geofence polyline_capsules{ std::vector<Quad::CPtr>{ polyline_ptr }, extension, geo::PageMode::NORMAL, Geofence::EdgeModel::CAPSULE };
+    Geofence graph_capsules{ std::vector<Quad::CPtr>{ graph_ptr }, extension, geo::PageMode::NORMAL, Geofence::EdgeModel::CAPSULE };
+    CHECK( areas.edge_model() == Geofence::EdgeModel::AREA );
+    CHECK( capsules.edge_model() == Geofence::EdgeModel::CAPSULE );
+    CHECK( capsules.get_shape( 0 ).type == Geofence::ShapeType::CAPSULE );
+    CHECK( polyline_capsules.get_shape( 0 ).type == Geofence::ShapeType::CAPSULE_RUN );
+
+    // a point is inside when it is within half the width plus the extension of a segment.
+    geo::EdgeCPtr first = factory.get_edges()[0];
+    double radius = first->get_way_width() / 2.0 + extension;
+    geo::Location middle{ (first->v1->lat + first->v2->lat) / 2.0, (first->v1->lon + first->v2->lon) / 2.0 };
+    CHECK( capsules.contains( middle ) );
+    CHECK( capsules.contains( geo::Location::project_position( middle, first->bearing() + 90.0, radius - 0.2 ) ) );
+    CHECK_FALSE( capsules.contains( geo::Location::project_position( middle, first->bearing() + 90.0, radius + 0.2 ) ) );
+    CHECK_FALSE( capsules.contains( geo::Location::project_position( middle, first->bearing() - 90.0, radius + 0.2 ) ) );
+
+    // the ends are round: every point within the radius of a vertex is inside, while the rectangles miss the points
+    // around the ends of the road and outside its bends.
+    uint32_t missed_by_areas = 0;
+    for (auto& e : factory.get_edges()) {
+        for (double bearing = 0.0; bearing < 360.0; bearing += 10.0) {
+            geo::Location pt = geo::Location::project_position( *e->v1, bearing, radius - 0.2 );
+            CHECK( capsules.contains( pt ) );
+            if (!areas.contains( pt )) ++missed_by_areas;
+        }
+    }
+    CHECK( missed_by_areas > 0 );
+
+    // polylines and graph edges make the same capsules as edges, and capsule indexes have images.
+    std::size_t size = capsules.memory_usage();
+    std::shared_ptr<char> copy{ new char[size], std::default_delete<char[]>() };
+    std::memcpy( copy.get(), capsules.image(), size );
+    Geofence attached{ std::shared_ptr<const char>{ copy }, size };
+    CHECK( attached.edge_model() == Geofence::EdgeModel::CAPSULE );
+
+    uint32_t inside = 0;
+    for (double lat = 42.2928; lat < 42.2952; lat += 0.00002) {
+        for (double lon = -83.7358; lon < -83.7322; lon += 0.00002) {
+            geo::Point pt{ lat, lon };
+            bool expected = capsules.contains( pt );
+            CHECK( polyline_capsules.contains( pt ) == expected );
+            CHECK( graph_capsules.contains( pt ) == expected );
+            CHECK( attached.contains( pt ) == expected );
+            if (expected) ++inside;
+
+            Geofence::Cover cover = capsules.classify( pt, geo::Point{ lat + 0.00001, lon + 0.00001 } );
+            if (cover == Geofence::Cover::INSIDE) CHECK( expected );
+            if (cover == Geofence::Cover::OUTSIDE) CHECK_FALSE( expected );
+        }
+    }
+    CHECK( inside > 0 );
+}
+
+TEST_CASE( "Map Simplification", "[quad][geofence][simplify]" ) {
+    // a way with two small wiggles, a bend, and a straight run after it; a reversed copy of one of its edges; and an
+    // edge with no way.
+    const std::string path{ "unit-test-data/test-data/test.simplify.shapes" };
+    const std::vector<geo::Point> way{ { 42.290000, -83.7400 }, { 42.290005, -83.7398 }, { 42.289990, -83.7396 },
+                                       { 42.290000, -83.7394 }, { 42.290500, -83.7392 }, { 42.291000, -83.7390 } };
+    {
+        std::ofstream file{ path };
+        file << std::setprecision(10) << "type,id,geography,attributes\n";
+        for (std::size_t e = 0; e + 1 < way.size(); ++e) {
+            file << "edge," << e + 1 << "," << e + 1 << ";" << way[e].lat << ";" << way[e].lon << ":" << e + 2 << ";" << way[e + 1].lat << ";" << way[e + 1].lon << ",way_type=secondary:way_id=9\n";
+        }
+        file << "edge,10,5;42.2905;-83.7392:4;42.29;-83.7394,way_type=secondary:way_id=9\n";
+        file << "edge,20,20;42.2920;-83.7400:21;42.2921;-83.7390,way_type=secondary\n";
+    }
+
+    shapes::CSVInputFactory plain_factory{ path };
+    plain_factory.make_shapes();
+    CHECK( plain_factory.get_edges().size() == 7 );
+    CHECK( plain_factory.get_duplicate_count() == 0 );
+
+    // the wiggles are within 2 m of the chain and the bend is on a straight line, so v1 - v4 - v6 remains.
+    shapes::CSVInputFactory factory{ path, false, false, 2.0 };
+    factory.make_shapes();
+    CHECK( factory.get_duplicate_count() == 1 );
+    CHECK( factory.get_simplified_count() == 3 );
+    REQUIRE( factory.get_edges().size() == 3 );
+    CHECK( factory.get_edges()[0]->get_uid() == 1 );
+    CHECK( factory.get_edges()[0]->v2->uid == 4 );
+    CHECK( factory.get_edges()[1]->get_uid() == 4 );
+    CHECK( factory.get_edges()[1]->v1 == factory.get_edges()[0]->v2 );
+    CHECK( factory.get_edges()[2]->get_uid() == 20 );
+
+    // a tolerance smaller than the wiggles keeps them.
+    shapes::CSVInputFactory tight_factory{ path, false, false, 0.1 };
+    tight_factory.make_shapes();
+    CHECK( tight_factory.get_simplified_count() == 1 );
+
+    // polylines are simplified the same way.
+    shapes::CSVInputFactory polyline_factory{ path, false, true, 2.0 };
+    polyline_factory.make_shapes();
+    REQUIRE( polyline_factory.get_polylines().size() == 2 );
+    CHECK( polyline_factory.get_polylines()[0]->get_vertices().size() == 3 );
+    CHECK( polyline_factory.get_polylines()[0]->get_uid() == 1 );
+    std::remove( path.c_str() );
+
+    // every point of the original way is still inside the simplified geofence.
+    geo::Bounds bounds;
+    REQUIRE( factory.get_bounds( bounds ) );
+    Quad::Ptr qptr = std::make_shared<Quad>( geo::Point{ bounds.sw.lat - 0.001, bounds.sw.lon - 0.001 }, geo::Point{ bounds.ne.lat + 0.001, bounds.ne.lon + 0.001 } );
+    for (auto& edge_ptr : factory.get_edges()) {
+        Quad::insert( qptr, std::dynamic_pointer_cast<const geo::Entity>( edge_ptr ) );
+    }
+    Geofence geofence{ qptr, 1.0 };
+
+    for (std::size_t e = 0; e + 1 < way.size(); ++e) {
+        for (int step = 0; step <= 10; ++step) {
+            geo::Point pt{ way[e].lat + step * (way[e + 1].lat - way[e].lat) / 10.0, way[e].lon + step * (way[e + 1].lon - way[e].lon) / 10.0 };
+            CHECK( geofence.contains( pt ) );
+        }
+    }
+}
+
+TEST_CASE( "OSM Import", "[quad][geofence][osm]" ) {
+    // a primary road of three nodes, a service road (blacklisted), a building, a platform (not a road type), and a
+    // residential road to a node outside the extract.
+    const std::string path{ "unit-test-data/test-data/test.import.osm" };
+    {
+        std::ofstream file{ path };
+        file << "<?xml version='1.0' encoding='UTF-8'?>\n";
+        file << "<osm version=\"0.6\" generator=\"test\">\n";
+        file << " <!-- nodes -> ways -> relations -->\n";
+        file << " <bounds minlat=\"42.28\" minlon=\"-83.75\" maxlat=\"42.30\" maxlon=\"-83.73\"/>\n";
+        file << " <node id=\"1\" lat=\"42.2930\" lon=\"-83.7353\" version=\"1\"/>\n";
+        file << " <node id=\"2\" lat=\"42.2935\" lon=\"-83.7347\" version=\"1\">\n";
+        file << "  <tag k=\"highway\" v=\"traffic_signals\"/>\n";
+        file << " </node>\n";
+        file << " <node id='3' lon='-83.7339' lat='42.2941'/>\n";
+        file << " <node id=\"4\" lat=\"42.2948\" lon=\"-83.7327\"/>\n";
+        file << " <node id=\"5\" lat=\"42.2850\" lon=\"-83.7450\"/>\n";
+        file << " <node id=\"6\" lat=\"42.2851\" lon=\"-83.7449\"/>\n";
+        file << " <way id=\"100\">\n";
+        file << "  <nd ref=\"1\"/>\n  <nd ref=\"2\"/>\n  <nd ref=\"3\"/>\n";
+        file << "  <tag k=\"name\" v=\"Fuller &amp; Beal &gt; Main\"/>\n";
+        file << "  <tag k=\"highway\" v=\"Primary\"/>\n";
+        file << " </way>\n";
+        file << " <way id=\"101\">\n  <nd ref=\"3\"/>\n  <nd ref=\"4\"/>\n  <tag k=\"highway\" v=\"service\"/>\n </way>\n";
+        file << " <way id=\"102\">\n  <nd ref=\"5\"/>\n  <nd ref=\"6\"/>\n  <tag k=\"building\" v=\"yes\"/>\n </way>\n";
+        file << " <way id=\"103\">\n  <nd ref=\"5\"/>\n  <nd ref=\"6\"/>\n  <tag k=\"highway\" v=\"platform\"/>\n </way>\n";
+        file << " <way id=\"104\">\n  <nd ref=\"3\"/>\n  <nd ref=\"4\"/>\n  <nd ref=\"99\"/>\n  <tag k=\"highway\" v=\"residential\"/>\n </way>\n";
+        file << " <relation id=\"200\">\n  <member type=\"way\" ref=\"102\" role=\"outer\"/>\n  <tag k=\"highway\" v=\"motorway\"/>\n </relation>\n";
+        file << "</osm>\n";
+    }
+
+    shapes::CSVInputFactory factory{ path };
+    factory.make_shapes();
+
+    REQUIRE( factory.get_edges().size() == 3 );
+    CHECK( factory.get_edges()[0]->get_uid() == 1 );
+    CHECK( factory.get_edges()[0]->v1->uid == 1 );
+    CHECK( factory.get_edges()[0]->v2->uid == 2 );
+    CHECK( factory.get_edges()[0]->v2->lat == Approx( 42.2935 ) );
+    CHECK( factory.get_edges()[0]->v2->lon == Approx( -83.7347 ) );
+    CHECK( factory.get_edges()[1]->v1 == factory.get_edges()[0]->v2 );
+    CHECK( factory.get_edges()[1]->get_way_type() == osm::Highway::PRIMARY );
+    CHECK( factory.get_edges()[2]->get_way_type() == osm::Highway::RESIDENTIAL );
+    CHECK( factory.get_edges()[2]->v1 == factory.get_edges()[1]->v2 );
+    CHECK( factory.get_edges()[2]->v2->uid == 4 );
+
+    // the ways are chained into polylines by their ids.
+    shapes::CSVInputFactory polyline_factory{ path, false, true };
+    polyline_factory.make_shapes();
+    REQUIRE( polyline_factory.get_polylines().size() == 2 );
+    CHECK( polyline_factory.get_polylines()[0]->get_vertices().size() == 3 );
+    CHECK( polyline_factory.get_polylines()[1]->get_way_type() == osm::Highway::RESIDENTIAL );
+
+    shapes::CSVInputFactory graph_factory{ path, true };
+    graph_factory.make_shapes();
+    CHECK( graph_factory.get_graph()->vertex_count() == 4 );
+    CHECK( graph_factory.get_graph()->edge_count() == 3 );
+
+    // the same roads in a shape file make the same geofence.
+    const std::string csv_path{ "unit-test-data/test-data/test.import.shapes" };
+    {
+        std::ofstream file{ csv_path };
+        file << "type,id,geography,attributes\n";
+        file << "edge,1,1;42.2930;-83.7353:2;42.2935;-83.7347,way_type=primary:way_id=100\n";
+        file << "edge,2,2;42.2935;-83.7347:3;42.2941;-83.7339,way_type=primary:way_id=100\n";
+        file << "edge,3,3;42.2941;-83.7339:4;42.2948;-83.7327,way_type=residential:way_id=104\n";
+    }
+    shapes::CSVInputFactory csv_factory{ csv_path };
+    csv_factory.make_shapes();
+    std::remove( csv_path.c_str() );
+    std::remove( path.c_str() );
+
+    geo::Bounds bounds;
+    REQUIRE( factory.get_bounds( bounds ) );
+    Quad::Ptr osm_qptr = std::make_shared<Quad>( geo::Point{ bounds.sw.lat - 0.001, bounds.sw.lon - 0.001 }, geo::Point{ bounds.ne.lat + 0.001, bounds.ne.lon + 0.001 } );
+    Quad::Ptr csv_qptr = std::make_shared<Quad>( geo::Point{ bounds.sw.lat - 0.001, bounds.sw.lon - 0.001 }, geo::Point{ bounds.ne.lat + 0.001, bounds.ne.lon + 0.001 } );
+    for (auto& edge_ptr : factory.get_edges()) {
+        Quad::insert( osm_qptr, std::dynamic_pointer_cast<const geo::Entity>( edge_ptr ) );
+    }
+    for (auto& edge_ptr : csv_factory.get_edges()) {
+        Quad::insert( csv_qptr, std::dynamic_pointer_cast<const geo::Entity>( edge_ptr ) );
+    }
+    Geofence osm_geofence{ osm_qptr, 10.0 };
+    Geofence csv_geofence{ csv_qptr, 10.0 };
+    CHECK( osm_geofence.shape_count() == csv_geofence.shape_count() );
+    int inside = 0;
+    for (int i = 0; i <= 40; ++i) {
+        for (int j = 0; j <= 40; ++j) {
+            geo::Point pt{ bounds.sw.lat + (bounds.ne.lat - bounds.sw.lat) * i / 40.0, bounds.sw.lon + (bounds.ne.lon - bounds.sw.lon) * j / 40.0 };
+            CHECK( osm_geofence.contains( pt ) == csv_geofence.contains( pt ) );
+            inside += osm_geofence.contains( pt ) ? 1 : 0;
+        }
+    }
+    CHECK( inside > 0 );
+
+    shapes::CSVInputFactory missing_factory{ "unit-test-data/test-data/missing.osm" };
+    CHECK_THROWS_AS( missing_factory.make_shapes(), std::invalid_argument );
+}
+
+TEST_CASE( "Geofence Validity", "[quad][geofence][validity]" ) {
+    int64_t seconds = 0;
+    CHECK( time_utilities::parse_utc( "2025-08-13T08:52:48.583Z", seconds ) );
+    CHECK( seconds == 1755075168 );
+    CHECK( time_utilities::format_utc( seconds ) == "2025-08-13T08:52:48Z" );
+    CHECK( time_utilities::parse_utc( "1970-01-01", seconds ) );
+    CHECK( seconds == 0 );
+    CHECK( time_utilities::parse_utc( "1755075168", seconds ) );
+    CHECK( seconds == 1755075168 );
+    CHECK( time_utilities::format_utc( -1 ) == "1969-12-31T23:59:59Z" );
+    CHECK_FALSE( time_utilities::parse_utc( "2025-13-01", seconds ) );
+    CHECK_FALSE( time_utilities::parse_utc( "2025-08-13T08:52", seconds ) );
+    CHECK_FALSE( time_utilities::parse_utc( "", seconds ) );
+    CHECK( seconds == 1755075168 );
+
+    const int64_t noon = 1748779200;                                // 2025-06-01T12:00:00Z.
+    const std::string path{ "unit-test-data/test-data/test.validity.shapes" };
+    {
+        std::ofstream file{ path };
+        file << "type,id,geography,attributes\n";
+        file << "circle,1,42.2800:-83.7400:20.0\n";
+        file << "circle,2,42.2810:-83.7400:20.0,valid_from=2025-06-01T06:00:00Z:valid_to=2025-06-01T18:00:00Z\n";
+        file << "circle,3,42.2820:-83.7400:20.0,valid_to=" << noon << "\n";
+        file << "edge,4,1;42.2830;-83.7410:2;42.2830;-83.7390,way_type=secondary:way_id=7:valid_from=2025-06-01\n";
+        file << "edge,5,2;42.2830;-83.7390:3;42.2830;-83.7370,way_type=secondary:way_id=7\n";
+    }
+
+    shapes::CSVInputFactory factory{ path, false, true };
+    factory.make_shapes();
+    REQUIRE( factory.get_circles().size() == 3 );
+    CHECK( factory.get_circles()[0]->get_validity().always() );
+    CHECK( factory.get_circles()[1]->get_validity() == geo::Validity( noon - 6 * 3600, noon + 6 * 3600 ) );
+    CHECK( factory.get_circles()[2]->get_validity() == geo::Validity( geo::Validity::kBeginning, noon ) );
+
+    // the timed edge is not chained with the permanent one.
+    CHECK( factory.get_polylines().size() + factory.get_edges().size() == 2 );
+
+    // times that cannot be read and empty intervals are errors.
+    shapes::CSVInputFactory bad_factory;
+    CHECK_THROWS_AS( bad_factory.make_circle( string_utilities::split( "circle,9,42.28:-83.74:20.0,valid_from=June", ',' ) ), std::invalid_argument );
+    CHECK_THROWS_AS( bad_factory.make_circle( string_utilities::split( "circle,9,42.28:-83.74:20.0,valid_from=100:valid_to=100", ',' ) ), std::invalid_argument );
+
+    geo::Bounds bounds;
+    REQUIRE( factory.get_bounds( bounds ) );
+    Quad::Ptr qptr = std::make_shared<Quad>( geo::Point{ bounds.sw.lat - 0.01, bounds.sw.lon - 0.01 }, geo::Point{ bounds.ne.lat + 0.01, bounds.ne.lon + 0.01 } );
+    for (auto& circle_ptr : factory.get_circles()) {
+        Quad::insert( qptr, circle_ptr );
+    }
+    for (auto& edge_ptr : factory.get_edges()) {
+        Quad::insert( qptr, std::dynamic_pointer_cast<const geo::Entity>( edge_ptr ) );
+    }
+    for (auto& polyline_ptr : factory.get_polylines()) {
+        Quad::insert( qptr, polyline_ptr );
+    }
+    Geofence geofence{ qptr, 1.0 };
+    CHECK( geofence.window_count() >= 3 );
+
+    const geo::Point permanent{ 42.2800, -83.7400 };
+    const geo::Point daytime{ 42.2810, -83.7400 };
+    const geo::Point until_noon{ 42.2820, -83.7400 };
+    const geo::Point timed_edge{ 42.2830, -83.7400 };
+    const geo::Point permanent_edge{ 42.2830, -83.7380 };
+
+    CHECK( geofence.contains( permanent, 0 ) );
+    CHECK( geofence.contains( permanent_edge, 0 ) );
+
+    // an interval includes its start and not its end.
+    CHECK_FALSE( geofence.contains( daytime, noon - 6 * 3600 - 1 ) );
+    CHECK( geofence.contains( daytime, noon - 6 * 3600 ) );
+    CHECK( geofence.contains( daytime, noon ) );
+    CHECK_FALSE( geofence.contains( daytime, noon + 6 * 3600 ) );
+
+    CHECK( geofence.contains( until_noon, 0 ) );
+    CHECK( geofence.contains( until_noon, noon - 1 ) );
+    CHECK_FALSE( geofence.contains( until_noon, noon ) );
+
+    CHECK_FALSE( geofence.contains( timed_edge, noon - 12 * 3600 - 1 ) );
+    CHECK( geofence.contains( timed_edge, noon ) );
+
+    // without a time every shape counts.
+    CHECK( geofence.contains( daytime ) );
+    CHECK( geofence.contains( until_noon ) );
+
+    // a box near a timed shape is never answered as outside, and the cache follows the time.
+    CHECK( geofence.classify( geo::Point{ 42.2809, -83.7401 }, geo::Point{ 42.2811, -83.7399 } ) == Geofence::Cover::MIXED );
+    GeofenceCache cache{ 5.0 };
+    for (int pass = 0; pass < 2; ++pass) {
+        CHECK( cache.contains( geofence, daytime, noon ) );
+        CHECK_FALSE( cache.contains( geofence, daytime, noon + 6 * 3600 ) );
+    }
+
+    // the attributes are written back.
+    const std::string out_path{ "unit-test-data/test-data/test.validity.out.shapes" };
+    {
+        shapes::CSVOutputFactory output{ out_path };
+        for (auto& circle_ptr : factory.get_circles()) {
+            output.add_circle( circle_ptr );
+        }
+        output.write_shapes();
+    }
+    shapes::CSVInputFactory reread{ out_path };
+    reread.make_shapes();
+    REQUIRE( reread.get_circles().size() == 3 );
+    for (std::size_t c = 0; c < 3; ++c) {
+        CHECK( reread.get_circles()[c]->get_validity() == factory.get_circles()[c]->get_validity() );
+    }
+
+    std::remove( path.c_str() );
+    std::remove( out_path.c_str() );
+}
+
+TEST_CASE( "Geofence Grades", "[quad][geofence][grade]" ) {
+    // an east-west secondary (17 m wide) about 830 m long, and a circle around a point just past its west end.
+    const double lat_meter = 1.0 / 111319.9;
+    const double lon_meter = 1.0 / (111319.9 * std::cos( 42.0 * M_PI / 180.0 ));
+    geo::Vertex::Ptr v1 = std::make_shared<geo::Vertex>( 42.0, -83.00, 1 );
+    geo::Vertex::Ptr v2 = std::make_shared<geo::Vertex>( 42.0, -82.99, 2 );
+    geo::EdgePtr edge = std::make_shared<geo::Edge>( v1, v2, osm::Highway::SECONDARY, 1 );
+    geo::Circle::Ptr circle = std::make_shared<geo::Circle>( 42.0, -83.00 - 30.0 * lon_meter, 26.0 );
+
+    Quad::Ptr qptr = std::make_shared<Quad>( geo::Point{ 41.99, -83.01 }, geo::Point{ 42.01, -82.98 } );
+    Quad::insert( qptr, edge );
+    Quad::insert( qptr, circle );
+
+    Geofence area_geofence{ std::vector<Quad::CPtr>{ qptr }, 10.0, geo::PageMode::NORMAL, Geofence::EdgeModel::AREA };
+    Geofence capsule_geofence{ std::vector<Quad::CPtr>{ qptr }, 10.0, geo::PageMode::NORMAL, Geofence::EdgeModel::CAPSULE };
+
+    const geo::Point middle{ 42.0, -82.995 };
+    const geo::Point beside{ 42.0 + 7.0 * lat_meter, -82.995 };
+    const geo::Point wide{ 42.0 + 12.0 * lat_meter, -82.995 };
+    const geo::Point past_east{ 42.0, -82.99 + 5.0 * lon_meter };
+    const geo::Point far_east{ 42.0, -82.99 + 15.0 * lon_meter };
+    const geo::Point past_west{ 42.0, -83.00 - 5.0 * lon_meter };
+
+    CHECK( area_geofence.grade( middle ) == Geofence::Grade::CORE );
+    CHECK( area_geofence.grade( beside ) == Geofence::Grade::CORE );
+    CHECK( area_geofence.grade( wide ) == Geofence::Grade::OUTSIDE );
+    CHECK( area_geofence.grade( past_east ) == Geofence::Grade::BUFFER );
+    CHECK( area_geofence.grade( far_east ) == Geofence::Grade::OUTSIDE );
+
+    CHECK( capsule_geofence.grade( middle ) == Geofence::Grade::CORE );
+    CHECK( capsule_geofence.grade( beside ) == Geofence::Grade::CORE );
+    CHECK( capsule_geofence.grade( wide ) == Geofence::Grade::BUFFER );
+    // a capsule's core is the capsule of half the way's width, so it has round ends too.
+    CHECK( capsule_geofence.grade( past_east ) == Geofence::Grade::CORE );
+    CHECK( capsule_geofence.grade( far_east ) == Geofence::Grade::BUFFER );
+
+    // a point in the edge's buffer is in the core of the circle after it.
+    CHECK( area_geofence.grade( past_west ) == Geofence::Grade::CORE );
+    CHECK( capsule_geofence.grade( past_west ) == Geofence::Grade::CORE );
+
+    // the grade agrees with contains everywhere, with or without the decision cache.
+    GeofenceCache cache{ 2.0 };
+    for (int i = -20; i <= 20; ++i) {
+        for (int j = -20; j <= 20; ++j) {
+            geo::Point pt{ 42.0 + i * lat_meter, -83.00 + j * 2.0 * lon_meter };
+            Geofence::Grade grade = area_geofence.grade( pt );
+            CHECK( (grade != Geofence::Grade::OUTSIDE) == area_geofence.contains( pt ) );
+            CHECK( cache.grade( area_geofence, pt ) == grade );
+            CHECK( cache.grade( area_geofence, pt ) == grade );
+        }
+    }
 }
 
 /** PPM tests below **/
 
+/**
+ * @brief A quad of one leaf with three separate circles, 100 m apart on an east-west line, in the order inserted.
+ */
+Quad::Ptr buildCircleQuadTree( std::vector<geo::Point>& centers ) {
+    const double lon_meter = 1.0 / (111319.9 * std::cos( 42.0 * M_PI / 180.0 ));
+    Quad::Ptr qptr = std::make_shared<Quad>( geo::Point{ 41.99, -83.01 }, geo::Point{ 42.01, -82.98 } );
+
+    centers.clear();
+    for (int c = 0; c < 3; ++c) {
+        centers.push_back( geo::Point{ 42.0, -83.0 + c * 100.0 * lon_meter } );
+        Quad::insert( qptr, std::make_shared<geo::Circle>( centers.back().lat, centers.back().lon, 10.0 ) );
+    }
+
+    return qptr;
+}
+
+TEST_CASE( "Geofence Leaf Order", "[quad][geofence][reorder]" ) {
+    std::vector<geo::Point> centers;
+    Geofence geofence{ buildCircleQuadTree( centers ), 10.0 };
+    std::vector<uint32_t> inserted( geofence.retrieve_shapes( centers[0] ).begin(), geofence.retrieve_shapes( centers[0] ).end() );
+    REQUIRE( inserted.size() == 3 );
+
+    // nothing has been hit, so the order does not change.
+    CHECK( geofence.reordered() == nullptr );
+
+    // the last circle is hit most, then the middle one; misses, and searches without a table, count nothing.
+    Geofence::Hits::Ptr hits_ptr = geofence.count_hits();
+    for (int i = 0; i < 5; ++i) CHECK( geofence.contains( centers[2], 0, hits_ptr.get() ) );
+    CHECK( geofence.grade( centers[1], 0, hits_ptr.get() ) == Geofence::Grade::CORE );
+    CHECK_FALSE( geofence.contains( geo::Point{ 42.005, -82.995 }, 0, hits_ptr.get() ) );
+    for (int i = 0; i < 8; ++i) CHECK( geofence.contains( centers[0] ) );
+    CHECK( geofence.hit_count() == 6 );
+
+    Geofence::CPtr reordered_ptr = geofence.reordered();
+    REQUIRE( reordered_ptr );
+    std::vector<uint32_t> order( reordered_ptr->retrieve_shapes( centers[0] ).begin(), reordered_ptr->retrieve_shapes( centers[0] ).end() );
+    CHECK( order == (std::vector<uint32_t>{ inserted[2], inserted[1], inserted[0] }) );
+
+    // the index itself is unchanged.
+    CHECK( reordered_ptr->memory_usage() == geofence.memory_usage() );
+    CHECK( reordered_ptr->has_source() );
+    CHECK( std::vector<uint32_t>( geofence.retrieve_shapes( centers[0] ).begin(), geofence.retrieve_shapes( centers[0] ).end() ) == inserted );
+
+    // the copy keeps half of the counts, which are already in order; new traffic changes it again.
+    CHECK( reordered_ptr->reordered() == nullptr );
+    hits_ptr = reordered_ptr->count_hits();
+    for (int i = 0; i < 8; ++i) CHECK( reordered_ptr->contains( centers[0], 0, hits_ptr.get() ) );
+    Geofence::CPtr again_ptr = reordered_ptr->reordered();
+    REQUIRE( again_ptr );
+    order.assign( again_ptr->retrieve_shapes( centers[0] ).begin(), again_ptr->retrieve_shapes( centers[0] ).end() );
+    CHECK( order == (std::vector<uint32_t>{ inserted[0], inserted[2], inserted[1] }) );
+
+    // the copies answer as the index does.
+    for (int i = -50; i <= 250; ++i) {
+        geo::Point pt{ 42.0, -83.0 + i * 1.0e-5 };
+        CHECK( again_ptr->contains( pt ) == geofence.contains( pt ) );
+        CHECK( again_ptr->grade( pt ) == geofence.grade( pt ) );
+    }
+}
+
+TEST_CASE( "Geofence Hit Counts", "[quad][geofence][reorder]" ) {
+    std::vector<geo::Point> centers;
+    Geofence geofence{ buildCircleQuadTree( centers ), 10.0 };
+    const int kThreads = 4;
+    const int kLookups = 200000;
+
+    // each searcher counts in its own table, so none of the hits of concurrent searchers is lost.
+    std::atomic<int> misses{ 0 };
+    auto search = [&geofence, &centers, &misses, kLookups]( bool counted ) {
+        Geofence::Hits::Ptr hits_ptr = counted ? geofence.count_hits() : nullptr;
+        for (int i = 0; i < kLookups; ++i) {
+            if (!geofence.contains( centers[2 - i % 2], i, hits_ptr.get() )) misses.fetch_add( 1 );
+        }
+    };
+
+    // the slowest of the searchers running at once; the counters are in no searcher's way, so counting costs as little
+    // with several searchers as with one.
+    auto timed = [&search, kThreads]( bool counted ) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) threads.emplace_back( search, counted );
+        for (auto& thread : threads) thread.join();
+        return std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - start ).count();
+    };
+
+    int64_t uncounted = INT64_MAX;
+    int64_t counted = INT64_MAX;
+    for (int run = 0; run < 3; ++run) {
+        uncounted = std::min<int64_t>( uncounted, timed( false ) );
+        counted = std::min<int64_t>( counted, timed( true ) );
+    }
+
+    INFO( "uncounted " << uncounted << " us, counted " << counted << " us" );
+    CHECK( misses.load() == 0 );
+    CHECK( geofence.hit_count() == 3ULL * kThreads * kLookups );
+    CHECK( counted < uncounted * 3 / 2 );
+
+    Geofence::CPtr reordered_ptr = geofence.reordered();
+    REQUIRE( reordered_ptr );
+    CHECK( reordered_ptr->hit_count() == 3ULL * kThreads * kLookups / 2 );
+
+    // a handler counts only when the index it uses is reordered.
+    ConfigMap pconf;
+    REQUIRE( buildBaseConfiguration( pconf ) );
+    GeofenceSlot::Ptr slot = std::make_shared<GeofenceSlot>( reordered_ptr );
+    BSMHandler plain{ nullptr, pconf, testLogger };
+    plain.set_geofence_slot( slot );
+    CHECK_FALSE( plain.get_geofence_hits() );
+
+    pconf["privacy.filter.geofence.reorder.interval.ms"] = "1000";
+    BSMHandler reordering{ nullptr, pconf, testLogger };
+    reordering.set_geofence_slot( slot );
+    REQUIRE( reordering.get_geofence_hits() );
+    Geofence::Hits::Ptr hits_ptr = reordering.get_geofence_hits();
+    reordering.set_geofence_slot( std::make_shared<GeofenceSlot>( reordered_ptr ) );
+    CHECK( reordering.get_geofence_hits() != hits_ptr );
+
+    // a reordered copy answers as its source, so the cached answers are kept; a rebuilt index forgets them.
+    Geofence::CPtr rebuilt_ptr = std::make_shared<const Geofence>( buildCircleQuadTree( centers ), 10.0 );
+    CHECK( reordered_ptr->answers() == geofence.answers() );
+    CHECK( rebuilt_ptr->answers() != geofence.answers() );
+
+    pconf["privacy.filter.geofence.cache.cell"] = "1.0";
+    BSMHandler caching{ nullptr, pconf, testLogger };
+    GeofenceSlot::Ptr cached_slot = std::make_shared<GeofenceSlot>( rebuilt_ptr );
+    caching.set_geofence_slot( cached_slot );
+    GeofenceCache::Ptr cache_ptr = caching.get_geofence_cache();
+    REQUIRE( cache_ptr );
+    CHECK( cache_ptr->contains( *rebuilt_ptr, centers[1] ) );
+    uint64_t cache_misses = cache_ptr->misses();
+
+    CHECK( rebuilt_ptr->contains( centers[2], 0, caching.get_geofence_hits().get() ) );
+    Geofence::CPtr rebuilt_reordered_ptr = rebuilt_ptr->reordered();
+    REQUIRE( rebuilt_reordered_ptr );
+    cached_slot->store( rebuilt_reordered_ptr );
+    caching.set_geofence_slot( cached_slot );
+    CHECK( caching.get_geofence_hits() );
+    CHECK( cache_ptr->contains( *rebuilt_reordered_ptr, centers[1] ) );
+    CHECK( cache_ptr->misses() == cache_misses );
+
+    cached_slot->store( std::make_shared<const Geofence>( buildCircleQuadTree( centers ), 10.0 ) );
+    caching.set_geofence_slot( cached_slot );
+    CHECK( cache_ptr->contains( *cached_slot->load(), centers[1] ) );
+    CHECK( cache_ptr->misses() == cache_misses + 1 );
+    pconf.erase( "privacy.filter.geofence.cache.cell" );
+
+    pconf["privacy.filter.geofence.shared.file"] = "unit-test-data/test-data/unused.geofence";
+    BSMHandler sharing{ nullptr, pconf, testLogger };
+    sharing.set_geofence_slot( slot );
+    CHECK_FALSE( sharing.get_geofence_hits() );
+}
+
+TEST_CASE( "Geofence Coverage", "[quad][geofence][coverage]" ) {
+    // a junction: 12 edges about 400 m long through points around a center, crossing each other many times, a polyline
+    // through it, and a circle beside it, all in one leaf.
+    const double lat_meter = 1.0 / 111319.9;
+    const double lon_meter = 1.0 / (111319.9 * std::cos( 42.0 * M_PI / 180.0 ));
+    Quad::Ptr qptr = std::make_shared<Quad>( geo::Point{ 41.99, -83.01 }, geo::Point{ 42.01, -82.98 } );
+
+    for (int e = 0; e < 12; ++e) {
+        double angle = e * M_PI / 12.0;
+        double offset = (e % 3 - 1) * 15.0;
+        double lat = 42.0 + offset * std::cos( angle ) * lat_meter;
+        double lon = -82.995 - offset * std::sin( angle ) * lon_meter;
+        geo::Vertex::Ptr v1 = std::make_shared<geo::Vertex>( lat - 200.0 * std::sin( angle ) * lat_meter, lon - 200.0 * std::cos( angle ) * lon_meter, 2 * e + 1 );
+        geo::Vertex::Ptr v2 = std::make_shared<geo::Vertex>( lat + 200.0 * std::sin( angle ) * lat_meter, lon + 200.0 * std::cos( angle ) * lon_meter, 2 * e + 2 );
+        Quad::insert( qptr, std::make_shared<geo::Edge>( v1, v2, e % 2 ? osm::Highway::SECONDARY : osm::Highway::RESIDENTIAL, e + 1 ) );
+    }
+
+    std::vector<geo::Location> vertices;
+    for (int v = 0; v < 5; ++v) {
+        vertices.push_back( geo::Location{ 42.0 - 150.0 * lat_meter + v * 75.0 * lat_meter, -82.995 + (v % 2 ? 40.0 : -40.0) * lon_meter } );
+    }
+    Quad::insert( qptr, std::make_shared<geo::Polyline>( vertices, osm::Highway::SECONDARY, 100 ) );
+    Quad::insert( qptr, std::make_shared<geo::Circle>( 42.0, -82.995 + 300.0 * lon_meter, 20.0 ) );
+    REQUIRE_FALSE( qptr->haschildren() );
+
+    Geofence geofence{ std::vector<Quad::CPtr>{ qptr }, 5.0, geo::PageMode::NORMAL, Geofence::EdgeModel::AREA };
+    CHECK( geofence.coverage_leaf_count() == 1 );
+
+    // the coverage decides as the areas do one by one (grade tests every shape of the leaf).
+    for (int i = -250; i <= 250; i += 2) {
+        for (int j = -350; j <= 350; j += 2) {
+            geo::Point pt{ 42.0 + i * lat_meter, -82.995 + j * lon_meter };
+            CHECK( geofence.contains( pt ) == (geofence.grade( pt ) != Geofence::Grade::OUTSIDE) );
+        }
+    }
+
+    // the circle is not in the coverage, but is still found.
+    CHECK( geofence.contains( geo::Point{ 42.0, -82.995 + 300.0 * lon_meter } ) );
+    CHECK_FALSE( geofence.contains( geo::Point{ 42.0 + 300.0 * lat_meter, -82.995 } ) );
+
+    // an image keeps the coverage; a leaf of few areas and the capsule model have none.
+    Geofence copy{ std::shared_ptr<const char>( geofence.image(), []( const char* ) {} ), geofence.memory_usage() };
+    CHECK( copy.coverage_leaf_count() == 1 );
+    CHECK( copy.contains( geo::Point{ 42.0, -82.995 } ) );
+    CHECK( Geofence( buildTestQuadTree(), 5.2 ).coverage_leaf_count() == 0 );
+    CHECK( Geofence( std::vector<Quad::CPtr>{ qptr }, 5.0, geo::PageMode::NORMAL, Geofence::EdgeModel::CAPSULE ).coverage_leaf_count() == 0 );
+}
+
 TEST_CASE( "Redactor Checks", "[ppm][redactor]" ) {
 
     ConfigMap conf{ 
@@ -1435,6 +2780,760 @@ TEST_CASE( "BSMHandler JSON Geofence Only Filtering", "[ppm][filtering][geofence
     }
 }
 
+TEST_CASE( "BSMHandler Geofence Grade", "[ppm][filtering][grade]" ) {
+
+    ConfigMap pconf;
+
+    REQUIRE( buildBaseConfiguration( pconf ) );
+    pconf["privacy.filter.geofence.grade"] = "ON";
+    BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+
+    BSM bsm;
+
+    // On A - B; On C - E; On Edge of C - E; Outside; inside the circle; inside the grid.
+    double points[6][2] = { { 35.951090, -83.930716 }, { 35.951181, -83.935486 }, { 35.951181, -83.935456 }, { 35.964, -83.926 },
+                            { 35.951221, -83.931833 }, { 35.952289, -83.931821 } };
+    for (auto& point : points) {
+        bsm.set_latitude( point[0] );
+        bsm.set_longitude( point[1] );
+        CHECK( (handler.geofenceGrade( bsm ) != Geofence::Grade::OUTSIDE) == handler.isWithinEntity( bsm ) );
+    }
+
+    bsm.set_latitude( points[4][0] );
+    bsm.set_longitude( points[4][1] );
+    CHECK( handler.geofenceGrade( bsm ) == Geofence::Grade::CORE );
+
+    std::vector<std::string> json_test_cases;
+    REQUIRE ( loadTestCases( "unit-test-data/test-case.inside.geofence.json", json_test_cases ) );
+
+    for ( auto& test_case : json_test_cases ) {
+        CHECK( handler.process( test_case ) );
+        CHECK( handler.get_geofence_grade() != Geofence::Grade::OUTSIDE );
+        CHECK( handler.get_json().find( "\"geofenceGrade\":\"" ) != std::string::npos );
+    }
+
+    json_test_cases.clear();
+    REQUIRE ( loadTestCases( "unit-test-data/test-case.outside.geofence.json", json_test_cases ) );
+    for ( auto& test_case : json_test_cases ) {
+        CHECK_FALSE( handler.process( test_case ) );
+        CHECK( handler.get_result_string() == "geoposition" );
+        CHECK( handler.get_geofence_grade() == Geofence::Grade::OUTSIDE );
+    }
+}
+
+TEST_CASE( "BSMHandler Graph Geofence", "[ppm][filtering][graph]" ) {
+
+    ConfigMap pconf;
+
+    REQUIRE( buildBaseConfiguration( pconf ) ); 
+
+    // the road network of buildTestQuadTree as a graph.
+    geo::RoadGraph::Ptr graph_ptr = std::make_shared<geo::RoadGraph>();
+    uint32_t v[7];
+    v[0] = graph_ptr->add_vertex(1, 35.952500, -83.932434);
+    v[1] = graph_ptr->add_vertex(2, 35.948878, -83.928081);
+    v[2] = graph_ptr->add_vertex(3, 35.950715, -83.934971);
+    v[3] = graph_ptr->add_vertex(4, 35.953302, -83.931344);
+    v[4] = graph_ptr->add_vertex(5, 35.952175, -83.936688);
+    v[5] = graph_ptr->add_vertex(6, 35.949813, -83.936214);
+    v[6] = graph_ptr->add_vertex(7, 35.948272, -83.934421);
+    graph_ptr->add_edge(v[0], v[1], osm::Highway::SECONDARY, 1);
+    graph_ptr->add_edge(v[2], v[0], osm::Highway::SECONDARY, 2);
+    graph_ptr->add_edge(v[3], v[0], osm::Highway::SECONDARY, 3);
+    graph_ptr->add_edge(v[4], v[2], osm::Highway::SECONDARY, 4);
+    graph_ptr->add_edge(v[5], v[6], osm::Highway::SECONDARY, 5);
+    graph_ptr->add_edge(v[5], v[2], osm::Highway::SECONDARY, 6);
+    graph_ptr->finalize();
+
+    Quad::Ptr qptr = std::make_shared<Quad>(geo::Point{ 35.946920, -83.938486 }, geo::Point{ 35.955526, -83.926738 });
+    for (uint32_t e = 0; e < graph_ptr->edge_count(); ++e) {
+        Quad::insert( qptr, std::make_shared<const geo::GraphEdge>( graph_ptr, e ) );
+    }
+
+    BSMHandler handler{ qptr, pconf, testLogger };
+    BSMHandler object_handler{ buildTestQuadTree(), pconf, testLogger };
+
+    BSM bsm;
+
+    // On A - B; On C - E; On Edge of C - E; Outside.
+    double points[4][2] = { { 35.951090, -83.930716 }, { 35.951181, -83.935486 }, { 35.951181, -83.935456 }, { 35.964, -83.926 } };
+    for (auto& point : points) {
+        bsm.set_latitude( point[0] );
+        bsm.set_longitude( point[1] );
+        CHECK( handler.isWithinEntity( bsm ) == object_handler.isWithinEntity( bsm ) );
+    }
+
+    // handlers index the tree when they are constructed.
+    CHECK( Quad::remove( qptr, "edge", 4 ) );
+    BSMHandler removed_handler{ qptr, pconf, testLogger };
+    bsm.set_latitude( 35.951181 );
+    bsm.set_longitude( -83.935486 );
+    CHECK( handler.isWithinEntity( bsm ) );
+    CHECK_FALSE( removed_handler.isWithinEntity( bsm ) );
+}
+
+TEST_CASE( "BSMHandler Streaming Parse", "[ppm][filtering][streaming]" ) {
+    const std::vector<std::string> case_files{ "unit-test-data/test-case.all.good.json", "unit-test-data/test-case.inside.geofence.json",
+        "unit-test-data/test-case.outside.geofence.json", "unit-test-data/test-case.bad.speed.json", "unit-test-data/test-case.bad.id.json",
+        "unit-test-data/test-case.redaction.general.json", "unit-test-data/test-case.malformed.json", "unit-test-data/error_cases.json" };
+
+    std::vector<std::string> json_test_cases;
+    for (auto& case_file : case_files) {
+        REQUIRE( loadTestCases( case_file, json_test_cases ) );
+    }
+
+    // the scan suppresses the same BSMs for the same reasons, and the retained BSMs are written the same way.
+    for (const char* graded : { "OFF", "ON" }) {
+        ConfigMap pconf;
+        REQUIRE( buildBaseConfiguration( pconf ) );
+        pconf["privacy.redaction.id"] = "OFF";
+        pconf["privacy.filter.geofence.grade"] = graded;
+        BSMHandler document_handler{ buildTestQuadTree(), pconf, testLogger };
+        pconf["privacy.parse.streaming"] = "ON";
+        BSMHandler streaming_handler{ buildTestQuadTree(), pconf, testLogger };
+
+        int retained = 0;
+        int suppressed = 0;
+        for (auto& test_case : json_test_cases) {
+            bool kept = document_handler.process( test_case );
+            REQUIRE( streaming_handler.process( test_case ) == kept );
+
+            if (kept) {
+                CHECK( streaming_handler.get_json() == document_handler.get_json() );
+                CHECK( streaming_handler.get_geofence_grade() == document_handler.get_geofence_grade() );
+                ++retained;
+            } else if (document_handler.get_result() == BSMHandler::ResultStatus::SPEED || document_handler.get_result() == BSMHandler::ResultStatus::GEOPOSITION) {
+                CHECK( streaming_handler.get_result() == document_handler.get_result() );
+                ++suppressed;
+            }
+        }
+
+        CHECK( retained > 0 );
+        CHECK( suppressed > 0 );
+    }
+
+    // a BSM suppressed by its speed is not parsed past its coreData.
+    ConfigMap pconf;
+    REQUIRE( buildBaseConfiguration( pconf ) );
+    pconf["privacy.parse.streaming"] = "ON";
+    BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+
+    json_test_cases.clear();
+    REQUIRE( loadTestCases( "unit-test-data/test-case.bad.speed.json", json_test_cases ) );
+    std::string truncated = json_test_cases[0].substr( 0, json_test_cases[0].find( "\"partII\"" ) );
+    CHECK_FALSE( handler.process( truncated ) );
+    CHECK( handler.get_result_string() == "speed" );
+
+    pconf.erase( "privacy.parse.streaming" );
+    BSMHandler document_handler{ buildTestQuadTree(), pconf, testLogger };
+    CHECK_FALSE( document_handler.process( truncated ) );
+    CHECK( document_handler.get_result_string() == "parse" );
+}
+
+TEST_CASE( "BSMHandler Parse Arena", "[ppm][filtering][arena]" ) {
+    std::vector<std::string> json_test_cases;
+    REQUIRE( loadTestCases( "unit-test-data/test-case.all.good.json", json_test_cases ) );
+    REQUIRE( loadTestCases( "unit-test-data/test-case.redaction.general.json", json_test_cases ) );
+    REQUIRE( loadTestCases( "unit-test-data/test-case.outside.geofence.json", json_test_cases ) );
+    REQUIRE( loadTestCases( "unit-test-data/error_cases.json", json_test_cases ) );
+
+    ConfigMap pconf;
+    REQUIRE( buildBaseConfiguration( pconf ) );
+    pconf["privacy.redaction.id"] = "OFF";
+    BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+    std::size_t capacity = handler.get_parse_arena_capacity();
+    CHECK( capacity > 0 );
+    CHECK( capacity <= BSMHandler::kDefaultParseArenaBytes );
+
+    // an arena too small for a BSM borrows chunks from the heap for that BSM only; the output is the same.
+    pconf["privacy.parse.arena"] = "1024";
+    BSMHandler small_handler{ buildTestQuadTree(), pconf, testLogger };
+    std::size_t small_capacity = small_handler.get_parse_arena_capacity();
+    CHECK( small_capacity < 1024 );
+
+    // a value that is not a count of bytes is logged and the default is used.
+    for (std::string bad : { "big", "-1", "64k", "" }) {
+        pconf["privacy.parse.arena"] = bad;
+        std::unique_ptr<BSMHandler> bad_handler;
+        REQUIRE_NOTHROW( bad_handler.reset( new BSMHandler{ buildTestQuadTree(), pconf, testLogger } ) );
+        CHECK( bad_handler->get_parse_arena_capacity() == capacity );
+    }
+
+    // every BSM, however many are processed, fits in the arena's fixed buffer.
+    for (int pass = 0; pass < 3; ++pass) {
+        for (auto& test_case : json_test_cases) {
+            bool kept = handler.process( test_case );
+            CHECK( handler.get_parse_arena_capacity() == capacity );
+
+            REQUIRE( small_handler.process( test_case ) == kept );
+            if (kept) {
+                CHECK( small_handler.get_json() == handler.get_json() );
+                CHECK( small_handler.get_parse_arena_capacity() > small_capacity );
+            }
+        }
+    }
+}
+
+TEST_CASE( "BSMHandler Splice Output", "[ppm][redaction][splice]" ) {
+    std::vector<std::string> json_test_cases;
+    REQUIRE( loadTestCases( "unit-test-data/test-case.all.good.json", json_test_cases ) );
+    REQUIRE( loadTestCases( "unit-test-data/test-case.redaction.general.json", json_test_cases ) );
+    REQUIRE( loadTestCases( "unit-test-data/test-case.outside.geofence.json", json_test_cases ) );
+    REQUIRE( loadTestCases( "unit-test-data/error_cases.json", json_test_cases ) );
+
+    SECTION( "Same Document As Written" ) {
+        for (std::string graded : { "OFF", "ON" }) {
+            ConfigMap pconf;
+            REQUIRE( buildBaseConfiguration( pconf ) );
+            pconf["privacy.filter.geofence.grade"] = graded;
+            BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+
+            pconf["privacy.output.splice"] = "ON";
+            BSMHandler splice_handler{ buildTestQuadTree(), pconf, testLogger };
+
+            int kept_count = 0;
+            for (auto& test_case : json_test_cases) {
+                bool kept = handler.process( test_case );
+                REQUIRE( splice_handler.process( test_case ) == kept );
+                CHECK( splice_handler.get_result() == handler.get_result() );
+                if (!kept) continue;
+                ++kept_count;
+
+                // the members may be in a different order, which the comparison ignores.
+                rapidjson::Document written, spliced;
+                REQUIRE_FALSE( written.Parse( handler.get_json().c_str() ).HasParseError() );
+                REQUIRE_FALSE( spliced.Parse( splice_handler.get_json().c_str() ).HasParseError() );
+                CHECK( spliced == written );
+                CHECK( spliced["metadata"]["sanitized"].GetBool() );
+            }
+
+            CHECK( kept_count > 0 );
+        }
+    }
+
+    SECTION( "Original Formatting Kept" ) {
+        std::string json = "{\n  \"a\": 1,\n  \"b\": { \"x\": \"\\\"}\", \"y\": [1, {\"z\": 2}] },\n  \"c\" : true,\n  \"d\": \"v\"\n}";
+        std::vector<char> insitu{ json.begin(), json.end() };
+        insitu.push_back( '\0' );
+        rapidjson::Document document;
+        REQUIRE_FALSE( document.ParseInsitu( insitu.data() ).HasParseError() );
+
+        JsonSplice splice;
+        splice.reset( json, insitu.data() );
+
+        // a removed member takes the comma after it; the last member takes the comma before it.
+        splice.remove( document, "b" );
+        document.RemoveMember( "b" );
+        splice.remove( document, "d" );
+        document.RemoveMember( "d" );
+        document["c"] = false;
+        splice.replace( document, "c" );
+        document["a"].SetString( "q\"" );
+        splice.replace( document, "a" );
+        CHECK( splice.edit_count() == 4 );
+
+        std::string out;
+        REQUIRE( splice.write( out ) );
+        CHECK( out == "{\n  \"a\": \"q\\\"\",\n  \"c\" : false\n}" );
+
+        // members added to the document cannot be located.
+        document.AddMember( "e", 5, document.GetAllocator() );
+        splice.replace( document, "e" );
+        CHECK_FALSE( splice.valid() );
+        CHECK_FALSE( splice.write( out ) );
+    }
+
+    SECTION( "Every Member Removed" ) {
+        std::string json = "{\"o\":{\"a\":1,\"b\":2,\"c\":3},\"p\":4}";
+        std::vector<char> insitu{ json.begin(), json.end() };
+        insitu.push_back( '\0' );
+        rapidjson::Document document;
+        REQUIRE_FALSE( document.ParseInsitu( insitu.data() ).HasParseError() );
+
+        JsonSplice splice;
+        splice.reset( json, insitu.data() );
+        for (const char* name : { "c", "a", "b" }) {
+            splice.remove( document["o"], name );
+            document["o"].RemoveMember( name );
+        }
+
+        document["o"].AddMember( "g", "core", document.GetAllocator() );
+        splice.append( document, "o", "g" );
+
+        std::string out;
+        REQUIRE( splice.write( out ) );
+        CHECK( out == "{\"o\":{\"g\":\"core\"},\"p\":4}" );
+    }
+}
+
+TEST_CASE( "BSMHandler Geofence Reload", "[ppm][filtering][geofencereload]" ) {
+
+    ConfigMap pconf;
+
+    REQUIRE( buildBaseConfiguration( pconf ) ); 
+
+    // start with a geofence that contains no shapes; everything is outside.
+    GeofenceSlot::Ptr slot = std::make_shared<GeofenceSlot>( std::make_shared<const Geofence>( std::make_shared<Quad>( geo::Point{ 35.946920, -83.938486 }, geo::Point{ 35.955526, -83.926738 } ), 10.0 ) );
+    BSMHandler handler{ nullptr, pconf, testLogger };
+    handler.set_geofence_slot( slot );
+
+    handler.deactivate<BSMHandler::kVelocityFilterFlag>();
+    handler.deactivate<BSMHandler::kIdRedactFlag>();
+    handler.deactivate<BSMHandler::kGeneralRedactFlag>();
+
+    std::vector<std::string> json_test_cases;
+    REQUIRE ( loadTestCases( "unit-test-data/test-case.inside.geofence.json", json_test_cases ) );
+
+    SECTION( "Slot Publish" ) {
+        CHECK( slot->generation() == 0 );
+
+        for ( auto& test_case : json_test_cases ) {
+            CHECK_FALSE( handler.process( test_case ) );
+            CHECK( handler.get_result_string() == "geoposition" );
+        }
+
+        slot->store( std::make_shared<const Geofence>( buildTestQuadTree(), 10.0 ) );
+        CHECK( slot->generation() == 1 );
+
+        for ( auto& test_case : json_test_cases ) {
+            CHECK( handler.process( test_case ) );
+            CHECK( handler.get_result_string() == "success" );
+        }
+    }
+
+    SECTION( "Reloader Publish" ) {
+        GeofenceReloader reloader{ slot, []() { return std::make_shared<const Geofence>( buildTestQuadTree(), 10.0 ); }, {}, std::chrono::milliseconds{ 5 }, testLogger };
+        reloader.start();
+        reloader.request_reload();
+
+        for ( int i = 0; i < 400 && reloader.reload_count() == 0; ++i ) {
+            std::this_thread::sleep_for( std::chrono::milliseconds{ 5 } );
+        }
+
+        reloader.stop();
+        REQUIRE( reloader.reload_count() == 1 );
+        CHECK( slot->generation() == 1 );
+
+        for ( auto& test_case : json_test_cases ) {
+            CHECK( handler.process( test_case ) );
+            CHECK( handler.get_result_string() == "success" );
+        }
+    }
+
+    SECTION( "Reloader Reorder" ) {
+        std::vector<geo::Point> centers;
+        slot->store( std::make_shared<const Geofence>( buildCircleQuadTree( centers ), 10.0 ) );
+        Geofence::CPtr geofence_ptr = slot->load();
+        Geofence::Hits::Ptr hits_ptr = geofence_ptr->count_hits();
+        for (int i = 0; i < 3; ++i) CHECK( geofence_ptr->contains( centers[1], 0, hits_ptr.get() ) );
+
+        GeofenceReloader reloader{ slot, []() -> Geofence::CPtr { return nullptr; }, {}, std::chrono::milliseconds{ 5 }, testLogger };
+        reloader.reorder_every( std::chrono::milliseconds{ 5 }, []( const Geofence& geofence ) { return geofence.reordered(); } );
+        reloader.start();
+
+        for ( int i = 0; i < 400 && reloader.reorder_count() == 0; ++i ) {
+            std::this_thread::sleep_for( std::chrono::milliseconds{ 5 } );
+        }
+
+        // later reorders find the order unchanged and publish nothing.
+        std::this_thread::sleep_for( std::chrono::milliseconds{ 30 } );
+        reloader.stop();
+        REQUIRE( reloader.reorder_count() == 1 );
+        CHECK( slot->generation() == 2 );
+        CHECK( *slot->load()->retrieve_shapes( centers[0] ).begin() == *(geofence_ptr->retrieve_shapes( centers[0] ).begin() + 1) );
+    }
+
+    SECTION( "Same Size Rewrite Triggers Rebuild" ) {
+        const std::string path{ "unit-test-data/test-data/reload.watch" };
+        const std::string replacement{ path + ".new" };
+        std::ofstream{ path } << "aaaa";
+
+        GeofenceReloader reloader{ slot, []() { return std::make_shared<const Geofence>( buildTestQuadTree(), 10.0 ); }, { path }, std::chrono::milliseconds{ 5 }, testLogger };
+        reloader.start();
+
+        // rewritten in place with the same size, well within the same second.
+        std::this_thread::sleep_for( std::chrono::milliseconds{ 20 } );
+        std::ofstream{ path } << "bbbb";
+
+        for ( int i = 0; i < 400 && reloader.reload_count() == 0; ++i ) {
+            std::this_thread::sleep_for( std::chrono::milliseconds{ 5 } );
+        }
+
+        CHECK( reloader.reload_count() == 1 );
+
+        // replaced by a file of the same size; only the inode is sure to differ.
+        std::ofstream{ replacement } << "cccc";
+        REQUIRE( std::rename( replacement.c_str(), path.c_str() ) == 0 );
+
+        for ( int i = 0; i < 400 && reloader.reload_count() == 1; ++i ) {
+            std::this_thread::sleep_for( std::chrono::milliseconds{ 5 } );
+        }
+
+        reloader.stop();
+        CHECK( reloader.reload_count() == 2 );
+        std::remove( path.c_str() );
+    }
+
+    SECTION( "Delta Applied At Load And Every Rebuild" ) {
+        const std::string path{ "unit-test-data/test-data/reload.delta" };
+        std::ofstream{ path } << "remove,edge,1\n";
+
+        // the map is indexed with a 10 m extension and the delta makes it 20 m; the index shows whether it has the delta.
+        // every version of the delta is applied to the map alone, never on top of an index with an earlier version.
+        std::atomic<int> deltas{ 0 };
+        std::atomic<int> stacked{ 0 };
+        GeofenceSlot::Ptr restarted = std::make_shared<GeofenceSlot>( nullptr );
+        GeofenceReloader reloader{ restarted, []() { return std::make_shared<const Geofence>( buildTestQuadTree(), 10.0 ); }, {}, std::chrono::milliseconds{ 5 }, testLogger };
+        reloader.watch_deltas( path, [&deltas, &stacked]( const Geofence& geofence ) {
+            ++deltas;
+            if (geofence.get_extension() != 10.0) ++stacked;
+            return std::make_shared<const Geofence>( buildTestQuadTree(), 20.0 );
+        } );
+
+        // a delta file present when the PPM starts is applied to the first index.
+        reloader.load();
+        CHECK( deltas == 1 );
+        CHECK( restarted->load()->get_extension() == 20.0 );
+
+        // the published index already has this version.
+        reloader.start();
+        std::this_thread::sleep_for( std::chrono::milliseconds{ 30 } );
+        CHECK( deltas == 1 );
+        CHECK( reloader.update_count() == 0 );
+
+        // a rebuild from the map applies it again rather than dropping it.
+        reloader.request_reload();
+        for ( int i = 0; i < 400 && reloader.reload_count() == 0; ++i ) {
+            std::this_thread::sleep_for( std::chrono::milliseconds{ 5 } );
+        }
+
+        REQUIRE( reloader.reload_count() == 1 );
+        CHECK( deltas == 2 );
+        CHECK( restarted->load()->get_extension() == 20.0 );
+        CHECK( reloader.update_count() == 0 );
+
+        // a new version is applied to the map the published index was built from, not to the published index.
+        std::this_thread::sleep_for( std::chrono::milliseconds{ 20 } );
+        std::ofstream{ path } << "remove,edge,2\n";
+        for ( int i = 0; i < 400 && reloader.update_count() == 0; ++i ) {
+            std::this_thread::sleep_for( std::chrono::milliseconds{ 5 } );
+        }
+
+        REQUIRE( reloader.update_count() == 1 );
+        CHECK( deltas == 3 );
+        CHECK( stacked == 0 );
+        CHECK( restarted->load()->get_extension() == 20.0 );
+
+        // once the file is removed a rebuild is the map alone.
+        std::remove( path.c_str() );
+        reloader.request_reload();
+        for ( int i = 0; i < 400 && reloader.reload_count() == 1; ++i ) {
+            std::this_thread::sleep_for( std::chrono::milliseconds{ 5 } );
+        }
+
+        reloader.stop();
+        REQUIRE( reloader.reload_count() == 2 );
+        CHECK( deltas == 3 );
+        CHECK( restarted->load()->get_extension() == 10.0 );
+    }
+
+    SECTION( "Failed Rebuild Keeps Current Geofence" ) {
+        GeofenceReloader reloader{ slot, []() -> Geofence::CPtr { throw std::invalid_argument( "bad map file" ); }, {}, std::chrono::milliseconds{ 5 }, testLogger };
+        reloader.start();
+        reloader.request_reload();
+        std::this_thread::sleep_for( std::chrono::milliseconds{ 50 } );
+        reloader.stop();
+
+        CHECK( reloader.reload_count() == 0 );
+        CHECK( slot->generation() == 0 );
+    }
+}
+
+TEST_CASE( "Geofence Share", "[ppm][geofenceshare]" ) {
+    const std::string path{ "unit-test-data/test-data/test.geofence.idx" };
+    std::remove( path.c_str() );
+
+    int builds = 0;
+    auto builder = [&builds]() {
+        ++builds;
+        return std::make_shared<const Geofence>( buildTestQuadTree(), 10.0 );
+    };
+
+    std::vector<std::string> files{ "unit-test-data/test-data/test.shapes" };
+    uint64_t stamp = GeofenceShare::fingerprint( files, "10.0" );
+    CHECK( stamp == GeofenceShare::fingerprint( files, "10.0" ) );
+    CHECK( stamp != GeofenceShare::fingerprint( files, "5.0" ) );
+
+    // the first process builds and writes the file; the next one maps it without building.
+    GeofenceShare first{ path, testLogger };
+    Geofence::CPtr built_ptr = first.acquire( stamp, builder );
+    CHECK( builds == 1 );
+    CHECK_FALSE( first.attached() );
+    CHECK_FALSE( built_ptr->has_source() );
+
+    GeofenceShare second{ path, testLogger };
+    Geofence::CPtr mapped_ptr = second.acquire( stamp, builder );
+    CHECK( builds == 1 );
+    CHECK( second.attached() );
+    CHECK( mapped_ptr->shape_count() == built_ptr->shape_count() );
+    CHECK( mapped_ptr->contains( geo::Point{ 35.951090, -83.930716 } ) );
+    CHECK_FALSE( mapped_ptr->contains( geo::Point{ 35.946920, -83.926738 } ) );
+
+    // a different stamp replaces the file; indices already mapped keep working.
+    Geofence::CPtr rebuilt_ptr = second.acquire( stamp + 1, builder );
+    CHECK( builds == 2 );
+    CHECK_FALSE( second.attached() );
+    CHECK( mapped_ptr->contains( geo::Point{ 35.951090, -83.930716 } ) );
+    CHECK( rebuilt_ptr->contains( geo::Point{ 35.951090, -83.930716 } ) );
+
+    // an unusable file location falls back to the built index.
+    GeofenceShare unusable{ "unit-test-data/no-such-directory/test.geofence.idx", testLogger };
+    Geofence::CPtr local_ptr = unusable.acquire( stamp, builder );
+    CHECK( builds == 3 );
+    CHECK( local_ptr->has_source() );
+
+    std::remove( path.c_str() );
+    std::remove( ( path + ".lock" ).c_str() );
+}
+
+TEST_CASE( "Geofence Tiles", "[ppm][geofencetiles]" ) {
+    const std::string path{ "unit-test-data/test-data/test.geofence.tiles" };
+    std::remove( path.c_str() );
+
+    shapes::CSVInputFactory factory{ "unit-test-data/test-data/test.shapes" };
+    factory.make_shapes();
+
+    std::vector<geo::Entity::CPtr> shapes;
+    shapes.insert( shapes.end(), factory.get_circles().begin(), factory.get_circles().end() );
+    shapes.insert( shapes.end(), factory.get_edges().begin(), factory.get_edges().end() );
+    shapes.insert( shapes.end(), factory.get_grids().begin(), factory.get_grids().end() );
+
+    geo::Bounds bounds{ geo::Point{}, geo::Point{} };
+    REQUIRE( factory.get_bounds( bounds ) );
+
+    // the index of the whole map that the tiles must agree with.
+    Quad::Ptr qptr = std::make_shared<Quad>( geo::Point{ bounds.sw.lat - 0.01, bounds.sw.lon - 0.01 }, geo::Point{ bounds.ne.lat + 0.01, bounds.ne.lon + 0.01 } );
+    for (auto& shape_ptr : shapes) {
+        Quad::insert( qptr, shape_ptr );
+    }
+    Geofence geofence{ qptr, 10.0 };
+
+    CHECK_THROWS_AS( GeofenceTiles::write( path, 7, shapes, 0.0, 10.0 ), std::invalid_argument );
+    CHECK_THROWS_AS( GeofenceTiles( path, 1 << 20 ), std::invalid_argument );
+
+    std::size_t written = GeofenceTiles::write( path, 7, shapes, 0.002, 10.0 );
+    CHECK( written > 4 );
+
+    GeofenceTiles tiles{ path, 1 << 30 };
+    CHECK( tiles.stamp() == 7 );
+    CHECK( tiles.tile_count() == written );
+    CHECK( tiles.loaded_count() == 0 );
+
+    // every position, including those along the tile borders, gets the answer of the whole map.
+    uint32_t inside = 0;
+    for (int i = 0; i <= 200; ++i) {
+        for (int j = 0; j <= 200; ++j) {
+            geo::Point pt{ bounds.sw.lat - 0.001 + i * (bounds.ne.lat - bounds.sw.lat + 0.002) / 200.0,
+                           bounds.sw.lon - 0.001 + j * (bounds.ne.lon - bounds.sw.lon + 0.002) / 200.0 };
+            bool expected = geofence.contains( pt );
+            REQUIRE( tiles.contains( pt ) == expected );
+            if (expected) ++inside;
+        }
+    }
+
+    CHECK( inside > 0 );
+    CHECK( tiles.loaded_count() == written );
+    CHECK( tiles.loads() == written );
+    CHECK( tiles.evictions() == 0 );
+
+    // under a cap of one byte only the last tile used is held; the others are read again when needed.
+    GeofenceTiles capped{ path, 1 };
+    Geofence::CPtr tile_ptr;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (auto& circle_ptr : factory.get_circles()) {
+            CHECK( capped.contains( *circle_ptr ) );
+            if (!tile_ptr) tile_ptr = capped.tile( *circle_ptr );
+        }
+    }
+
+    CHECK( capped.loaded_count() == 1 );
+    CHECK( capped.loads() == 6 );
+    CHECK( capped.evictions() == 5 );
+
+    // a dropped tile stays usable by whoever holds it.
+    REQUIRE( tile_ptr );
+    CHECK( tile_ptr->shape_count() > 0 );
+
+    // a tile that cannot be read after the file was truncated is told apart from one that is not in the file, read once,
+    // and answered per the fail open setting.
+    GeofenceTiles closed{ path, 1 << 30 };
+    GeofenceTiles open{ path, 1 << 30, true, testLogger };
+    CHECK_FALSE( closed.fail_open() );
+    CHECK( open.fail_open() );
+    REQUIRE( truncate( path.c_str(), 64 ) == 0 );
+
+    bool failed = false;
+    geo::Point away{ bounds.ne.lat + 1.0, bounds.ne.lon + 1.0 };
+    CHECK_FALSE( closed.tile( away, failed ) );
+    CHECK_FALSE( failed );
+    CHECK_FALSE( open.contains( away ) );
+
+    const geo::Circle& circle = *factory.get_circles().front();
+    for (int pass = 0; pass < 3; ++pass) {
+        CHECK_FALSE( closed.tile( circle, failed ) );
+        CHECK( failed );
+        CHECK_FALSE( closed.contains( circle ) );
+        CHECK( open.contains( circle ) );
+    }
+
+    CHECK( closed.failures() == 1 );
+    CHECK( closed.failed_lookups() == 6 );
+    CHECK( closed.loads() == 0 );
+    CHECK( open.failures() == 1 );
+
+    std::remove( path.c_str() );
+}
+
+TEST_CASE( "Geofence Cache", "[ppm][geofencecache]" ) {
+    Geofence geofence{ buildTestQuadTree(), 10.0 };
+    GeofenceCache cache{ 1.0, 4000 };
+    CHECK( cache.capacity() == 4096 );
+    CHECK( cache.cell_size() == 1.0 );
+    CHECK( GeofenceCache{ 0.0, 0 }.cell_size() == GeofenceCache::kMinCellSize );
+
+    // the cached answers are always the index's answers.
+    for (int pass = 0; pass < 2; ++pass) {
+        for (double lat = 35.9508; lat < 35.9513; lat += 0.000002) {
+            for (double lon = -83.9310; lon < -83.9305; lon += 0.000002) {
+                REQUIRE( cache.contains( geofence, geo::Point{ lat, lon } ) == geofence.contains( geo::Point{ lat, lon } ) );
+            }
+        }
+    }
+    CHECK( cache.hits() > cache.misses() );
+    CHECK( cache.ambiguous() > 0 );
+
+    // positions the key cannot hold go straight to the index.
+    uint64_t lookups = cache.hits() + cache.misses() + cache.ambiguous();
+    CHECK_FALSE( cache.contains( geofence, geo::Point{ 95.0, 0.0 } ) );
+    CHECK( cache.hits() + cache.misses() + cache.ambiguous() == lookups );
+
+    uint64_t misses = cache.misses();
+    cache.clear();
+    CHECK( cache.contains( geofence, geo::Point{ 35.951090, -83.930716 } ) );
+    CHECK( cache.misses() == misses + 1 );
+
+    // the handler uses a configured cache and clears it when a new geofence is published.
+    ConfigMap pconf;
+    REQUIRE( buildBaseConfiguration( pconf ) );
+    pconf["privacy.filter.geofence.cache.cell"] = "1.0";
+    pconf["privacy.filter.geofence.cache.size"] = "1024";
+    BSMHandler handler{ nullptr, pconf, testLogger };
+    REQUIRE( handler.get_geofence_cache() );
+    CHECK( handler.get_geofence_cache()->capacity() == 1024 );
+
+    pconf.erase( "privacy.filter.geofence.cache.cell" );
+    CHECK_FALSE( BSMHandler( nullptr, pconf, testLogger ).get_geofence_cache() );
+}
+
+TEST_CASE( "Privacy Zones", "[ppm][zones]" ) {
+    CHECK_THROWS_AS( PrivacyZones( 0.0, 300 ), std::invalid_argument );
+    CHECK_THROWS_AS( PrivacyZones( 100.0, 0 ), std::invalid_argument );
+
+    // a zone of 100 m for 300 s around the first position of each vehicle.
+    PrivacyZones zones{ 100.0, 300, 4 };
+    geo::Point start{ 42.2930, -83.7353 };
+    geo::Point near{ 42.2930 + 50.0 / PrivacyZones::kMetersPerDegree, -83.7353 };
+    geo::Point far{ 42.2930 + 150.0 / PrivacyZones::kMetersPerDegree, -83.7353 };
+    std::size_t memory = zones.memory_usage();
+
+    CHECK( zones.observe( "A", start, 1000 ) );
+    CHECK( zones.zone_count() == 1 );
+    CHECK_FALSE( zones.observe( "A", far, 1010 ) );
+    CHECK( zones.observe( "A", near, 1020 ) );
+    CHECK( zones.zone_count() == 1 );
+
+    // another vehicle has its own zone and is suppressed in the first one.
+    CHECK( zones.observe( "B", geo::Point{ 42.3, -83.7 }, 1030 ) );
+    CHECK( zones.observe( "B", near, 1040 ) );
+    CHECK( zones.vehicle_count() == 2 );
+
+    // the first zone expires 300 s after it was made; A is remembered until 300 s after it was last seen.
+    CHECK( zones.contains( start, 1299 ) );
+    CHECK_FALSE( zones.contains( start, 1300 ) );
+    CHECK( zones.zone_count() == 1 );
+    CHECK_FALSE( zones.observe( "A", start, 1310 ) );
+    CHECK( zones.observe( "A", start, 1611 ) );
+
+    // the zones closest to expiring make room for new ones.
+    for (int v = 0; v < 6; ++v) {
+        CHECK( zones.observe( "C" + std::to_string( v ), geo::Point{ 43.0 + v, -83.0 }, 1620 + v ) );
+    }
+    CHECK( zones.zone_count() == 4 );
+    CHECK( zones.evictions() > 0 );
+    CHECK_FALSE( zones.contains( geo::Point{ 43.0, -83.0 }, 1630 ) );
+    CHECK( zones.contains( geo::Point{ 48.0, -83.0 }, 1630 ) );
+    CHECK( zones.memory_usage() == memory );
+
+    // the zones always answer as a list of circles would, far north, across time jumps, and for durations longer than
+    // the wheel.
+    for (int64_t duration : { int64_t{ 30 }, int64_t{ 100000 } }) {
+        PrivacyZones many{ 250.0, duration, 1024 };
+        std::vector<std::pair<geo::Point, int64_t>> circles;
+        std::mt19937 generator{ 7 };
+        std::uniform_real_distribution<double> offset{ -0.02, 0.02 };
+        int64_t time = 5000;
+        int inside = 0;
+
+        for (int i = 0; i < 4000; ++i) {
+            double base = i % 2 == 0 ? 42.29 : 75.5;
+            geo::Point pt{ base + offset( generator ), -83.73 + offset( generator ) };
+            time += i % 500 == 499 ? duration / 2 + 7 : generator() % 3;
+
+            bool expected = false;
+            for (auto& circle : circles) {
+                double dlat = (pt.lat - circle.first.lat) * PrivacyZones::kMetersPerDegree;
+                double dlon = (pt.lon - circle.first.lon) * PrivacyZones::kMetersPerDegree * std::cos( pt.lat * M_PI / 180.0 );
+                expected = expected || (circle.second > time && dlat * dlat + dlon * dlon <= 250.0 * 250.0);
+            }
+
+            if (i % 4 == 0) {
+                REQUIRE( many.observe( "V" + std::to_string( i ), pt, time ) );
+                circles.emplace_back( pt, time + duration );
+            } else {
+                REQUIRE( many.contains( pt, time ) == expected );
+                inside += expected ? 1 : 0;
+            }
+        }
+
+        CHECK( many.evictions() == 0 );
+        CHECK( inside > 0 );
+    }
+
+    // the handler suppresses the first BSM of a vehicle, but not the later ones outside its zone.
+    ConfigMap pconf;
+    REQUIRE( buildBaseConfiguration( pconf ) );
+    pconf["privacy.filter.zones"] = "ON";
+    pconf["privacy.filter.zones.radius"] = "50";
+    pconf["privacy.filter.zones.duration"] = "600";
+    BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+    REQUIRE( handler.get_privacy_zones() );
+    CHECK( handler.get_privacy_zones()->radius() == 50.0 );
+
+    std::vector<std::string> json_test_cases;
+    REQUIRE( loadTestCases( "unit-test-data/test-case.inside.geofence.json", json_test_cases ) );
+    REQUIRE( json_test_cases.size() > 1 );
+    CHECK_FALSE( handler.process( json_test_cases[0] ) );
+    CHECK( handler.get_result_string() == "zone" );
+    for (std::size_t i = 1; i < json_test_cases.size(); ++i) {
+        CHECK( handler.process( json_test_cases[i] ) );
+    }
+    CHECK_FALSE( handler.process( json_test_cases[0] ) );
+    CHECK( handler.get_privacy_zones()->zone_count() == 1 );
+
+    pconf.erase( "privacy.filter.zones" );
+    CHECK_FALSE( BSMHandler( nullptr, pconf, testLogger ).get_privacy_zones() );
+}
+
 TEST_CASE( "BSMHandler JSON Error Checking", "[ppm][filtering][error]" ) {
     ConfigMap pconf;
 